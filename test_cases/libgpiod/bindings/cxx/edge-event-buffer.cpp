@@ -24,32 +24,56 @@ edge_event_buffer_ptr make_edge_event_buffer(unsigned int capacity)
 
 edge_event_buffer::impl::impl(unsigned int capacity)
 	: buffer(make_edge_event_buffer(capacity)),
+	  slots(),
 	  events()
 {
-	events.reserve(capacity);
+	/* The C library may have clamped the requested capacity. */
+	capacity = ::gpiod_edge_event_buffer_get_capacity(this->buffer.get());
 
+	this->slots.reset(new edge_event::impl_external[capacity]);
+	this->events.reserve(capacity);
+
+	/*
+	 * All slots live in a single allocation. Each event shares ownership
+	 * of the whole array instead of having a control block of its own.
+	 */
 	for (unsigned int i = 0; i < capacity; i++) {
-		events.push_back(edge_event());
-		events.back()._m_priv.reset(new edge_event::impl_external);
+		this->events.push_back(edge_event());
+		this->events.back()._m_priv = ::std::shared_ptr<edge_event::impl>(this->slots,
+										  &this->slots[i]);
 	}
 }
 
-int edge_event_buffer::impl::read_events(const line_request_ptr& request, unsigned int max_events)
+int edge_event_buffer::impl::read_events_noexcept(const line_request_ptr& request,
+						  unsigned int max_events) noexcept
 {
 	int ret = ::gpiod_line_request_read_edge_events(request.get(),
 						       this->buffer.get(), max_events);
 	if (ret < 0)
-		throw_from_errno("error reading edge events from file descriptor");
+		return ret;
 
-	for (int i = 0; i < ret; i++) {
-		::gpiod_edge_event* event = ::gpiod_edge_event_buffer_get_event(this->buffer.get(), i);
+	this->sync_events();
 
-		dynamic_cast<edge_event::impl_external&>(*this->events[i]._m_priv).event = event;
-	}
+	return ret;
+}
+
+int edge_event_buffer::impl::read_events(const line_request_ptr& request, unsigned int max_events)
+{
+	int ret = this->read_events_noexcept(request, max_events);
+	if (ret < 0)
+		throw_from_errno("error reading edge events from file descriptor");
 
 	return ret;
 }
 
+void edge_event_buffer::impl::sync_events() noexcept
+{
+	unsigned int num_events = ::gpiod_edge_event_buffer_get_num_events(this->buffer.get());
+
+	for (unsigned int i = 0; i < num_events; i++)
+		this->slots[i].event = ::gpiod_edge_event_buffer_get_event(this->buffer.get(), i);
+}
+
 GPIOD_CXX_API edge_event_buffer::edge_event_buffer(::std::size_t capacity)
 	: _m_priv(new impl(capacity))
 {
@@ -79,7 +103,7 @@ GPIOD_CXX_API const edge_event& edge_event_buffer::get_event(unsigned int index)
 	return this->_m_priv->events.at(index);
 }
 
-GPIOD_CXX_API ::std::size_t edge_event_buffer::num_events() const
+GPIOD_CXX_API ::std::size_t edge_event_buffer::num_events() const noexcept
 {
 	return ::gpiod_edge_event_buffer_get_num_events(this->_m_priv->buffer.get());
 }
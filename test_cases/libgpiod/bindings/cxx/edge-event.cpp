@@ -49,14 +49,13 @@ edge_event::impl_external::impl_external()
 ::std::shared_ptr<edge_event::impl>
 edge_event::impl_external::copy([[maybe_unused]] const ::std::shared_ptr<impl>& self) const
 {
-	::std::shared_ptr<impl> ret(new impl_managed);
-	impl_managed& managed = dynamic_cast<impl_managed&>(*ret);
+	auto managed = ::std::make_shared<impl_managed>();
 
-	managed.event.reset(::gpiod_edge_event_copy(this->event));
-	if (!managed.event)
+	managed->event.reset(::gpiod_edge_event_copy(this->event));
+	if (!managed->event)
 		throw_from_errno("unable to copy the edge event object");
 
-	return ret;
+	return managed;
 }
 
 edge_event::edge_event()
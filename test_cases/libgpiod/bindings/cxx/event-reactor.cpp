@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+#include <cerrno>
+#include <stdexcept>
+#include <utility>
+
+#include "internal.hpp"
+
+namespace gpiod {
+
+namespace {
+
+event_reactor_ptr make_event_reactor()
+{
+	event_reactor_ptr reactor(::gpiod_event_reactor_new());
+	if (!reactor)
+		throw_from_errno("unable to allocate the event reactor");
+
+	return reactor;
+}
+
+} /* namespace */
+
+event_reactor::impl::impl()
+	: reactor(make_event_reactor()),
+	  requests(),
+	  chips()
+{
+
+}
+
+GPIOD_CXX_API event_reactor::event_reactor()
+	: _m_priv(new impl)
+{
+
+}
+
+GPIOD_CXX_API event_reactor::event_reactor(event_reactor&& other) noexcept
+	: _m_priv(::std::move(other._m_priv))
+{
+
+}
+
+GPIOD_CXX_API event_reactor::~event_reactor()
+{
+
+}
+
+GPIOD_CXX_API event_reactor& event_reactor::operator=(event_reactor&& other) noexcept
+{
+	this->_m_priv = ::std::move(other._m_priv);
+
+	return *this;
+}
+
+GPIOD_CXX_API event_reactor&
+event_reactor::add_request(line_request& request, edge_event_buffer& buffer)
+{
+	request._m_priv->throw_if_released();
+
+	::gpiod_line_request* req_ptr = request._m_priv->request.get();
+
+	int ret = ::gpiod_event_reactor_add_request(this->_m_priv->reactor.get(),
+						   req_ptr, buffer._m_priv->buffer.get());
+	if (ret)
+		throw_from_errno("unable to add the line request to the event reactor");
+
+	this->_m_priv->requests[req_ptr] = { &request, &buffer };
+
+	return *this;
+}
+
+GPIOD_CXX_API event_reactor& event_reactor::remove_request(line_request& request)
+{
+	request._m_priv->throw_if_released();
+
+	::gpiod_line_request* req_ptr = request._m_priv->request.get();
+
+	int ret = ::gpiod_event_reactor_remove_request(this->_m_priv->reactor.get(), req_ptr);
+	if (ret)
+		throw_from_errno("unable to remove the line request from the event reactor");
+
+	this->_m_priv->requests.erase(req_ptr);
+
+	return *this;
+}
+
+GPIOD_CXX_API event_reactor& event_reactor::add_chip(chip& chip)
+{
+	chip._m_priv->throw_if_closed();
+
+	::gpiod_chip* chip_ptr = chip._m_priv->chip.get();
+
+	int ret = ::gpiod_event_reactor_add_chip(this->_m_priv->reactor.get(), chip_ptr);
+	if (ret)
+		throw_from_errno("unable to add the chip to the event reactor");
+
+	this->_m_priv->chips[chip_ptr] = &chip;
+
+	return *this;
+}
+
+GPIOD_CXX_API event_reactor& event_reactor::remove_chip(chip& chip)
+{
+	chip._m_priv->throw_if_closed();
+
+	::gpiod_chip* chip_ptr = chip._m_priv->chip.get();
+
+	int ret = ::gpiod_event_reactor_remove_chip(this->_m_priv->reactor.get(), chip_ptr);
+	if (ret)
+		throw_from_errno("unable to remove the chip from the event reactor");
+
+	this->_m_priv->chips.erase(chip_ptr);
+
+	return *this;
+}
+
+GPIOD_CXX_API int event_reactor::fd() const noexcept
+{
+	return ::gpiod_event_reactor_get_fd(this->_m_priv->reactor.get());
+}
+
+GPIOD_CXX_API ::std::size_t event_reactor::num_sources() const noexcept
+{
+	return ::gpiod_event_reactor_get_num_sources(this->_m_priv->reactor.get());
+}
+
+GPIOD_CXX_API ::std::size_t event_reactor::wait(const ::std::chrono::nanoseconds& timeout)
+{
+	int ret = ::gpiod_event_reactor_wait(this->_m_priv->reactor.get(), timeout.count());
+	if (ret < 0)
+		throw_from_errno("error waiting for events");
+
+	for (::std::size_t i = 0; i < this->num_ready_requests(); i++) {
+		edge_event_buffer& buffer = this->get_ready_buffer(i);
+
+		buffer._m_priv->sync_events();
+	}
+
+	/* Events of the other requests stay available to the caller. */
+	if (this->num_failed_requests()) {
+		errno = ::gpiod_event_reactor_get_failed_error(this->_m_priv->reactor.get(), 0);
+		throw_from_errno("error reading edge events");
+	}
+
+	return ret;
+}
+
+GPIOD_CXX_API ::std::size_t event_reactor::num_ready_requests() const noexcept
+{
+	return ::gpiod_event_reactor_get_num_ready_requests(this->_m_priv->reactor.get());
+}
+
+GPIOD_CXX_API line_request& event_reactor::get_ready_request(::std::size_t index) const
+{
+	::gpiod_line_request* req_ptr =
+		::gpiod_event_reactor_get_ready_request(this->_m_priv->reactor.get(), index);
+	if (!req_ptr)
+		throw ::std::out_of_range("ready line request index out of range");
+
+	return *this->_m_priv->requests.at(req_ptr).first;
+}
+
+GPIOD_CXX_API edge_event_buffer& event_reactor::get_ready_buffer(::std::size_t index) const
+{
+	::gpiod_line_request* req_ptr =
+		::gpiod_event_reactor_get_ready_request(this->_m_priv->reactor.get(), index);
+	if (!req_ptr)
+		throw ::std::out_of_range("ready line request index out of range");
+
+	return *this->_m_priv->requests.at(req_ptr).second;
+}
+
+GPIOD_CXX_API ::std::size_t event_reactor::num_ready_chips() const noexcept
+{
+	return ::gpiod_event_reactor_get_num_ready_chips(this->_m_priv->reactor.get());
+}
+
+GPIOD_CXX_API chip& event_reactor::get_ready_chip(::std::size_t index) const
+{
+	::gpiod_chip* chip_ptr =
+		::gpiod_event_reactor_get_ready_chip(this->_m_priv->reactor.get(), index);
+	if (!chip_ptr)
+		throw ::std::out_of_range("ready chip index out of range");
+
+	return *this->_m_priv->chips.at(chip_ptr);
+}
+
+GPIOD_CXX_API ::std::size_t event_reactor::num_failed_requests() const noexcept
+{
+	return ::gpiod_event_reactor_get_num_failed_requests(this->_m_priv->reactor.get());
+}
+
+GPIOD_CXX_API line_request& event_reactor::get_failed_request(::std::size_t index) const
+{
+	::gpiod_line_request* req_ptr =
+		::gpiod_event_reactor_get_failed_request(this->_m_priv->reactor.get(), index);
+	if (!req_ptr)
+		throw ::std::out_of_range("failed line request index out of range");
+
+	return *this->_m_priv->requests.at(req_ptr).first;
+}
+
+} /* namespace gpiod */
@@ -34,6 +34,7 @@
 #include "gpiodcxx/chip-info.hpp"
 #include "gpiodcxx/edge-event.hpp"
 #include "gpiodcxx/edge-event-buffer.hpp"
+#include "gpiodcxx/event-reactor.hpp"
 #include "gpiodcxx/exception.hpp"
 #include "gpiodcxx/info-event.hpp"
 #include "gpiodcxx/line.hpp"
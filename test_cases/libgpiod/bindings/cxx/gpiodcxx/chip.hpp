@@ -23,6 +23,7 @@
 namespace gpiod {
 
 class chip_info;
+class event_reactor;
 class info_event;
 class line_config;
 class line_info;
@@ -162,6 +163,7 @@ private:
 
 	chip(const chip& other);
 
+	friend event_reactor;
 	friend request_builder;
 };
 
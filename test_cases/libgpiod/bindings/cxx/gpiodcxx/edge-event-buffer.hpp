@@ -20,6 +20,7 @@
 namespace gpiod {
 
 class edge_event;
+class event_reactor;
 class line_request;
 
 /**
@@ -32,7 +33,9 @@ class line_request;
  *
  * The edge_event_buffer allows reading edge_event objects into an existing
  * buffer which improves the performance by avoiding needless memory
- * allocations.
+ * allocations. Events stored in the buffer are views over the underlying
+ * C buffer and are only valid until the next read. Copy an event to keep it
+ * around for longer.
  */
 class edge_event_buffer final
 {
@@ -81,7 +84,7 @@ public:
 	 * @brief Get the number of edge events currently stored in the buffer.
 	 * @return Number of edge events in the buffer.
 	 */
-	::std::size_t num_events() const;
+	::std::size_t num_events() const noexcept;
 
 	/**
 	 * @brief Maximum capacity of the buffer.
@@ -109,6 +112,7 @@ private:
 
 	::std::unique_ptr<impl> _m_priv;
 
+	friend event_reactor;
 	friend line_request;
 };
 
@@ -0,0 +1,187 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* SPDX-FileCopyrightText: 2026 agent <agent@local> */
+
+/**
+ * @file event-reactor.hpp
+ */
+
+#ifndef __LIBGPIOD_CXX_EVENT_REACTOR_HPP__
+#define __LIBGPIOD_CXX_EVENT_REACTOR_HPP__
+
+#if !defined(__LIBGPIOD_GPIOD_CXX_INSIDE__)
+#error "Only gpiod.hpp can be included directly."
+#endif
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
+namespace gpiod {
+
+class chip;
+class edge_event_buffer;
+class line_request;
+
+/**
+ * @ingroup gpiod_cxx
+ * @{
+ */
+
+/**
+ * @brief Waits for events on many line requests and chips at once.
+ *
+ * Each line request is registered together with an edge event buffer. A
+ * single call to wait() blocks until any of the registered objects becomes
+ * ready and reads the pending edge events of every ready request into its
+ * buffer.
+ *
+ * The reactor stores references to the registered objects. They must not be
+ * moved or destroyed before being removed from the reactor.
+ */
+class event_reactor final
+{
+public:
+
+	/**
+	 * @brief Constructor. Creates a new, empty event reactor.
+	 */
+	event_reactor();
+
+	event_reactor(const event_reactor& other) = delete;
+
+	/**
+	 * @brief Move constructor.
+	 * @param other Object to move.
+	 */
+	event_reactor(event_reactor&& other) noexcept;
+
+	~event_reactor();
+
+	event_reactor& operator=(const event_reactor& other) = delete;
+
+	/**
+	 * @brief Move assignment operator.
+	 * @param other Object to move.
+	 * @return Reference to self.
+	 */
+	event_reactor& operator=(event_reactor&& other) noexcept;
+
+	/**
+	 * @brief Start watching a line request for edge events.
+	 * @param request Line request to watch.
+	 * @param buffer Buffer into which edge events of this request are read.
+	 * @return Reference to self.
+	 */
+	event_reactor& add_request(line_request& request, edge_event_buffer& buffer);
+
+	/**
+	 * @brief Stop watching a line request.
+	 * @param request Line request to remove.
+	 * @return Reference to self.
+	 */
+	event_reactor& remove_request(line_request& request);
+
+	/**
+	 * @brief Start watching a chip for line status events.
+	 * @param chip GPIO chip to watch.
+	 * @return Reference to self.
+	 */
+	event_reactor& add_chip(chip& chip);
+
+	/**
+	 * @brief Stop watching a chip.
+	 * @param chip GPIO chip to remove.
+	 * @return Reference to self.
+	 */
+	event_reactor& remove_chip(chip& chip);
+
+	/**
+	 * @brief Get the file descriptor associated with this reactor.
+	 * @return File descriptor number.
+	 */
+	int fd() const noexcept;
+
+	/**
+	 * @brief Get the number of objects watched by this reactor.
+	 * @return Number of registered line requests and chips.
+	 */
+	::std::size_t num_sources() const noexcept;
+
+	/**
+	 * @brief Wait for events on any of the registered objects.
+	 * @param timeout Wait time limit in nanoseconds. If set to 0, the
+	 *                function returns immediatelly. If set to a negative
+	 *                number, the function blocks indefinitely until an
+	 *                event becomes available.
+	 * @return Number of objects that became ready or 0 if the wait timed
+	 *         out.
+	 * @note If reading the events of a line request fails, an exception
+	 *       is thrown only after the buffers of all other ready requests
+	 *       have been filled. Failed requests can be retrieved with
+	 *       get_failed_request().
+	 */
+	::std::size_t wait(const ::std::chrono::nanoseconds& timeout);
+
+	/**
+	 * @brief Get the number of line requests for which events were read
+	 *        by the last call to wait().
+	 * @return Number of ready line requests.
+	 */
+	::std::size_t num_ready_requests() const noexcept;
+
+	/**
+	 * @brief Get a line request for which events were read.
+	 * @param index Index of the ready line request.
+	 * @return Reference to the line request.
+	 */
+	line_request& get_ready_request(::std::size_t index) const;
+
+	/**
+	 * @brief Get the edge event buffer of a ready line request.
+	 * @param index Index of the ready line request.
+	 * @return Reference to the buffer holding the events just read.
+	 */
+	edge_event_buffer& get_ready_buffer(::std::size_t index) const;
+
+	/**
+	 * @brief Get the number of chips with pending line status events
+	 *        after the last call to wait().
+	 * @return Number of ready chips.
+	 */
+	::std::size_t num_ready_chips() const noexcept;
+
+	/**
+	 * @brief Get a chip with pending line status events.
+	 * @param index Index of the ready chip.
+	 * @return Reference to the chip.
+	 */
+	chip& get_ready_chip(::std::size_t index) const;
+
+	/**
+	 * @brief Get the number of line requests for which reading events
+	 *        failed during the last call to wait().
+	 * @return Number of failed line requests.
+	 */
+	::std::size_t num_failed_requests() const noexcept;
+
+	/**
+	 * @brief Get a line request for which reading events failed.
+	 * @param index Index of the failed line request.
+	 * @return Reference to the line request.
+	 */
+	line_request& get_failed_request(::std::size_t index) const;
+
+private:
+
+	struct impl;
+
+	::std::unique_ptr<impl> _m_priv;
+};
+
+/**
+ * @}
+ */
+
+} /* namespace gpiod */
+
+#endif /* __LIBGPIOD_CXX_EVENT_REACTOR_HPP__ */
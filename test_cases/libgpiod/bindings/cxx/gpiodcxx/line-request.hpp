@@ -16,6 +16,7 @@
 #include <cstddef>
 #include <iostream>
 #include <memory>
+#include <system_error>
 
 #include "misc.hpp"
 
@@ -24,6 +25,7 @@ namespace gpiod {
 class chip;
 class edge_event;
 class edge_event_buffer;
+class event_reactor;
 class line_config;
 
 /**
@@ -208,6 +210,19 @@ public:
 	 */
 	::std::size_t read_edge_events(edge_event_buffer& buffer, ::std::size_t max_events);
 
+	/**
+	 * @brief Read a number of edge events from this request up to the
+	 *        maximum capacity of the buffer without throwing.
+	 * @param buffer Edge event buffer to read events into.
+	 * @param ec Set to the error that occurred or cleared on success.
+	 * @return Number of events read or 0 on error.
+	 * @note Together with the iterators of edge_event_buffer this allows
+	 *       reading and processing edge events without allocating memory
+	 *       or throwing exceptions.
+	 */
+	::std::size_t read_edge_events(edge_event_buffer& buffer,
+				       ::std::error_code& ec) noexcept;
+
 private:
 
 	line_request();
@@ -216,6 +231,7 @@ private:
 
 	::std::unique_ptr<impl> _m_priv;
 
+	friend event_reactor;
 	friend request_builder;
 };
 
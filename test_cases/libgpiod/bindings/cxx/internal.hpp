@@ -50,6 +50,7 @@ using line_request_deleter = deleter<::gpiod_line_request, ::gpiod_line_request_
 using edge_event_deleter = deleter<::gpiod_edge_event, ::gpiod_edge_event_free>;
 using edge_event_buffer_deleter = deleter<::gpiod_edge_event_buffer,
 					  ::gpiod_edge_event_buffer_free>;
+using event_reactor_deleter = deleter<::gpiod_event_reactor, ::gpiod_event_reactor_free>;
 
 using chip_ptr = ::std::unique_ptr<::gpiod_chip, chip_deleter>;
 using chip_info_ptr = ::std::unique_ptr<::gpiod_chip_info, chip_info_deleter>;
@@ -62,6 +63,7 @@ using line_request_ptr = ::std::unique_ptr<::gpiod_line_request, line_request_de
 using edge_event_ptr = ::std::unique_ptr<::gpiod_edge_event, edge_event_deleter>;
 using edge_event_buffer_ptr = ::std::unique_ptr<::gpiod_edge_event_buffer,
 						edge_event_buffer_deleter>;
+using event_reactor_ptr = ::std::unique_ptr<::gpiod_event_reactor, event_reactor_deleter>;
 
 struct chip::impl
 {
@@ -224,11 +226,27 @@ struct edge_event_buffer::impl
 	impl& operator=(impl&& other) = delete;
 
 	int read_events(const line_request_ptr& request, unsigned int max_events);
+	int read_events_noexcept(const line_request_ptr& request, unsigned int max_events) noexcept;
+	void sync_events() noexcept;
 
 	edge_event_buffer_ptr buffer;
+	::std::shared_ptr<edge_event::impl_external[]> slots;
 	::std::vector<edge_event> events;
 };
 
+struct event_reactor::impl
+{
+	impl();
+	impl(const impl& other) = delete;
+	impl(impl&& other) = delete;
+	impl& operator=(const impl& other) = delete;
+	impl& operator=(impl&& other) = delete;
+
+	event_reactor_ptr reactor;
+	::std::map<::gpiod_line_request*, ::std::pair<line_request*, edge_event_buffer*>> requests;
+	::std::map<::gpiod_chip*, chip*> chips;
+};
+
 } /* namespace gpiod */
 
 #endif /* __LIBGPIOD_CXX_INTERNAL_HPP__ */
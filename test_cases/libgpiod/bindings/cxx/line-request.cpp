@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 // SPDX-FileCopyrightText: 2021-2022 Bartosz Golaszewski <brgl@bgdev.pl>
 
+#include <cerrno>
 #include <iterator>
 #include <ostream>
 #include <utility>
@@ -224,6 +225,26 @@ line_request::read_edge_events(edge_event_buffer& buffer, ::std::size_t max_even
 	return buffer._m_priv->read_events(this->_m_priv->request, max_events);
 }
 
+GPIOD_CXX_API ::std::size_t
+line_request::read_edge_events(edge_event_buffer& buffer, ::std::error_code& ec) noexcept
+{
+	if (!this->_m_priv->request) {
+		ec = ::std::error_code(EBADF, ::std::system_category());
+		return 0;
+	}
+
+	int ret = buffer._m_priv->read_events_noexcept(this->_m_priv->request,
+						       buffer.capacity());
+	if (ret < 0) {
+		ec = ::std::error_code(errno, ::std::system_category());
+		return 0;
+	}
+
+	ec.clear();
+
+	return ret;
+}
+
 GPIOD_CXX_API ::std::ostream& operator<<(::std::ostream& out, const line_request& request)
 {
 	if (!request)
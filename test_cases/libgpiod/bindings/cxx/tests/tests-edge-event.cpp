@@ -5,8 +5,10 @@
 #include <chrono>
 #include <gpiod.hpp>
 #include <sstream>
+#include <system_error>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "gpiosim.hpp"
 #include "helpers.hpp"
@@ -270,6 +272,75 @@ TEST_CASE("reading multiple events", "[edge-event]")
 		REQUIRE(request.read_edge_events(buffer) == 2);
 		REQUIRE(buffer.num_events() == 2);
 	}
+
+	SECTION("read without exceptions")
+	{
+		::gpiod::edge_event_buffer buffer;
+		::std::error_code ec;
+
+		REQUIRE(request.wait_edge_events(::std::chrono::seconds(1)));
+		REQUIRE(request.read_edge_events(buffer, ec) == 3);
+		REQUIRE_FALSE(ec);
+
+		for (const auto& event: buffer)
+			REQUIRE(event.line_seqno() == line_seqno++);
+
+		request.release();
+		REQUIRE(request.read_edge_events(buffer, ec) == 0);
+		REQUIRE(ec.value() == EBADF);
+	}
+}
+
+TEST_CASE("edge_event_buffer benchmarks", "[edge-event][!benchmark]")
+{
+	static constexpr unsigned int num_edges = 64;
+
+	auto sim = make_sim()
+		.set_num_lines(8)
+		.build();
+
+	::gpiod::chip chip(sim.dev_path());
+
+	auto request = chip
+		.prepare_request()
+		.add_line_settings(
+			1,
+			::gpiod::line_settings()
+				.set_edge_detection(edge::BOTH)
+		)
+		.do_request();
+
+	for (unsigned int i = 0; i < num_edges; i++)
+		sim.set_pull(1, i % 2 ? pull::PULL_DOWN : pull::PULL_UP);
+
+	::gpiod::edge_event_buffer buffer(1024);
+	::std::error_code ec;
+
+	REQUIRE(request.wait_edge_events(::std::chrono::seconds(1)));
+	REQUIRE(request.read_edge_events(buffer, ec) == num_edges);
+
+	BENCHMARK("allocate a 1024-slot buffer")
+	{
+		return ::gpiod::edge_event_buffer(1024);
+	};
+
+	BENCHMARK("iterate over buffered events")
+	{
+		unsigned long sum = 0;
+
+		for (const auto& event: buffer)
+			sum += event.timestamp_ns() + event.line_offset() +
+			       event.line_seqno() + event.global_seqno();
+
+		return sum;
+	};
+
+	BENCHMARK("copy buffered events")
+	{
+		::std::vector<::gpiod::edge_event> copies(buffer.begin(), buffer.end());
+
+		return copies.size();
+	};
 }
 
 TEST_CASE("edge_event_buffer can be moved", "[edge-event]")
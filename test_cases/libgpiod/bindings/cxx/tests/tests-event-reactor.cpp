@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <fcntl.h>
+#include <gpiod.hpp>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+#include "gpiosim.hpp"
+#include "helpers.hpp"
+
+using ::gpiosim::make_sim;
+using direction = ::gpiod::line::direction;
+using edge = ::gpiod::line::edge;
+using pull = ::gpiosim::chip::pull;
+using event_type = ::gpiod::edge_event::event_type;
+using info_event_type = ::gpiod::info_event::event_type;
+
+namespace {
+
+::gpiod::line_request request_edge_events(::gpiod::chip& chip, unsigned int offset)
+{
+	return chip.prepare_request()
+		.add_line_settings(
+			offset,
+			::gpiod::line_settings()
+				.set_direction(direction::INPUT)
+				.set_edge_detection(edge::BOTH)
+		)
+		.do_request();
+}
+
+TEST_CASE("event_reactor wait timeout", "[event-reactor]")
+{
+	auto sim = make_sim().build();
+	::gpiod::chip chip(sim.dev_path());
+	::gpiod::edge_event_buffer buffer;
+	::gpiod::event_reactor reactor;
+
+	auto request = request_edge_events(chip, 0);
+
+	reactor.add_request(request, buffer);
+	REQUIRE(reactor.num_sources() == 1);
+	REQUIRE(reactor.fd() >= 0);
+
+	REQUIRE(reactor.wait(::std::chrono::milliseconds(10)) == 0);
+	REQUIRE(reactor.num_ready_requests() == 0);
+	REQUIRE_THROWS_AS(reactor.get_ready_request(0), ::std::out_of_range);
+}
+
+TEST_CASE("event_reactor registration errors", "[event-reactor]")
+{
+	auto sim = make_sim().build();
+	::gpiod::chip chip(sim.dev_path());
+	::gpiod::edge_event_buffer buffer;
+	::gpiod::event_reactor reactor;
+
+	auto request = request_edge_events(chip, 0);
+
+	SECTION("adding the same request twice fails")
+	{
+		reactor.add_request(request, buffer);
+		REQUIRE_THROWS_MATCHES(
+			reactor.add_request(request, buffer),
+			::std::system_error,
+			::system_error_matcher(EEXIST)
+		);
+	}
+
+	SECTION("removing an unregistered chip fails")
+	{
+		REQUIRE_THROWS_MATCHES(
+			reactor.remove_chip(chip),
+			::std::system_error,
+			::system_error_matcher(ENOENT)
+		);
+	}
+
+	SECTION("waiting with no sources fails")
+	{
+		REQUIRE_THROWS_MATCHES(
+			reactor.wait(::std::chrono::milliseconds(10)),
+			::std::system_error,
+			::system_error_matcher(ENOENT)
+		);
+	}
+}
+
+TEST_CASE("event_reactor reads events from many requests", "[event-reactor]")
+{
+	auto sim0 = make_sim().set_num_lines(4).build();
+	auto sim1 = make_sim().set_num_lines(4).build();
+	::gpiod::chip chip0(sim0.dev_path());
+	::gpiod::chip chip1(sim1.dev_path());
+	::gpiod::edge_event_buffer buffer0, buffer1, buffer2;
+	::gpiod::event_reactor reactor;
+
+	auto request0 = request_edge_events(chip0, 1);
+	auto request1 = request_edge_events(chip1, 2);
+	auto request2 = request_edge_events(chip1, 3);
+
+	reactor
+		.add_request(request0, buffer0)
+		.add_request(request1, buffer1)
+		.add_request(request2, buffer2);
+
+	sim0.set_pull(1, pull::PULL_UP);
+	sim1.set_pull(3, pull::PULL_UP);
+	sim1.set_pull(3, pull::PULL_DOWN);
+
+	REQUIRE(reactor.wait(::std::chrono::seconds(1)) == 2);
+	REQUIRE(reactor.num_ready_requests() == 2);
+	REQUIRE(reactor.num_ready_chips() == 0);
+
+	for (::std::size_t i = 0; i < reactor.num_ready_requests(); i++) {
+		auto& request = reactor.get_ready_request(i);
+		auto& buffer = reactor.get_ready_buffer(i);
+
+		if (&request == &request0) {
+			REQUIRE(&buffer == &buffer0);
+			REQUIRE(buffer.num_events() == 1);
+			REQUIRE(buffer.get_event(0).type() == event_type::RISING_EDGE);
+			REQUIRE(buffer.get_event(0).line_offset() == 1);
+		} else {
+			REQUIRE(&request == &request2);
+			REQUIRE(&buffer == &buffer2);
+			REQUIRE(buffer.num_events() == 2);
+			REQUIRE(buffer.get_event(1).type() == event_type::FALLING_EDGE);
+			REQUIRE(buffer.get_event(1).line_offset() == 3);
+		}
+	}
+
+	reactor.remove_request(request0);
+	REQUIRE(reactor.num_sources() == 2);
+}
+
+TEST_CASE("event_reactor keeps events of other requests if one fails", "[event-reactor]")
+{
+	auto sim = make_sim().set_num_lines(4).build();
+	::gpiod::chip chip(sim.dev_path());
+	::gpiod::edge_event_buffer buffer0, buffer1;
+	::gpiod::event_reactor reactor;
+
+	auto request0 = request_edge_events(chip, 1);
+	auto request1 = request_edge_events(chip, 3);
+
+	reactor
+		.add_request(request0, buffer0)
+		.add_request(request1, buffer1);
+
+	/* make reading fail while epoll keeps watching the request */
+	int fd = request0.fd();
+	int saved_fd = ::dup(fd);
+	int null_fd = ::open("/dev/null", O_WRONLY);
+	REQUIRE(saved_fd >= 0);
+	REQUIRE(null_fd >= 0);
+	REQUIRE(::dup2(null_fd, fd) == fd);
+
+	sim.set_pull(1, pull::PULL_UP);
+	sim.set_pull(3, pull::PULL_UP);
+
+	REQUIRE_THROWS_AS(reactor.wait(::std::chrono::seconds(1)), ::std::system_error);
+
+	REQUIRE(reactor.num_ready_requests() == 1);
+	REQUIRE(&reactor.get_ready_request(0) == &request1);
+	REQUIRE(buffer1.num_events() == 1);
+	REQUIRE(buffer1.get_event(0).line_offset() == 3);
+
+	REQUIRE(reactor.num_failed_requests() == 1);
+	REQUIRE(&reactor.get_failed_request(0) == &request0);
+	REQUIRE_THROWS_AS(reactor.get_failed_request(1), ::std::out_of_range);
+
+	::dup2(saved_fd, fd);
+	::close(saved_fd);
+	::close(null_fd);
+}
+
+TEST_CASE("event_reactor reports chips with info events", "[event-reactor]")
+{
+	auto sim = make_sim().build();
+	::gpiod::chip chip(sim.dev_path());
+	::gpiod::event_reactor reactor;
+
+	chip.watch_line_info(2);
+	reactor.add_chip(chip);
+
+	auto request = chip.prepare_request()
+		.add_line_settings(2, ::gpiod::line_settings())
+		.do_request();
+
+	REQUIRE(reactor.wait(::std::chrono::seconds(1)) == 1);
+	REQUIRE(reactor.num_ready_chips() == 1);
+	REQUIRE(&reactor.get_ready_chip(0) == &chip);
+	REQUIRE(chip.read_info_event().type() == info_event_type::LINE_REQUESTED);
+
+	reactor.remove_chip(chip);
+}
+
+} /* namespace */
@@ -82,6 +82,17 @@ struct gpiod_chip_info;
 */
 struct gpiod_line_info;
 
+/**
+ * @struct gpiod_line_info_snapshot
+ * @{
+ *
+ * Refer to @ref line_info_snapshot for functions that operate on
+ * gpiod_line_info_snapshot.
+ *
+ * @}
+*/
+struct gpiod_line_info_snapshot;
+
 /**
  * @struct gpiod_line_settings
  * @{
@@ -156,6 +167,17 @@ struct gpiod_edge_event;
 */
 struct gpiod_edge_event_buffer;
 
+/**
+ * @struct gpiod_event_reactor
+ * @{
+ *
+ * Refer to @ref event_reactor for functions that operate on
+ * gpiod_event_reactor.
+ *
+ * @}
+*/
+struct gpiod_event_reactor;
+
 /**
  * @defgroup chips GPIO chips
  * @{
@@ -209,6 +231,24 @@ const char *gpiod_chip_get_path(struct gpiod_chip *chip);
 struct gpiod_line_info *gpiod_chip_get_line_info(struct gpiod_chip *chip,
 						 unsigned int offset);
 
+/**
+ * @brief Read the status of all lines exposed by the chip into a snapshot.
+ * @param chip GPIO chip object.
+ * @param snapshot Line info snapshot to fill. Any previous contents are
+ *                 discarded.
+ * @return Number of lines stored in the snapshot or -1 on error.
+ * @note If the chip exposes more lines than the snapshot can hold, only the
+ *       lines up to the snapshot's capacity are read.
+ * @note If an error occurs, the contents of the snapshot are undefined until
+ *       it is successfully filled again.
+ *
+ * Unlike calling ::gpiod_chip_get_line_info for every line, this doesn't
+ * allocate any memory and indexes the line names so that they can be looked
+ * up without further system calls.
+ */
+int gpiod_chip_read_line_info_snapshot(struct gpiod_chip *chip,
+				       struct gpiod_line_info_snapshot *snapshot);
+
 /**
  * @brief Get a snapshot of the status of a line and start watching it for
  *        future changes.
@@ -576,6 +616,79 @@ gpiod_line_info_get_debounce_period_us(struct gpiod_line_info *info);
 enum gpiod_line_clock
 gpiod_line_info_get_event_clock(struct gpiod_line_info *info);
 
+/**
+ * @}
+ *
+ * @defgroup line_info_snapshot Line info snapshots
+ * @{
+ *
+ * A line info snapshot holds the line info objects for all lines of a chip,
+ * stored in a single contiguous allocation owned by the caller. It can be
+ * refilled any number of times using ::gpiod_chip_read_line_info_snapshot
+ * without allocating more memory.
+ *
+ * Line info objects returned by ::gpiod_line_info_snapshot_get_line_info are
+ * owned by the snapshot. They must not be freed by the caller and are only
+ * valid until the snapshot is refilled or freed. Use ::gpiod_line_info_copy
+ * to keep them around for longer.
+ */
+
+/**
+ * @brief Create a new line info snapshot.
+ * @param capacity Maximum number of lines the snapshot can hold. Typically
+ *                 the number of lines of the chip, as returned by
+ *                 ::gpiod_chip_info_get_num_lines. Must be greater than 0.
+ * @return New line info snapshot or NULL on error. The returned object must
+ *         be freed by the caller using ::gpiod_line_info_snapshot_free.
+ */
+struct gpiod_line_info_snapshot *gpiod_line_info_snapshot_new(size_t capacity);
+
+/**
+ * @brief Free a line info snapshot and release all associated resources.
+ * @param snapshot Line info snapshot to free.
+ */
+void gpiod_line_info_snapshot_free(struct gpiod_line_info_snapshot *snapshot);
+
+/**
+ * @brief Get the capacity of the snapshot.
+ * @param snapshot Line info snapshot.
+ * @return Maximum number of lines the snapshot can hold.
+ */
+size_t
+gpiod_line_info_snapshot_get_capacity(struct gpiod_line_info_snapshot *snapshot);
+
+/**
+ * @brief Get the number of lines currently stored in the snapshot.
+ * @param snapshot Line info snapshot.
+ * @return Number of lines stored in the snapshot.
+ */
+size_t
+gpiod_line_info_snapshot_get_num_lines(struct gpiod_line_info_snapshot *snapshot);
+
+/**
+ * @brief Get the line info of a line stored in the snapshot.
+ * @param snapshot Line info snapshot.
+ * @param offset Offset of the line.
+ * @return Pointer to the line info object or NULL if the offset is not
+ *         stored in the snapshot. The returned object is owned by the
+ *         snapshot and must not be freed by the caller.
+ */
+struct gpiod_line_info *
+gpiod_line_info_snapshot_get_line_info(
+		struct gpiod_line_info_snapshot *snapshot, unsigned int offset);
+
+/**
+ * @brief Map a line's name to its offset using the snapshot's name index.
+ * @param snapshot Line info snapshot.
+ * @param name Name of the GPIO line to map.
+ * @return Offset of the line or -1 on error.
+ * @note If the snapshot holds no line with given name, the function sets
+ *       errno to ENOENT. If multiple lines share the name, the lowest offset
+ *       is returned.
+ */
+int gpiod_line_info_snapshot_find_line(struct gpiod_line_info_snapshot *snapshot,
+				       const char *name);
+
 /**
  * @}
  *
@@ -1094,6 +1207,21 @@ int gpiod_line_request_get_values_subset(struct gpiod_line_request *request,
 int gpiod_line_request_get_values(struct gpiod_line_request *request,
 				  enum gpiod_line_value *values);
 
+/**
+ * @brief Get the values of requested lines using a bitmap.
+ * @param request GPIO line request.
+ * @param mask Bitmap selecting the lines to read. Bit N corresponds to the
+ *             line at index N in the offset array filled by
+ *             ::gpiod_line_request_get_requested_offsets.
+ * @param bits Location in which the values will be stored. Bit N is set if
+ *             the line at index N is active. Bits not set in \p mask are
+ *             cleared.
+ * @return 0 on success, -1 on failure.
+ * @note Selecting a bit beyond the number of requested lines is an error.
+ */
+int gpiod_line_request_get_values_mask(struct gpiod_line_request *request,
+				       uint64_t mask, uint64_t *bits);
+
 /**
  * @brief Set the value of a single requested line.
  * @param request Line request object.
@@ -1136,6 +1264,20 @@ int gpiod_line_request_set_values_subset(struct gpiod_line_request *request,
 int gpiod_line_request_set_values(struct gpiod_line_request *request,
 				  const enum gpiod_line_value *values);
 
+/**
+ * @brief Set the values of requested lines using a bitmap.
+ * @param request GPIO line request.
+ * @param mask Bitmap selecting the lines to set. Bit N corresponds to the
+ *             line at index N in the offset array filled by
+ *             ::gpiod_line_request_get_requested_offsets.
+ * @param bits Values to set. Bit N set drives the line at index N active.
+ *             Bits not set in \p mask are ignored.
+ * @return 0 on success, -1 on failure.
+ * @note Selecting a bit beyond the number of requested lines is an error.
+ */
+int gpiod_line_request_set_values_mask(struct gpiod_line_request *request,
+				       uint64_t mask, uint64_t bits);
+
 /**
  * @brief Update the configuration of lines associated with a line request.
  * @param request GPIO line request.
@@ -1330,6 +1472,208 @@ gpiod_edge_event_buffer_get_event(struct gpiod_edge_event_buffer *buffer,
 size_t
 gpiod_edge_event_buffer_get_num_events(struct gpiod_edge_event_buffer *buffer);
 
+/**
+ * @}
+ *
+ * @defgroup event_reactor Waiting for events on multiple objects
+ * @{
+ *
+ * Functions for multiplexing edge and info events of many line requests and
+ * chips.
+ *
+ * An event reactor watches the file descriptors of any number of line
+ * requests and chips at once. Each line request is registered together with
+ * an edge event buffer. A single wait call blocks until at least one of the
+ * registered objects becomes ready and then drains the pending edge events
+ * of every ready request into its buffer.
+ *
+ * The reactor doesn't take ownership of the registered objects. They must
+ * be removed from the reactor before being released.
+ */
+
+/**
+ * @brief Create a new event reactor.
+ * @return New event reactor or NULL on error. The returned object must be
+ *         freed by the caller using ::gpiod_event_reactor_free.
+ */
+struct gpiod_event_reactor *gpiod_event_reactor_new(void);
+
+/**
+ * @brief Free the event reactor and release all associated resources.
+ * @param reactor Event reactor to free.
+ * @note Registered line requests, chips and buffers are not released.
+ */
+void gpiod_event_reactor_free(struct gpiod_event_reactor *reactor);
+
+/**
+ * @brief Get the file descriptor associated with the event reactor.
+ * @param reactor Event reactor.
+ * @return The epoll file descriptor which becomes readable whenever any of
+ *         the registered objects has events pending. This function never
+ *         fails. The returned file descriptor must not be closed by the
+ *         caller.
+ */
+int gpiod_event_reactor_get_fd(struct gpiod_event_reactor *reactor);
+
+/**
+ * @brief Start watching a line request for edge events.
+ * @param reactor Event reactor.
+ * @param request Line request to watch.
+ * @param buffer Edge event buffer into which events of this request will be
+ *               read by ::gpiod_event_reactor_wait.
+ * @return 0 on success, -1 on failure. If the request is already registered,
+ *         errno is set to EEXIST.
+ */
+int gpiod_event_reactor_add_request(struct gpiod_event_reactor *reactor,
+				    struct gpiod_line_request *request,
+				    struct gpiod_edge_event_buffer *buffer);
+
+/**
+ * @brief Stop watching a line request.
+ * @param reactor Event reactor.
+ * @param request Line request to remove.
+ * @return 0 on success, -1 on failure. If the request is not registered,
+ *         errno is set to ENOENT.
+ * @note Removing any object invalidates the ready lists filled by the last
+ *       call to ::gpiod_event_reactor_wait.
+ */
+int gpiod_event_reactor_remove_request(struct gpiod_event_reactor *reactor,
+				       struct gpiod_line_request *request);
+
+/**
+ * @brief Start watching a chip for line info events.
+ * @param reactor Event reactor.
+ * @param chip GPIO chip to watch.
+ * @return 0 on success, -1 on failure. If the chip is already registered,
+ *         errno is set to EEXIST.
+ * @note Info events are not read by the reactor. Use
+ *       ::gpiod_chip_read_info_event on chips reported as ready.
+ */
+int gpiod_event_reactor_add_chip(struct gpiod_event_reactor *reactor,
+				 struct gpiod_chip *chip);
+
+/**
+ * @brief Stop watching a chip.
+ * @param reactor Event reactor.
+ * @param chip GPIO chip to remove.
+ * @return 0 on success, -1 on failure. If the chip is not registered,
+ *         errno is set to ENOENT.
+ * @note Removing any object invalidates the ready lists filled by the last
+ *       call to ::gpiod_event_reactor_wait.
+ */
+int gpiod_event_reactor_remove_chip(struct gpiod_event_reactor *reactor,
+				    struct gpiod_chip *chip);
+
+/**
+ * @brief Get the number of objects watched by the event reactor.
+ * @param reactor Event reactor.
+ * @return Number of registered line requests and chips.
+ */
+size_t gpiod_event_reactor_get_num_sources(struct gpiod_event_reactor *reactor);
+
+/**
+ * @brief Wait for events on any of the registered objects.
+ * @param reactor Event reactor.
+ * @param timeout_ns Wait time limit in nanoseconds. If set to 0, the function
+ *                   returns immediately. If set to a negative number, the
+ *                   function blocks indefinitely until an event becomes
+ *                   available. The timeout is rounded up to a millisecond.
+ * @return 0 if wait timed out, -1 if an error occurred, otherwise the number
+ *         of objects that became ready.
+ *
+ * For every ready line request, pending edge events are read into the buffer
+ * it was registered with, overwriting its previous contents. Ready requests
+ * and chips can then be retrieved with
+ * ::gpiod_event_reactor_get_ready_request and
+ * ::gpiod_event_reactor_get_ready_chip respectively.
+ *
+ * Failing to read the events of one line request doesn't abort the wait.
+ * Such requests are counted in the return value but reported separately by
+ * ::gpiod_event_reactor_get_failed_request, together with the error number
+ * returned by ::gpiod_event_reactor_get_failed_error.
+ */
+int gpiod_event_reactor_wait(struct gpiod_event_reactor *reactor,
+			     int64_t timeout_ns);
+
+/**
+ * @brief Get the number of line requests for which events were read by the
+ *        last call to ::gpiod_event_reactor_wait.
+ * @param reactor Event reactor.
+ * @return Number of ready line requests.
+ */
+size_t
+gpiod_event_reactor_get_num_ready_requests(struct gpiod_event_reactor *reactor);
+
+/**
+ * @brief Get a line request for which events were read.
+ * @param reactor Event reactor.
+ * @param index Index of the ready line request.
+ * @return Ready line request or NULL if the index is out of range.
+ */
+struct gpiod_line_request *
+gpiod_event_reactor_get_ready_request(struct gpiod_event_reactor *reactor,
+				      size_t index);
+
+/**
+ * @brief Get the edge event buffer of a ready line request.
+ * @param reactor Event reactor.
+ * @param index Index of the ready line request.
+ * @return Buffer holding the events of the line request at \p index or NULL
+ *         if the index is out of range.
+ */
+struct gpiod_edge_event_buffer *
+gpiod_event_reactor_get_ready_buffer(struct gpiod_event_reactor *reactor,
+				     size_t index);
+
+/**
+ * @brief Get the number of chips with pending info events after the last
+ *        call to ::gpiod_event_reactor_wait.
+ * @param reactor Event reactor.
+ * @return Number of ready chips.
+ */
+size_t
+gpiod_event_reactor_get_num_ready_chips(struct gpiod_event_reactor *reactor);
+
+/**
+ * @brief Get a chip with pending info events.
+ * @param reactor Event reactor.
+ * @param index Index of the ready chip.
+ * @return Ready chip or NULL if the index is out of range.
+ */
+struct gpiod_chip *
+gpiod_event_reactor_get_ready_chip(struct gpiod_event_reactor *reactor,
+				   size_t index);
+
+/**
+ * @brief Get the number of line requests for which reading events failed
+ *        during the last call to ::gpiod_event_reactor_wait.
+ * @param reactor Event reactor.
+ * @return Number of failed line requests.
+ */
+size_t
+gpiod_event_reactor_get_num_failed_requests(struct gpiod_event_reactor *reactor);
+
+/**
+ * @brief Get a line request for which reading events failed.
+ * @param reactor Event reactor.
+ * @param index Index of the failed line request.
+ * @return Failed line request or NULL if the index is out of range.
+ */
+struct gpiod_line_request *
+gpiod_event_reactor_get_failed_request(struct gpiod_event_reactor *reactor,
+				       size_t index);
+
+/**
+ * @brief Get the error that occurred when reading events of a failed line
+ *        request.
+ * @param reactor Event reactor.
+ * @param index Index of the failed line request.
+ * @return Error number as set in errno by the failed read or -1 if the index
+ *         is out of range.
+ */
+int gpiod_event_reactor_get_failed_error(struct gpiod_event_reactor *reactor,
+					 size_t index);
+
 /**
  * @}
  *
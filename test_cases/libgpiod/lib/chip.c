@@ -139,6 +139,28 @@ gpiod_chip_get_line_info(struct gpiod_chip *chip, unsigned int offset)
 	return chip_get_line_info(chip, offset, false);
 }
 
+GPIOD_API int
+gpiod_chip_read_line_info_snapshot(struct gpiod_chip *chip,
+				   struct gpiod_line_info_snapshot *snapshot)
+{
+	struct gpiochip_info chinfo;
+	int ret;
+
+	assert(chip);
+
+	if (!snapshot) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	ret = read_chip_info(chip->fd, &chinfo);
+	if (ret < 0)
+		return -1;
+
+	return gpiod_line_info_snapshot_read_fd(chip->fd, snapshot,
+						chinfo.lines);
+}
+
 GPIOD_API struct gpiod_line_info *
 gpiod_chip_watch_line_info(struct gpiod_chip *chip, unsigned int offset)
 {
@@ -13,19 +13,18 @@
 /* As defined in the kernel. */
 #define EVENT_BUFFER_MAX_CAPACITY (GPIO_V2_LINES_MAX * 16)
 
+/*
+ * Edge events wrap the uAPI structure directly so that the buffer can read()
+ * straight into its event array and accessors translate fields on demand.
+ */
 struct gpiod_edge_event {
-	enum gpiod_edge_event_type event_type;
-	uint64_t timestamp;
-	unsigned int line_offset;
-	unsigned long global_seqno;
-	unsigned long line_seqno;
+	struct gpio_v2_line_event data;
 };
 
 struct gpiod_edge_event_buffer {
 	size_t capacity;
 	size_t num_events;
 	struct gpiod_edge_event *events;
-	struct gpio_v2_line_event *event_data;
 };
 
 GPIOD_API void gpiod_edge_event_free(struct gpiod_edge_event *event)
@@ -54,7 +53,9 @@ gpiod_edge_event_get_event_type(struct gpiod_edge_event *event)
 {
 	assert(event);
 
-	return event->event_type;
+	return event->data.id == GPIO_V2_LINE_EVENT_RISING_EDGE ?
+			GPIOD_EDGE_EVENT_RISING_EDGE :
+			GPIOD_EDGE_EVENT_FALLING_EDGE;
 }
 
 GPIOD_API uint64_t
@@ -62,7 +63,7 @@ gpiod_edge_event_get_timestamp_ns(struct gpiod_edge_event *event)
 {
 	assert(event);
 
-	return event->timestamp;
+	return event->data.timestamp_ns;
 }
 
 GPIOD_API unsigned int
@@ -70,7 +71,7 @@ gpiod_edge_event_get_line_offset(struct gpiod_edge_event *event)
 {
 	assert(event);
 
-	return event->line_offset;
+	return event->data.offset;
 }
 
 GPIOD_API unsigned long
@@ -78,7 +79,7 @@ gpiod_edge_event_get_global_seqno(struct gpiod_edge_event *event)
 {
 	assert(event);
 
-	return event->global_seqno;
+	return event->data.seqno;
 }
 
 GPIOD_API unsigned long
@@ -86,7 +87,7 @@ gpiod_edge_event_get_line_seqno(struct gpiod_edge_event *event)
 {
 	assert(event);
 
-	return event->line_seqno;
+	return event->data.line_seqno;
 }
 
 GPIOD_API struct gpiod_edge_event_buffer *
@@ -112,13 +113,6 @@ gpiod_edge_event_buffer_new(size_t capacity)
 		return NULL;
 	}
 
-	buf->event_data = calloc(capacity, sizeof(*buf->event_data));
-	if (!buf->event_data) {
-		free(buf->events);
-		free(buf);
-		return NULL;
-	}
-
 	return buf;
 }
 
@@ -137,7 +131,6 @@ gpiod_edge_event_buffer_free(struct gpiod_edge_event_buffer *buffer)
 		return;
 
 	free(buffer->events);
-	free(buffer->event_data);
 	free(buffer);
 }
 
@@ -167,9 +160,6 @@ int gpiod_edge_event_buffer_read_fd(int fd,
 				    struct gpiod_edge_event_buffer *buffer,
 				    size_t max_events)
 {
-	struct gpio_v2_line_event *curr;
-	struct gpiod_edge_event *event;
-	size_t i;
 	ssize_t rd;
 
 	if (!buffer) {
@@ -177,36 +167,24 @@ int gpiod_edge_event_buffer_read_fd(int fd,
 		return -1;
 	}
 
-	memset(buffer->event_data, 0,
-	       sizeof(*buffer->event_data) * buffer->capacity);
-	memset(buffer->events, 0, sizeof(*buffer->events) * buffer->capacity);
+	/*
+	 * No need to clear the buffer: the kernel only ever returns whole
+	 * events and slots past num_events can't be accessed.
+	 */
+	buffer->num_events = 0;
 
 	if (max_events > buffer->capacity)
 		max_events = buffer->capacity;
 
-	rd = read(fd, buffer->event_data,
-		  max_events * sizeof(*buffer->event_data));
+	rd = read(fd, buffer->events, max_events * sizeof(*buffer->events));
 	if (rd < 0) {
 		return -1;
-	} else if ((unsigned int)rd < sizeof(*buffer->event_data)) {
+	} else if ((unsigned int)rd < sizeof(*buffer->events)) {
 		errno = EIO;
 		return -1;
 	}
 
-	buffer->num_events = rd / sizeof(*buffer->event_data);
+	buffer->num_events = rd / sizeof(*buffer->events);
 
-	for (i = 0; i < buffer->num_events; i++) {
-		curr = &buffer->event_data[i];
-		event = &buffer->events[i];
-
-		event->line_offset = curr->offset;
-		event->event_type = curr->id == GPIO_V2_LINE_EVENT_RISING_EDGE ?
-					    GPIOD_EDGE_EVENT_RISING_EDGE :
-					    GPIOD_EDGE_EVENT_FALLING_EDGE;
-		event->timestamp = curr->timestamp_ns;
-		event->global_seqno = curr->seqno;
-		event->line_seqno = curr->line_seqno;
-	}
-
-	return i;
+	return buffer->num_events;
 }
@@ -0,0 +1,448 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+#include <assert.h>
+#include <errno.h>
+#include <gpiod.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "internal.h"
+
+#define REACTOR_MIN_SOURCES 16
+
+enum {
+	SOURCE_REQUEST = 1,
+	SOURCE_CHIP,
+};
+
+struct reactor_source {
+	int type;
+	int fd;
+	void *obj;
+	struct gpiod_edge_event_buffer *buffer;
+	int error;
+};
+
+struct gpiod_event_reactor {
+	int epfd;
+	struct reactor_source **sources;
+	size_t num_sources;
+	size_t max_sources;
+	struct epoll_event *epoll_events;
+	struct reactor_source **ready_requests;
+	size_t num_ready_requests;
+	struct reactor_source **ready_chips;
+	size_t num_ready_chips;
+	struct reactor_source **failed_requests;
+	size_t num_failed_requests;
+};
+
+static void reactor_clear_ready(struct gpiod_event_reactor *reactor)
+{
+	reactor->num_ready_requests = 0;
+	reactor->num_ready_chips = 0;
+	reactor->num_failed_requests = 0;
+}
+
+static int reactor_grow(struct gpiod_event_reactor *reactor)
+{
+	struct reactor_source **sources, **ready_requests, **ready_chips;
+	struct reactor_source **failed_requests;
+	struct epoll_event *epoll_events;
+	size_t max_sources;
+
+	max_sources = reactor->max_sources ? reactor->max_sources * 2 :
+					     REACTOR_MIN_SOURCES;
+
+	sources = realloc(reactor->sources, sizeof(*sources) * max_sources);
+	if (!sources)
+		return -1;
+	reactor->sources = sources;
+
+	epoll_events = realloc(reactor->epoll_events,
+			       sizeof(*epoll_events) * max_sources);
+	if (!epoll_events)
+		return -1;
+	reactor->epoll_events = epoll_events;
+
+	ready_requests = realloc(reactor->ready_requests,
+				 sizeof(*ready_requests) * max_sources);
+	if (!ready_requests)
+		return -1;
+	reactor->ready_requests = ready_requests;
+
+	ready_chips = realloc(reactor->ready_chips,
+			      sizeof(*ready_chips) * max_sources);
+	if (!ready_chips)
+		return -1;
+	reactor->ready_chips = ready_chips;
+
+	failed_requests = realloc(reactor->failed_requests,
+				  sizeof(*failed_requests) * max_sources);
+	if (!failed_requests)
+		return -1;
+	reactor->failed_requests = failed_requests;
+
+	reactor->max_sources = max_sources;
+
+	return 0;
+}
+
+static struct reactor_source *
+reactor_find_source(struct gpiod_event_reactor *reactor, void *obj,
+		    size_t *index)
+{
+	size_t i;
+
+	for (i = 0; i < reactor->num_sources; i++) {
+		if (reactor->sources[i]->obj == obj) {
+			if (index)
+				*index = i;
+			return reactor->sources[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int reactor_add_source(struct gpiod_event_reactor *reactor, int type,
+			      int fd, void *obj,
+			      struct gpiod_edge_event_buffer *buffer)
+{
+	struct reactor_source *source;
+	struct epoll_event ev;
+	int ret;
+
+	if (reactor_find_source(reactor, obj, NULL)) {
+		errno = EEXIST;
+		return -1;
+	}
+
+	if (reactor->num_sources == reactor->max_sources) {
+		ret = reactor_grow(reactor);
+		if (ret)
+			return -1;
+	}
+
+	source = malloc(sizeof(*source));
+	if (!source)
+		return -1;
+
+	memset(source, 0, sizeof(*source));
+	source->type = type;
+	source->fd = fd;
+	source->obj = obj;
+	source->buffer = buffer;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLPRI;
+	ev.data.ptr = source;
+
+	ret = epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, fd, &ev);
+	if (ret) {
+		free(source);
+		return -1;
+	}
+
+	reactor->sources[reactor->num_sources++] = source;
+
+	return 0;
+}
+
+static int reactor_remove_source(struct gpiod_event_reactor *reactor,
+				 void *obj)
+{
+	struct reactor_source *source;
+	size_t index;
+
+	source = reactor_find_source(reactor, obj, &index);
+	if (!source) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	/*
+	 * The file descriptor may already have been closed by the caller in
+	 * which case the kernel has dropped it from the set on its own.
+	 */
+	epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, source->fd, NULL);
+
+	reactor->sources[index] = reactor->sources[--reactor->num_sources];
+	free(source);
+
+	/* Ready lists may now reference the freed source. */
+	reactor_clear_ready(reactor);
+
+	return 0;
+}
+
+GPIOD_API struct gpiod_event_reactor *gpiod_event_reactor_new(void)
+{
+	struct gpiod_event_reactor *reactor;
+
+	reactor = malloc(sizeof(*reactor));
+	if (!reactor)
+		return NULL;
+
+	memset(reactor, 0, sizeof(*reactor));
+
+	reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (reactor->epfd < 0) {
+		free(reactor);
+		return NULL;
+	}
+
+	return reactor;
+}
+
+GPIOD_API void gpiod_event_reactor_free(struct gpiod_event_reactor *reactor)
+{
+	size_t i;
+
+	if (!reactor)
+		return;
+
+	for (i = 0; i < reactor->num_sources; i++)
+		free(reactor->sources[i]);
+
+	close(reactor->epfd);
+	free(reactor->sources);
+	free(reactor->epoll_events);
+	free(reactor->ready_requests);
+	free(reactor->ready_chips);
+	free(reactor->failed_requests);
+	free(reactor);
+}
+
+GPIOD_API int gpiod_event_reactor_get_fd(struct gpiod_event_reactor *reactor)
+{
+	assert(reactor);
+
+	return reactor->epfd;
+}
+
+GPIOD_API int
+gpiod_event_reactor_add_request(struct gpiod_event_reactor *reactor,
+				struct gpiod_line_request *request,
+				struct gpiod_edge_event_buffer *buffer)
+{
+	assert(reactor);
+
+	if (!request || !buffer) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return reactor_add_source(reactor, SOURCE_REQUEST,
+				  gpiod_line_request_get_fd(request),
+				  request, buffer);
+}
+
+GPIOD_API int
+gpiod_event_reactor_remove_request(struct gpiod_event_reactor *reactor,
+				   struct gpiod_line_request *request)
+{
+	assert(reactor);
+
+	if (!request) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return reactor_remove_source(reactor, request);
+}
+
+GPIOD_API int gpiod_event_reactor_add_chip(struct gpiod_event_reactor *reactor,
+					   struct gpiod_chip *chip)
+{
+	assert(reactor);
+
+	if (!chip) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return reactor_add_source(reactor, SOURCE_CHIP,
+				  gpiod_chip_get_fd(chip), chip, NULL);
+}
+
+GPIOD_API int
+gpiod_event_reactor_remove_chip(struct gpiod_event_reactor *reactor,
+				struct gpiod_chip *chip)
+{
+	assert(reactor);
+
+	if (!chip) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return reactor_remove_source(reactor, chip);
+}
+
+GPIOD_API size_t
+gpiod_event_reactor_get_num_sources(struct gpiod_event_reactor *reactor)
+{
+	assert(reactor);
+
+	return reactor->num_sources;
+}
+
+GPIOD_API int gpiod_event_reactor_wait(struct gpiod_event_reactor *reactor,
+				       int64_t timeout_ns)
+{
+	struct reactor_source *source;
+	int ret, num_ready, timeout_ms, i;
+
+	assert(reactor);
+
+	reactor_clear_ready(reactor);
+
+	if (!reactor->num_sources) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	/*
+	 * Round up so that a short non-zero timeout doesn't become a poll.
+	 * Clamp long ones, they would otherwise wrap to an infinite wait.
+	 */
+	if (timeout_ns < 0)
+		timeout_ms = -1;
+	else if (timeout_ns > (int64_t)INT_MAX * 1000000)
+		timeout_ms = INT_MAX;
+	else
+		timeout_ms = (timeout_ns + 999999) / 1000000;
+
+	num_ready = epoll_wait(reactor->epfd, reactor->epoll_events,
+			       reactor->num_sources, timeout_ms);
+	if (num_ready <= 0)
+		return num_ready;
+
+	for (i = 0; i < num_ready; i++) {
+		source = reactor->epoll_events[i].data.ptr;
+
+		if (source->type == SOURCE_CHIP) {
+			reactor->ready_chips[reactor->num_ready_chips++] =
+								source;
+			continue;
+		}
+
+		ret = gpiod_edge_event_buffer_read_fd(
+			source->fd, source->buffer,
+			gpiod_edge_event_buffer_get_capacity(source->buffer));
+		if (ret < 0) {
+			/*
+			 * Don't bail out: events of other sources may already
+			 * have been drained into their buffers.
+			 */
+			source->error = errno;
+			reactor->failed_requests[
+				reactor->num_failed_requests++] = source;
+			continue;
+		}
+
+		source->error = 0;
+		reactor->ready_requests[reactor->num_ready_requests++] = source;
+	}
+
+	return num_ready;
+}
+
+GPIOD_API size_t
+gpiod_event_reactor_get_num_ready_requests(struct gpiod_event_reactor *reactor)
+{
+	assert(reactor);
+
+	return reactor->num_ready_requests;
+}
+
+GPIOD_API struct gpiod_line_request *
+gpiod_event_reactor_get_ready_request(struct gpiod_event_reactor *reactor,
+				      size_t index)
+{
+	assert(reactor);
+
+	if (index >= reactor->num_ready_requests) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return reactor->ready_requests[index]->obj;
+}
+
+GPIOD_API struct gpiod_edge_event_buffer *
+gpiod_event_reactor_get_ready_buffer(struct gpiod_event_reactor *reactor,
+				     size_t index)
+{
+	assert(reactor);
+
+	if (index >= reactor->num_ready_requests) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return reactor->ready_requests[index]->buffer;
+}
+
+GPIOD_API size_t
+gpiod_event_reactor_get_num_ready_chips(struct gpiod_event_reactor *reactor)
+{
+	assert(reactor);
+
+	return reactor->num_ready_chips;
+}
+
+GPIOD_API struct gpiod_chip *
+gpiod_event_reactor_get_ready_chip(struct gpiod_event_reactor *reactor,
+				   size_t index)
+{
+	assert(reactor);
+
+	if (index >= reactor->num_ready_chips) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return reactor->ready_chips[index]->obj;
+}
+
+GPIOD_API size_t
+gpiod_event_reactor_get_num_failed_requests(struct gpiod_event_reactor *reactor)
+{
+	assert(reactor);
+
+	return reactor->num_failed_requests;
+}
+
+GPIOD_API struct gpiod_line_request *
+gpiod_event_reactor_get_failed_request(struct gpiod_event_reactor *reactor,
+				       size_t index)
+{
+	assert(reactor);
+
+	if (index >= reactor->num_failed_requests) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return reactor->failed_requests[index]->obj;
+}
+
+GPIOD_API int
+gpiod_event_reactor_get_failed_error(struct gpiod_event_reactor *reactor,
+				     size_t index)
+{
+	assert(reactor);
+
+	if (index >= reactor->num_failed_requests) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return reactor->failed_requests[index]->error;
+}
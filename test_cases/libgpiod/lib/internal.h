@@ -21,6 +21,9 @@ struct gpiod_chip_info *
 gpiod_chip_info_from_uapi(struct gpiochip_info *uapi_info);
 struct gpiod_line_info *
 gpiod_line_info_from_uapi(struct gpio_v2_line_info *uapi_info);
+int gpiod_line_info_snapshot_read_fd(int fd,
+				     struct gpiod_line_info_snapshot *snapshot,
+				     size_t num_lines);
 void gpiod_request_config_to_uapi(struct gpiod_request_config *config,
 				  struct gpio_v2_line_request *uapi_req);
 int gpiod_line_config_to_uapi(struct gpiod_line_config *config,
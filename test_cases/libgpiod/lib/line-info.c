@@ -2,9 +2,11 @@
 // SPDX-FileCopyrightText: 2021 Bartosz Golaszewski <brgl@bgdev.pl>
 
 #include <assert.h>
+#include <errno.h>
 #include <gpiod.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 
 #include "internal.h"
 
@@ -23,6 +25,21 @@ struct gpiod_line_info {
 	unsigned long debounce_period_us;
 };
 
+/*
+ * Empty slots in the name index are zero so that it can be cleared with
+ * memset(). Occupied slots store the line offset plus one.
+ */
+#define NAME_INDEX_EMPTY	0
+#define NAME_INDEX_MIN_SIZE	16
+
+struct gpiod_line_info_snapshot {
+	size_t capacity;
+	size_t num_lines;
+	struct gpiod_line_info *infos;
+	unsigned int *name_index;
+	size_t name_index_size;
+};
+
 GPIOD_API void gpiod_line_info_free(struct gpiod_line_info *info)
 {
 	free(info);
@@ -134,17 +151,12 @@ gpiod_line_info_get_debounce_period_us(struct gpiod_line_info *info)
 	return info->debounce_period_us;
 }
 
-struct gpiod_line_info *
-gpiod_line_info_from_uapi(struct gpio_v2_line_info *uapi_info)
+static void line_info_set_from_uapi(struct gpiod_line_info *info,
+				    struct gpio_v2_line_info *uapi_info)
 {
 	struct gpio_v2_line_attribute *attr;
-	struct gpiod_line_info *info;
 	size_t i;
 
-	info = malloc(sizeof(*info));
-	if (!info)
-		return NULL;
-
 	memset(info, 0, sizeof(*info));
 
 	info->offset = uapi_info->offset;
@@ -206,6 +218,208 @@ gpiod_line_info_from_uapi(struct gpio_v2_line_info *uapi_info)
 			info->debounce_period_us = attr->debounce_period_us;
 		}
 	}
+}
+
+struct gpiod_line_info *
+gpiod_line_info_from_uapi(struct gpio_v2_line_info *uapi_info)
+{
+	struct gpiod_line_info *info;
+
+	info = malloc(sizeof(*info));
+	if (!info)
+		return NULL;
+
+	line_info_set_from_uapi(info, uapi_info);
 
 	return info;
 }
+
+static size_t name_index_size(size_t capacity)
+{
+	size_t size = NAME_INDEX_MIN_SIZE;
+
+	/* Keep the load factor at or below one half. */
+	while (size < capacity * 2)
+		size <<= 1;
+
+	return size;
+}
+
+/* FNV-1a - names are short so anything fancier isn't worth it. */
+static uint32_t name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	for (; *name; name++) {
+		hash ^= (unsigned char)*name;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static void name_index_insert(struct gpiod_line_info_snapshot *snapshot,
+			      struct gpiod_line_info *info)
+{
+	size_t mask = snapshot->name_index_size - 1, slot;
+	unsigned int entry;
+
+	for (slot = name_hash(info->name) & mask;;
+	     slot = (slot + 1) & mask) {
+		entry = snapshot->name_index[slot];
+		if (entry == NAME_INDEX_EMPTY) {
+			snapshot->name_index[slot] = info->offset + 1;
+			return;
+		}
+
+		/*
+		 * Lines are inserted in offset order so keeping the existing
+		 * entry makes lookups return the first line with given name,
+		 * same as gpiod_chip_get_line_offset_from_name().
+		 */
+		if (strcmp(snapshot->infos[entry - 1].name, info->name) == 0)
+			return;
+	}
+}
+
+GPIOD_API struct gpiod_line_info_snapshot *
+gpiod_line_info_snapshot_new(size_t capacity)
+{
+	struct gpiod_line_info_snapshot *snapshot;
+
+	if (capacity == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	snapshot = malloc(sizeof(*snapshot));
+	if (!snapshot)
+		return NULL;
+
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->capacity = capacity;
+	snapshot->name_index_size = name_index_size(capacity);
+
+	snapshot->infos = calloc(capacity, sizeof(*snapshot->infos));
+	if (!snapshot->infos)
+		goto err_free_snapshot;
+
+	snapshot->name_index = calloc(snapshot->name_index_size,
+				      sizeof(*snapshot->name_index));
+	if (!snapshot->name_index)
+		goto err_free_infos;
+
+	return snapshot;
+
+err_free_infos:
+	free(snapshot->infos);
+err_free_snapshot:
+	free(snapshot);
+
+	return NULL;
+}
+
+GPIOD_API void
+gpiod_line_info_snapshot_free(struct gpiod_line_info_snapshot *snapshot)
+{
+	if (!snapshot)
+		return;
+
+	free(snapshot->name_index);
+	free(snapshot->infos);
+	free(snapshot);
+}
+
+GPIOD_API size_t
+gpiod_line_info_snapshot_get_capacity(struct gpiod_line_info_snapshot *snapshot)
+{
+	assert(snapshot);
+
+	return snapshot->capacity;
+}
+
+GPIOD_API size_t
+gpiod_line_info_snapshot_get_num_lines(struct gpiod_line_info_snapshot *snapshot)
+{
+	assert(snapshot);
+
+	return snapshot->num_lines;
+}
+
+GPIOD_API struct gpiod_line_info *
+gpiod_line_info_snapshot_get_line_info(
+		struct gpiod_line_info_snapshot *snapshot, unsigned int offset)
+{
+	assert(snapshot);
+
+	if (offset >= snapshot->num_lines) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return &snapshot->infos[offset];
+}
+
+GPIOD_API int
+gpiod_line_info_snapshot_find_line(struct gpiod_line_info_snapshot *snapshot,
+				   const char *name)
+{
+	size_t mask, slot;
+	unsigned int entry;
+
+	assert(snapshot);
+
+	if (!name) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	mask = snapshot->name_index_size - 1;
+
+	for (slot = name_hash(name) & mask;; slot = (slot + 1) & mask) {
+		entry = snapshot->name_index[slot];
+		if (entry == NAME_INDEX_EMPTY)
+			break;
+
+		if (strcmp(snapshot->infos[entry - 1].name, name) == 0)
+			return entry - 1;
+	}
+
+	errno = ENOENT;
+	return -1;
+}
+
+int gpiod_line_info_snapshot_read_fd(int fd,
+				     struct gpiod_line_info_snapshot *snapshot,
+				     size_t num_lines)
+{
+	struct gpio_v2_line_info uapi_info;
+	struct gpiod_line_info *info;
+	unsigned int offset;
+	int ret;
+
+	if (num_lines > snapshot->capacity)
+		num_lines = snapshot->capacity;
+
+	snapshot->num_lines = 0;
+	memset(snapshot->name_index, 0,
+	       snapshot->name_index_size * sizeof(*snapshot->name_index));
+
+	for (offset = 0; offset < num_lines; offset++) {
+		memset(&uapi_info, 0, sizeof(uapi_info));
+		uapi_info.offset = offset;
+
+		ret = ioctl(fd, GPIO_V2_GET_LINEINFO_IOCTL, &uapi_info);
+		if (ret)
+			return -1;
+
+		info = &snapshot->infos[offset];
+		line_info_set_from_uapi(info, &uapi_info);
+		snapshot->num_lines++;
+
+		if (info->name[0] != '\0')
+			name_index_insert(snapshot, info);
+	}
+
+	return snapshot->num_lines;
+}
@@ -12,13 +12,56 @@
 
 #include "internal.h"
 
+/*
+ * Offset-to-bit lookups go through a small open-addressed hash table kept
+ * at twice the maximum number of requested lines so that probe sequences
+ * stay short.
+ */
+#define OFFSET_INDEX_ORDER	7
+#define OFFSET_INDEX_SIZE	(1U << OFFSET_INDEX_ORDER)
+#define OFFSET_INDEX_EMPTY	0xff
+
 struct gpiod_line_request {
 	char *chip_name;
 	unsigned int offsets[GPIO_V2_LINES_MAX];
 	size_t num_lines;
 	int fd;
+	unsigned int index_offsets[OFFSET_INDEX_SIZE];
+	uint8_t index_bits[OFFSET_INDEX_SIZE];
 };
 
+static unsigned int offset_hash(unsigned int offset)
+{
+	/* Fibonacci hashing - spreads runs of consecutive offsets. */
+	return (uint32_t)(offset * 2654435769U) >> (32 - OFFSET_INDEX_ORDER);
+}
+
+static void offset_index_build(struct gpiod_line_request *request)
+{
+	unsigned int slot;
+	size_t i;
+
+	memset(request->index_bits, OFFSET_INDEX_EMPTY,
+	       sizeof(request->index_bits));
+
+	for (i = 0; i < request->num_lines; i++) {
+		slot = offset_hash(request->offsets[i]);
+		while (request->index_bits[slot] != OFFSET_INDEX_EMPTY)
+			slot = (slot + 1) & (OFFSET_INDEX_SIZE - 1);
+
+		request->index_offsets[slot] = request->offsets[i];
+		request->index_bits[slot] = i;
+	}
+}
+
+static uint64_t requested_lines_mask(struct gpiod_line_request *request)
+{
+	if (request->num_lines >= 64)
+		return ~0ULL;
+
+	return (1ULL << request->num_lines) - 1;
+}
+
 struct gpiod_line_request *
 gpiod_line_request_from_uapi(struct gpio_v2_line_request *uapi_req,
 			     const char *chip_name)
@@ -41,6 +84,7 @@ gpiod_line_request_from_uapi(struct gpio_v2_line_request *uapi_req,
 	request->num_lines = uapi_req->num_lines;
 	memcpy(request->offsets, uapi_req->offsets,
 	       sizeof(*request->offsets) * request->num_lines);
+	offset_index_build(request);
 
 	return request;
 }
@@ -109,13 +153,16 @@ gpiod_line_request_get_value(struct gpiod_line_request *request,
 static int offset_to_bit(struct gpiod_line_request *request,
 			 unsigned int offset)
 {
-	size_t i;
+	unsigned int slot;
 
 	assert(request);
 
-	for (i = 0; i < request->num_lines; i++) {
-		if (offset == request->offsets[i])
-			return i;
+	slot = offset_hash(offset);
+	while (request->index_bits[slot] != OFFSET_INDEX_EMPTY) {
+		if (request->index_offsets[slot] == offset)
+			return request->index_bits[slot];
+
+		slot = (slot + 1) & (OFFSET_INDEX_SIZE - 1);
 	}
 
 	return -1;
@@ -171,10 +218,53 @@ gpiod_line_request_get_values_subset(struct gpiod_line_request *request,
 GPIOD_API int gpiod_line_request_get_values(struct gpiod_line_request *request,
 					    enum gpiod_line_value *values)
 {
+	uint64_t bits;
+	size_t i;
+	int ret;
+
 	assert(request);
 
-	return gpiod_line_request_get_values_subset(request, request->num_lines,
-						    request->offsets, values);
+	if (!values) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	ret = gpiod_line_request_get_values_mask(request,
+						 requested_lines_mask(request),
+						 &bits);
+	if (ret)
+		return -1;
+
+	for (i = 0; i < request->num_lines; i++)
+		values[i] = gpiod_line_mask_test_bit(&bits, i) ? 1 : 0;
+
+	return 0;
+}
+
+GPIOD_API int
+gpiod_line_request_get_values_mask(struct gpiod_line_request *request,
+				   uint64_t mask, uint64_t *bits)
+{
+	struct gpio_v2_line_values uapi_values;
+	int ret;
+
+	assert(request);
+
+	if (!bits || (mask & ~requested_lines_mask(request))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	uapi_values.mask = mask;
+	uapi_values.bits = 0;
+
+	ret = ioctl(request->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &uapi_values);
+	if (ret)
+		return -1;
+
+	*bits = uapi_values.bits & mask;
+
+	return 0;
 }
 
 GPIOD_API int gpiod_line_request_set_value(struct gpiod_line_request *request,
@@ -224,10 +314,42 @@ gpiod_line_request_set_values_subset(struct gpiod_line_request *request,
 GPIOD_API int gpiod_line_request_set_values(struct gpiod_line_request *request,
 					    const enum gpiod_line_value *values)
 {
+	uint64_t bits = 0;
+	size_t i;
+
+	assert(request);
+
+	if (!values) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (i = 0; i < request->num_lines; i++)
+		gpiod_line_mask_assign_bit(&bits, i, values[i]);
+
+	return gpiod_line_request_set_values_mask(request,
+						  requested_lines_mask(request),
+						  bits);
+}
+
+GPIOD_API int
+gpiod_line_request_set_values_mask(struct gpiod_line_request *request,
+				   uint64_t mask, uint64_t bits)
+{
+	struct gpio_v2_line_values uapi_values;
+
 	assert(request);
 
-	return gpiod_line_request_set_values_subset(request, request->num_lines,
-						    request->offsets, values);
+	if (mask & ~requested_lines_mask(request)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&uapi_values, 0, sizeof(uapi_values));
+	uapi_values.mask = mask;
+	uapi_values.bits = bits & mask;
+
+	return ioctl(request->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &uapi_values);
 }
 
 static bool offsets_equal(struct gpiod_line_request *request,
@@ -266,6 +388,10 @@ gpiod_line_request_reconfigure_lines(struct gpiod_line_request *request,
 	if (ret)
 		return ret;
 
+	/*
+	 * The set of requested offsets can't change over the lifetime of
+	 * the request so the offset index built at request time stays valid.
+	 */
 	if (!offsets_equal(request, &uapi_cfg)) {
 		errno = EINVAL;
 		return -1;
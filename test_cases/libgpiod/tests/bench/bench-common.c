@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench-common.h"
+
+void die(const char *fmt, ...)
+{
+	va_list va;
+
+	va_start(va, fmt);
+	vfprintf(stderr, fmt, va);
+	fputc('\n', stderr);
+	va_end(va);
+
+	exit(EXIT_FAILURE);
+}
+
+void die_perror(const char *fmt, ...)
+{
+	int errnum = errno;
+	va_list va;
+
+	va_start(va, fmt);
+	vfprintf(stderr, fmt, va);
+	fprintf(stderr, ": %s\n", strerror(errnum));
+	va_end(va);
+
+	exit(EXIT_FAILURE);
+}
+
+void bench_sim_new(struct bench_sim *sim, size_t num_lines)
+{
+	sim->ctx = gpiosim_ctx_new();
+	if (!sim->ctx)
+		die_perror("unable to create the gpio-sim context");
+
+	sim->dev = gpiosim_dev_new(sim->ctx);
+	if (!sim->dev)
+		die_perror("unable to create the gpio-sim device");
+
+	sim->bank = gpiosim_bank_new(sim->dev);
+	if (!sim->bank)
+		die_perror("unable to create the gpio-sim bank");
+
+	if (gpiosim_bank_set_num_lines(sim->bank, num_lines))
+		die_perror("unable to set the number of simulated lines");
+
+	if (gpiosim_dev_enable(sim->dev))
+		die_perror("unable to enable the gpio-sim device");
+}
+
+void bench_sim_free(struct bench_sim *sim)
+{
+	gpiosim_dev_disable(sim->dev);
+	gpiosim_bank_unref(sim->bank);
+	gpiosim_dev_unref(sim->dev);
+	gpiosim_ctx_unref(sim->ctx);
+}
+
+uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned long bench_parse_count(const char *arg, unsigned long fallback)
+{
+	unsigned long val;
+	char *end;
+
+	if (!arg)
+		return fallback;
+
+	errno = 0;
+	val = strtoul(arg, &end, 0);
+	if (errno || *end != '\0' || val == 0)
+		die("invalid count: %s", arg);
+
+	return val;
+}
+
+void bench_report(const char *name, unsigned long ops, uint64_t elapsed_ns)
+{
+	printf("%-32s %10lu ops %12.1f ns/op %12.0f ops/s\n", name, ops,
+	       (double)elapsed_ns / ops, ops * 1000000000.0 / elapsed_ns);
+}
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* SPDX-FileCopyrightText: 2026 agent <agent@local> */
+
+#ifndef __GPIOD_BENCH_COMMON_H__
+#define __GPIOD_BENCH_COMMON_H__
+
+#include <gpiosim.h>
+#include <stdint.h>
+
+/*
+ * Common helpers for the microbenchmarks. All of them run against a single
+ * gpio-sim bank which is created and enabled by bench_sim_new().
+ */
+
+#define UNUSED __attribute__((unused))
+#define NORETURN __attribute__((noreturn))
+#define PRINTF(fmt, arg) __attribute__((format(printf, fmt, arg)))
+
+struct bench_sim {
+	struct gpiosim_ctx *ctx;
+	struct gpiosim_dev *dev;
+	struct gpiosim_bank *bank;
+};
+
+void die(const char *fmt, ...) NORETURN PRINTF(1, 2);
+void die_perror(const char *fmt, ...) NORETURN PRINTF(1, 2);
+
+void bench_sim_new(struct bench_sim *sim, size_t num_lines);
+void bench_sim_free(struct bench_sim *sim);
+
+uint64_t bench_now_ns(void);
+unsigned long bench_parse_count(const char *arg, unsigned long fallback);
+void bench_report(const char *name, unsigned long ops, uint64_t elapsed_ns);
+
+#endif /* __GPIOD_BENCH_COMMON_H__ */
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+/*
+ * Drive bursts of edges on a simulated line and measure how long it takes
+ * to drain them from the kernel into an edge event buffer.
+ */
+
+#include <gpiod.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench-common.h"
+
+#define BUFFER_CAPACITY	1024
+
+int main(int argc, char **argv)
+{
+	unsigned long bursts, burst_size, i, j, total = 0;
+	enum gpiosim_pull pull = GPIOSIM_PULL_DOWN;
+	struct gpiod_edge_event_buffer *buffer;
+	struct gpiod_line_settings *settings;
+	struct gpiod_request_config *req_cfg;
+	struct gpiod_line_config *line_cfg;
+	struct gpiod_line_request *request;
+	static const unsigned int offset = 0;
+	uint64_t elapsed = 0, start;
+	struct gpiod_chip *chip;
+	struct bench_sim sim;
+	int ret;
+
+	bursts = bench_parse_count(argc > 1 ? argv[1] : NULL, 100);
+	burst_size = bench_parse_count(argc > 2 ? argv[2] : NULL,
+				       BUFFER_CAPACITY);
+	if (burst_size > BUFFER_CAPACITY)
+		die("burst size must not exceed %d", BUFFER_CAPACITY);
+
+	bench_sim_new(&sim, 1);
+
+	chip = gpiod_chip_open(gpiosim_bank_get_dev_path(sim.bank));
+	if (!chip)
+		die_perror("unable to open the simulated chip");
+
+	settings = gpiod_line_settings_new();
+	line_cfg = gpiod_line_config_new();
+	req_cfg = gpiod_request_config_new();
+	buffer = gpiod_edge_event_buffer_new(BUFFER_CAPACITY);
+	if (!settings || !line_cfg || !req_cfg || !buffer)
+		die_perror("unable to allocate request resources");
+
+	gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+	gpiod_line_settings_set_edge_detection(settings, GPIOD_LINE_EDGE_BOTH);
+	if (gpiod_line_config_add_line_settings(line_cfg, &offset, 1, settings))
+		die_perror("unable to add line settings");
+
+	gpiod_request_config_set_event_buffer_size(req_cfg, BUFFER_CAPACITY);
+
+	request = gpiod_chip_request_lines(chip, req_cfg, line_cfg);
+	if (!request)
+		die_perror("unable to request lines");
+
+	for (i = 0; i < bursts; i++) {
+		for (j = 0; j < burst_size; j++) {
+			pull = pull == GPIOSIM_PULL_UP ? GPIOSIM_PULL_DOWN :
+							 GPIOSIM_PULL_UP;
+			ret = gpiosim_bank_set_pull(sim.bank, offset, pull);
+			if (ret)
+				die_perror("unable to toggle the line");
+		}
+
+		for (j = 0; j < burst_size; j += ret) {
+			start = bench_now_ns();
+			ret = gpiod_line_request_read_edge_events(
+					request, buffer, BUFFER_CAPACITY);
+			elapsed += bench_now_ns() - start;
+			if (ret < 0)
+				die_perror("unable to read edge events");
+		}
+
+		total += j;
+	}
+
+	bench_report("read_edge_events (per event)", total, elapsed);
+
+	gpiod_line_request_release(request);
+	gpiod_edge_event_buffer_free(buffer);
+	gpiod_request_config_free(req_cfg);
+	gpiod_line_config_free(line_cfg);
+	gpiod_line_settings_free(settings);
+	gpiod_chip_close(chip);
+	bench_sim_free(&sim);
+
+	return EXIT_SUCCESS;
+}
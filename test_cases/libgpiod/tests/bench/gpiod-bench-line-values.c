@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+/*
+ * Compare the cost of reading and setting a whole 64-line bank through the
+ * offset-based and the bitmap-based line request interfaces.
+ */
+
+#include <gpiod.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench-common.h"
+
+#define NUM_SIM_LINES	128
+#define NUM_REQ_LINES	64
+
+static struct gpiod_line_request *request_lines(const char *path,
+						unsigned int *offsets,
+						enum gpiod_line_direction dir)
+{
+	struct gpiod_line_settings *settings;
+	struct gpiod_line_config *line_cfg;
+	struct gpiod_line_request *request;
+	struct gpiod_chip *chip;
+
+	chip = gpiod_chip_open(path);
+	if (!chip)
+		die_perror("unable to open %s", path);
+
+	settings = gpiod_line_settings_new();
+	line_cfg = gpiod_line_config_new();
+	if (!settings || !line_cfg)
+		die_perror("unable to allocate line config");
+
+	gpiod_line_settings_set_direction(settings, dir);
+	if (gpiod_line_config_add_line_settings(line_cfg, offsets,
+						NUM_REQ_LINES, settings))
+		die_perror("unable to add line settings");
+
+	request = gpiod_chip_request_lines(chip, NULL, line_cfg);
+	if (!request)
+		die_perror("unable to request lines");
+
+	gpiod_line_config_free(line_cfg);
+	gpiod_line_settings_free(settings);
+	gpiod_chip_close(chip);
+
+	return request;
+}
+
+int main(int argc, char **argv)
+{
+	enum gpiod_line_value values[NUM_REQ_LINES];
+	unsigned int offsets[NUM_REQ_LINES];
+	struct gpiod_line_request *request;
+	unsigned long iterations, i;
+	struct bench_sim sim;
+	uint64_t start, bits;
+	const char *path;
+
+	iterations = bench_parse_count(argc > 1 ? argv[1] : NULL, 100000);
+
+	bench_sim_new(&sim, NUM_SIM_LINES);
+	path = gpiosim_bank_get_dev_path(sim.bank);
+
+	/* Worst case for a linear scan: offsets requested in reverse. */
+	for (i = 0; i < NUM_REQ_LINES; i++)
+		offsets[i] = NUM_SIM_LINES - 1 - 2 * i;
+
+	request = request_lines(path, offsets, GPIOD_LINE_DIRECTION_INPUT);
+
+	start = bench_now_ns();
+	for (i = 0; i < iterations; i++) {
+		if (gpiod_line_request_get_values_subset(request, NUM_REQ_LINES,
+							 offsets, values))
+			die_perror("unable to read values");
+	}
+	bench_report("get_values_subset", iterations, bench_now_ns() - start);
+
+	start = bench_now_ns();
+	for (i = 0; i < iterations; i++) {
+		if (gpiod_line_request_get_values_mask(request, ~0ULL, &bits))
+			die_perror("unable to read values");
+	}
+	bench_report("get_values_mask", iterations, bench_now_ns() - start);
+
+	gpiod_line_request_release(request);
+
+	request = request_lines(path, offsets, GPIOD_LINE_DIRECTION_OUTPUT);
+
+	start = bench_now_ns();
+	for (i = 0; i < iterations; i++) {
+		values[i % NUM_REQ_LINES] = !values[i % NUM_REQ_LINES];
+		if (gpiod_line_request_set_values_subset(request, NUM_REQ_LINES,
+							 offsets, values))
+			die_perror("unable to set values");
+	}
+	bench_report("set_values_subset", iterations, bench_now_ns() - start);
+
+	start = bench_now_ns();
+	for (i = 0; i < iterations; i++) {
+		if (gpiod_line_request_set_values_mask(request, ~0ULL, i))
+			die_perror("unable to set values");
+	}
+	bench_report("set_values_mask", iterations, bench_now_ns() - start);
+
+	gpiod_line_request_release(request);
+	bench_sim_free(&sim);
+
+	return EXIT_SUCCESS;
+}
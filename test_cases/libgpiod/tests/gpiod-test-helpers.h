@@ -24,6 +24,10 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC(struct_gpiod_chip_info, gpiod_chip_info_free);
 typedef struct gpiod_line_info struct_gpiod_line_info;
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(struct_gpiod_line_info, gpiod_line_info_free);
 
+typedef struct gpiod_line_info_snapshot struct_gpiod_line_info_snapshot;
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(struct_gpiod_line_info_snapshot,
+			      gpiod_line_info_snapshot_free);
+
 typedef struct gpiod_info_event struct_gpiod_info_event;
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(struct_gpiod_info_event, gpiod_info_event_free);
 
@@ -49,6 +53,10 @@ typedef struct gpiod_edge_event_buffer struct_gpiod_edge_event_buffer;
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(struct_gpiod_edge_event_buffer,
 			      gpiod_edge_event_buffer_free);
 
+typedef struct gpiod_event_reactor struct_gpiod_event_reactor;
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(struct_gpiod_event_reactor,
+			      gpiod_event_reactor_free);
+
 #define gpiod_test_return_if_failed() \
 	do { \
 		if (g_test_failed()) \
@@ -115,6 +123,15 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC(struct_gpiod_edge_event_buffer,
 		_config; \
 	})
 
+#define gpiod_test_create_line_info_snapshot_or_fail(_capacity) \
+	({ \
+		struct gpiod_line_info_snapshot *_snapshot = \
+				gpiod_line_info_snapshot_new(_capacity); \
+		g_assert_nonnull(_snapshot); \
+		gpiod_test_return_if_failed(); \
+		_snapshot; \
+	})
+
 #define gpiod_test_create_edge_event_buffer_or_fail(_capacity) \
 	({ \
 		struct gpiod_edge_event_buffer *_buffer = \
@@ -124,6 +141,15 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC(struct_gpiod_edge_event_buffer,
 		_buffer; \
 	})
 
+#define gpiod_test_create_event_reactor_or_fail() \
+	({ \
+		struct gpiod_event_reactor *_reactor = \
+				gpiod_event_reactor_new(); \
+		g_assert_nonnull(_reactor); \
+		gpiod_test_return_if_failed(); \
+		_reactor; \
+	})
+
 #define gpiod_test_line_config_add_line_settings_or_fail(_line_cfg, _offsets, \
 							 _num_offsets, \
 							 _settings) \
@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+#include <fcntl.h>
+#include <glib.h>
+#include <gpiod.h>
+#include <unistd.h>
+
+#include "gpiod-test.h"
+#include "gpiod-test-helpers.h"
+#include "gpiod-test-sim.h"
+
+#define GPIOD_TEST_GROUP "event-reactor"
+
+static struct gpiod_line_request *
+request_edge_events(struct gpiod_chip *chip, guint offset)
+{
+	g_autoptr(struct_gpiod_line_settings) settings = NULL;
+	g_autoptr(struct_gpiod_line_config) line_cfg = NULL;
+	struct gpiod_line_request *request;
+	gint ret;
+
+	settings = gpiod_line_settings_new();
+	line_cfg = gpiod_line_config_new();
+	g_assert_nonnull(settings);
+	g_assert_nonnull(line_cfg);
+
+	gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+	gpiod_line_settings_set_edge_detection(settings, GPIOD_LINE_EDGE_BOTH);
+
+	ret = gpiod_line_config_add_line_settings(line_cfg, &offset, 1,
+						  settings);
+	g_assert_cmpint(ret, ==, 0);
+
+	request = gpiod_chip_request_lines(chip, NULL, line_cfg);
+	g_assert_nonnull(request);
+
+	return request;
+}
+
+GPIOD_TEST_CASE(wait_without_sources)
+{
+	g_autoptr(struct_gpiod_event_reactor) reactor = NULL;
+	gint ret;
+
+	reactor = gpiod_test_create_event_reactor_or_fail();
+
+	ret = gpiod_event_reactor_wait(reactor, 0);
+	g_assert_cmpint(ret, ==, -1);
+	gpiod_test_expect_errno(ENOENT);
+}
+
+GPIOD_TEST_CASE(wait_timeout)
+{
+	g_autoptr(GPIOSimChip) sim = g_gpiosim_chip_new("num-lines", 8, NULL);
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_request) request = NULL;
+	g_autoptr(struct_gpiod_edge_event_buffer) buffer = NULL;
+	g_autoptr(struct_gpiod_event_reactor) reactor = NULL;
+	gint ret;
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	buffer = gpiod_test_create_edge_event_buffer_or_fail(8);
+	reactor = gpiod_test_create_event_reactor_or_fail();
+
+	request = request_edge_events(chip, 2);
+	gpiod_test_return_if_failed();
+
+	ret = gpiod_event_reactor_add_request(reactor, request, buffer);
+	g_assert_cmpint(ret, ==, 0);
+	gpiod_test_return_if_failed();
+
+	ret = gpiod_event_reactor_wait(reactor, 1000000);
+	g_assert_cmpint(ret, ==, 0);
+	g_assert_cmpuint(gpiod_event_reactor_get_num_ready_requests(reactor),
+			 ==, 0);
+
+	gpiod_event_reactor_remove_request(reactor, request);
+}
+
+GPIOD_TEST_CASE(add_same_request_twice)
+{
+	g_autoptr(GPIOSimChip) sim = g_gpiosim_chip_new("num-lines", 8, NULL);
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_request) request = NULL;
+	g_autoptr(struct_gpiod_edge_event_buffer) buffer = NULL;
+	g_autoptr(struct_gpiod_event_reactor) reactor = NULL;
+	gint ret;
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	buffer = gpiod_test_create_edge_event_buffer_or_fail(8);
+	reactor = gpiod_test_create_event_reactor_or_fail();
+
+	request = request_edge_events(chip, 2);
+	gpiod_test_return_if_failed();
+
+	ret = gpiod_event_reactor_add_request(reactor, request, buffer);
+	g_assert_cmpint(ret, ==, 0);
+	gpiod_test_return_if_failed();
+
+	ret = gpiod_event_reactor_add_request(reactor, request, buffer);
+	g_assert_cmpint(ret, ==, -1);
+	gpiod_test_expect_errno(EEXIST);
+	g_assert_cmpuint(gpiod_event_reactor_get_num_sources(reactor), ==, 1);
+
+	ret = gpiod_event_reactor_remove_request(reactor, request);
+	g_assert_cmpint(ret, ==, 0);
+
+	ret = gpiod_event_reactor_remove_request(reactor, request);
+	g_assert_cmpint(ret, ==, -1);
+	gpiod_test_expect_errno(ENOENT);
+	g_assert_cmpuint(gpiod_event_reactor_get_num_sources(reactor), ==, 0);
+}
+
+GPIOD_TEST_CASE(read_events_from_multiple_chips)
+{
+	g_autoptr(GPIOSimChip) sim0 = g_gpiosim_chip_new("num-lines", 8, NULL);
+	g_autoptr(GPIOSimChip) sim1 = g_gpiosim_chip_new("num-lines", 8, NULL);
+	g_autoptr(struct_gpiod_chip) chip0 = NULL;
+	g_autoptr(struct_gpiod_chip) chip1 = NULL;
+	g_autoptr(struct_gpiod_line_request) request0 = NULL;
+	g_autoptr(struct_gpiod_line_request) request1 = NULL;
+	g_autoptr(struct_gpiod_line_request) request2 = NULL;
+	g_autoptr(struct_gpiod_edge_event_buffer) buffer0 = NULL;
+	g_autoptr(struct_gpiod_edge_event_buffer) buffer1 = NULL;
+	g_autoptr(struct_gpiod_edge_event_buffer) buffer2 = NULL;
+	g_autoptr(struct_gpiod_event_reactor) reactor = NULL;
+	struct gpiod_edge_event_buffer *buffer;
+	struct gpiod_line_request *request;
+	struct gpiod_edge_event *event;
+	guint i, seen = 0;
+	gint ret;
+
+	chip0 = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim0));
+	chip1 = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim1));
+	buffer0 = gpiod_test_create_edge_event_buffer_or_fail(8);
+	buffer1 = gpiod_test_create_edge_event_buffer_or_fail(8);
+	buffer2 = gpiod_test_create_edge_event_buffer_or_fail(8);
+	reactor = gpiod_test_create_event_reactor_or_fail();
+
+	request0 = request_edge_events(chip0, 1);
+	request1 = request_edge_events(chip1, 3);
+	request2 = request_edge_events(chip1, 5);
+	gpiod_test_return_if_failed();
+
+	ret = gpiod_event_reactor_add_request(reactor, request0, buffer0);
+	g_assert_cmpint(ret, ==, 0);
+	ret = gpiod_event_reactor_add_request(reactor, request1, buffer1);
+	g_assert_cmpint(ret, ==, 0);
+	ret = gpiod_event_reactor_add_request(reactor, request2, buffer2);
+	g_assert_cmpint(ret, ==, 0);
+	gpiod_test_return_if_failed();
+
+	g_gpiosim_chip_set_pull(sim0, 1, G_GPIOSIM_PULL_UP);
+	g_gpiosim_chip_set_pull(sim1, 5, G_GPIOSIM_PULL_UP);
+	g_gpiosim_chip_set_pull(sim1, 5, G_GPIOSIM_PULL_DOWN);
+
+	ret = gpiod_event_reactor_wait(reactor, 1000000000);
+	g_assert_cmpint(ret, ==, 2);
+	gpiod_test_return_if_failed();
+
+	g_assert_cmpuint(gpiod_event_reactor_get_num_ready_requests(reactor),
+			 ==, 2);
+	g_assert_cmpuint(gpiod_event_reactor_get_num_ready_chips(reactor),
+			 ==, 0);
+
+	for (i = 0; i < 2; i++) {
+		request = gpiod_event_reactor_get_ready_request(reactor, i);
+		buffer = gpiod_event_reactor_get_ready_buffer(reactor, i);
+
+		if (request == request0) {
+			g_assert_true(buffer == buffer0);
+			g_assert_cmpuint(
+				gpiod_edge_event_buffer_get_num_events(buffer),
+				==, 1);
+			event = gpiod_edge_event_buffer_get_event(buffer, 0);
+			g_assert_cmpuint(gpiod_edge_event_get_line_offset(event),
+					 ==, 1);
+			g_assert_cmpint(gpiod_edge_event_get_event_type(event),
+					==, GPIOD_EDGE_EVENT_RISING_EDGE);
+			seen |= 1;
+		} else if (request == request2) {
+			g_assert_true(buffer == buffer2);
+			g_assert_cmpuint(
+				gpiod_edge_event_buffer_get_num_events(buffer),
+				==, 2);
+			event = gpiod_edge_event_buffer_get_event(buffer, 1);
+			g_assert_cmpuint(gpiod_edge_event_get_line_offset(event),
+					 ==, 5);
+			g_assert_cmpint(gpiod_edge_event_get_event_type(event),
+					==, GPIOD_EDGE_EVENT_FALLING_EDGE);
+			seen |= 2;
+		}
+	}
+
+	g_assert_cmpuint(seen, ==, 3);
+	g_assert_null(gpiod_event_reactor_get_ready_request(reactor, 2));
+	gpiod_test_expect_errno(EINVAL);
+
+	gpiod_event_reactor_remove_request(reactor, request0);
+	gpiod_event_reactor_remove_request(reactor, request1);
+	gpiod_event_reactor_remove_request(reactor, request2);
+}
+
+/*
+ * Point the file descriptor number of one request at /dev/null so that reading
+ * its events fails while epoll still watches the original file.
+ */
+GPIOD_TEST_CASE(failed_request_does_not_lose_events)
+{
+	g_autoptr(GPIOSimChip) sim = g_gpiosim_chip_new("num-lines", 8, NULL);
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_request) request0 = NULL;
+	g_autoptr(struct_gpiod_line_request) request1 = NULL;
+	g_autoptr(struct_gpiod_edge_event_buffer) buffer0 = NULL;
+	g_autoptr(struct_gpiod_edge_event_buffer) buffer1 = NULL;
+	g_autoptr(struct_gpiod_event_reactor) reactor = NULL;
+	struct gpiod_edge_event *event;
+	gint ret, fd, saved_fd, null_fd;
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	buffer0 = gpiod_test_create_edge_event_buffer_or_fail(8);
+	buffer1 = gpiod_test_create_edge_event_buffer_or_fail(8);
+	reactor = gpiod_test_create_event_reactor_or_fail();
+
+	request0 = request_edge_events(chip, 1);
+	request1 = request_edge_events(chip, 3);
+	gpiod_test_return_if_failed();
+
+	ret = gpiod_event_reactor_add_request(reactor, request0, buffer0);
+	g_assert_cmpint(ret, ==, 0);
+	ret = gpiod_event_reactor_add_request(reactor, request1, buffer1);
+	g_assert_cmpint(ret, ==, 0);
+	gpiod_test_return_if_failed();
+
+	fd = gpiod_line_request_get_fd(request0);
+	saved_fd = dup(fd);
+	null_fd = open("/dev/null", O_WRONLY);
+	g_assert_cmpint(saved_fd, >=, 0);
+	g_assert_cmpint(null_fd, >=, 0);
+	g_assert_cmpint(dup2(null_fd, fd), ==, fd);
+	gpiod_test_return_if_failed();
+
+	g_gpiosim_chip_set_pull(sim, 1, G_GPIOSIM_PULL_UP);
+	g_gpiosim_chip_set_pull(sim, 3, G_GPIOSIM_PULL_UP);
+
+	ret = gpiod_event_reactor_wait(reactor, 1000000000);
+	g_assert_cmpint(ret, ==, 2);
+
+	g_assert_cmpuint(gpiod_event_reactor_get_num_ready_requests(reactor),
+			 ==, 1);
+	g_assert_true(gpiod_event_reactor_get_ready_request(reactor, 0) ==
+		      request1);
+	g_assert_cmpuint(gpiod_edge_event_buffer_get_num_events(buffer1),
+			 ==, 1);
+	event = gpiod_edge_event_buffer_get_event(buffer1, 0);
+	g_assert_cmpuint(gpiod_edge_event_get_line_offset(event), ==, 3);
+
+	g_assert_cmpuint(gpiod_event_reactor_get_num_failed_requests(reactor),
+			 ==, 1);
+	g_assert_true(gpiod_event_reactor_get_failed_request(reactor, 0) ==
+		      request0);
+	g_assert_cmpint(gpiod_event_reactor_get_failed_error(reactor, 0),
+			==, EBADF);
+	g_assert_cmpint(gpiod_event_reactor_get_failed_error(reactor, 1),
+			==, -1);
+	gpiod_test_expect_errno(EINVAL);
+
+	/* restore the request's descriptor before releasing it */
+	dup2(saved_fd, fd);
+	close(saved_fd);
+	close(null_fd);
+
+	gpiod_event_reactor_remove_request(reactor, request0);
+	gpiod_event_reactor_remove_request(reactor, request1);
+}
+
+GPIOD_TEST_CASE(chip_with_info_event_is_ready)
+{
+	static const guint offset = 4;
+
+	g_autoptr(GPIOSimChip) sim = g_gpiosim_chip_new("num-lines", 8, NULL);
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_info) info = NULL;
+	g_autoptr(struct_gpiod_line_config) line_cfg = NULL;
+	g_autoptr(struct_gpiod_line_request) request = NULL;
+	g_autoptr(struct_gpiod_info_event) event = NULL;
+	g_autoptr(struct_gpiod_event_reactor) reactor = NULL;
+	gint ret;
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	line_cfg = gpiod_test_create_line_config_or_fail();
+	reactor = gpiod_test_create_event_reactor_or_fail();
+
+	info = gpiod_test_chip_watch_line_info_or_fail(chip, offset);
+
+	ret = gpiod_event_reactor_add_chip(reactor, chip);
+	g_assert_cmpint(ret, ==, 0);
+	gpiod_test_return_if_failed();
+
+	gpiod_test_line_config_add_line_settings_or_fail(line_cfg, &offset, 1,
+							 NULL);
+
+	request = gpiod_test_chip_request_lines_or_fail(chip, NULL, line_cfg);
+
+	ret = gpiod_event_reactor_wait(reactor, 1000000000);
+	g_assert_cmpint(ret, ==, 1);
+	gpiod_test_return_if_failed();
+
+	g_assert_cmpuint(gpiod_event_reactor_get_num_ready_chips(reactor),
+			 ==, 1);
+	g_assert_true(gpiod_event_reactor_get_ready_chip(reactor, 0) == chip);
+
+	event = gpiod_chip_read_info_event(chip);
+	g_assert_nonnull(event);
+	g_assert_cmpint(gpiod_info_event_get_event_type(event), ==,
+			GPIOD_INFO_EVENT_LINE_REQUESTED);
+
+	ret = gpiod_event_reactor_remove_chip(reactor, chip);
+	g_assert_cmpint(ret, ==, 0);
+}
@@ -405,3 +405,199 @@ GPIOD_TEST_CASE(event_clock)
 	g_assert_cmpint(gpiod_line_info_get_event_clock(info2), ==,
 			GPIOD_LINE_CLOCK_HTE);
 }
+
+GPIOD_TEST_CASE(snapshot_basic_properties)
+{
+	static const GPIOSimLineName names[] = {
+		{ .offset = 1, .name = "foo", },
+		{ .offset = 4, .name = "bar", },
+		{ }
+	};
+
+	static const GPIOSimHog hogs[] = {
+		{
+			.offset = 3,
+			.name = "hog3",
+			.direction = G_GPIOSIM_DIRECTION_OUTPUT_HIGH,
+		},
+		{ }
+	};
+
+	g_autoptr(GPIOSimChip) sim = NULL;
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_info_snapshot) snapshot = NULL;
+	g_autoptr(GVariant) vnames = gpiod_test_package_line_names(names);
+	g_autoptr(GVariant) vhogs = gpiod_test_package_hogs(hogs);
+	struct gpiod_line_info *info;
+	guint offset;
+
+	sim = g_gpiosim_chip_new(
+			"num-lines", 8,
+			"line-names", vnames,
+			"hogs", vhogs,
+			NULL);
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	snapshot = gpiod_test_create_line_info_snapshot_or_fail(8);
+
+	g_assert_cmpuint(gpiod_line_info_snapshot_get_capacity(snapshot), ==,
+			 8);
+	g_assert_cmpuint(gpiod_line_info_snapshot_get_num_lines(snapshot), ==,
+			 0);
+
+	g_assert_cmpint(gpiod_chip_read_line_info_snapshot(chip, snapshot),
+			==, 8);
+	gpiod_test_return_if_failed();
+	g_assert_cmpuint(gpiod_line_info_snapshot_get_num_lines(snapshot), ==,
+			 8);
+
+	for (offset = 0; offset < 8; offset++) {
+		info = gpiod_line_info_snapshot_get_line_info(snapshot, offset);
+		g_assert_nonnull(info);
+		gpiod_test_return_if_failed();
+		g_assert_cmpuint(gpiod_line_info_get_offset(info), ==, offset);
+	}
+
+	info = gpiod_line_info_snapshot_get_line_info(snapshot, 1);
+	g_assert_cmpstr(gpiod_line_info_get_name(info), ==, "foo");
+	g_assert_false(gpiod_line_info_is_used(info));
+
+	info = gpiod_line_info_snapshot_get_line_info(snapshot, 3);
+	g_assert_null(gpiod_line_info_get_name(info));
+	g_assert_true(gpiod_line_info_is_used(info));
+	g_assert_cmpstr(gpiod_line_info_get_consumer(info), ==, "hog3");
+	g_assert_cmpint(gpiod_line_info_get_direction(info), ==,
+			GPIOD_LINE_DIRECTION_OUTPUT);
+}
+
+GPIOD_TEST_CASE(snapshot_offset_out_of_range)
+{
+	g_autoptr(GPIOSimChip) sim = g_gpiosim_chip_new("num-lines", 8, NULL);
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_info_snapshot) snapshot = NULL;
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	snapshot = gpiod_test_create_line_info_snapshot_or_fail(8);
+
+	g_assert_null(gpiod_line_info_snapshot_get_line_info(snapshot, 0));
+	gpiod_test_expect_errno(EINVAL);
+
+	g_assert_cmpint(gpiod_chip_read_line_info_snapshot(chip, snapshot),
+			==, 8);
+	g_assert_null(gpiod_line_info_snapshot_get_line_info(snapshot, 8));
+	gpiod_test_expect_errno(EINVAL);
+}
+
+GPIOD_TEST_CASE(snapshot_capacity_smaller_than_chip)
+{
+	static const GPIOSimLineName names[] = {
+		{ .offset = 1, .name = "foo", },
+		{ .offset = 6, .name = "bar", },
+		{ }
+	};
+
+	g_autoptr(GPIOSimChip) sim = NULL;
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_info_snapshot) snapshot = NULL;
+	g_autoptr(GVariant) vnames = gpiod_test_package_line_names(names);
+
+	sim = g_gpiosim_chip_new(
+			"num-lines", 8,
+			"line-names", vnames,
+			NULL);
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	snapshot = gpiod_test_create_line_info_snapshot_or_fail(4);
+
+	g_assert_cmpint(gpiod_chip_read_line_info_snapshot(chip, snapshot),
+			==, 4);
+	g_assert_cmpuint(gpiod_line_info_snapshot_get_num_lines(snapshot), ==,
+			 4);
+	g_assert_cmpint(gpiod_line_info_snapshot_find_line(snapshot, "foo"),
+			==, 1);
+	g_assert_cmpint(gpiod_line_info_snapshot_find_line(snapshot, "bar"),
+			==, -1);
+	gpiod_test_expect_errno(ENOENT);
+}
+
+GPIOD_TEST_CASE(snapshot_zero_capacity)
+{
+	g_assert_null(gpiod_line_info_snapshot_new(0));
+	gpiod_test_expect_errno(EINVAL);
+}
+
+GPIOD_TEST_CASE(snapshot_find_line)
+{
+	static const GPIOSimLineName names[] = {
+		{ .offset = 1, .name = "foo", },
+		{ .offset = 2, .name = "baz", },
+		{ .offset = 4, .name = "baz", },
+		{ .offset = 5, .name = "xyz", },
+		{ .offset = 7, .name = "foo bar", },
+		{ }
+	};
+
+	g_autoptr(GPIOSimChip) sim = NULL;
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_info_snapshot) snapshot = NULL;
+	g_autoptr(GVariant) vnames = gpiod_test_package_line_names(names);
+
+	sim = g_gpiosim_chip_new(
+			"num-lines", 8,
+			"line-names", vnames,
+			NULL);
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	snapshot = gpiod_test_create_line_info_snapshot_or_fail(8);
+
+	g_assert_cmpint(gpiod_chip_read_line_info_snapshot(chip, snapshot),
+			==, 8);
+	gpiod_test_return_if_failed();
+
+	g_assert_cmpint(gpiod_line_info_snapshot_find_line(snapshot, "foo"),
+			==, 1);
+	g_assert_cmpint(gpiod_line_info_snapshot_find_line(snapshot, "xyz"),
+			==, 5);
+	g_assert_cmpint(gpiod_line_info_snapshot_find_line(snapshot,
+							   "foo bar"),
+			==, 7);
+	/* For duplicated line names, the first one is returned. */
+	g_assert_cmpint(gpiod_line_info_snapshot_find_line(snapshot, "baz"),
+			==, 2);
+	g_assert_cmpint(gpiod_line_info_snapshot_find_line(snapshot,
+							   "nonexistent"),
+			==, -1);
+	gpiod_test_expect_errno(ENOENT);
+	g_assert_cmpint(gpiod_line_info_snapshot_find_line(snapshot, NULL),
+			==, -1);
+	gpiod_test_expect_errno(EINVAL);
+}
+
+GPIOD_TEST_CASE(snapshot_refill)
+{
+	g_autoptr(GPIOSimChip) sim = g_gpiosim_chip_new("num-lines", 4, NULL);
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_info_snapshot) snapshot = NULL;
+	g_autoptr(struct_gpiod_line_config) line_cfg = NULL;
+	g_autoptr(struct_gpiod_line_request) request = NULL;
+	struct gpiod_line_info *info;
+	guint offset = 2;
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	snapshot = gpiod_test_create_line_info_snapshot_or_fail(4);
+	line_cfg = gpiod_test_create_line_config_or_fail();
+
+	g_assert_cmpint(gpiod_chip_read_line_info_snapshot(chip, snapshot),
+			==, 4);
+	info = gpiod_line_info_snapshot_get_line_info(snapshot, offset);
+	g_assert_false(gpiod_line_info_is_used(info));
+
+	gpiod_test_line_config_add_line_settings_or_fail(line_cfg, &offset, 1,
+							 NULL);
+	request = gpiod_test_chip_request_lines_or_fail(chip, NULL, line_cfg);
+
+	g_assert_cmpint(gpiod_chip_read_line_info_snapshot(chip, snapshot),
+			==, 4);
+	info = gpiod_line_info_snapshot_get_line_info(snapshot, offset);
+	g_assert_true(gpiod_line_info_is_used(info));
+}
@@ -699,3 +699,134 @@ GPIOD_TEST_CASE(get_chip_name)
 	g_assert_cmpstr(g_gpiosim_chip_get_name(sim), ==,
 			gpiod_line_request_get_chip_name(request));
 }
+
+GPIOD_TEST_CASE(read_values_mask)
+{
+	static const guint offsets[] = { 6, 1, 3, 0 };
+	static const gint pulls[] = { 1, 0, 1, 1 };
+
+	g_autoptr(GPIOSimChip) sim = g_gpiosim_chip_new("num-lines", 8, NULL);
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_settings) settings = NULL;
+	g_autoptr(struct_gpiod_line_config) line_cfg = NULL;
+	g_autoptr(struct_gpiod_line_request) request = NULL;
+	guint64 bits;
+	gint ret;
+	guint i;
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	settings = gpiod_test_create_line_settings_or_fail();
+	line_cfg = gpiod_test_create_line_config_or_fail();
+
+	gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+	gpiod_test_line_config_add_line_settings_or_fail(line_cfg, offsets, 4,
+							 settings);
+
+	request = gpiod_test_chip_request_lines_or_fail(chip, NULL, line_cfg);
+
+	for (i = 0; i < 4; i++)
+		g_gpiosim_chip_set_pull(sim, offsets[i],
+					pulls[i] ? G_GPIOSIM_PULL_UP :
+						   G_GPIOSIM_PULL_DOWN);
+
+	ret = gpiod_line_request_get_values_mask(request, 0xf, &bits);
+	g_assert_cmpint(ret, ==, 0);
+	gpiod_test_return_if_failed();
+	g_assert_cmphex(bits, ==, 0xd);
+
+	ret = gpiod_line_request_get_values_mask(request, 0x6, &bits);
+	g_assert_cmpint(ret, ==, 0);
+	gpiod_test_return_if_failed();
+	g_assert_cmphex(bits, ==, 0x4);
+
+	ret = gpiod_line_request_get_values_mask(request, 0x10, &bits);
+	g_assert_cmpint(ret, ==, -1);
+	gpiod_test_expect_errno(EINVAL);
+}
+
+GPIOD_TEST_CASE(set_values_mask)
+{
+	static const guint offsets[] = { 7, 2, 4, 0 };
+
+	g_autoptr(GPIOSimChip) sim = g_gpiosim_chip_new("num-lines", 8, NULL);
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_settings) settings = NULL;
+	g_autoptr(struct_gpiod_line_config) line_cfg = NULL;
+	g_autoptr(struct_gpiod_line_request) request = NULL;
+	gint ret;
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	settings = gpiod_test_create_line_settings_or_fail();
+	line_cfg = gpiod_test_create_line_config_or_fail();
+
+	gpiod_line_settings_set_direction(settings,
+					  GPIOD_LINE_DIRECTION_OUTPUT);
+	gpiod_test_line_config_add_line_settings_or_fail(line_cfg, offsets, 4,
+							 settings);
+
+	request = gpiod_test_chip_request_lines_or_fail(chip, NULL, line_cfg);
+
+	/* Bit 2 is set in bits but not in mask so it must be left alone. */
+	ret = gpiod_line_request_set_values_mask(request, 0xb, 0x5);
+	g_assert_cmpint(ret, ==, 0);
+	gpiod_test_return_if_failed();
+
+	g_assert_cmpint(g_gpiosim_chip_get_value(sim, 7), ==,
+			G_GPIOSIM_VALUE_ACTIVE);
+	g_assert_cmpint(g_gpiosim_chip_get_value(sim, 2), ==,
+			G_GPIOSIM_VALUE_INACTIVE);
+	g_assert_cmpint(g_gpiosim_chip_get_value(sim, 4), ==,
+			G_GPIOSIM_VALUE_INACTIVE);
+	g_assert_cmpint(g_gpiosim_chip_get_value(sim, 0), ==,
+			G_GPIOSIM_VALUE_INACTIVE);
+
+	ret = gpiod_line_request_set_values_mask(request, 0x20, 0x20);
+	g_assert_cmpint(ret, ==, -1);
+	gpiod_test_expect_errno(EINVAL);
+}
+
+GPIOD_TEST_CASE(get_values_subset_of_many_lines)
+{
+	g_autoptr(GPIOSimChip) sim = g_gpiosim_chip_new("num-lines", 128, NULL);
+	g_autoptr(struct_gpiod_chip) chip = NULL;
+	g_autoptr(struct_gpiod_line_settings) settings = NULL;
+	g_autoptr(struct_gpiod_line_config) line_cfg = NULL;
+	g_autoptr(struct_gpiod_line_request) request = NULL;
+	enum gpiod_line_value values[64];
+	guint offsets[64], subset[64];
+	gint ret;
+	guint i;
+
+	/* Spread offsets over the chip in reverse to exercise the index. */
+	for (i = 0; i < 64; i++) {
+		offsets[i] = 127 - 2 * i;
+		subset[i] = offsets[(i * 7) % 64];
+	}
+
+	chip = gpiod_test_open_chip_or_fail(g_gpiosim_chip_get_dev_path(sim));
+	settings = gpiod_test_create_line_settings_or_fail();
+	line_cfg = gpiod_test_create_line_config_or_fail();
+
+	gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+	gpiod_test_line_config_add_line_settings_or_fail(line_cfg, offsets, 64,
+							 settings);
+
+	request = gpiod_test_chip_request_lines_or_fail(chip, NULL, line_cfg);
+
+	for (i = 0; i < 64; i++)
+		g_gpiosim_chip_set_pull(sim, offsets[i],
+					offsets[i] % 3 ? G_GPIOSIM_PULL_UP :
+							 G_GPIOSIM_PULL_DOWN);
+
+	ret = gpiod_line_request_get_values_subset(request, 64, subset, values);
+	g_assert_cmpint(ret, ==, 0);
+	gpiod_test_return_if_failed();
+
+	for (i = 0; i < 64; i++)
+		g_assert_cmpint(values[i], ==, subset[i] % 3 ? 1 : 0);
+
+	subset[0] = 0;
+	ret = gpiod_line_request_get_values_subset(request, 1, subset, values);
+	g_assert_cmpint(ret, ==, -1);
+	gpiod_test_expect_errno(EINVAL);
+}
@@ -2115,6 +2115,44 @@ test_gpiomon_with_idle_timeout() {
 	num_lines_is 0
 }
 
+test_gpiomon_with_stats() {
+	gpiosim_chip sim0 num_lines=8
+
+	local sim0=${GPIOSIM_CHIP_NAME[sim0]}
+
+	# redirect, as gpiomon exits after 4 events
+	dut_run_redirect gpiomon --stats=0 --num-events=4 --chip $sim0 4
+
+	gpiosim_set_pull sim0 4 pull-up
+	sleep 0.01
+	gpiosim_set_pull sim0 4 pull-down
+	sleep 0.01
+	gpiosim_set_pull sim0 4 pull-up
+	sleep 0.01
+	gpiosim_set_pull sim0 4 pull-down
+	sleep 0.01
+
+	dut_wait
+	status_is 0
+	dut_read_redirect
+
+	regex_matches "# elapsed=[0-9]+\.[0-9]+s events=4 dropped=0" "${lines[0]}"
+	regex_matches "$sim0 4\s+rising=2 falling=2 dropped=0 interval_us=.* latency_us=.*" \
+		"${lines[1]}"
+	num_lines_is 2
+}
+
+test_gpiomon_with_invalid_stats_period() {
+	gpiosim_chip sim0 num_lines=8
+
+	local sim0=${GPIOSIM_CHIP_NAME[sim0]}
+
+	run_tool gpiomon --stats bad -c $sim0 0
+
+	output_regex_match ".*invalid period: bad"
+	status_is 1
+}
+
 test_gpiomon_multiple_lines() {
 	gpiosim_chip sim0 num_lines=8
 
@@ -100,7 +100,8 @@ static int parse_config(int argc, char **argv, struct config *cfg)
  * Does not die on non-unique lines.
  */
 static bool resolve_line(struct line_resolver *resolver,
-			 struct gpiod_line_info *info, int chip_num)
+			 struct gpiod_line_info *info, int chip_num,
+			 bool by_offset)
 {
 	struct resolved_line *line;
 	bool resolved = false;
@@ -110,7 +111,7 @@ static bool resolve_line(struct line_resolver *resolver,
 
 	offset = gpiod_line_info_get_offset(info);
 
-	for (i = 0; i < resolver->num_lines; i++) {
+	for (i = 0; by_offset && (i < resolver->num_lines); i++) {
 		line = &resolver->lines[i];
 
 		/* already resolved by offset? */
@@ -118,18 +119,22 @@ static bool resolve_line(struct line_resolver *resolver,
 		    (line->chip_num == chip_num)) {
 			resolved = true;
 		}
+	}
+
+	/* else resolve by name */
+	name = gpiod_line_info_get_name(info);
+	if (!name)
+		return resolved;
 
+	for (line = find_line_by_name(resolver, name); line;
+	     line = next_line_by_name(resolver, line)) {
 		if (line->resolved && !resolver->strict)
 			continue;
 
-		/* else resolve by name */
-		name = gpiod_line_info_get_name(info);
-		if (name && (strcmp(line->id, name) == 0)) {
-			line->resolved = true;
-			line->offset = offset;
-			line->chip_num = chip_num;
-			resolved = true;
-		}
+		line->resolved = true;
+		line->offset = offset;
+		line->chip_num = chip_num;
+		resolved = true;
 	}
 
 	return resolved;
@@ -175,6 +180,7 @@ static void list_lines(struct line_resolver *resolver, struct gpiod_chip *chip,
 	struct gpiod_chip_info *chip_info;
 	struct gpiod_line_info *info;
 	int offset, num_lines;
+	bool by_offset = false;
 
 	chip_info = gpiod_chip_get_info(chip);
 	if (!chip_info)
@@ -184,33 +190,21 @@ static void list_lines(struct line_resolver *resolver, struct gpiod_chip *chip,
 	num_lines = gpiod_chip_info_get_num_lines(chip_info);
 
 	if ((chip_num == 0) && (cfg->chip_id && !cfg->by_name))
-		resolve_lines_by_offset(resolver, num_lines);
+		by_offset = resolve_lines_by_offset(resolver, num_lines);
 
-	for (offset = 0; ((offset < num_lines) &&
-			  !(resolver->num_lines && resolve_done(resolver)));
+	for (offset = 0; (offset < num_lines) && !resolve_done(resolver);
 	     offset++) {
 		info = gpiod_chip_get_line_info(chip, offset);
 		if (!info)
 			die_perror("unable to read info for line %d from %s",
 				   offset, gpiod_chip_info_get_name(chip_info));
 
-		if (resolver->num_lines &&
-		    !resolve_line(resolver, info, chip_num))
+		if (!resolve_line(resolver, info, chip_num, by_offset)) {
+			gpiod_line_info_free(info);
 			continue;
-
-		if (resolver->num_lines) {
-			printf("%s %u", gpiod_chip_info_get_name(chip_info),
-			       offset);
-		} else {
-			if (offset == 0)
-				printf("%s - %u lines:\n",
-				       gpiod_chip_info_get_name(chip_info),
-				       num_lines);
-
-			printf("\tline %3u:", offset);
 		}
 
-		fputc('\t', stdout);
+		printf("%s %u\t", gpiod_chip_info_get_name(chip_info), offset);
 		print_line_info(info, cfg->unquoted_strings);
 		fputc('\n', stdout);
 		gpiod_line_info_free(info);
@@ -220,8 +214,59 @@ static void list_lines(struct line_resolver *resolver, struct gpiod_chip *chip,
 	gpiod_chip_info_free(chip_info);
 }
 
+/*
+ * every line is printed, so read them all at once into a snapshot, which is
+ * reused for all chips
+ */
+static void list_all_lines(struct gpiod_chip *chip,
+			   struct gpiod_line_info_snapshot **snapshot,
+			   struct config *cfg)
+{
+	struct gpiod_chip_info *chip_info;
+	struct gpiod_line_info *info;
+	int offset, num_lines;
+
+	chip_info = gpiod_chip_get_info(chip);
+	if (!chip_info)
+		die_perror("unable to read info from chip %s",
+			   gpiod_chip_get_path(chip));
+
+	num_lines = gpiod_chip_info_get_num_lines(chip_info);
+	if (num_lines == 0)
+		goto out;
+
+	if (!*snapshot ||
+	    gpiod_line_info_snapshot_get_capacity(*snapshot) <
+							(size_t)num_lines) {
+		gpiod_line_info_snapshot_free(*snapshot);
+		*snapshot = gpiod_line_info_snapshot_new(num_lines);
+		if (!*snapshot)
+			die_perror("unable to allocate the line info snapshot for %s",
+				   gpiod_chip_info_get_name(chip_info));
+	}
+
+	if (gpiod_chip_read_line_info_snapshot(chip, *snapshot) < 0)
+		die_perror("unable to read the line info from %s",
+			   gpiod_chip_info_get_name(chip_info));
+
+	printf("%s - %u lines:\n", gpiod_chip_info_get_name(chip_info),
+	       num_lines);
+
+	for (offset = 0; offset < num_lines; offset++) {
+		info = gpiod_line_info_snapshot_get_line_info(*snapshot, offset);
+
+		printf("\tline %3u:\t", offset);
+		print_line_info(info, cfg->unquoted_strings);
+		fputc('\n', stdout);
+	}
+
+out:
+	gpiod_chip_info_free(chip_info);
+}
+
 int main(int argc, char **argv)
 {
+	struct gpiod_line_info_snapshot *snapshot = NULL;
 	struct line_resolver *resolver = NULL;
 	int num_chips, i, ret = EXIT_SUCCESS;
 	struct gpiod_chip *chip;
@@ -246,7 +291,10 @@ int main(int argc, char **argv)
 	for (i = 0; i < num_chips; i++) {
 		chip = gpiod_chip_open(paths[i]);
 		if (chip) {
-			list_lines(resolver, chip, i, &cfg);
+			if (resolver->num_lines)
+				list_lines(resolver, chip, i, &cfg);
+			else
+				list_all_lines(chip, &snapshot, &cfg);
 			gpiod_chip_close(chip);
 		} else {
 			print_perror("unable to open chip '%s'", paths[i]);
@@ -258,6 +306,7 @@ int main(int argc, char **argv)
 		}
 		free(paths[i]);
 	}
+	gpiod_line_info_snapshot_free(snapshot);
 	free(paths);
 
 	validate_resolution(resolver, cfg.chip_id);
@@ -2,23 +2,35 @@
 // SPDX-FileCopyrightText: 2017-2021 Bartosz Golaszewski <bartekgola@gmail.com>
 // SPDX-FileCopyrightText: 2022 Kent Gibson <warthog618@gmail.com>
 
+#include <errno.h>
 #include <getopt.h>
 #include <gpiod.h>
 #include <inttypes.h>
 #include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "tools-common.h"
 
 #define EVENT_BUF_SIZE 32
 
+/*
+ * Statistics histograms are log-linear: each power of two is split into
+ * 2^HIST_SUB_BITS buckets, which keeps the relative error below 25% while
+ * using a fixed amount of memory for the whole range of 64-bit values.
+ */
+#define HIST_SUB_BITS		2
+#define HIST_NUM_BUCKETS	(64 << HIST_SUB_BITS)
+
 struct config {
 	bool active_low;
 	bool banner;
 	bool by_name;
 	bool quiet;
+	bool stats;
 	bool strict;
 	bool unquoted;
 	enum gpiod_line_bias bias;
@@ -31,8 +43,37 @@ struct config {
 	enum gpiod_line_clock event_clock;
 	int timestamp_fmt;
 	int timeout;
+	unsigned int stats_period_us;
+};
+
+struct histogram {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[HIST_NUM_BUCKETS];
+};
+
+struct line_stats {
+	uint64_t rising;
+	uint64_t falling;
+	uint64_t dropped;
+	uint64_t last_timestamp;
+	unsigned long last_seqno;
+	struct histogram interval;
+	struct histogram latency;
+};
+
+struct stats {
+	struct line_stats *lines;
+	unsigned long *last_global_seqno;
+	uint64_t events;
+	uint64_t dropped;
+	uint64_t start_ms;
+	uint64_t next_report_ms;
 };
 
+static volatile sig_atomic_t stop_requested;
+
 static void print_help(void)
 {
 	printf("Usage: %s [OPTIONS] <line>...\n", get_prog_name());
@@ -69,6 +110,10 @@ static void print_help(void)
 	printf("\t\t\tdebounce the line(s) with the specified period\n");
 	printf("  -q, --quiet\t\tdon't generate any output\n");
 	printf("  -s, --strict\t\tabort if requested line names are not unique\n");
+	printf("  -S, --stats <period>\n");
+	printf("\t\t\tdon't print events, instead collect per-line statistics and\n");
+	printf("\t\t\tprint a summary every period and on exit (a period of 0\n");
+	printf("\t\t\tonly prints the summary on exit)\n");
 	printf("      --unquoted\tdon't quote line or consumer names\n");
 	printf("      --utc\t\tformat event timestamps as UTC (default for 'realtime')\n");
 	printf("  -v, --version\t\toutput version information and exit\n");
@@ -112,7 +157,7 @@ static int parse_event_clock_or_die(const char *option)
 
 static int parse_config(int argc, char **argv, struct config *cfg)
 {
-	static const char *const shortopts = "+b:c:C:e:E:hF:ln:p:qshv";
+	static const char *const shortopts = "+b:c:C:e:E:hF:ln:p:qsS:hv";
 
 	const struct option longopts[] = {
 		{ "active-low",	no_argument,	NULL,		'l' },
@@ -131,6 +176,7 @@ static int parse_config(int argc, char **argv, struct config *cfg)
 		{ "num-events",	required_argument, NULL,	'n' },
 		{ "quiet",	no_argument,	NULL,		'q' },
 		{ "silent",	no_argument,	NULL,		'q' },
+		{ "stats",	required_argument, NULL,	'S' },
 		{ "strict",	no_argument,	NULL,		's' },
 		{ "unquoted",	no_argument,	NULL,		'Q' },
 		{ "utc",	no_argument,	&cfg->timestamp_fmt,	1 },
@@ -196,6 +242,10 @@ static int parse_config(int argc, char **argv, struct config *cfg)
 		case 's':
 			cfg->strict = true;
 			break;
+		case 'S':
+			cfg->stats = true;
+			cfg->stats_period_us = parse_period_or_die(optarg);
+			break;
 		case 'h':
 			print_help();
 			exit(EXIT_SUCCESS);
@@ -352,6 +402,208 @@ static void event_print(struct gpiod_edge_event *event,
 		event_print_human_readable(event, resolver, chip_num, cfg);
 }
 
+static uint64_t clock_now_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int hist_bucket(uint64_t val)
+{
+	unsigned int msb;
+
+	if (val < (1U << HIST_SUB_BITS))
+		return val;
+
+	msb = 63 - __builtin_clzll(val);
+
+	return ((msb - HIST_SUB_BITS + 1) << HIST_SUB_BITS) |
+	       ((val >> (msb - HIST_SUB_BITS)) & ((1U << HIST_SUB_BITS) - 1));
+}
+
+static uint64_t hist_bucket_max(unsigned int bucket)
+{
+	unsigned int group = bucket >> HIST_SUB_BITS;
+	unsigned int sub = bucket & ((1U << HIST_SUB_BITS) - 1);
+
+	if (!group)
+		return sub;
+
+	return (((uint64_t)((1U << HIST_SUB_BITS) | sub)) << (group - 1)) +
+	       ((1ULL << (group - 1)) - 1);
+}
+
+static void hist_record(struct histogram *hist, uint64_t val)
+{
+	if (!hist->count || val < hist->min)
+		hist->min = val;
+	if (val > hist->max)
+		hist->max = val;
+
+	hist->count++;
+	hist->buckets[hist_bucket(val)]++;
+}
+
+static uint64_t hist_percentile(struct histogram *hist, unsigned int permille)
+{
+	uint64_t rank, seen = 0;
+	unsigned int i;
+
+	rank = (hist->count * permille + 999) / 1000;
+	if (!rank)
+		rank = 1;
+
+	for (i = 0; i < HIST_NUM_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	if (i == HIST_NUM_BUCKETS)
+		return hist->max;
+
+	if (hist_bucket_max(i) > hist->max)
+		return hist->max;
+
+	return hist_bucket_max(i);
+}
+
+static void hist_print(const char *name, struct histogram *hist)
+{
+	if (!hist->count) {
+		printf(" %s=n/a", name);
+		return;
+	}
+
+	printf(" %s_us=%.1f/%.1f/%.1f/%.1f", name, hist->min / 1000.0,
+	       hist_percentile(hist, 500) / 1000.0,
+	       hist_percentile(hist, 990) / 1000.0, hist->max / 1000.0);
+}
+
+static int find_line(struct line_resolver *resolver, int chip_num,
+		     unsigned int offset)
+{
+	int i;
+
+	for (i = 0; i < resolver->num_lines; i++) {
+		if (resolver->lines[i].chip_num == chip_num &&
+		    resolver->lines[i].offset == offset)
+			return i;
+	}
+
+	return -1;
+}
+
+static void stats_record(struct stats *stats, struct gpiod_edge_event *event,
+			 struct line_resolver *resolver, int chip_num,
+			 uint64_t read_ns, bool has_latency)
+{
+	unsigned long seqno, global_seqno;
+	struct line_stats *ls;
+	uint64_t evtime;
+	int line;
+
+	line = find_line(resolver, chip_num,
+			 gpiod_edge_event_get_line_offset(event));
+	if (line < 0)
+		return;
+
+	ls = &stats->lines[line];
+	evtime = gpiod_edge_event_get_timestamp_ns(event);
+	seqno = gpiod_edge_event_get_line_seqno(event);
+	global_seqno = gpiod_edge_event_get_global_seqno(event);
+
+	/* Sequence numbers start at 1, a gap means the kernel dropped events. */
+	if (seqno > ls->last_seqno + 1)
+		ls->dropped += seqno - ls->last_seqno - 1;
+	ls->last_seqno = seqno;
+
+	if (global_seqno > stats->last_global_seqno[chip_num] + 1)
+		stats->dropped += global_seqno -
+				  stats->last_global_seqno[chip_num] - 1;
+	stats->last_global_seqno[chip_num] = global_seqno;
+
+	if (gpiod_edge_event_get_event_type(event) ==
+	    GPIOD_EDGE_EVENT_RISING_EDGE)
+		ls->rising++;
+	else
+		ls->falling++;
+
+	if ((ls->rising + ls->falling) > 1 && evtime >= ls->last_timestamp)
+		hist_record(&ls->interval, evtime - ls->last_timestamp);
+	ls->last_timestamp = evtime;
+
+	if (has_latency && read_ns >= evtime)
+		hist_record(&ls->latency, read_ns - evtime);
+
+	stats->events++;
+}
+
+static void stats_print(struct stats *stats, struct line_resolver *resolver,
+			struct config *cfg)
+{
+	struct line_stats *ls;
+	uint64_t elapsed_ms;
+	int i;
+
+	elapsed_ms = clock_now_ns(CLOCK_MONOTONIC) / 1000000 - stats->start_ms;
+
+	printf("# elapsed=%" PRIu64 ".%03" PRIu64 "s events=%" PRIu64
+	       " dropped=%" PRIu64 "\n", elapsed_ms / 1000, elapsed_ms % 1000,
+	       stats->events, stats->dropped);
+
+	for (i = 0; i < resolver->num_lines; i++) {
+		ls = &stats->lines[i];
+
+		print_line_id(resolver, resolver->lines[i].chip_num,
+			      resolver->lines[i].offset, cfg->chip_id,
+			      cfg->unquoted);
+		printf("\trising=%" PRIu64 " falling=%" PRIu64
+		       " dropped=%" PRIu64, ls->rising, ls->falling,
+		       ls->dropped);
+		hist_print("interval", &ls->interval);
+		hist_print("latency", &ls->latency);
+		fputc('\n', stdout);
+	}
+
+	fflush(stdout);
+}
+
+static void handle_stop_signal(int signum UNUSED)
+{
+	stop_requested = 1;
+}
+
+/*
+ * Compute the poll() timeout taking both the idle timeout and the time left
+ * until the next statistics report into account.
+ */
+static int poll_timeout(struct config *cfg, struct stats *stats,
+			uint64_t last_event_ms)
+{
+	int64_t now_ms, idle_left, report_left;
+
+	if (!cfg->stats || !cfg->stats_period_us)
+		return cfg->timeout;
+
+	now_ms = clock_now_ns(CLOCK_MONOTONIC) / 1000000;
+	report_left = (int64_t)stats->next_report_ms - now_ms;
+	if (report_left < 0)
+		report_left = 0;
+
+	if (cfg->timeout < 0)
+		return report_left;
+
+	idle_left = (int64_t)last_event_ms + cfg->timeout - now_ms;
+	if (idle_left < 0)
+		idle_left = 0;
+
+	return idle_left < report_left ? idle_left : report_left;
+}
+
 int main(int argc, char **argv)
 {
 	struct gpiod_edge_event_buffer *event_buffer;
@@ -362,11 +614,17 @@ int main(int argc, char **argv)
 	int num_lines, events_done = 0;
 	struct gpiod_edge_event *event;
 	struct line_resolver *resolver;
+	uint64_t read_ns, now_ms, last_event_ms;
+	sigset_t stop_signals, poll_mask;
 	struct gpiod_chip *chip;
 	struct pollfd *pollfds;
 	unsigned int *offsets;
+	struct timespec ts;
+	struct stats stats;
 	struct config cfg;
-	int ret, i, j;
+	int ret, i, j, timeout_ms;
+	bool has_latency;
+	clockid_t clk;
 
 	set_prog_name(argv[0]);
 	i = parse_config(argc, argv, &cfg);
@@ -419,6 +677,39 @@ int main(int argc, char **argv)
 	if (!requests || !pollfds || !offsets)
 		die("out of memory");
 
+	memset(&stats, 0, sizeof(stats));
+	if (cfg.stats) {
+		stats.lines = calloc(resolver->num_lines, sizeof(*stats.lines));
+		stats.last_global_seqno = calloc(resolver->num_chips,
+					 sizeof(*stats.last_global_seqno));
+		if (!stats.lines || !stats.last_global_seqno)
+			die("out of memory");
+
+		stats.start_ms = clock_now_ns(CLOCK_MONOTONIC) / 1000000;
+		stats.next_report_ms = stats.start_ms +
+				       cfg.stats_period_us / 1000;
+	}
+
+	/*
+	 * Stop signals are only delivered while waiting in ppoll() so that one
+	 * arriving while events are being processed isn't missed.
+	 */
+	sigprocmask(SIG_SETMASK, NULL, &poll_mask);
+	if (cfg.stats) {
+		sigemptyset(&stop_signals);
+		sigaddset(&stop_signals, SIGINT);
+		sigaddset(&stop_signals, SIGTERM);
+		sigprocmask(SIG_BLOCK, &stop_signals, &poll_mask);
+
+		signal(SIGINT, handle_stop_signal);
+		signal(SIGTERM, handle_stop_signal);
+	}
+
+	/* Latency can only be measured against a clock we can read. */
+	has_latency = cfg.event_clock != GPIOD_LINE_CLOCK_HTE;
+	clk = cfg.event_clock == GPIOD_LINE_CLOCK_REALTIME ? CLOCK_REALTIME :
+							     CLOCK_MONOTONIC;
+
 	for (i = 0; i < resolver->num_chips; i++) {
 		num_lines = get_line_offsets_and_values(resolver, i, offsets,
 							NULL);
@@ -450,15 +741,45 @@ int main(int argc, char **argv)
 	if (cfg.banner)
 		print_banner(argc, argv);
 
+	last_event_ms = clock_now_ns(CLOCK_MONOTONIC) / 1000000;
+
 	for (;;) {
 		fflush(stdout);
 
-		ret = poll(pollfds, resolver->num_chips, cfg.timeout);
+		if (stop_requested)
+			goto done;
+
+		timeout_ms = poll_timeout(&cfg, &stats, last_event_ms);
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+
+		ret = ppoll(pollfds, resolver->num_chips,
+			    timeout_ms < 0 ? NULL : &ts, &poll_mask);
+		if (ret < 0 && errno == EINTR && stop_requested)
+			goto done;
 		if (ret < 0)
 			die_perror("error polling for events");
 
-		if (ret == 0)
-			goto done;
+		now_ms = clock_now_ns(CLOCK_MONOTONIC) / 1000000;
+
+		if (cfg.stats && cfg.stats_period_us &&
+		    now_ms >= stats.next_report_ms) {
+			if (!cfg.quiet)
+				stats_print(&stats, resolver, &cfg);
+			while (stats.next_report_ms <= now_ms)
+				stats.next_report_ms +=
+						cfg.stats_period_us / 1000 ?: 1;
+		}
+
+		if (ret == 0) {
+			if (cfg.timeout >= 0 &&
+			    now_ms - last_event_ms >= (uint64_t)cfg.timeout)
+				goto done;
+
+			continue;
+		}
+
+		last_event_ms = now_ms;
 
 		for (i = 0; i < resolver->num_chips; i++) {
 			if (pollfds[i].revents == 0)
@@ -469,13 +790,19 @@ int main(int argc, char **argv)
 			if (ret < 0)
 				die_perror("error reading line events");
 
+			read_ns = cfg.stats ? clock_now_ns(clk) : 0;
+
 			for (j = 0; j < ret; j++) {
 				event = gpiod_edge_event_buffer_get_event(
 						event_buffer, j);
 				if (!event)
 					die_perror("unable to retrieve event from buffer");
 
-				event_print(event, resolver, i, &cfg);
+				if (cfg.stats)
+					stats_record(&stats, event, resolver, i,
+						     read_ns, has_latency);
+				else
+					event_print(event, resolver, i, &cfg);
 
 				events_done++;
 
@@ -487,10 +814,15 @@ int main(int argc, char **argv)
 	}
 
 done:
+	if (cfg.stats && !cfg.quiet)
+		stats_print(&stats, resolver, &cfg);
+
 	for (i = 0; i < resolver->num_chips; i++)
 		gpiod_line_request_release(requests[i]);
 
 	free(requests);
+	free(stats.lines);
+	free(stats.last_global_seqno);
 	free_line_resolver(resolver);
 	gpiod_edge_event_buffer_free(event_buffer);
 	free(offsets);
@@ -497,6 +497,94 @@ int all_chip_paths(char ***paths_ptr)
 	return ret;
 }
 
+/* FNV-1a - line names are short so anything fancier isn't worth it */
+static uint32_t name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	for (; *name; name++) {
+		hash ^= (unsigned char)*name;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static void build_name_index(struct line_resolver *resolver)
+{
+	struct resolved_line *line;
+	size_t mask, slot;
+	unsigned int entry;
+	int i, *tail;
+
+	/* keep the load factor at or below one half */
+	resolver->name_index_size = 16;
+	while (resolver->name_index_size < (size_t)resolver->num_lines * 2)
+		resolver->name_index_size <<= 1;
+
+	resolver->name_index = calloc(resolver->name_index_size,
+				      sizeof(*resolver->name_index));
+	if (!resolver->name_index)
+		die("out of memory");
+
+	mask = resolver->name_index_size - 1;
+	for (i = 0; i < resolver->num_lines; i++) {
+		line = &resolver->lines[i];
+		for (slot = name_hash(line->id) & mask;;
+		     slot = (slot + 1) & mask) {
+			entry = resolver->name_index[slot];
+			if (!entry) {
+				resolver->name_index[slot] = i + 1;
+				break;
+			}
+
+			/* same id requested again - chain it */
+			if (strcmp(resolver->lines[entry - 1].id, line->id) == 0) {
+				tail = &resolver->lines[entry - 1].next_by_name;
+				while (*tail != -1)
+					tail = &resolver->lines[*tail].next_by_name;
+				*tail = i;
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * find the first requested line with the given id, further ones are chained
+ * via next_by_name
+ *
+ * The index is only built once a line name actually needs to be looked up.
+ */
+struct resolved_line *find_line_by_name(struct line_resolver *resolver,
+					const char *name)
+{
+	size_t mask, slot;
+	unsigned int entry;
+
+	if (!resolver->name_index)
+		build_name_index(resolver);
+
+	mask = resolver->name_index_size - 1;
+	for (slot = name_hash(name) & mask;; slot = (slot + 1) & mask) {
+		entry = resolver->name_index[slot];
+		if (!entry)
+			return NULL;
+
+		if (strcmp(resolver->lines[entry - 1].id, name) == 0)
+			return &resolver->lines[entry - 1];
+	}
+}
+
+struct resolved_line *next_line_by_name(struct line_resolver *resolver,
+					struct resolved_line *line)
+{
+	if (line->next_by_name == -1)
+		return NULL;
+
+	return &resolver->lines[line->next_by_name];
+}
+
 static bool resolve_line(struct line_resolver *resolver,
 			 struct gpiod_line_info *info, int chip_num)
 {
@@ -504,33 +592,34 @@ static bool resolve_line(struct line_resolver *resolver,
 	bool resolved = false;
 	unsigned int offset;
 	const char *name;
-	int i;
+
+	name = gpiod_line_info_get_name(info);
+	if (!name)
+		return false;
 
 	offset = gpiod_line_info_get_offset(info);
-	for (i = 0; i < resolver->num_lines; i++) {
-		line = &resolver->lines[i];
+	for (line = find_line_by_name(resolver, name); line;
+	     line = next_line_by_name(resolver, line)) {
 		/* already resolved by offset? */
 		if (line->resolved && (line->offset == offset) &&
-		    (line->chip_num == chip_num)) {
-			line->info = info;
-			resolver->num_found++;
-			resolved = true;
-		}
-		if (line->resolved && !resolver->strict)
+		    (line->chip_num == chip_num))
 			continue;
 
-		/* else resolve by name */
-		name = gpiod_line_info_get_name(info);
-		if (name && (strcmp(line->id, name) == 0)) {
-			if (resolver->strict && line->resolved)
+		if (line->resolved) {
+			if (resolver->strict)
 				die("line '%s' is not unique", line->id);
-			line->offset = offset;
-			line->info = info;
-			line->chip_num = resolver->num_chips;
-			line->resolved = true;
-			resolver->num_found++;
-			resolved = true;
+			continue;
 		}
+
+		line->offset = offset;
+		/* the same id may be requested more than once */
+		line->info = resolved ? gpiod_line_info_copy(info) : info;
+		if (!line->info)
+			die("out of memory");
+		line->chip_num = chip_num;
+		line->resolved = true;
+		resolver->num_found++;
+		resolved = true;
 	}
 
 	return resolved;
@@ -562,6 +651,31 @@ bool resolve_lines_by_offset(struct line_resolver *resolver,
 	return used;
 }
 
+/*
+ * read the info of the lines resolved by offset directly, rather than
+ * scanning the chip for them
+ */
+static void get_offset_line_info(struct line_resolver *resolver,
+				 struct gpiod_chip *chip, int chip_num)
+{
+	struct resolved_line *line;
+	int i;
+
+	for (i = 0; i < resolver->num_lines; i++) {
+		line = &resolver->lines[i];
+		if (!line->resolved || line->info ||
+		    (line->chip_num != chip_num))
+			continue;
+
+		line->info = gpiod_chip_get_line_info(chip, line->offset);
+		if (!line->info)
+			die_perror("unable to read the info for line %u from %s",
+				   line->offset, gpiod_chip_get_path(chip));
+
+		resolver->num_found++;
+	}
+}
+
 bool resolve_done(struct line_resolver *resolver)
 {
 	return (!resolver->strict &&
@@ -595,6 +709,7 @@ struct line_resolver *resolver_init(int num_lines, char **lines, int num_chips,
 		line->id = lines[i];
 		line->id_as_offset = by_name ? -1 : parse_uint(lines[i]);
 		line->chip_num = -1;
+		line->next_by_name = -1;
 	}
 
 	return resolver;
@@ -639,8 +754,11 @@ struct line_resolver *resolve_lines(int num_lines, char **lines,
 
 		num_lines = gpiod_chip_info_get_num_lines(chip_info);
 
-		if (i == 0 && chip_id && !by_name)
+		if (i == 0 && chip_id && !by_name) {
 			chip_used = resolve_lines_by_offset(resolver, num_lines);
+			if (chip_used)
+				get_offset_line_info(resolver, chip, 0);
+		}
 
 		for (offset = 0;
 		     (offset < num_lines) && !resolve_done(resolver);
@@ -651,7 +769,8 @@ struct line_resolver *resolve_lines(int num_lines, char **lines,
 					   offset,
 					   gpiod_chip_info_get_name(chip_info));
 
-			if (resolve_line(resolver, line_info, i))
+			if (resolve_line(resolver, line_info,
+					 resolver->num_chips))
 				chip_used = true;
 			else
 				gpiod_line_info_free(line_info);
@@ -722,6 +841,7 @@ void free_line_resolver(struct line_resolver *resolver)
 		free(resolver->chips[i].path);
 	}
 
+	free(resolver->name_index);
 	free(resolver->chips);
 	free(resolver);
 }
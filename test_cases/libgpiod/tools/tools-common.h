@@ -16,6 +16,7 @@
 
 #define NORETURN		__attribute__((noreturn))
 #define PRINTF(fmt, arg)	__attribute__((format(printf, fmt, arg)))
+#define UNUSED			__attribute__((unused))
 
 #define GETOPT_NULL_LONGOPT	NULL, 0, NULL, 0
 
@@ -45,6 +46,9 @@ struct resolved_line {
 
 	/* line value for gpioget/set */
 	int value;
+
+	/* next requested line with the same id, or -1 */
+	int next_by_name;
 };
 
 struct resolved_chip {
@@ -71,6 +75,13 @@ struct line_resolver {
 	/* perform exhaustive search to check line names are unique */
 	bool strict;
 
+	/*
+	 * hash of the requested ids, mapping to the index of the first line
+	 * with that id plus one, built on first lookup by name
+	 */
+	unsigned int *name_index;
+	size_t name_index_size;
+
 	/* details of the relevant chips */
 	struct resolved_chip *chips;
 
@@ -108,6 +119,10 @@ struct line_resolver *resolver_init(int num_lines, char **lines, int num_chips,
 				    bool strict, bool by_name);
 bool resolve_lines_by_offset(struct line_resolver *resolver,
 			     unsigned int num_lines);
+struct resolved_line *find_line_by_name(struct line_resolver *resolver,
+					const char *name);
+struct resolved_line *next_line_by_name(struct line_resolver *resolver,
+					struct resolved_line *line);
 bool resolve_done(struct line_resolver *resolver);
 void validate_resolution(struct line_resolver *resolver, const char *chip_id);
 void free_line_resolver(struct line_resolver *resolver);
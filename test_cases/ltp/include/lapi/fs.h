@@ -20,6 +20,18 @@
 #include <limits.h>
 #include "lapi/abisize.h"
 
+#ifndef FICLONE
+# define	FICLONE		_IOW(0x94, 9, int)
+#endif
+
+#ifndef BLKFLSBUF
+# define	BLKFLSBUF	_IO(0x12, 97)
+#endif
+
+#ifndef BLKDISCARD
+# define	BLKDISCARD	_IO(0x12, 119)
+#endif
+
 #ifndef FS_IOC_GETFLAGS
 # define	FS_IOC_GETFLAGS	_IOR('f', 1, long)
 #endif
@@ -39,6 +39,11 @@ CPPFLAGS			+= -I$(top_srcdir)/include -I$(top_builddir)/include -I$(top_srcdir)/
 
 LDFLAGS				+= -L$(top_builddir)/lib
 
+# libltp reads compressed kernel configs with zlib if available
+ifneq ($(filter -lltp,$(LDLIBS)),)
+LDLIBS				+= $(ZLIB_LIBS)
+endif
+
 ifeq ($(UCLINUX),1)
 CPPFLAGS			+= -D__UCLIBC__ -DUCLINUX
 endif
@@ -30,6 +30,16 @@ else
 	@echo LD $(target_rel_dir)$@
 endif
 
+# Shared object for testcases/lib/tst_batch, the library is provided by the
+# host binary.
+%.so: %.c
+ifdef VERBOSE
+	$(CC) $(CPPFLAGS) -DTST_BATCH $(CFLAGS) -fPIC -shared $(LDFLAGS) $^ $(LTPLDLIBS) $(filter-out -lltp,$(LDLIBS)) -o $@
+else
+	@$(CC) $(CPPFLAGS) -DTST_BATCH $(CFLAGS) -fPIC -shared $(LDFLAGS) $^ $(LTPLDLIBS) $(filter-out -lltp,$(LDLIBS)) -o $@
+	@echo CC $(target_rel_dir)$@
+endif
+
 $(HOST_MAKE_TARGETS): %: %.c
 ifdef VERBOSE
 	$(HOSTCC) $(HOST_CFLAGS) $(HOST_LDFLAGS) $< $(HOST_LDLIBS) -o $@
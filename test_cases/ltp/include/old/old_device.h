@@ -68,6 +68,21 @@ const char *tst_acquire_loop_device(unsigned int size, const char *filename);
  */
 int tst_release_device(const char *dev);
 
+/*
+ * Attaches @slot_cnt loop devices of @size MB (0 for the default size) backed
+ * by files next to @pool_path and records them in the pool file @pool_path.
+ * When LTP_DEV_POOL points to the pool file, tst_acquire_device() takes a free
+ * device from it and tst_release_device() wipes the device and returns it to
+ * the pool instead of detaching it.
+ */
+int tst_loop_pool_create(const char *pool_path, unsigned int slot_cnt,
+			 unsigned int size);
+
+/*
+ * Detaches the devices and removes the files created by tst_loop_pool_create().
+ */
+int tst_loop_pool_destroy(const char *pool_path);
+
 /*
  * Cleanup function for tst_acquire_loop_device(). If you have acquired
  * a device using tst_acquire_device(), use tst_release_device() instead.
@@ -10,6 +10,23 @@ long tst_ncpus_conf(void);
 long tst_ncpus_max(void);
 long tst_ncpus_available(void);
 
+/*
+ * Picks two CPUs the calling thread is allowed to run on, cpu_a is the one
+ * the thread runs on now if possible. If remote is zero cpu_b is an SMT
+ * sibling of cpu_a, otherwise it is on another core and on another package
+ * if there is one. Returns 0 on success, -1 if no such pair exists.
+ */
+int tst_cpu_pick_pair(int remote, int *cpu_a, int *cpu_b);
+
+/* Pins the calling thread to the CPU, returns 0 or -1 and sets errno */
+int tst_cpu_pin(int cpu);
+
+/*
+ * Restores the CPU affinity of the calling thread to the mask it had in the
+ * last call to tst_cpu_pick_pair().
+ */
+void tst_cpu_unpin(void);
+
 #define VIRT_ANY	0	/* catch-all argument for tst_is_virt() */
 #define VIRT_XEN	1	/* xen dom0/domU */
 #define VIRT_KVM	2	/* only default virtual CPU */
@@ -56,12 +56,22 @@
  * For a usage example see testcases/cve/cve-2016-7117.c or just run
  * 'git grep tst_fuzzy_sync.h'
  *
+ * Two things affect how quickly the race windows are found. The threads
+ * should run on different CPUs all the time, so they can be pinned to a pair
+ * of SMT siblings or to CPUs on different cores (LTP_FZSYNC_PIN=sibling or
+ * remote). Reading the time should be as cheap and as stable as possible, so
+ * the CPU cycle counter (TSC on x86, CNTVCT on aarch64) can be used instead
+ * of clock_gettime() (LTP_FZSYNC_CYCLES=1). Once the random delays are
+ * introduced the library tracks which parts of the delay range have been
+ * hit and prints the window coverage when the loop ends.
+ *
  * @sa tst_fzsync_pair
  */
 
 #include <math.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <time.h>
 #include "tst_atomic.h"
@@ -75,6 +85,31 @@
 /* how much of exec time is sampling allowed to take */
 #define SAMPLING_SLICE 0.5f
 
+/* fields written by different threads are kept in separate cache lines */
+#if defined(__powerpc64__)
+# define TST_FZSYNC_CACHELINE 128
+#else
+# define TST_FZSYNC_CACHELINE 64
+#endif
+#define TST_FZSYNC_ALIGNED __attribute__((aligned(TST_FZSYNC_CACHELINE)))
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+# define TST_FZSYNC_HAVE_CYCLES
+#endif
+
+/* the delay range is split into this many parts to measure the coverage */
+#define TST_FZSYNC_COVERAGE 64
+
+/** Where to run thread A and thread B */
+enum tst_fzsync_pin {
+	/** Let the scheduler decide */
+	TST_FZSYNC_PIN_NONE,
+	/** Pin the threads to two SMT siblings of the same core */
+	TST_FZSYNC_PIN_SIBLING,
+	/** Pin the threads to two different cores, packages if possible */
+	TST_FZSYNC_PIN_REMOTE,
+};
+
 /** Some statistics for a variable */
 struct tst_fzsync_stat {
 	float avg;
@@ -102,14 +137,24 @@ struct tst_fzsync_pair {
 	 * Defaults to 0.25.
 	 */
 	float avg_alpha;
-	/** Internal; Thread A start time */
-	struct timespec a_start;
-	/** Internal; Thread B start time */
-	struct timespec b_start;
-	/** Internal; Thread A end time */
-	struct timespec a_end;
-	/** Internal; Thread B end time */
-	struct timespec b_end;
+	/**
+	 * Where to run the threads
+	 *
+	 * Defaults to TST_FZSYNC_PIN_NONE, can be overridden with
+	 * LTP_FZSYNC_PIN=none|sibling|remote.
+	 */
+	enum tst_fzsync_pin pin;
+	/**
+	 * Take the timestamps from the CPU cycle counter
+	 *
+	 * Defaults to false, can be enabled with LTP_FZSYNC_CYCLES=1. Falls
+	 * back to clock_gettime() if the counter can't be trusted.
+	 */
+	bool use_cycles;
+	/** Internal; Nanoseconds per timestamp tick */
+	float ns_per_tick;
+	/** Internal; Thread A is pinned and has to be unpinned on cleanup */
+	bool a_pinned;
 	/** Internal; Avg. difference between a_start and b_start */
 	struct tst_fzsync_stat diff_ss;
 	/** Internal; Avg. difference between a_start and a_end */
@@ -154,14 +199,34 @@ struct tst_fzsync_pair {
 	 */
 	float max_dev_ratio;
 
+	/** Internal; Delay range parts hit by the start of thread B */
+	unsigned long long window_hits;
+	/** Internal; Number of iterations with random delays */
+	int window_samples;
+	/** Internal; Number of those where the race windows overlapped */
+	int window_overlaps;
+
 	/** Internal; Atomic counter used by fzsync_pair_wait() */
-	int a_cntr;
+	int a_cntr TST_FZSYNC_ALIGNED;
 	/** Internal; Atomic counter used by fzsync_pair_wait() */
-	int b_cntr;
+	int b_cntr TST_FZSYNC_ALIGNED;
 	/** Internal; Used by tst_fzsync_pair_exit() and fzsync_pair_wait() */
-	int exit;
+	int exit TST_FZSYNC_ALIGNED;
+
+	/** Internal; Thread A start time */
+	unsigned long long a_start TST_FZSYNC_ALIGNED;
+	/** Internal; Thread A end time */
+	unsigned long long a_end;
+
+	/** Internal; Thread B start time */
+	unsigned long long b_start TST_FZSYNC_ALIGNED;
+	/** Internal; Thread B end time */
+	unsigned long long b_end;
+	/** Internal; CPU + 1 to pin thread B to or 0 */
+	int pin_b;
+
 	/** Internal; The test time remaining on tst_fzsync_pair_reset() */
-	float exec_time_start;
+	float exec_time_start TST_FZSYNC_ALIGNED;
 	/**
 	 * The maximum number of iterations to execute during the test
 	 *
@@ -183,6 +248,137 @@ struct tst_fzsync_pair {
 
 };
 
+/** Reads the CPU cycle counter */
+static inline unsigned long long tst_fzsync_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+
+	return ((unsigned long long)hi << 32) | lo;
+#elif defined(__aarch64__)
+	unsigned long long val;
+
+	__asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r" (val) :: "memory");
+
+	return val;
+#else
+	return 0;
+#endif
+}
+
+/** Wraps clock_gettime */
+static inline unsigned long long tst_fzsync_clock_ns(void)
+{
+	struct timespec t;
+
+#ifdef CLOCK_MONOTONIC_RAW
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &t);
+#endif
+
+	return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/**
+ * Get a timestamp
+ *
+ * @relates tst_fzsync_pair
+ *
+ * @return The time in ticks of pair->ns_per_tick nanoseconds
+ */
+static inline unsigned long long tst_fzsync_time(struct tst_fzsync_pair *pair)
+{
+	if (pair->use_cycles)
+		return tst_fzsync_cycles();
+
+	return tst_fzsync_clock_ns();
+}
+
+/**
+ * Check the cycle counter and measure its frequency
+ *
+ * @relates tst_fzsync_pair
+ *
+ * The counter has to run at a constant rate and be synchronised between the
+ * CPUs. On x86 we trust the TSC only if the kernel uses it as the clock
+ * source, the aarch64 virtual counter is synchronised by the architecture.
+ */
+static inline void tst_fzsync_calibrate(struct tst_fzsync_pair *pair)
+{
+	unsigned long long ns_start, ns_end, cyc_start, cyc_end;
+#if defined(__x86_64__) || defined(__i386__)
+	char clksrc[32];
+#endif
+
+	pair->ns_per_tick = 1;
+
+	if (!pair->use_cycles)
+		return;
+
+#ifndef TST_FZSYNC_HAVE_CYCLES
+	tst_res(TINFO, "No cycle counter support, using clock_gettime()");
+	pair->use_cycles = 0;
+	return;
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+	if (FILE_SCANF("/sys/devices/system/clocksource/clocksource0/current_clocksource",
+		       "%31s", clksrc) || strcmp(clksrc, "tsc")) {
+		tst_res(TINFO, "TSC is not the clock source, using clock_gettime()");
+		pair->use_cycles = 0;
+		return;
+	}
+#endif
+
+	ns_start = tst_fzsync_clock_ns();
+	cyc_start = tst_fzsync_cycles();
+
+	do {
+		ns_end = tst_fzsync_clock_ns();
+	} while (ns_end - ns_start < 10000000);
+
+	cyc_end = tst_fzsync_cycles();
+
+	if (cyc_end <= cyc_start) {
+		tst_res(TINFO, "Cycle counter is not running, using clock_gettime()");
+		pair->use_cycles = 0;
+		return;
+	}
+
+	pair->ns_per_tick = (float)(ns_end - ns_start) / (cyc_end - cyc_start);
+
+	tst_res(TINFO, "Using cycle counter for timestamps, %.3f ns per tick",
+		pair->ns_per_tick);
+}
+
+/**
+ * Apply LTP_FZSYNC_PIN and LTP_FZSYNC_CYCLES
+ *
+ * @relates tst_fzsync_pair
+ */
+static inline void tst_fzsync_pair_env(struct tst_fzsync_pair *pair)
+{
+	const char *pin = getenv("LTP_FZSYNC_PIN");
+	const char *cycles = getenv("LTP_FZSYNC_CYCLES");
+
+	if (pin) {
+		if (!strcmp(pin, "none"))
+			pair->pin = TST_FZSYNC_PIN_NONE;
+		else if (!strcmp(pin, "sibling"))
+			pair->pin = TST_FZSYNC_PIN_SIBLING;
+		else if (!strcmp(pin, "remote"))
+			pair->pin = TST_FZSYNC_PIN_REMOTE;
+		else
+			tst_brk(TBROK, "Invalid LTP_FZSYNC_PIN '%s'", pin);
+	}
+
+	if (cycles)
+		pair->use_cycles = !strcmp(cycles, "1") || !strcmp(cycles, "y");
+}
+
 #define CHK(param, low, hi, def) do {					      \
 	pair->param = (pair->param ? pair->param : def);		      \
 	if (pair->param < low)						      \
@@ -207,20 +403,49 @@ static inline void tst_fzsync_pair_init(struct tst_fzsync_pair *pair)
 	CHK(max_dev_ratio, 0, 1, 0.1);
 	CHK(exec_loops, 20, INT_MAX, 3000000);
 
+	tst_fzsync_pair_env(pair);
+	tst_fzsync_calibrate(pair);
+
 	if (tst_ncpus_available() <= 1)
 		pair->yield_in_wait = 1;
 }
 #undef CHK
 
+/**
+ * Print which part of the delay range was covered
+ *
+ * @relates tst_fzsync_pair
+ *
+ * A part is covered if thread B started the race at least once at a time
+ * relative to thread A which falls into it. The windows overlap when B
+ * starts anywhere in the range.
+ */
+static inline void tst_fzsync_pair_coverage_info(struct tst_fzsync_pair *pair)
+{
+	if (!pair->window_samples)
+		return;
+
+	tst_res(TINFO,
+		"Window coverage = %d/%d, overlaps = %d/%d (%.1f%%)",
+		__builtin_popcountll(pair->window_hits), TST_FZSYNC_COVERAGE,
+		pair->window_overlaps, pair->window_samples,
+		100.0 * pair->window_overlaps / pair->window_samples);
+}
+
 /**
  * Exit and join thread B if necessary.
  *
  * @relates tst_fzsync_pair
  *
+ * Prints the window coverage of the last run if there is one.
+ *
  * Call this from your cleanup function.
  */
 static inline void tst_fzsync_pair_cleanup(struct tst_fzsync_pair *pair)
 {
+	tst_fzsync_pair_coverage_info(pair);
+	pair->window_samples = 0;
+
 	if (pair->thread_b) {
 		/* Revoke thread B if parent hits accidental break */
 		if (!pair->exit)
@@ -228,6 +453,41 @@ static inline void tst_fzsync_pair_cleanup(struct tst_fzsync_pair *pair)
 		SAFE_PTHREAD_JOIN(pair->thread_b, NULL);
 		pair->thread_b = 0;
 	}
+
+	if (pair->a_pinned) {
+		tst_cpu_unpin();
+		pair->a_pinned = 0;
+	}
+}
+
+/**
+ * Pin thread A and ask thread B to pin itself
+ *
+ * @relates tst_fzsync_pair
+ *
+ * Thread B pins itself in tst_fzsync_run_b(), so this works also when
+ * thread B is a process or was started before tst_fzsync_pair_reset().
+ */
+static inline void tst_fzsync_pair_pin(struct tst_fzsync_pair *pair)
+{
+	int remote = pair->pin == TST_FZSYNC_PIN_REMOTE;
+	const char *name = remote ? "remote" : "sibling";
+	int cpu_a, cpu_b;
+
+	if (tst_cpu_pick_pair(remote, &cpu_a, &cpu_b)) {
+		tst_res(TINFO, "No %s CPU pair available, not pinning threads",
+			name);
+		return;
+	}
+
+	if (tst_cpu_pin(cpu_a))
+		tst_brk(TBROK | TERRNO, "Failed to pin thread A to CPU %d", cpu_a);
+
+	pair->a_pinned = 1;
+	tst_atomic_store(cpu_b + 1, &pair->pin_b);
+
+	tst_res(TINFO, "Pinned thread A to CPU %d and thread B to %s CPU %d",
+		cpu_a, name, cpu_b);
 }
 
 /**
@@ -275,9 +535,17 @@ static inline void tst_fzsync_pair_reset(struct tst_fzsync_pair *pair,
 
 	pair->exec_loop = 0;
 
+	pair->window_hits = 0;
+	pair->window_samples = 0;
+	pair->window_overlaps = 0;
+
 	pair->a_cntr = 0;
 	pair->b_cntr = 0;
 	pair->exit = 0;
+
+	if (pair->pin != TST_FZSYNC_PIN_NONE)
+		tst_fzsync_pair_pin(pair);
+
 	if (run_b)
 		SAFE_PTHREAD_CREATE(&pair->thread_b, 0, run_b, 0);
 
@@ -313,16 +581,6 @@ static inline void tst_fzsync_pair_info(struct tst_fzsync_pair *pair)
 	tst_fzsync_stat_info(pair->spins_avg, "  ", "spins");
 }
 
-/** Wraps clock_gettime */
-static inline void tst_fzsync_time(struct timespec *t)
-{
-#ifdef CLOCK_MONOTONIC_RAW
-	clock_gettime(CLOCK_MONOTONIC_RAW, t);
-#else
-	clock_gettime(CLOCK_MONOTONIC, t);
-#endif
-}
-
 /**
  * Exponential moving average
  *
@@ -361,10 +619,31 @@ static inline void tst_upd_stat(struct tst_fzsync_stat *s,
  */
 static inline void tst_upd_diff_stat(struct tst_fzsync_stat *s,
 				     float alpha,
-				     struct timespec t1,
-				     struct timespec t2)
+				     float ns_per_tick,
+				     unsigned long long t1,
+				     unsigned long long t2)
 {
-	tst_upd_stat(s, alpha, tst_timespec_diff_ns(t1, t2));
+	tst_upd_stat(s, alpha, (long long)(t1 - t2) * ns_per_tick);
+}
+
+/**
+ * Record where in the delay range thread B started the last race
+ *
+ * @relates tst_fzsync_pair
+ */
+static inline void tst_fzsync_upd_coverage(struct tst_fzsync_pair *pair)
+{
+	float range = pair->diff_sa.avg + pair->diff_sb.avg;
+	float offset = (long long)(pair->b_start - pair->a_start)
+		* pair->ns_per_tick + pair->diff_sb.avg;
+
+	pair->window_samples++;
+
+	if (range <= 0 || offset < 0 || offset >= range)
+		return;
+
+	pair->window_overlaps++;
+	pair->window_hits |= 1ULL << (int)(offset / range * TST_FZSYNC_COVERAGE);
 }
 
 /**
@@ -458,6 +737,7 @@ static inline void tst_upd_diff_stat(struct tst_fzsync_stat *s,
 static inline void tst_fzsync_pair_update(struct tst_fzsync_pair *pair)
 {
 	float alpha = pair->avg_alpha;
+	float ns_per_tick = pair->ns_per_tick;
 	float per_spin_time, time_delay;
 	float max_dev = pair->max_dev_ratio;
 	int over_max_dev;
@@ -471,13 +751,13 @@ static inline void tst_fzsync_pair_update(struct tst_fzsync_pair *pair)
 		|| pair->spins_avg.dev_ratio > max_dev;
 
 	if (pair->sampling > 0 || over_max_dev) {
-		tst_upd_diff_stat(&pair->diff_ss, alpha,
+		tst_upd_diff_stat(&pair->diff_ss, alpha, ns_per_tick,
 				  pair->a_start, pair->b_start);
-		tst_upd_diff_stat(&pair->diff_sa, alpha,
+		tst_upd_diff_stat(&pair->diff_sa, alpha, ns_per_tick,
 				  pair->a_end, pair->a_start);
-		tst_upd_diff_stat(&pair->diff_sb, alpha,
+		tst_upd_diff_stat(&pair->diff_sb, alpha, ns_per_tick,
 				  pair->b_end, pair->b_start);
-		tst_upd_diff_stat(&pair->diff_ab, alpha,
+		tst_upd_diff_stat(&pair->diff_ab, alpha, ns_per_tick,
 				  pair->a_end, pair->b_end);
 		tst_upd_stat(&pair->spins_avg, alpha, pair->spins);
 		if (pair->sampling > 0 && --pair->sampling == 0) {
@@ -485,6 +765,9 @@ static inline void tst_fzsync_pair_update(struct tst_fzsync_pair *pair)
 			tst_fzsync_pair_info(pair);
 		}
 	} else if (fabsf(pair->diff_ab.avg) >= 1) {
+		if (pair->sampling < 0)
+			tst_fzsync_upd_coverage(pair);
+
 		per_spin_time = fabsf(pair->diff_ab.avg) / MAX(pair->spins_avg.avg, 1.0f);
 		time_delay = drand48() * (pair->diff_sa.avg + pair->diff_sb.avg)
 			- pair->diff_sb.avg;
@@ -558,7 +841,6 @@ static inline void tst_fzsync_pair_wait(int *our_cntr,
 			}
 		}
 
-
 		tst_atomic_store(0, other_cntr);
 		/*
 		 * Once both counters have been set to zero the invariant
@@ -674,6 +956,15 @@ static inline int tst_fzsync_run_a(struct tst_fzsync_pair *pair)
  */
 static inline int tst_fzsync_run_b(struct tst_fzsync_pair *pair)
 {
+	int cpu = tst_atomic_load(&pair->pin_b);
+
+	if (cpu) {
+		tst_atomic_store(0, &pair->pin_b);
+		if (tst_cpu_pin(cpu - 1))
+			tst_brk(TBROK | TERRNO, "Failed to pin thread B to CPU %d",
+				cpu - 1);
+	}
+
 	tst_fzsync_wait_b(pair);
 	return !tst_atomic_load(&pair->exit);
 }
@@ -715,7 +1006,7 @@ static inline void tst_fzsync_start_race_a(struct tst_fzsync_pair *pair)
 			delay++;
 	}
 
-	tst_fzsync_time(&pair->a_start);
+	pair->a_start = tst_fzsync_time(pair);
 }
 
 /**
@@ -726,7 +1017,7 @@ static inline void tst_fzsync_start_race_a(struct tst_fzsync_pair *pair)
  */
 static inline void tst_fzsync_end_race_a(struct tst_fzsync_pair *pair)
 {
-	tst_fzsync_time(&pair->a_end);
+	pair->a_end = tst_fzsync_time(pair);
 	tst_fzsync_pair_wait(&pair->a_cntr, &pair->b_cntr,
 			     &pair->spins, &pair->exit, pair->yield_in_wait);
 }
@@ -754,7 +1045,7 @@ static inline void tst_fzsync_start_race_b(struct tst_fzsync_pair *pair)
 			delay--;
 	}
 
-	tst_fzsync_time(&pair->b_start);
+	pair->b_start = tst_fzsync_time(pair);
 }
 
 /**
@@ -765,7 +1056,7 @@ static inline void tst_fzsync_start_race_b(struct tst_fzsync_pair *pair)
  */
 static inline void tst_fzsync_end_race_b(struct tst_fzsync_pair *pair)
 {
-	tst_fzsync_time(&pair->b_end);
+	pair->b_end = tst_fzsync_time(pair);
 	tst_fzsync_pair_wait(&pair->b_cntr, &pair->a_cntr,
 			     &pair->spins, &pair->exit, pair->yield_in_wait);
 }
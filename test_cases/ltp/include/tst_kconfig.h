@@ -30,6 +30,11 @@ struct tst_kconfig_var {
  * the code looks for know locations. It can be explicitely set/overrided with
  * the KCONFIG_PATH environment variable as well.
  *
+ * The config is parsed only once into a sorted index which is then looked up
+ * for each variable. The index is also stored in the KCONFIG_CACHE_DIR
+ * directory (TMPDIR by default) and reused by subsequent tests running on the
+ * same kernel with the same config file.
+ *
  * The caller has to initialize the tst_kconfig_var structure. The id has to be
  * filled with config variable name such as 'CONFIG_FOO', the id_len should
  * hold the id string length and the choice and val has to be zeroed.
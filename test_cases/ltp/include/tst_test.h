@@ -353,6 +353,19 @@ void tst_run_tcases(int argc, char *argv[], struct tst_test *self)
  */
 void tst_reinit(void);
 
+/*
+ * Batch host support, see testcases/lib/tst_batch.c.
+ *
+ * Creates the IPC region once in the host process. Tests forked from the host
+ * and started by tst_run_tcases() reuse it instead of creating their own one.
+ */
+void tst_batch_setup_ipc(void);
+
+/*
+ * Removes the region created by tst_batch_setup_ipc().
+ */
+void tst_batch_cleanup_ipc(void);
+
 unsigned int tst_multiply_timeout(unsigned int timeout);
 
 /*
@@ -397,6 +410,11 @@ int tst_validate_children_(const char *file, const int lineno,
 
 static struct tst_test test;
 
+#ifdef TST_BATCH
+/* Test descriptor looked up by the batch host in the test shared object */
+struct tst_test *const tst_batch_test = &test;
+#endif
+
 int main(int argc, char *argv[])
 {
 	tst_run_tcases(argc, argv, &test);
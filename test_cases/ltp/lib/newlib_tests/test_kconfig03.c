@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2024
+ *
+ * Kernel config index cache test.
+ *
+ * The first child parses the config and writes the cache, the second one
+ * must get the same results from the cached index.
+ */
+
+#include <glob.h>
+#include <stdlib.h>
+#include "tst_test.h"
+#include "tst_kconfig.h"
+
+#define CONFIG_PATH "config"
+
+static void check_vars(void)
+{
+	struct tst_kconfig_var vars[] = {
+		TST_KCONFIG_INIT("CONFIG_MMU"),
+		TST_KCONFIG_INIT("CONFIG_EXT4_FS"),
+		TST_KCONFIG_INIT("CONFIG_BTRFS_FS"),
+		TST_KCONFIG_INIT("CONFIG_DEFAULT_HOSTNAME"),
+		TST_KCONFIG_INIT("CONFIG_PGTABLE_LEVELS"),
+		TST_KCONFIG_INIT("CONFIG_MISSING"),
+	};
+
+	tst_kconfig_read(vars, ARRAY_SIZE(vars));
+
+	TST_EXP_EXPR(vars[0].choice == 'y', "CONFIG_MMU=y");
+	TST_EXP_EXPR(vars[1].choice == 'm', "CONFIG_EXT4_FS=m");
+	TST_EXP_EXPR(vars[2].choice == 'n', "CONFIG_BTRFS_FS is not set");
+	TST_EXP_EXPR(vars[3].choice == 'v' &&
+		     !strcmp(vars[3].val, "\"(none)\""),
+		     "CONFIG_DEFAULT_HOSTNAME=\"(none)\"");
+	TST_EXP_EXPR(vars[4].choice == 'v' && !strcmp(vars[4].val, "5"),
+		     "CONFIG_PGTABLE_LEVELS=5 (last assignment wins)");
+	TST_EXP_EXPR(vars[5].choice == 0, "CONFIG_MISSING undefined");
+
+	free(vars[3].val);
+	free(vars[4].val);
+}
+
+static void do_test(void)
+{
+	glob_t g;
+
+	if (!SAFE_FORK()) {
+		check_vars();
+		exit(0);
+	}
+
+	tst_reap_children();
+
+	if (glob("ltp-kconfig-*.idx", 0, NULL, &g)) {
+		tst_res(TFAIL, "Cache file was not created");
+		return;
+	}
+
+	TST_EXP_EXPR(g.gl_pathc == 1, "One cache file created");
+	globfree(&g);
+
+	if (!SAFE_FORK()) {
+		check_vars();
+		exit(0);
+	}
+}
+
+static void setup(void)
+{
+	char cwd[PATH_MAX];
+
+	SAFE_FILE_PRINTF(CONFIG_PATH,
+			 "# CONFIG_BTRFS_FS is not set\n"
+			 "CONFIG_MMU=y\n"
+			 "CONFIG_EXT4_FS=m\n"
+			 "CONFIG_PGTABLE_LEVELS=4\n"
+			 "CONFIG_DEFAULT_HOSTNAME=\"(none)\"\n"
+			 "CONFIG_PGTABLE_LEVELS=5\n");
+
+	SAFE_GETCWD(cwd, sizeof(cwd));
+	SAFE_SETENV("KCONFIG_CACHE_DIR", cwd, 1);
+	SAFE_SETENV("KCONFIG_PATH", CONFIG_PATH, 1);
+}
+
+static struct tst_test test = {
+	.setup = setup,
+	.test_all = do_test,
+	.needs_tmpdir = 1,
+	.forks_child = 1,
+};
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2024
+ */
+
+/*
+ * Acquires and releases a device from a loop device pool with a single slot.
+ * A released slot has to be handed out again, a slot held by a running
+ * process must not be, and a slot left behind by a dead owner has to be
+ * reclaimed.
+ */
+
+#include <stdlib.h>
+#include "tst_test.h"
+#include "old_device.h"
+
+#define POOL_PATH "loop_pool"
+#define POOL_DEV_SIZE 16
+
+static char pool_dev[64];
+static int pool_created;
+
+static const char *acquire(char *buf)
+{
+	const char *dev = tst_acquire_device_(NULL, POOL_DEV_SIZE);
+
+	strncpy(buf, dev, 63);
+
+	return buf;
+}
+
+static void release(const char *dev)
+{
+	if (tst_release_device(dev))
+		tst_brk(TBROK, "Failed to release device '%s'", dev);
+}
+
+static void check_dev(const char *dev, int from_pool, const char *desc)
+{
+	int same = !strcmp(dev, pool_dev);
+
+	if (same == from_pool)
+		tst_res(TPASS, "%s: got '%s'", desc, dev);
+	else
+		tst_res(TFAIL, "%s: got '%s', pool device is '%s'",
+			desc, dev, pool_dev);
+}
+
+static void child(void)
+{
+	char dev[64];
+
+	check_dev(acquire(dev), 1, "Child acquired the free slot");
+
+	/* Exit without releasing the device */
+	TST_CHECKPOINT_WAKE_AND_WAIT(0);
+}
+
+static void run(void)
+{
+	char dev[64];
+
+	acquire(pool_dev);
+	release(pool_dev);
+
+	check_dev(acquire(dev), 1, "Released slot handed out again");
+	release(dev);
+
+	if (!SAFE_FORK()) {
+		child();
+		exit(0);
+	}
+
+	TST_CHECKPOINT_WAIT(0);
+	check_dev(acquire(dev), 0, "Slot held by a running owner skipped");
+	release(dev);
+
+	TST_CHECKPOINT_WAKE(0);
+	tst_reap_children();
+
+	check_dev(acquire(dev), 1, "Slot of a dead owner reclaimed");
+	release(dev);
+}
+
+static void setup(void)
+{
+	unsetenv("LTP_DEV");
+
+	if (tst_loop_pool_create(POOL_PATH, 1, POOL_DEV_SIZE))
+		tst_brk(TBROK, "Failed to create loop device pool");
+
+	pool_created = 1;
+	setenv("LTP_DEV_POOL", POOL_PATH, 1);
+}
+
+static void cleanup(void)
+{
+	if (pool_created && tst_loop_pool_destroy(POOL_PATH))
+		tst_res(TWARN, "Failed to destroy loop device pool");
+}
+
+static struct tst_test test = {
+	.setup = setup,
+	.cleanup = cleanup,
+	.test_all = run,
+	.needs_root = 1,
+	.needs_tmpdir = 1,
+	.needs_checkpoints = 1,
+	.forks_child = 1,
+};
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2024
+ */
+
+/*
+ * Many children reporting many results at once, run with LTP_RESULT_RING=1
+ * to pass the results through the result ring. The ring is small enough to
+ * fill up, the results have to be printed all and in order for each child.
+ */
+
+#include <stdlib.h>
+#include "tst_test.h"
+
+#define CHILDREN 8
+#define RESULTS 200
+
+static void child(int i)
+{
+	int j;
+
+	for (j = 0; j < RESULTS; j++)
+		tst_res(TPASS, "child %i result %i", i, j);
+
+	errno = ENOENT;
+	tst_res(TINFO | TERRNO, "child %i done", i);
+}
+
+static void run(void)
+{
+	int i;
+
+	for (i = 0; i < CHILDREN; i++) {
+		if (!SAFE_FORK()) {
+			child(i);
+			exit(0);
+		}
+	}
+
+	tst_reap_children();
+	tst_res(TPASS, "All %i children done", CHILDREN);
+}
+
+static struct tst_test test = {
+	.test_all = run,
+	.forks_child = 1,
+};
@@ -19,6 +19,8 @@
 
 #include "lapi/cpuset.h"
 
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include "test.h"
@@ -97,3 +99,137 @@ long tst_ncpus_available(void)
 	return tst_ncpus();
 #endif
 }
+
+#define CPU_TOPOLOGY "/sys/devices/system/cpu/cpu%d/topology/%s"
+
+static cpu_set_t *orig_cpus;
+static size_t orig_cpusz;
+
+/* Returns -1 if the topology is not exported, e.g. for offline CPUs */
+static int read_topology(int cpu, const char *name)
+{
+	char path[PATH_MAX];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), CPU_TOPOLOGY, cpu, name);
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	if (fscanf(f, "%d", &ret) != 1)
+		ret = -1;
+
+	fclose(f);
+
+	return ret;
+}
+
+static int cpu_score(int cpu_a, int cpu_b, int remote)
+{
+	int pkg_a = read_topology(cpu_a, "physical_package_id");
+	int pkg_b = read_topology(cpu_b, "physical_package_id");
+	int core_a = read_topology(cpu_a, "core_id");
+	int core_b = read_topology(cpu_b, "core_id");
+	int same_core = pkg_a == pkg_b && core_a == core_b;
+
+	if (!remote)
+		return core_a >= 0 && same_core ? 1 : 0;
+
+	if (pkg_a >= 0 && pkg_a != pkg_b)
+		return 2;
+
+	return same_core && core_a >= 0 ? 0 : 1;
+}
+
+int tst_cpu_pick_pair(int remote, int *cpu_a, int *cpu_b)
+{
+#ifdef CPU_COUNT_S
+	long ncpus = tst_ncpus_max();
+	int cpu, a, b = -1, score, best = 0;
+
+	if (orig_cpus)
+		CPU_FREE(orig_cpus);
+
+	orig_cpusz = CPU_ALLOC_SIZE(ncpus);
+	orig_cpus = CPU_ALLOC(ncpus);
+	if (!orig_cpus)
+		tst_brkm(TBROK | TERRNO, NULL, "CPU_ALLOC(%zu)", orig_cpusz);
+
+	if (sched_getaffinity(0, orig_cpusz, orig_cpus)) {
+		tst_resm(TWARN | TERRNO, "sched_getaffinity(0, %zu, %zx)",
+			 orig_cpusz, (size_t)orig_cpus);
+		CPU_FREE(orig_cpus);
+		orig_cpus = NULL;
+		return -1;
+	}
+
+	a = sched_getcpu();
+	if (a < 0 || !CPU_ISSET_S(a, orig_cpusz, orig_cpus)) {
+		for (a = 0; a < ncpus; a++) {
+			if (CPU_ISSET_S(a, orig_cpusz, orig_cpus))
+				break;
+		}
+	}
+
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		if (cpu == a || !CPU_ISSET_S(cpu, orig_cpusz, orig_cpus))
+			continue;
+
+		score = cpu_score(a, cpu, remote);
+		if (score > best) {
+			best = score;
+			b = cpu;
+		}
+	}
+
+	if (b < 0)
+		return -1;
+
+	*cpu_a = a;
+	*cpu_b = b;
+
+	return 0;
+#else
+	(void)remote;
+	(void)cpu_a;
+	(void)cpu_b;
+	return -1;
+#endif
+}
+
+int tst_cpu_pin(int cpu)
+{
+#ifdef CPU_COUNT_S
+	long ncpus = tst_ncpus_max();
+	size_t cpusz = CPU_ALLOC_SIZE(ncpus);
+	cpu_set_t *cpus = CPU_ALLOC(ncpus);
+	int ret;
+
+	if (!cpus)
+		tst_brkm(TBROK | TERRNO, NULL, "CPU_ALLOC(%zu)", cpusz);
+
+	CPU_ZERO_S(cpusz, cpus);
+	CPU_SET_S(cpu, cpusz, cpus);
+	ret = sched_setaffinity(0, cpusz, cpus);
+	CPU_FREE(cpus);
+
+	return ret;
+#else
+	(void)cpu;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+void tst_cpu_unpin(void)
+{
+	if (!orig_cpus)
+		return;
+
+	if (sched_setaffinity(0, orig_cpusz, orig_cpus)) {
+		tst_resm(TWARN | TERRNO, "sched_setaffinity(0, %zu, %zx)",
+			 orig_cpusz, (size_t)orig_cpus);
+	}
+}
@@ -7,6 +7,8 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <sys/mount.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <mntent.h>
 #include <errno.h>
 #include <unistd.h>
@@ -17,6 +19,7 @@
 #include <sys/sysmacros.h>
 #include <linux/btrfs.h>
 #include <linux/limits.h>
+#include "lapi/fs.h"
 #include "lapi/syscalls.h"
 #include "test.h"
 #include "safe_macros.h"
@@ -37,6 +40,39 @@ static char dev_path[PATH_MAX];
 static int device_acquired;
 static unsigned long prev_dev_sec_write;
 
+/*
+ * Pool of loop devices attached beforehand with 'tst_device pool create' and
+ * shared by all tests through a file mapped into each test process. Slots are
+ * claimed by storing an owner id with an atomic compare and exchange, slots
+ * of processes that died without releasing them are reclaimed.
+ *
+ * The owner id combines the pid with the process start time so that a slot
+ * of a dead owner is not kept locked when its pid is reused by a new process.
+ * Pids are limited to 2^22 (PID_MAX_LIMIT) and fit into the low bits.
+ */
+#define LOOP_POOL_MAGIC 0x4c54504du
+#define LOOP_POOL_MAX_SLOTS 256u
+#define LOOP_POOL_FILE_LEN 256
+#define LOOP_POOL_PID_BITS 22
+#define LOOP_POOL_PID_MASK ((1ull << LOOP_POOL_PID_BITS) - 1)
+
+struct loop_pool_slot {
+	uint64_t owner;
+	unsigned int size_mb;
+	char dev[64];
+	char file[LOOP_POOL_FILE_LEN];
+};
+
+struct loop_pool {
+	unsigned int magic;
+	unsigned int slot_cnt;
+	struct loop_pool_slot slots[];
+};
+
+static struct loop_pool *loop_pool;
+static size_t loop_pool_len;
+static struct loop_pool_slot *pool_slot;
+
 static const char * const dev_loop_variants[] = {
 	"/dev/loop%i",
 	"/dev/loop/%i",
@@ -303,6 +339,287 @@ const char *tst_acquire_loop_device(unsigned int size, const char *filename)
 	return dev_path;
 }
 
+static size_t loop_pool_size(unsigned int slot_cnt)
+{
+	return sizeof(struct loop_pool) +
+	       slot_cnt * sizeof(struct loop_pool_slot);
+}
+
+static struct loop_pool *loop_pool_map(const char *pool_path, size_t *len)
+{
+	struct loop_pool *pool;
+	struct stat st;
+	int fd;
+
+	fd = open(pool_path, O_RDWR);
+	if (fd < 0) {
+		tst_resm(TWARN | TERRNO, "open(%s) failed", pool_path);
+		return NULL;
+	}
+
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(*pool)) {
+		tst_resm(TWARN, "Invalid loop device pool '%s'", pool_path);
+		close(fd);
+		return NULL;
+	}
+
+	pool = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (pool == MAP_FAILED) {
+		tst_resm(TWARN | TERRNO, "mmap(%s) failed", pool_path);
+		return NULL;
+	}
+
+	if (pool->magic != LOOP_POOL_MAGIC ||
+	    pool->slot_cnt > LOOP_POOL_MAX_SLOTS ||
+	    loop_pool_size(pool->slot_cnt) > (size_t)st.st_size) {
+		tst_resm(TWARN, "Invalid loop device pool '%s'", pool_path);
+		munmap(pool, st.st_size);
+		return NULL;
+	}
+
+	*len = st.st_size;
+
+	return pool;
+}
+
+/*
+ * Returns the owner id of a running process, 0 if there is no such process.
+ */
+static uint64_t loop_pool_owner_id(pid_t pid)
+{
+	char path[64], buf[1024], *p;
+	unsigned long long start;
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/%i/stat", pid);
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	if (len <= 0)
+		return 0;
+
+	buf[len] = 0;
+
+	/* The comm field may contain spaces, skip past its closing ')' */
+	p = strrchr(buf, ')');
+	if (!p || sscanf(p + 2, "%*c %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s "
+			 "%*s %*s %*s %*s %*s %*s %*s %*s %llu", &start) != 1)
+		return 0;
+
+	return (uint64_t)start << LOOP_POOL_PID_BITS | pid;
+}
+
+static int loop_pool_owner_alive(uint64_t owner)
+{
+	pid_t pid = owner & LOOP_POOL_PID_MASK;
+
+	return owner && loop_pool_owner_id(pid) == owner;
+}
+
+static int loop_pool_claim(struct loop_pool_slot *slot)
+{
+	uint64_t owner = __atomic_load_n(&slot->owner, __ATOMIC_ACQUIRE);
+	uint64_t self = loop_pool_owner_id(getpid());
+
+	if (!self || loop_pool_owner_alive(owner))
+		return 0;
+
+	return __atomic_compare_exchange_n(&slot->owner, &owner, self, 0,
+					   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static const char *loop_pool_acquire(unsigned int size)
+{
+	const char *pool_path = getenv("LTP_DEV_POOL");
+	struct loop_pool_slot *slot;
+	unsigned int i;
+	int fd;
+
+	if (!pool_path)
+		return NULL;
+
+	if (!loop_pool) {
+		loop_pool = loop_pool_map(pool_path, &loop_pool_len);
+		if (!loop_pool)
+			return NULL;
+	}
+
+	for (i = 0; i < loop_pool->slot_cnt; i++) {
+		slot = &loop_pool->slots[i];
+
+		if (slot->size_mb < size || !loop_pool_claim(slot))
+			continue;
+
+		/*
+		 * A crashed test could have left the device mounted or dirty,
+		 * exclusive open of a block device fails while it's mounted.
+		 */
+		fd = open(slot->dev, O_RDONLY | O_EXCL);
+		if (fd < 0 || close(fd) || tst_clear_device(slot->dev)) {
+			tst_resm(TINFO, "Skipping busy pool device '%s'",
+				 slot->dev);
+			__atomic_store_n(&slot->owner, 0, __ATOMIC_RELEASE);
+			continue;
+		}
+
+		tst_resm(TINFO, "Using device '%s' from pool '%s'",
+			 slot->dev, pool_path);
+		pool_slot = slot;
+
+		return slot->dev;
+	}
+
+	tst_resm(TINFO, "No free device of %uMB in pool '%s'", size, pool_path);
+
+	return NULL;
+}
+
+/*
+ * Discarding the whole loop device punches a hole into the backing file which
+ * is much cheaper than detaching it and creating a new one.
+ */
+static int loop_pool_wipe(const char *dev)
+{
+	uint64_t range[2] = {0, 0};
+	int fd, ret;
+
+	fd = open(dev, O_RDWR);
+	if (fd < 0)
+		return 1;
+
+	ret = ioctl(fd, BLKGETSIZE64, &range[1]);
+	if (!ret)
+		ret = ioctl(fd, BLKDISCARD, range);
+
+	close(fd);
+
+	return ret ? 1 : 0;
+}
+
+static void loop_pool_release(void)
+{
+	if (loop_pool_wipe(pool_slot->dev))
+		tst_clear_device(pool_slot->dev);
+
+	__atomic_store_n(&pool_slot->owner, 0, __ATOMIC_RELEASE);
+	pool_slot = NULL;
+}
+
+int tst_loop_pool_create(const char *pool_path, unsigned int slot_cnt,
+			 unsigned int size)
+{
+	char dir[PATH_MAX], *sep;
+	struct loop_pool *pool;
+	struct loop_pool_slot *slot;
+	unsigned int i;
+	size_t len;
+	int fd;
+
+	if (!slot_cnt || slot_cnt > LOOP_POOL_MAX_SLOTS) {
+		tst_resm(TWARN, "Invalid number of devices %u (max %u)",
+			 slot_cnt, LOOP_POOL_MAX_SLOTS);
+		return 1;
+	}
+
+	snprintf(dir, sizeof(dir), "%s", pool_path);
+	sep = strrchr(dir, '/');
+	if (sep)
+		*sep = 0;
+	else
+		strcpy(dir, ".");
+
+	len = loop_pool_size(slot_cnt);
+	pool = calloc(1, len);
+	if (!pool) {
+		tst_resm(TWARN | TERRNO, "calloc() failed");
+		return 1;
+	}
+
+	pool->magic = LOOP_POOL_MAGIC;
+	pool->slot_cnt = slot_cnt;
+
+	for (i = 0; i < slot_cnt; i++) {
+		slot = &pool->slots[i];
+		slot->size_mb = size ? size : DEV_SIZE_MB;
+		snprintf(slot->file, sizeof(slot->file), "%s/loop_pool_%u.img",
+			 dir, i);
+
+		if (!tst_acquire_loop_device(slot->size_mb, slot->file))
+			goto err;
+
+		memcpy(slot->dev, dev_path, sizeof(slot->dev) - 1);
+	}
+
+	fd = open(pool_path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		tst_resm(TWARN | TERRNO, "open(%s) failed", pool_path);
+		goto err;
+	}
+
+	if (write(fd, pool, len) != (ssize_t)len) {
+		tst_resm(TWARN | TERRNO, "write(%s) failed", pool_path);
+		close(fd);
+		unlink(pool_path);
+		goto err;
+	}
+
+	close(fd);
+	free(pool);
+
+	return 0;
+err:
+	while (i--) {
+		tst_detach_device(pool->slots[i].dev);
+		unlink(pool->slots[i].file);
+	}
+
+	free(pool);
+
+	return 1;
+}
+
+int tst_loop_pool_destroy(const char *pool_path)
+{
+	struct loop_pool *pool;
+	struct loop_pool_slot *slot;
+	unsigned int i;
+	int ret = 0;
+	size_t len;
+
+	pool = loop_pool_map(pool_path, &len);
+	if (!pool)
+		return 1;
+
+	for (i = 0; i < pool->slot_cnt; i++) {
+		slot = &pool->slots[i];
+
+		if (loop_pool_owner_alive(slot->owner)) {
+			tst_resm(TWARN, "Device '%s' still in use by pid %i",
+				 slot->dev, (int)(slot->owner & LOOP_POOL_PID_MASK));
+			ret = 1;
+			continue;
+		}
+
+		ret |= tst_detach_device(slot->dev);
+		unlink(slot->file);
+	}
+
+	munmap(pool, len);
+
+	if (!ret)
+		unlink(pool_path);
+
+	return ret;
+}
+
 const char *tst_acquire_device__(unsigned int size)
 {
 	const char *dev;
@@ -348,6 +665,14 @@ const char *tst_acquire_device_(void (cleanup_fn)(void), unsigned int size)
 		return NULL;
 	}
 
+	if (!getenv("LTP_DEV")) {
+		device = loop_pool_acquire(size ? size : DEV_SIZE_MB);
+		if (device) {
+			device_acquired = 1;
+			return device;
+		}
+	}
+
 	device = tst_acquire_device__(size);
 
 	if (!device) {
@@ -365,6 +690,12 @@ int tst_release_device(const char *dev)
 	if (!device_acquired)
 		return 0;
 
+	if (pool_slot) {
+		loop_pool_release();
+		device_acquired = 0;
+		return 0;
+	}
+
 	/*
 	 * Loop device was created -> we need to detach it.
 	 *
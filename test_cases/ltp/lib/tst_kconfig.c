@@ -7,8 +7,19 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/utsname.h>
 
+#include "config.h"
+#ifdef HAVE_ZLIB
+# include <zlib.h>
+#endif
+
 #define TST_NO_DEFAULT_MAIN
 #include "tst_test.h"
 #include "tst_private.h"
@@ -72,49 +83,80 @@ static const char *kconfig_path(char *path_buf, size_t path_buf_len)
 	return NULL;
 }
 
-static char is_gzip;
-
-static FILE *open_kconfig(void)
-{
+/*
+ * Reading the kernel config is done through zlib when available, which also
+ * handles uncompressed files transparently, otherwise gzipped configs are
+ * piped through zcat.
+ */
+struct kconfig_file {
+#ifdef HAVE_ZLIB
+	gzFile gz;
+#else
 	FILE *fp;
-	char buf[1064];
-	char path_buf[1024];
-	const char *path = kconfig_path(path_buf, sizeof(path_buf));
+	int is_gzip;
+#endif
+};
 
-	if (!path)
-		return NULL;
+static int open_kconfig(struct kconfig_file *f, const char *path)
+{
+#ifdef HAVE_ZLIB
+	f->gz = gzopen(path, "rb");
 
-	tst_res(TINFO, "Parsing kernel config '%s'", path);
+	return f->gz ? 0 : -1;
+#else
+	char buf[1064];
 
-	is_gzip = !!strstr(path, ".gz");
+	f->is_gzip = !!strstr(path, ".gz");
 
-	if (is_gzip) {
+	if (f->is_gzip) {
 		snprintf(buf, sizeof(buf), "zcat '%s'", path);
-		fp = popen(buf, "r");
+		f->fp = popen(buf, "r");
 	} else {
-		fp = fopen(path, "r");
+		f->fp = fopen(path, "r");
 	}
 
-	if (!fp)
-		tst_brk(TBROK | TERRNO, "Failed to open '%s'", path);
+	return f->fp ? 0 : -1;
+#endif
+}
 
-	return fp;
+static char *read_kconfig_line(struct kconfig_file *f, char *buf, int len)
+{
+#ifdef HAVE_ZLIB
+	return gzgets(f->gz, buf, len);
+#else
+	return fgets(buf, len, f->fp);
+#endif
 }
 
-static void close_kconfig(FILE *fp)
+static void close_kconfig(struct kconfig_file *f)
 {
-	if (is_gzip)
-		pclose(fp);
+#ifdef HAVE_ZLIB
+	gzclose(f->gz);
+#else
+	if (f->is_gzip)
+		pclose(f->fp);
 	else
-		fclose(fp);
+		fclose(f->fp);
+#endif
 }
 
+/*
+ * A single parsed config line, id and val point into the line buffer and are
+ * not terminated.
+ */
+struct kconfig_rec {
+	const char *id;
+	const char *val;
+	unsigned int id_len;
+	unsigned int val_len;
+	char choice;
+};
+
 static inline int kconfig_parse_line(const char *line,
-                                     struct tst_kconfig_var *vars,
-                                     unsigned int vars_len)
+                                     struct kconfig_rec *rec)
 {
-	unsigned int i, var_len = 0;
-	const char *var;
+	unsigned int var_len = 0, val_len = 0;
+	const char *var, *val;
 	int is_not_set = 0;
 
 	while (isspace(*line))
@@ -146,75 +188,494 @@ static inline int kconfig_parse_line(const char *line,
 	}
 
 out:
+	rec->id = var;
+	rec->id_len = var_len;
+	rec->val = NULL;
+	rec->val_len = 0;
 
-	for (i = 0; i < vars_len; i++) {
-		const char *val;
-		unsigned int val_len = 0;
+	if (is_not_set) {
+		rec->choice = 'n';
+		return 1;
+	}
+
+	val = var + var_len;
+
+	while (isspace(*val))
+		val++;
 
-		if (vars[i].id_len != var_len)
+	if (*val != '=')
+		return 0;
+
+	val++;
+
+	while (isspace(*val))
+		val++;
+
+	while (val[val_len] && !isspace(val[val_len]))
+		val_len++;
+
+	if (val_len == 1 && (val[0] == 'y' || val[0] == 'm')) {
+		rec->choice = val[0];
+		return 1;
+	}
+
+	rec->choice = 'v';
+	rec->val = val;
+	rec->val_len = val_len;
+
+	return 1;
+}
+
+/*
+ * The parsed config is kept in a flat, position independent image so that it
+ * can be written to and mapped from a cache file shared by all test
+ * processes. The image is:
+ *
+ * struct kconfig_idx_hdr | key | struct kconfig_idx_entry[] | strings
+ *
+ * where the entries are sorted by the config variable name and the key
+ * identifies the kernel and the config file the image was created from.
+ */
+#define KCONFIG_IDX_MAGIC "LTPKCFG1"
+
+struct kconfig_idx_hdr {
+	char magic[8];
+	uint32_t size;
+	uint32_t key_len;
+	uint32_t entry_cnt;
+	uint32_t entries_off;
+};
+
+struct kconfig_idx_entry {
+	uint32_t id_off;
+	uint32_t val_off;
+	uint16_t id_len;
+	uint16_t val_len;
+	char choice;
+	char pad[3];
+};
+
+struct kconfig_idx {
+	const char *base;
+	size_t size;
+	const struct kconfig_idx_entry *entries;
+	uint32_t entry_cnt;
+};
+
+/* The index is built or mapped at most once per process. */
+static struct kconfig_idx kconfig_idx;
+
+static inline uint32_t align8(uint32_t off)
+{
+	return (off + 7) & ~7u;
+}
+
+static uint64_t fnv1a64(uint64_t hash, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+#define FNV1A64_INIT 0xcbf29ce484222325ULL
+
+/*
+ * The key identifies the running kernel by its release, version string and
+ * build id note, plus the config file the index was parsed from.
+ */
+static void kconfig_idx_key(const char *path, char *key, size_t key_len)
+{
+	uint64_t build_id = FNV1A64_INIT;
+	char notes[4096];
+	struct utsname un;
+	struct stat st;
+	ssize_t len;
+	int fd;
+
+	uname(&un);
+
+	fd = open("/sys/kernel/notes", O_RDONLY);
+	if (fd >= 0) {
+		len = read(fd, notes, sizeof(notes));
+		if (len > 0)
+			build_id = fnv1a64(build_id, notes, len);
+		close(fd);
+	}
+
+	memset(&st, 0, sizeof(st));
+
+	/* procfs timestamps are not stable, the release identifies it anyway */
+	if (strncmp(path, "/proc/", 6))
+		stat(path, &st);
+
+	snprintf(key, key_len, "%s\n%s\n%016llx\n%s\n%llu:%llu:%lld:%lld",
+		 un.release, un.version, (unsigned long long)build_id, path,
+		 (unsigned long long)st.st_dev, (unsigned long long)st.st_ino,
+		 (long long)st.st_size, (long long)st.st_mtime);
+}
+
+static int id_cmp(const char *id1, unsigned int len1,
+		   const char *id2, unsigned int len2)
+{
+	int ret = memcmp(id1, id2, MIN(len1, len2));
+
+	if (ret)
+		return ret;
+
+	return (int)len1 - (int)len2;
+}
+
+struct kconfig_idx_rec {
+	char *id;
+	char *val;
+	unsigned int id_len;
+	unsigned int val_len;
+	unsigned int seq;
+	char choice;
+};
+
+static int idx_rec_cmp(const void *a, const void *b)
+{
+	const struct kconfig_idx_rec *r1 = a, *r2 = b;
+	int ret = id_cmp(r1->id, r1->id_len, r2->id, r2->id_len);
+
+	if (ret)
+		return ret;
+
+	return r1->seq < r2->seq ? -1 : r1->seq > r2->seq;
+}
+
+/*
+ * Parses the kernel config into a newly allocated index image. Returns the
+ * image size and NULL on failure.
+ */
+static char *kconfig_idx_build(const char *path, const char *key,
+			       size_t *size)
+{
+	struct kconfig_idx_rec *recs = NULL, *rec;
+	unsigned int rec_cnt = 0, rec_max = 0, i, j;
+	uint32_t off, str_off, key_len = strlen(key);
+	struct kconfig_idx_entry *entries;
+	struct kconfig_idx_hdr *hdr;
+	struct kconfig_file f;
+	struct kconfig_rec r;
+	int partial = 0;
+	char line[4096];
+	size_t line_len;
+	char *image;
+
+	if (open_kconfig(&f, path))
+		tst_brk(TBROK | TERRNO, "Failed to open '%s'", path);
+
+	str_off = 0;
+
+	while (read_kconfig_line(&f, line, sizeof(line))) {
+		line_len = strlen(line);
+
+		/* Skip the rest of lines that do not fit into the buffer */
+		if (partial) {
+			partial = line_len && line[line_len - 1] != '\n';
+			continue;
+		}
+
+		partial = line_len && line[line_len - 1] != '\n';
+
+		if (!kconfig_parse_line(line, &r))
 			continue;
 
-		if (strncmp(vars[i].id, var, var_len))
+		if (r.id_len > UINT16_MAX || r.val_len > UINT16_MAX)
 			continue;
 
-		if (is_not_set) {
-			vars[i].choice = 'n';
-			return 1;
+		if (rec_cnt == rec_max) {
+			rec_max = rec_max ? 2 * rec_max : 1024;
+			recs = SAFE_REALLOC(recs, rec_max * sizeof(*recs));
 		}
 
-		val = var + var_len;
+		rec = &recs[rec_cnt];
+		rec->id = strndup(r.id, r.id_len);
+		rec->val = r.val ? strndup(r.val, r.val_len) : NULL;
 
-		while (isspace(*val))
-			val++;
+		if (!rec->id || (r.val && !rec->val))
+			tst_brk(TBROK | TERRNO, "strndup()");
 
-		if (*val != '=')
-			return 0;
+		rec->id_len = r.id_len;
+		rec->val_len = r.val_len;
+		rec->choice = r.choice;
+		rec->seq = rec_cnt++;
+	}
 
-		val++;
+	close_kconfig(&f);
+
+	/* The last assignment wins, same as in Kconfig */
+	qsort(recs, rec_cnt, sizeof(*recs), idx_rec_cmp);
 
-		while (isspace(*val))
-			val++;
-
-		while (!isspace(val[val_len]))
-			val_len++;
-
-		if (val_len == 1) {
-			switch (val[0]) {
-			case 'y':
-				vars[i].choice = 'y';
-				return 1;
-			case 'm':
-				vars[i].choice = 'm';
-				return 1;
-			}
+	for (i = 0, j = 0; i < rec_cnt; i++) {
+		if (i + 1 < rec_cnt &&
+		    !id_cmp(recs[i].id, recs[i].id_len,
+			     recs[i + 1].id, recs[i + 1].id_len)) {
+			free(recs[i].id);
+			free(recs[i].val);
+			continue;
 		}
 
-		vars[i].choice = 'v';
-		vars[i].val = strndup(val, val_len);
+		recs[j++] = recs[i];
+		str_off += recs[i].id_len + 1;
+
+		if (recs[i].val)
+			str_off += recs[i].val_len + 1;
+	}
+
+	rec_cnt = j;
+
+	off = align8(sizeof(*hdr) + key_len);
+	str_off += off + rec_cnt * sizeof(*entries);
+
+	image = SAFE_MALLOC(str_off);
+	memset(image, 0, off);
+
+	hdr = (struct kconfig_idx_hdr *)image;
+	memcpy(hdr->magic, KCONFIG_IDX_MAGIC, sizeof(hdr->magic));
+	hdr->size = str_off;
+	hdr->key_len = key_len;
+	hdr->entry_cnt = rec_cnt;
+	hdr->entries_off = off;
+	memcpy(image + sizeof(*hdr), key, key_len);
+
+	entries = (struct kconfig_idx_entry *)(image + off);
+	off += rec_cnt * sizeof(*entries);
+
+	for (i = 0; i < rec_cnt; i++) {
+		memset(&entries[i], 0, sizeof(entries[i]));
+		entries[i].choice = recs[i].choice;
+		entries[i].id_len = recs[i].id_len;
+		entries[i].id_off = off;
+		memcpy(image + off, recs[i].id, recs[i].id_len + 1);
+		off += recs[i].id_len + 1;
+
+		if (recs[i].val) {
+			entries[i].val_len = recs[i].val_len;
+			entries[i].val_off = off;
+			memcpy(image + off, recs[i].val, recs[i].val_len + 1);
+			off += recs[i].val_len + 1;
+		}
+
+		free(recs[i].id);
+		free(recs[i].val);
+	}
+
+	free(recs);
+	*size = str_off;
+
+	return image;
+}
+
+static int kconfig_idx_valid(const char *image, size_t size, const char *key)
+{
+	const struct kconfig_idx_hdr *hdr = (const void *)image;
+	const struct kconfig_idx_entry *e;
+	size_t key_len = strlen(key);
+	uint32_t i;
+
+	if (size < sizeof(*hdr) || memcmp(hdr->magic, KCONFIG_IDX_MAGIC, 8))
+		return 0;
+
+	if (hdr->size != size || hdr->key_len != key_len ||
+	    hdr->entries_off != align8(sizeof(*hdr) + key_len))
+		return 0;
+
+	if (memcmp(image + sizeof(*hdr), key, key_len))
+		return 0;
+
+	if (hdr->entry_cnt > (size - hdr->entries_off) / sizeof(*e))
+		return 0;
+
+	e = (const void *)(image + hdr->entries_off);
+
+	for (i = 0; i < hdr->entry_cnt; i++) {
+		if ((size_t)e[i].id_off + e[i].id_len >= size)
+			return 0;
+
+		if (e[i].val_off && (size_t)e[i].val_off + e[i].val_len >= size)
+			return 0;
+	}
+
+	return 1;
+}
+
+static const char *kconfig_cache_dir(void)
+{
+	const char *dir = getenv("KCONFIG_CACHE_DIR");
+
+	if (!dir)
+		return tst_get_tmpdir_root();
+
+	return dir[0] ? dir : NULL;
+}
+
+static void kconfig_cache_path(char *buf, size_t buf_len, const char *dir,
+			       const char *key)
+{
+	snprintf(buf, buf_len, "%s/ltp-kconfig-%016llx.idx", dir,
+		 (unsigned long long)fnv1a64(FNV1A64_INIT, key, strlen(key)));
+}
+
+static int kconfig_cache_map(const char *cache_path, const char *key)
+{
+	struct stat st;
+	void *image;
+	int fd;
+
+	fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	/* Do not trust cache files that could have been written by others */
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) ||
+	    st.st_uid != geteuid() || (st.st_mode & 022)) {
+		close(fd);
+		return -1;
+	}
+
+	image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (image == MAP_FAILED)
+		return -1;
+
+	if (!kconfig_idx_valid(image, st.st_size, key)) {
+		munmap(image, st.st_size);
+		return -1;
 	}
 
+	kconfig_idx.base = image;
+	kconfig_idx.size = st.st_size;
+
 	return 0;
 }
 
-void tst_kconfig_read(struct tst_kconfig_var vars[], size_t vars_len)
+/*
+ * The cache is written to a temporary file and renamed into place so that
+ * concurrently running tests never see a partially written index.
+ */
+static void kconfig_cache_store(const char *cache_path, const char *image,
+				size_t size)
+{
+	char tmp_path[PATH_MAX + 8];
+	ssize_t ret;
+	int fd;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", cache_path);
+
+	fd = mkstemp(tmp_path);
+	if (fd < 0) {
+		tst_res(TDEBUG | TERRNO, "Cannot create '%s'", tmp_path);
+		return;
+	}
+
+	ret = write(fd, image, size);
+	close(fd);
+
+	if (ret != (ssize_t)size || rename(tmp_path, cache_path)) {
+		tst_res(TDEBUG | TERRNO, "Cannot write '%s'", cache_path);
+		unlink(tmp_path);
+	}
+}
+
+static void kconfig_idx_load(void)
 {
-	char line[128];
-	unsigned int vars_found = 0;
+	char path_buf[1024], cache_path[PATH_MAX], key[1536];
+	const struct kconfig_idx_hdr *hdr;
+	const char *path, *cache_dir;
+	char *image;
+	size_t size;
+
+	if (kconfig_idx.base)
+		return;
 
-	FILE *fp = open_kconfig();
-	if (!fp)
+	path = kconfig_path(path_buf, sizeof(path_buf));
+	if (!path)
 		tst_brk(TBROK, "Cannot parse kernel .config");
 
-	while (fgets(line, sizeof(line), fp)) {
-		if (kconfig_parse_line(line, vars, vars_len))
-			vars_found++;
+	kconfig_idx_key(path, key, sizeof(key));
+	cache_dir = kconfig_cache_dir();
+
+	if (cache_dir) {
+		kconfig_cache_path(cache_path, sizeof(cache_path), cache_dir,
+				   key);
 
-		if (vars_found == vars_len)
-			goto exit;
+		if (!kconfig_cache_map(cache_path, key)) {
+			tst_res(TINFO, "Parsing kernel config '%s' (cached in '%s')",
+				path, cache_path);
+			goto out;
+		}
 	}
 
-exit:
-	close_kconfig(fp);
+	tst_res(TINFO, "Parsing kernel config '%s'", path);
+
+	image = kconfig_idx_build(path, key, &size);
+
+	if (cache_dir)
+		kconfig_cache_store(cache_path, image, size);
+
+	kconfig_idx.base = image;
+	kconfig_idx.size = size;
+out:
+	hdr = (const void *)kconfig_idx.base;
+	kconfig_idx.entries = (const void *)(kconfig_idx.base + hdr->entries_off);
+	kconfig_idx.entry_cnt = hdr->entry_cnt;
+}
+
+static const struct kconfig_idx_entry *kconfig_idx_find(const char *id,
+							unsigned int id_len)
+{
+	uint32_t lo = 0, hi = kconfig_idx.entry_cnt, mid;
+	const struct kconfig_idx_entry *e;
+	int ret;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		e = &kconfig_idx.entries[mid];
+		ret = id_cmp(id, id_len, kconfig_idx.base + e->id_off,
+			      e->id_len);
+
+		if (!ret)
+			return e;
+
+		if (ret < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+void tst_kconfig_read(struct tst_kconfig_var vars[], size_t vars_len)
+{
+	const struct kconfig_idx_entry *e;
+	size_t i;
+
+	kconfig_idx_load();
+
+	for (i = 0; i < vars_len; i++) {
+		e = kconfig_idx_find(vars[i].id, vars[i].id_len);
+
+		if (!e)
+			continue;
+
+		vars[i].choice = e->choice;
+
+		if (e->choice == 'v') {
+			vars[i].val = strndup(kconfig_idx.base + e->val_off,
+					      e->val_len);
+		}
+	}
 }
 
 static size_t array_len(const char *const kconfigs[])
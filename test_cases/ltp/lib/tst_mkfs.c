@@ -15,13 +15,270 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 #include "test.h"
 #include "ltp_priv.h"
 #include "tst_mkfs.h"
 #include "tst_device.h"
+#include "lapi/fs.h"
+#include "lapi/seek.h"
+#include "lapi/syscalls.h"
 
 #define OPTS_MAX 32
 
+/*
+ * Optional cache of pristine filesystem images, see LTP_MKFS_CACHE_DIR in
+ * doc/User-Guidelines.asciidoc.
+ *
+ * The cache is used only for loop devices, the image is cloned into the
+ * backing file which is much cheaper than running mkfs when the underlying
+ * filesystem supports reflinks and not much slower otherwise since only the
+ * allocated parts of the image are copied.
+ */
+static const char *mkfs_cache_dir(const char *fs_type)
+{
+	const char *dir = getenv("LTP_MKFS_CACHE_DIR");
+
+	if (!dir || !dir[0])
+		return NULL;
+
+	/* Btrfs tracks devices by fsid, clones would share it */
+	if (!strcmp(fs_type, "btrfs"))
+		return NULL;
+
+	return dir;
+}
+
+static int loop_backing_file(const char *dev, char *path, size_t path_len)
+{
+	const char *name = strrchr(dev, '/');
+	char sys_path[PATH_MAX];
+	ssize_t len;
+	int fd;
+
+	name = name ? name + 1 : dev;
+
+	if (strncmp(name, "loop", 4))
+		return -1;
+
+	snprintf(sys_path, sizeof(sys_path), "/sys/block/%s/loop/backing_file",
+		 name);
+
+	fd = open(sys_path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	len = read(fd, path, path_len - 1);
+	close(fd);
+
+	if (len <= 0)
+		return -1;
+
+	if (path[len - 1] == '\n')
+		len--;
+
+	path[len] = 0;
+
+	return 0;
+}
+
+static uint64_t fnv1a64(uint64_t hash, const char *str)
+{
+	for (; *str; str++) {
+		hash ^= (unsigned char)*str;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+/*
+ * The image depends on the mkfs binary as well, identify it by its size and
+ * timestamp so that images are recreated after mkfs is upgraded.
+ */
+static uint64_t hash_mkfs_tool(uint64_t hash, const char *mkfs)
+{
+	char *paths, *dir, *save = NULL, path[PATH_MAX], buf[128];
+	const char *env_path = getenv("PATH");
+	struct stat st;
+
+	hash = fnv1a64(hash, mkfs);
+
+	if (!env_path)
+		return hash;
+
+	paths = strdup(env_path);
+	if (!paths)
+		return hash;
+
+	for (dir = strtok_r(paths, ":", &save); dir;
+	     dir = strtok_r(NULL, ":", &save)) {
+		snprintf(path, sizeof(path), "%s/%s", dir, mkfs);
+
+		if (stat(path, &st))
+			continue;
+
+		snprintf(buf, sizeof(buf), "%lld:%lld", (long long)st.st_size,
+			 (long long)st.st_mtime);
+		hash = fnv1a64(hash, path);
+		hash = fnv1a64(hash, buf);
+		break;
+	}
+
+	free(paths);
+
+	return hash;
+}
+
+static int copy_range(int src_fd, int dst_fd, off_t off, off_t len)
+{
+	loff_t src_off = off, dst_off = off;
+	char buf[65536];
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = syscall(__NR_copy_file_range, src_fd, &src_off, dst_fd,
+			      &dst_off, len, 0);
+		if (ret <= 0)
+			break;
+
+		len -= ret;
+	}
+
+	/* Not supported between these files, copy it by hand */
+	while (len > 0) {
+		ret = pread(src_fd, buf, MIN((off_t)sizeof(buf), len), src_off);
+		if (ret <= 0)
+			return -1;
+
+		if (pwrite(dst_fd, buf, ret, dst_off) != ret)
+			return -1;
+
+		src_off += ret;
+		dst_off += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Makes dst a copy of src, which is a reflink if possible and a sparse copy
+ * of the allocated data otherwise.
+ */
+static int clone_file(int src_fd, int dst_fd, off_t size)
+{
+	off_t data, hole = 0;
+
+	if (!ioctl(dst_fd, FICLONE, src_fd))
+		return 0;
+
+	if (ftruncate(dst_fd, 0) || ftruncate(dst_fd, size))
+		return -1;
+
+	while (hole < size) {
+		data = lseek(src_fd, hole, SEEK_DATA);
+		if (data < 0)
+			return errno == ENXIO ? 0 : -1;
+
+		hole = lseek(src_fd, data, SEEK_HOLE);
+		if (hole < 0)
+			return -1;
+
+		if (copy_range(src_fd, dst_fd, data, hole - data))
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Writes dirty device buffers back to the backing file and drops the clean
+ * ones, so that the device sees changes done to the backing file directly.
+ */
+static int flush_device(const char *dev)
+{
+	int fd, ret;
+
+	fd = open(dev, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	ret = ioctl(fd, BLKFLSBUF, 0);
+	close(fd);
+
+	return ret;
+}
+
+static int mkfs_cache_restore(const char *image, const char *backing_file,
+			      const char *dev)
+{
+	int src_fd, dst_fd, ret = -1;
+	struct stat st;
+
+	src_fd = open(image, O_RDONLY);
+	if (src_fd < 0)
+		return -1;
+
+	dst_fd = open(backing_file, O_WRONLY);
+	if (dst_fd < 0)
+		goto out_close_src;
+
+	if (fstat(src_fd, &st) || flush_device(dev))
+		goto out;
+
+	if (clone_file(src_fd, dst_fd, st.st_size))
+		goto out;
+
+	ret = flush_device(dev);
+out:
+	close(dst_fd);
+out_close_src:
+	close(src_fd);
+	return ret;
+}
+
+/*
+ * The image is created under a temporary name and renamed into place, so
+ * that tests running in parallel never pick up a partially written one.
+ */
+static void mkfs_cache_store(const char *image, const char *backing_file,
+			     const char *dev)
+{
+	char tmp_image[PATH_MAX + 8];
+	int src_fd, dst_fd;
+	struct stat st;
+
+	if (flush_device(dev))
+		return;
+
+	src_fd = open(backing_file, O_RDONLY);
+	if (src_fd < 0)
+		return;
+
+	snprintf(tmp_image, sizeof(tmp_image), "%s.XXXXXX", image);
+
+	dst_fd = mkstemp(tmp_image);
+	if (dst_fd < 0) {
+		tst_resm(TINFO | TERRNO, "Cannot create '%s'", tmp_image);
+		close(src_fd);
+		return;
+	}
+
+	if (fstat(src_fd, &st) || clone_file(src_fd, dst_fd, st.st_size) ||
+	    fsync(dst_fd) || rename(tmp_image, image)) {
+		tst_resm(TINFO | TERRNO, "Cannot store '%s'", image);
+		unlink(tmp_image);
+	}
+
+	close(dst_fd);
+	close(src_fd);
+}
+
 void tst_mkfs_(const char *file, const int lineno, void (cleanup_fn)(void),
 	       const char *dev, const char *fs_type,
 	       const char *const fs_opts[], const char *const extra_opts[])
@@ -31,6 +288,10 @@ void tst_mkfs_(const char *file, const int lineno, void (cleanup_fn)(void),
 	const char *argv[OPTS_MAX] = {mkfs};
 	char fs_opts_str[1024] = "";
 	char extra_opts_str[1024] = "";
+	char backing_file[PATH_MAX], image[PATH_MAX];
+	const char *cache_dir;
+	struct stat st;
+	uint64_t hash;
 
 	if (!dev) {
 		tst_brkm_(file, lineno, TBROK, cleanup_fn,
@@ -88,6 +349,30 @@ void tst_mkfs_(const char *file, const int lineno, void (cleanup_fn)(void),
 
 	argv[pos] = NULL;
 
+	cache_dir = mkfs_cache_dir(fs_type);
+
+	if (cache_dir && !loop_backing_file(dev, backing_file,
+					    sizeof(backing_file)) &&
+	    !stat(backing_file, &st)) {
+		hash = fnv1a64(0xcbf29ce484222325ULL, fs_opts_str);
+		hash = fnv1a64(hash, "\n");
+		hash = fnv1a64(hash, extra_opts_str);
+		hash = hash_mkfs_tool(hash, mkfs);
+		snprintf(image, sizeof(image), "%s/%s-%lldk-%016llx.img",
+			 cache_dir, fs_type, (long long)st.st_size / 1024,
+			 (unsigned long long)hash);
+
+		if (!mkfs_cache_restore(image, backing_file, dev)) {
+			tst_resm_(file, lineno, TINFO,
+				"Formatting %s with %s opts='%s' extra opts='%s' from '%s'",
+				dev, fs_type, fs_opts_str, extra_opts_str,
+				image);
+			return;
+		}
+	} else {
+		cache_dir = NULL;
+	}
+
 	if (tst_clear_device(dev)) {
 		tst_brkm_(file, lineno, TBROK, cleanup_fn,
 			"tst_clear_device() failed");
@@ -109,7 +394,11 @@ void tst_mkfs_(const char *file, const int lineno, void (cleanup_fn)(void),
 	default:
 		tst_brkm_(file, lineno, TBROK, cleanup_fn,
 			"%s failed with exit code %i", mkfs, ret);
+		return;
 	}
+
+	if (cache_dir)
+		mkfs_cache_store(image, backing_file, dev);
 }
 
 const char *tst_dev_fs_type(void)
@@ -74,7 +74,54 @@ struct results {
 
 static struct results *results;
 
+/*
+ * Result ring, enabled with LTP_RESULT_RING=1, placed in the IPC region after
+ * the results page.
+ *
+ * The test processes only format the message into a fixed size record and
+ * append it to the ring without taking any lock. The library process prints
+ * the records in the order in which they were reserved, batching the lines
+ * into few writes. Messages which don't fit into a record, processes started
+ * by exec() and the library process itself still print directly.
+ *
+ * The result counters are still updated by the reporting process, the test
+ * process compares them right after each test function returns.
+ *
+ * Once a producer had to give up waiting for the library process, all
+ * results are printed directly for the rest of the run, so that a stalled
+ * library process doesn't slow down every single result.
+ */
+#define RING_RECORDS 512
+#define RING_FULL_WAIT_NS 10000000
+#define RING_FULL_WAITS 100
+
+struct result_record {
+	uint32_t seq;
+	int ttype;
+	int lineno;
+	int err;
+	char file[48];
+	char msg[448];
+};
+
+struct result_ring {
+	/* next record to be reserved by a test process */
+	uint32_t head __attribute__((aligned(64)));
+	/* next record to be printed, producers wait on it when the ring is full */
+	uint32_t tail __attribute__((aligned(64)));
+	uint32_t producers_waiting;
+	/* set when a producer timed out waiting for the tail */
+	uint32_t stalled;
+	/* bumped to wake up the library process */
+	uint32_t wake __attribute__((aligned(64)));
+	uint32_t waiting;
+	struct result_record recs[RING_RECORDS] __attribute__((aligned(64)));
+};
+
+static struct result_ring *res_ring;
+
 static int ipc_fd;
+static int batch_ipc;
 
 extern void *tst_futexes;
 extern unsigned int tst_max_futexes;
@@ -91,13 +138,48 @@ long TST_RET;
 static void do_cleanup(void);
 static void do_exit(int ret) __attribute__ ((noreturn));
 
+static int result_ring_enabled(void)
+{
+	const char *env = getenv("LTP_RESULT_RING");
+
+	return env && (!strcmp(env, "1") || !strcmp(env, "y"));
+}
+
+static size_t ipc_size(void)
+{
+	size_t page = getpagesize();
+
+	if (!result_ring_enabled())
+		return page;
+
+	return page + (sizeof(struct result_ring) + page - 1) / page * page;
+}
+
+static void create_ipc(const char *dir, size_t size)
+{
+	snprintf(shm_path, sizeof(shm_path), "%s/ltp_%s_%d", dir, tid, getpid());
+
+	ipc_fd = open(shm_path, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (ipc_fd < 0)
+		tst_brk(TBROK | TERRNO, "open(%s)", shm_path);
+	SAFE_CHMOD(shm_path, 0666);
+
+	SAFE_FTRUNCATE(ipc_fd, size);
+
+	results = SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ipc_fd, 0);
+
+	SAFE_CLOSE(ipc_fd);
+}
+
 static void setup_ipc(void)
 {
 	size_t size = getpagesize();
 
-	if (access("/dev/shm", F_OK) == 0) {
-		snprintf(shm_path, sizeof(shm_path), "/dev/shm/ltp_%s_%d",
-			 tid, getpid());
+	if (batch_ipc) {
+		/* Region inherited from the batch host, start from scratch */
+		memset(results, 0, size);
+	} else if (access("/dev/shm", F_OK) == 0) {
+		create_ipc("/dev/shm", ipc_size());
 	} else {
 		char *tmpdir;
 
@@ -105,30 +187,23 @@ static void setup_ipc(void)
 			tst_tmpdir();
 
 		tmpdir = tst_get_tmpdir();
-		snprintf(shm_path, sizeof(shm_path), "%s/ltp_%s_%d",
-			 tmpdir, tid, getpid());
+		create_ipc(tmpdir, ipc_size());
 		free(tmpdir);
 	}
 
-	ipc_fd = open(shm_path, O_CREAT | O_EXCL | O_RDWR, 0600);
-	if (ipc_fd < 0)
-		tst_brk(TBROK | TERRNO, "open(%s)", shm_path);
-	SAFE_CHMOD(shm_path, 0666);
-
-	SAFE_FTRUNCATE(ipc_fd, size);
-
-	results = SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ipc_fd, 0);
+	if (ipc_size() > size) {
+		res_ring = (void *)((char *)results + size);
+		memset(res_ring, 0, sizeof(*res_ring));
+	}
 
 	/* Checkpoints needs to be accessible from processes started by exec() */
 	if (tst_test->needs_checkpoints || tst_test->child_needs_reinit) {
 		sprintf(ipc_path, IPC_ENV_VAR "=%s", shm_path);
 		putenv(ipc_path);
-	} else {
+	} else if (!batch_ipc) {
 		SAFE_UNLINK(shm_path);
 	}
 
-	SAFE_CLOSE(ipc_fd);
-
 	if (tst_test->needs_checkpoints) {
 		tst_futexes = (char *)results + sizeof(struct results);
 		tst_max_futexes = (size - sizeof(struct results))/sizeof(futex_t);
@@ -137,21 +212,42 @@ static void setup_ipc(void)
 
 static void cleanup_ipc(void)
 {
-	size_t size = getpagesize();
+	size_t size = ipc_size();
 
 	if (ipc_fd > 0 && close(ipc_fd))
 		tst_res(TWARN | TERRNO, "close(ipc_fd) failed");
 
-	if (shm_path[0] && !access(shm_path, F_OK) && unlink(shm_path))
+	/* The batch host removes the region once all tests are done */
+	if (!batch_ipc && shm_path[0] && !access(shm_path, F_OK) &&
+	    unlink(shm_path))
 		tst_res(TWARN | TERRNO, "unlink(%s) failed", shm_path);
 
 	if (results) {
 		msync((void *)results, size, MS_SYNC);
 		munmap((void *)results, size);
 		results = NULL;
+		res_ring = NULL;
 	}
 }
 
+void tst_batch_setup_ipc(void)
+{
+	tid = "batch";
+
+	if (access("/dev/shm", F_OK) == 0)
+		create_ipc("/dev/shm", ipc_size());
+	else
+		create_ipc(tst_get_tmpdir_root(), ipc_size());
+
+	batch_ipc = 1;
+}
+
+void tst_batch_cleanup_ipc(void)
+{
+	batch_ipc = 0;
+	cleanup_ipc();
+}
+
 void tst_reinit(void)
 {
 	const char *path = getenv(IPC_ENV_VAR);
@@ -197,13 +293,36 @@ static void update_results(int ttype)
 	}
 }
 
-static void print_result(const char *file, const int lineno, int ttype,
+static const char *result_errno(int ttype, int *int_errno)
+{
+	if (ttype & TRERRNO) {
+		*int_errno = TST_RET < 0 ? -(int)TST_RET : (int)TST_RET;
+		return tst_strerrno(*int_errno);
+	}
+
+	if (ttype & TTERRNO) {
+		*int_errno = TST_ERR;
+		return tst_strerrno(TST_ERR);
+	}
+
+	if (ttype & TERRNO) {
+		*int_errno = errno;
+		return tst_strerrno(errno);
+	}
+
+	return NULL;
+}
+
+/*
+ * Formats the result line into buf, which has to be at least 1024 bytes
+ * long, and returns the length of the line.
+ */
+static int format_result(char *buf, const char *file, const int lineno,
+			 int ttype, const char *str_errno, int int_errno,
 			 const char *fmt, va_list va)
 {
-	char buf[1024];
 	char *str = buf;
-	int ret, size = sizeof(buf), ssize, int_errno, buflen;
-	const char *str_errno = NULL;
+	int ret, size = 1024, ssize;
 	const char *res;
 
 	switch (TTYPE_RESULT(ttype)) {
@@ -233,21 +352,6 @@ static void print_result(const char *file, const int lineno, int ttype,
 		abort();
 	}
 
-	if (ttype & TERRNO) {
-		str_errno = tst_strerrno(errno);
-		int_errno = errno;
-	}
-
-	if (ttype & TTERRNO) {
-		str_errno = tst_strerrno(TST_ERR);
-		int_errno = TST_ERR;
-	}
-
-	if (ttype & TRERRNO) {
-		int_errno = TST_RET < 0 ? -(int)TST_RET : (int)TST_RET;
-		str_errno = tst_strerrno(int_errno);
-	}
-
 	ret = snprintf(str, size, "%s:%i: ", file, lineno);
 	str += ret;
 	size -= ret;
@@ -279,9 +383,14 @@ static void print_result(const char *file, const int lineno, int ttype,
 
 	snprintf(str, size, "\n");
 
+	return str - buf + 1;
+}
+
+static void write_stderr(const char *str, int buflen)
+{
+	int ret;
+
 	/* we might be called from signal handler, so use write() */
-	buflen = str - buf + 1;
-	str = buf;
 	while (buflen) {
 		ret = write(STDERR_FILENO, str, buflen);
 		if (ret <= 0)
@@ -292,10 +401,255 @@ static void print_result(const char *file, const int lineno, int ttype,
 	}
 }
 
+static void futex_wake(uint32_t *addr, int nr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, nr, NULL);
+}
+
+static void futex_wait(uint32_t *addr, uint32_t val, long nsec)
+{
+	struct timespec ts = {
+		.tv_sec = nsec / 1000000000,
+		.tv_nsec = nsec % 1000000000,
+	};
+	int err = errno;
+
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts);
+
+	/* the message may still use %m */
+	errno = err;
+}
+
+/*
+ * Waits for the library process to print the results appended to the ring
+ * so far, so that results printed directly by a test process are not
+ * reordered with the ones it appended before.
+ */
+static void ring_wait_drained(void)
+{
+	uint32_t head, tail;
+	int waits = 0;
+
+	if (!res_ring || getpid() == lib_pid)
+		return;
+
+	head = __atomic_load_n(&res_ring->head, __ATOMIC_ACQUIRE);
+
+	for (;;) {
+		if (__atomic_load_n(&res_ring->stalled, __ATOMIC_RELAXED))
+			return;
+
+		tail = __atomic_load_n(&res_ring->tail, __ATOMIC_ACQUIRE);
+
+		if ((int32_t)(head - tail) <= 0)
+			return;
+
+		if (waits++ >= RING_FULL_WAITS) {
+			__atomic_store_n(&res_ring->stalled, 1, __ATOMIC_RELAXED);
+			return;
+		}
+
+		__atomic_add_fetch(&res_ring->producers_waiting, 1, __ATOMIC_SEQ_CST);
+		futex_wait(&res_ring->tail, tail, RING_FULL_WAIT_NS);
+		__atomic_sub_fetch(&res_ring->producers_waiting, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+static void print_result(const char *file, const int lineno, int ttype,
+			 int err, const char *fmt, va_list va)
+{
+	char buf[1024];
+	int len;
+
+	len = format_result(buf, file, lineno, ttype,
+			    err < 0 ? NULL : tst_strerrno(err), err, fmt, va);
+
+	ring_wait_drained();
+	write_stderr(buf, len);
+}
+
+static int ring_reserve(uint32_t *pos)
+{
+	uint32_t head = __atomic_load_n(&res_ring->head, __ATOMIC_RELAXED);
+	uint32_t tail;
+	int waits = 0;
+
+	for (;;) {
+		if (__atomic_load_n(&res_ring->stalled, __ATOMIC_RELAXED))
+			return 0;
+
+		tail = __atomic_load_n(&res_ring->tail, __ATOMIC_ACQUIRE);
+
+		if (head - tail < RING_RECORDS) {
+			if (__atomic_compare_exchange_n(&res_ring->head, &head,
+							head + 1, 1,
+							__ATOMIC_ACQ_REL,
+							__ATOMIC_RELAXED)) {
+				*pos = head;
+				return 1;
+			}
+			continue;
+		}
+
+		/* Give up and print directly if the ring isn't drained */
+		if (waits++ >= RING_FULL_WAITS) {
+			__atomic_store_n(&res_ring->stalled, 1, __ATOMIC_RELAXED);
+			return 0;
+		}
+
+		__atomic_add_fetch(&res_ring->producers_waiting, 1, __ATOMIC_SEQ_CST);
+		futex_wait(&res_ring->tail, tail, RING_FULL_WAIT_NS);
+		__atomic_sub_fetch(&res_ring->producers_waiting, 1, __ATOMIC_SEQ_CST);
+
+		head = __atomic_load_n(&res_ring->head, __ATOMIC_RELAXED);
+	}
+}
+
+static void ring_publish(struct result_record *rec, uint32_t pos)
+{
+	__atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&res_ring->waiting, __ATOMIC_RELAXED)) {
+		__atomic_add_fetch(&res_ring->wake, 1, __ATOMIC_RELEASE);
+		futex_wake(&res_ring->wake, 1);
+	}
+}
+
+/*
+ * Appends the result to the ring, returns 0 if the result has to be printed
+ * directly instead.
+ */
+static int ring_push(const char *file, const int lineno, int ttype, int err,
+		     const char *fmt, va_list va)
+{
+	struct result_record *rec;
+	uint32_t pos;
+	va_list vac;
+	int ret;
+
+	if (!res_ring || getpid() == lib_pid)
+		return 0;
+
+	if (strlen(file) >= sizeof(rec->file))
+		return 0;
+
+	switch (TTYPE_RESULT(ttype)) {
+	case TPASS:
+	case TFAIL:
+	case TBROK:
+	case TCONF:
+	case TWARN:
+	case TINFO:
+	case TDEBUG:
+	break;
+	default:
+		return 0;
+	}
+
+	if (!ring_reserve(&pos))
+		return 0;
+
+	rec = &res_ring->recs[pos % RING_RECORDS];
+	rec->ttype = ttype;
+	rec->lineno = lineno;
+	rec->err = err;
+	strcpy(rec->file, file);
+
+	va_copy(vac, va);
+	ret = vsnprintf(rec->msg, sizeof(rec->msg), fmt, vac);
+	va_end(vac);
+
+	/* The slot has been reserved already, publish it as an empty one */
+	if (ret < 0 || ret >= (int)sizeof(rec->msg))
+		rec->ttype = -1;
+
+	ring_publish(rec, pos);
+
+	return rec->ttype != -1;
+}
+
+static int format_record(char *buf, struct result_record *rec, ...)
+{
+	va_list va;
+	int ret;
+
+	va_start(va, rec);
+	ret = format_result(buf, rec->file, rec->lineno, rec->ttype,
+			    rec->err < 0 ? NULL : tst_strerrno(rec->err),
+			    rec->err, "%s", va);
+	va_end(va);
+
+	return ret;
+}
+
+/*
+ * Prints the published records. The final drain, once the test process has
+ * exited, skips records reserved by processes which were killed before
+ * publishing them.
+ */
+static void ring_drain(int final)
+{
+	char out[8192];
+	char line[1024];
+	struct result_record *rec;
+	uint32_t tail = res_ring->tail;
+	int len = 0, ret;
+
+	for (;;) {
+		rec = &res_ring->recs[tail % RING_RECORDS];
+
+		if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != tail + 1) {
+			if (!final ||
+			    tail == __atomic_load_n(&res_ring->head, __ATOMIC_ACQUIRE))
+				break;
+		} else if (rec->ttype >= 0) {
+			ret = format_record(line, rec, rec->msg);
+
+			if (len + ret > (int)sizeof(out)) {
+				write_stderr(out, len);
+				len = 0;
+			}
+
+			memcpy(out + len, line, ret);
+			len += ret;
+		}
+
+		__atomic_store_n(&res_ring->tail, ++tail, __ATOMIC_RELEASE);
+
+		if (__atomic_load_n(&res_ring->producers_waiting, __ATOMIC_SEQ_CST))
+			futex_wake(&res_ring->tail, INT_MAX);
+	}
+
+	write_stderr(out, len);
+}
+
+static int ring_pending(void)
+{
+	struct result_record *rec = &res_ring->recs[res_ring->tail % RING_RECORDS];
+
+	return __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) == res_ring->tail + 1;
+}
+
+static void emit_result(const char *file, const int lineno, int ttype,
+			const char *fmt, va_list va)
+{
+	int int_errno = 0, err;
+
+	/*
+	 * Waiting for the ring to drain overwrites errno, save it (and
+	 * TST_ERR/TST_RET) before anything else.
+	 */
+	err = result_errno(ttype, &int_errno) ? int_errno : -1;
+
+	if (!ring_push(file, lineno, ttype, err, fmt, va))
+		print_result(file, lineno, ttype, err, fmt, va);
+}
+
 void tst_vres_(const char *file, const int lineno, int ttype, const char *fmt,
 	       va_list va)
 {
-	print_result(file, lineno, ttype, fmt, va);
+	emit_result(file, lineno, ttype, fmt, va);
 
 	update_results(TTYPE_RESULT(ttype));
 }
@@ -314,7 +668,7 @@ static void tst_cvres(const char *file, const int lineno, int ttype,
 		ttype |= TWARN;
 	}
 
-	print_result(file, lineno, ttype, fmt, va);
+	emit_result(file, lineno, ttype, fmt, va);
 	update_results(TTYPE_RESULT(ttype));
 }
 
@@ -333,7 +687,7 @@ static void do_test_cleanup(void)
 void tst_vbrk_(const char *file, const int lineno, int ttype, const char *fmt,
 	       va_list va)
 {
-	print_result(file, lineno, ttype, fmt, va);
+	emit_result(file, lineno, ttype, fmt, va);
 	update_results(TTYPE_RESULT(ttype));
 
 	/*
@@ -533,10 +887,16 @@ static void print_help(void)
 	fprintf(stderr, "---------------------\n");
 	fprintf(stderr, "KCONFIG_PATH         Specify kernel config file\n");
 	fprintf(stderr, "KCONFIG_SKIP_CHECK   Skip kernel config check if variable set (not set by default)\n");
+	fprintf(stderr, "KCONFIG_CACHE_DIR    Directory for parsed kernel config cache (default: TMPDIR, empty disables)\n");
 	fprintf(stderr, "LTPROOT              Prefix for installed LTP (default: /opt/ltp)\n");
 	fprintf(stderr, "LTP_COLORIZE_OUTPUT  Force colorized output behaviour (y/1 always, n/0: never)\n");
 	fprintf(stderr, "LTP_DEV              Path to the block device to be used (for .needs_device)\n");
 	fprintf(stderr, "LTP_DEV_FS_TYPE      Filesystem used for testing (default: %s)\n", DEFAULT_FS_TYPE);
+	fprintf(stderr, "LTP_DEV_POOL         Loop device pool created by 'tst_device pool create' (not set by default)\n");
+	fprintf(stderr, "LTP_FZSYNC_CYCLES    Fuzzy sync timestamps from the CPU cycle counter (y/1, not set by default)\n");
+	fprintf(stderr, "LTP_FZSYNC_PIN       Pin fuzzy sync threads (none, sibling or remote CPUs, not set by default)\n");
+	fprintf(stderr, "LTP_MKFS_CACHE_DIR   Directory for caching formatted filesystem images (not set by default)\n");
+	fprintf(stderr, "LTP_RESULT_RING      Pass test results to the library process via shared memory ring (y/1, not set by default)\n");
 	fprintf(stderr, "LTP_SINGLE_FS_TYPE   Testing only - specifies filesystem instead all supported (for .all_filesystems)\n");
 	fprintf(stderr, "LTP_TIMEOUT_MUL      Timeout multiplier (must be a number >=1)\n");
 	fprintf(stderr, "LTP_RUNTIME_MUL      Runtime multiplier (must be a number >=1)\n");
@@ -1604,6 +1964,45 @@ void tst_set_max_runtime(int max_runtime)
 	heartbeat();
 }
 
+static void sigchld_handler(int sig LTP_ATTRIBUTE_UNUSED)
+{
+	__atomic_add_fetch(&res_ring->wake, 1, __ATOMIC_RELEASE);
+	futex_wake(&res_ring->wake, 1);
+}
+
+/*
+ * Prints the results from the ring until the test process exits. The test
+ * processes wake us up only when we announced that we are going to sleep,
+ * SIGCHLD wakes us up when the test process exits.
+ */
+static void ring_wait_test(int *status)
+{
+	uint32_t wake;
+	pid_t pid;
+
+	for (;;) {
+		ring_drain(0);
+
+		__atomic_store_n(&res_ring->waiting, 1, __ATOMIC_SEQ_CST);
+		wake = __atomic_load_n(&res_ring->wake, __ATOMIC_ACQUIRE);
+
+		pid = waitpid(test_pid, status, WNOHANG);
+		if (pid < 0 && errno != EINTR)
+			tst_brk(TBROK | TERRNO, "waitpid(%i)", test_pid);
+
+		if (pid == test_pid)
+			break;
+
+		if (!ring_pending())
+			futex_wait(&res_ring->wake, wake, 1000000000);
+
+		__atomic_store_n(&res_ring->waiting, 0, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&res_ring->waiting, 0, __ATOMIC_RELAXED);
+	ring_drain(1);
+}
+
 static int fork_testrun(void)
 {
 	int status;
@@ -1613,6 +2012,9 @@ static int fork_testrun(void)
 
 	alarm(results->timeout);
 
+	if (res_ring)
+		SAFE_SIGNAL(SIGCHLD, sigchld_handler);
+
 	test_pid = fork();
 	if (test_pid < 0)
 		tst_brk(TBROK | TERRNO, "fork()");
@@ -1623,11 +2025,19 @@ static int fork_testrun(void)
 		SAFE_SIGNAL(SIGUSR1, SIG_DFL);
 		SAFE_SIGNAL(SIGTERM, SIG_DFL);
 		SAFE_SIGNAL(SIGINT, SIG_DFL);
+		if (res_ring)
+			SAFE_SIGNAL(SIGCHLD, SIG_DFL);
 		SAFE_SETPGID(0, 0);
 		testrun();
 	}
 
-	SAFE_WAITPID(test_pid, &status, 0);
+	if (res_ring) {
+		ring_wait_test(&status);
+		SAFE_SIGNAL(SIGCHLD, SIG_DFL);
+	} else {
+		SAFE_WAITPID(test_pid, &status, 0);
+	}
+
 	alarm(0);
 	SAFE_SIGNAL(SIGTERM, SIG_DFL);
 	SAFE_SIGNAL(SIGINT, SIG_DFL);
@@ -14,7 +14,16 @@
 #include "tst_clocks.h"
 #include "tst_timer_test.h"
 
-#define MAX_SAMPLES 500
+/*
+ * The samples are recorded into a log-linear histogram. Values smaller than
+ * 2^HIST_SUB_BITS us are recorded exactly, larger values fall into one of
+ * HIST_SUB_CNT buckets per power of two, i.e. with a relative error smaller
+ * than 0.1%. Values above ~2^40 us end up in the last bucket.
+ */
+#define HIST_SUB_BITS 11
+#define HIST_SUB_CNT (1u << (HIST_SUB_BITS - 1))
+#define HIST_MAX_SHIFT 30
+#define HIST_BUCKETS ((HIST_MAX_SHIFT + 2) * HIST_SUB_CNT)
 
 static const char *scall;
 static void (*setup)(void);
@@ -22,8 +31,18 @@ static void (*cleanup)(void);
 static int (*sample)(int clk_id, long long usec);
 static struct tst_test *test;
 
-static long long *samples;
-static unsigned int cur_sample;
+static unsigned long long *hist;
+static unsigned long long hist_cnt;
+static long long hist_min, hist_max, hist_sum;
+
+/*
+ * Samples that have woken up early and outliers are counted exactly as they
+ * are recorded.
+ */
+static long long early_limit, outlier_limit;
+static unsigned int early_cnt, outlier_cnt;
+static long long early_max, outlier_min;
+
 static unsigned int monotonic_resolution;
 static unsigned int timerslack;
 static int virt_env;
@@ -75,13 +94,110 @@ static unsigned int header_len(long long max_sample)
 	return MAX(strlen(table_heading) + 2, l + 3);
 }
 
+static unsigned int hist_idx(long long val)
+{
+	unsigned int shift;
+
+	if (val < 0)
+		val = 0;
+
+	if (val < (1LL << HIST_SUB_BITS))
+		return val;
+
+	shift = 63 - __builtin_clzll(val) - (HIST_SUB_BITS - 1);
+	if (shift > HIST_MAX_SHIFT)
+		return HIST_BUCKETS - 1;
+
+	return shift * HIST_SUB_CNT + (val >> shift);
+}
+
+static unsigned int hist_shift(unsigned int idx)
+{
+	if (idx < 2 * HIST_SUB_CNT)
+		return 0;
+
+	return idx / HIST_SUB_CNT - 1;
+}
+
+static long long hist_low(unsigned int idx)
+{
+	unsigned int shift = hist_shift(idx);
+
+	return (long long)(idx - shift * HIST_SUB_CNT) << shift;
+}
+
+/*
+ * Highest value that falls into the bucket clamped to the recorded range.
+ */
+static long long hist_high(unsigned int idx)
+{
+	long long high = hist_low(idx) + (1LL << hist_shift(idx)) - 1;
+
+	return MIN(MAX(high, hist_min), hist_max);
+}
+
+static long long hist_mid(unsigned int idx)
+{
+	long long mid = hist_low(idx) + (1LL << hist_shift(idx)) / 2;
+
+	return MIN(MAX(mid, hist_min), hist_max);
+}
+
+static void hist_reset(void)
+{
+	memset(hist, 0, sizeof(*hist) * HIST_BUCKETS);
+	hist_cnt = hist_sum = hist_max = 0;
+	hist_min = LLONG_MAX;
+	early_cnt = outlier_cnt = 0;
+	early_max = 0;
+	outlier_min = LLONG_MAX;
+}
+
+/*
+ * Returns the value of the sample at the given percentile.
+ */
+static long long hist_percentile(double percentile)
+{
+	unsigned long long rank, sum = 0;
+	unsigned int i;
+
+	rank = MAX(1ULL, (unsigned long long)(percentile / 100 * hist_cnt + 0.5));
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		sum += hist[i];
+
+		if (sum >= rank)
+			return hist_mid(i);
+	}
+
+	return hist_max;
+}
+
+/*
+ * Returns the sum of the lowest cnt samples.
+ */
+static long long hist_low_sum(unsigned long long cnt)
+{
+	unsigned long long n;
+	long long sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < HIST_BUCKETS && cnt; i++) {
+		n = MIN(hist[i], cnt);
+		sum += n * hist_mid(i);
+		cnt -= n;
+	}
+
+	return sum;
+}
+
 static void frequency_plot(void)
 {
 	unsigned int cols = 80;
 	unsigned int rows = 20;
 	unsigned int i, buckets[rows];
-	long long max_sample = samples[0];
-	long long min_sample = samples[cur_sample-1];
+	long long max_sample = hist_max;
+	long long min_sample = hist_min;
 	unsigned int line_header_len = header_len(max_sample);
 	unsigned int plot_line_len = cols - line_header_len;
 	unsigned int bucket_size;
@@ -95,10 +211,14 @@ static void frequency_plot(void)
 	 */
 	bucket_size = MAX(1u, ceilu(1.00 * (max_sample - min_sample)/(rows-1)));
 
-	for (i = 0; i < cur_sample; i++) {
+	for (i = 0; i < HIST_BUCKETS; i++) {
 		unsigned int bucket;
-		bucket = flooru(1.00 * (samples[i] - min_sample)/bucket_size);
-		buckets[bucket]++;
+
+		if (!hist[i])
+			continue;
+
+		bucket = flooru(1.00 * (hist_mid(i) - min_sample)/bucket_size);
+		buckets[MIN(bucket, rows - 1)] += hist[i];
 	}
 
 	unsigned int max_bucket = buckets[0];
@@ -153,14 +273,23 @@ static void frequency_plot(void)
 
 void tst_timer_sample(void)
 {
-	samples[cur_sample++] = tst_timer_elapsed_us();
-}
+	long long val = tst_timer_elapsed_us();
 
-static int cmp(const void *a, const void *b)
-{
-	const long long *aa = a, *bb = b;
+	hist[hist_idx(val)]++;
+	hist_cnt++;
+	hist_sum += val;
+	hist_min = MIN(hist_min, val);
+	hist_max = MAX(hist_max, val);
+
+	if (val < early_limit) {
+		early_cnt++;
+		early_max = MAX(early_max, val);
+	}
 
-	return (*bb - *aa);
+	if (val > outlier_limit) {
+		outlier_cnt++;
+		outlier_min = MIN(outlier_min, val);
+	}
 }
 
 /*
@@ -205,7 +334,11 @@ static unsigned int compute_discard(unsigned int nsamples)
 	return MAX(1u, nsamples / 20);
 }
 
-static void write_to_file(void)
+/*
+ * Writes the histogram as lines of 'low_us high_us count' for each non-empty
+ * bucket.
+ */
+static void write_to_file(long long usec)
 {
 	unsigned int i;
 	FILE *f;
@@ -221,8 +354,15 @@ static void write_to_file(void)
 		return;
 	}
 
-	for (i = 0; i < cur_sample; i++)
-		fprintf(f, "%lli\n", samples[i]);
+	fprintf(f, "# %s %llius %llu samples\n", scall, usec, hist_cnt);
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+
+		fprintf(f, "%lli %lli %llu\n",
+			MAX(hist_low(i), hist_min), hist_high(i), hist[i]);
+	}
 
 	if (fclose(f)) {
 		tst_res(TWARN | TERRNO,
@@ -239,74 +379,65 @@ static void write_to_file(void)
  * * Take nsamples measurements of the timer function, the function
  *   to be sampled is defined in the actual test.
  *
- * * We sort the array of samples, then:
+ * * Each sample is recorded into a histogram, at the same time we count:
  *
- *   - look for outliners which are samples where the sleep time has exceeded
- *     requested sleep time by an order of magnitude and, at the same time, are
- *     greater than clock resolution multiplied by three.
+ *   - outliners which are samples where the sleep time has exceeded requested
+ *     sleep time by an order of magnitude and, at the same time, are greater
+ *     than clock resolution multiplied by three.
  *
- *   - check for samples where the call has woken up too early which is a plain
- *     old bug
+ *   - samples where the call has woken up too early which is a plain old bug
  *
- *   - then we compute truncated mean and compare that with the requested sleep
- *     time increased by a threshold
+ * * Then we compute truncated mean from the histogram and compare that with
+ *   the requested sleep time increased by a threshold
  */
 void do_timer_test(long long usec, unsigned int nsamples)
 {
-	long long trunc_mean, median;
+	long long trunc_mean;
 	unsigned int discard = compute_discard(nsamples);
 	unsigned int keep_samples = nsamples - discard;
 	long long threshold = compute_threshold(usec, keep_samples);
-	int i;
+	unsigned int i;
 	int failed = 0;
 
 	tst_res(TINFO,
 		"%s sleeping for %llius %u iterations, threshold %.2fus",
 		scall, usec, nsamples, 1.00 * threshold / (keep_samples));
 
-	cur_sample = 0;
-	for (i = 0; i < (int)nsamples; i++) {
+	hist_reset();
+	early_limit = usec;
+	outlier_limit = MAX(10 * usec, 3LL * monotonic_resolution);
+
+	for (i = 0; i < nsamples; i++) {
 		if (sample(CLOCK_MONOTONIC, usec)) {
 			tst_res(TINFO, "sampling function failed, exiting");
 			return;
 		}
 	}
 
-	qsort(samples, nsamples, sizeof(samples[0]), cmp);
-
-	write_to_file();
-
-	for (i = 0; samples[i] > 10 * usec && i < (int)nsamples; i++) {
-		if (samples[i] <= 3 * monotonic_resolution)
-			break;
-	}
+	write_to_file(usec);
 
-	if (i > 0) {
-		tst_res(TINFO, "Found %i outliners in [%lli,%lli] range",
-			i, samples[0], samples[i-1]);
+	if (outlier_cnt) {
+		tst_res(TINFO, "Found %u outliners in [%lli,%lli] range",
+			outlier_cnt, hist_max, outlier_min);
 	}
 
-	for (i = nsamples - 1; samples[i] < usec && i > -1; i--);
-
-	if (i < (int)nsamples - 1) {
+	if (early_cnt) {
 		tst_res(TFAIL, "%s woken up early %u times range: [%lli,%lli]",
-			scall, nsamples - 1 - i,
-			samples[i+1], samples[nsamples-1]);
+			scall, early_cnt, early_max, hist_min);
 		failed = 1;
 	}
 
-	median = samples[nsamples/2];
-
-	trunc_mean = 0;
-
-	for (i = discard; i < (int)nsamples; i++)
-		trunc_mean += samples[i];
+	trunc_mean = hist_low_sum(keep_samples);
 
 	tst_res(TINFO,
 		"min %llius, max %llius, median %llius, trunc mean %.2fus (discarded %u)",
-		samples[nsamples-1], samples[0], median,
+		hist_min, hist_max, hist_percentile(50),
 		1.00 * trunc_mean / keep_samples, discard);
 
+	tst_res(TINFO, "p90 %llius, p99 %llius, p99.9 %llius, mean %.2fus",
+		hist_percentile(90), hist_percentile(99),
+		hist_percentile(99.9), 1.00 * hist_sum / hist_cnt);
+
 	if (virt_env) {
 		tst_res(TINFO,
 			"Virtualisation detected, skipping oversleep checks");
@@ -374,14 +505,14 @@ static void timer_setup(void)
 #endif /* PR_GET_TIMERSLACK */
 	parse_timer_opts();
 
-	samples = SAFE_MALLOC(sizeof(long long) * MAX(MAX_SAMPLES, sample_cnt));
+	hist = SAFE_MALLOC(sizeof(*hist) * HIST_BUCKETS);
 	if (set_latency() < 0)
 		tst_res(TINFO, "Failed to set zero latency constraint: %m");
 }
 
 static void timer_cleanup(void)
 {
-	free(samples);
+	free(hist);
 
 	if (cleanup)
 		cleanup();
@@ -414,7 +545,7 @@ static struct tst_option options[] = {
 	{"p",  &print_frequency_plot, "-p       Print frequency plot"},
 	{"s:", &str_sleep_time, "-s us    Sleep time"},
 	{"n:", &str_sample_cnt, "-n uint  Number of samples to take"},
-	{"f:", &file_name, "-f fname Write measured samples into a file"},
+	{"f:", &file_name, "-f fname Write histogram of measured samples into a file"},
 	{NULL, NULL, NULL}
 };
 
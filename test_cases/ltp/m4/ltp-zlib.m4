@@ -0,0 +1,11 @@
+dnl SPDX-License-Identifier: GPL-2.0-or-later
+dnl Copyright (c) Linux Test Project, 2024
+
+AC_DEFUN([LTP_CHECK_ZLIB], [
+	AC_CHECK_LIB([z], [gzopen], [have_libz=yes])
+	AC_CHECK_HEADERS([zlib.h], [have_zlib_h=yes])
+	if test "x$have_libz" = "xyes" -a "x$have_zlib_h" = "xyes"; then
+		AC_DEFINE(HAVE_ZLIB, 1, [Define to 1 if you have zlib library and headers])
+		AC_SUBST(ZLIB_LIBS, "-lz")
+	fi
+])
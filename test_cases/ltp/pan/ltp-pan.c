@@ -69,6 +69,7 @@
 
 #include "splitstr.h"
 #include "zoolib.h"
+#include "pan_sched.h"
 #include "tst_res_flags.h"
 
 /* One entry in the command line collection.  */
@@ -87,6 +88,7 @@ struct collection {
 struct tag_pgrp {
 	int pgrp;
 	int stopping;
+	int sched_idx;
 	time_t mystime;
 	struct coll_entry *cmd;
 	char output[PATH_MAX];
@@ -130,6 +132,7 @@ static char *panname = NULL;
 static char *test_out_dir = NULL;	/* dir to buffer output to */
 zoo_t zoofile;
 static char *reporttype = NULL;
+static struct pan_sched *sched;	/* resource aware scheduler, -M */
 
 /* Common format string for ltp-pan results */
 #define ResultFmt	"%-50s %-10.10s"
@@ -159,6 +162,7 @@ int main(int argc, char **argv)
 	char *failcmdfilename = NULL;
 	char *tconfcmdfilename = NULL;
 	char *outputfilename = NULL;
+	char *metafilename = NULL;
 	struct collection *coll = NULL;
 	struct tag_pgrp *running;
 	struct orphan_pgrp *orphans, *orph;
@@ -191,13 +195,17 @@ int main(int argc, char **argv)
 	struct sigaction sa;
 
 	while ((c =
-		getopt(argc, argv, "AO:Sa:C:QT:d:ef:hl:n:o:pqr:s:t:x:y"))
+		getopt(argc, argv, "AM:O:Sa:C:QT:d:ef:hl:n:o:pqr:s:t:x:y"))
 		       != -1) {
 		switch (c) {
 		case 'A':	/* all-stop flag */
 			has_brakes = 1;
 			track_exit_stats = 1;
 			break;
+		case 'M':	/* metadata file for the scheduler */
+			metafilename = strdup(optarg);
+			sequential = 1;
+			break;
 		case 'O':	/* output buffering directory */
 			test_out_dir = strdup(optarg);
 			break;
@@ -233,6 +241,7 @@ int main(int argc, char **argv)
 			fprintf(stdout,
 				"Usage: pan -n name [ -SyAehpqQ ] [ -s starts ]"
 				" [-t time[s|m|h|d] [ -x nactive ] [ -l logfile ]\n\t"
+				"[ -M metadata-file ] "
 				"[ -a active-file ] [ -f command-file ] "
 				"[ -C fail-command-file ] "
 				"[ -d debug-level ]\n\t[-o output-file] "
@@ -372,6 +381,28 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (metafilename) {
+		char **cmdlines = malloc(coll->cnt * sizeof(char *));
+
+		if (!cmdlines) {
+			fprintf(stderr, "pan(%s): Failed to allocate memory: %s\n",
+				panname, strerror(errno));
+			exit(2);
+		}
+
+		for (i = 0; i < coll->cnt; i++)
+			cmdlines[i] = coll->ary[i]->cmdline;
+
+		sched = pan_sched_new(metafilename, cmdlines, coll->cnt);
+		if (!sched)
+			exit(1);
+
+		if (Debug & Dsetup)
+			pan_sched_dump(sched, cmdlines);
+
+		free(cmdlines);
+	}
+
 	if (Debug & Dsetup)
 		dump_coll(coll);
 
@@ -527,8 +558,13 @@ int main(int argc, char **argv)
 			if (stop || rec_signal || go_idle)
 				break;
 
-			if (!sequential)
+			if (sched) {
+				c = pan_sched_pick(sched);
+				if (c < 0)
+					break;
+			} else if (!sequential) {
 				c = lrand48() % coll->cnt;
+			}
 
 			/* find a slot for the child */
 			for (i = 0; i < keep_active; ++i) {
@@ -544,15 +580,18 @@ int main(int argc, char **argv)
 				break;
 			}
 
+			running[i].sched_idx = c;
 			cpid =
 			    run_child(coll->ary[c], running + i, quiet_mode,
 				      &failcnt, fmt_print, logfile, no_kmsg);
 			if (cpid != -1)
 				++num_active;
+			else if (sched)
+				pan_sched_done(sched, c);
 			if ((cpid != -1 || sequential) && starts > 0)
 				--starts;
 
-			if (sequential)
+			if (sequential && !sched)
 				if (++c >= coll->cnt)
 					c = 0;
 
@@ -873,6 +912,8 @@ check_pids(struct tag_pgrp *running, int *num_active, int keep_active,
 					ret++;
 
 				running[i].pgrp = 0;
+				if (sched)
+					pan_sched_done(sched, running[i].sched_idx);
 				if (zoo_clear(zoofile, cpid)) {
 					fprintf(stderr, "pan(%s): %s\n",
 						panname, zoo_error);
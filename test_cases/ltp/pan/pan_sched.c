@@ -0,0 +1,780 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2024
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/stat.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pan_sched.h"
+
+/*
+ * Estimated runtime in seconds of a test that does not set .max_runtime and
+ * the multiplier for tests that run for each supported filesystem.
+ */
+#define EST_DEFAULT	1
+#define EST_ALL_FS	6
+
+enum json_type {
+	JSON_NULL,
+	JSON_NUM,
+	JSON_STR,
+	JSON_ARR,
+	JSON_OBJ,
+};
+
+struct json_node {
+	enum json_type type;
+	char *key;
+	char *str;
+	long num;
+	struct json_node *child;
+	struct json_node *next;
+};
+
+struct json_parser {
+	const char *path;
+	const char *buf;
+	size_t off;
+};
+
+struct sched_test {
+	unsigned int est;
+	unsigned int cpus;
+	int exclusive;
+	int device;
+	int *locks;
+	unsigned int lock_cnt;
+	int state;
+};
+
+enum {
+	TEST_PENDING,
+	TEST_RUNNING,
+	TEST_DONE,
+};
+
+struct pan_sched {
+	struct sched_test *tests;
+	int *order;
+	int cnt;
+	int pending;
+	int running;
+	int exclusive_running;
+	unsigned int cpus_total;
+	unsigned int cpus_free;
+	int devs_free;
+	char **lock_names;
+	char *locks_held;
+	unsigned int lock_cnt;
+};
+
+static struct json_node *json_parse_value(struct json_parser *p);
+
+static void json_err(struct json_parser *p, const char *msg)
+{
+	fprintf(stderr, "pan: %s:%zu: %s\n", p->path, p->off, msg);
+}
+
+static void json_skip_ws(struct json_parser *p)
+{
+	while (isspace((unsigned char)p->buf[p->off]))
+		p->off++;
+}
+
+static struct json_node *json_node_new(enum json_type type)
+{
+	struct json_node *node = calloc(1, sizeof(*node));
+
+	if (node)
+		node->type = type;
+
+	return node;
+}
+
+static void json_free(struct json_node *node)
+{
+	struct json_node *next;
+
+	while (node) {
+		next = node->next;
+		json_free(node->child);
+		free(node->key);
+		free(node->str);
+		free(node);
+		node = next;
+	}
+}
+
+static char *json_parse_str(struct json_parser *p)
+{
+	size_t start, len = 0;
+	char *str, c;
+
+	/* skip the opening quote */
+	start = ++p->off;
+
+	for (;;) {
+		c = p->buf[p->off];
+
+		if (!c) {
+			json_err(p, "unterminated string");
+			return NULL;
+		}
+
+		if (c == '"')
+			break;
+
+		if (c == '\\' && p->buf[p->off + 1])
+			p->off++;
+
+		p->off++;
+	}
+
+	str = malloc(p->off - start + 1);
+	if (!str)
+		return NULL;
+
+	for (; start < p->off; start++) {
+		c = p->buf[start];
+
+		if (c == '\\') {
+			c = p->buf[++start];
+
+			switch (c) {
+			case 'n':
+				c = '\n';
+				break;
+			case 't':
+				c = '\t';
+				break;
+			case 'u':
+				/* only ASCII is interesting here */
+				start += 4;
+				c = '?';
+				break;
+			}
+		}
+
+		str[len++] = c;
+	}
+
+	str[len] = 0;
+	p->off++;
+
+	return str;
+}
+
+static struct json_node *json_parse_list(struct json_parser *p, int is_obj)
+{
+	struct json_node *node, *last = NULL, *child;
+	char close = is_obj ? '}' : ']';
+	char *key = NULL;
+
+	node = json_node_new(is_obj ? JSON_OBJ : JSON_ARR);
+	if (!node)
+		return NULL;
+
+	p->off++;
+	json_skip_ws(p);
+
+	if (p->buf[p->off] == close) {
+		p->off++;
+		return node;
+	}
+
+	for (;;) {
+		json_skip_ws(p);
+
+		if (is_obj) {
+			if (p->buf[p->off] != '"') {
+				json_err(p, "expected object key");
+				goto err;
+			}
+
+			key = json_parse_str(p);
+			if (!key)
+				goto err;
+
+			json_skip_ws(p);
+
+			if (p->buf[p->off++] != ':') {
+				json_err(p, "expected ':'");
+				goto err;
+			}
+		}
+
+		child = json_parse_value(p);
+		if (!child)
+			goto err;
+
+		child->key = key;
+		key = NULL;
+
+		if (last)
+			last->next = child;
+		else
+			node->child = child;
+
+		last = child;
+
+		json_skip_ws(p);
+
+		if (p->buf[p->off] == ',') {
+			p->off++;
+			continue;
+		}
+
+		if (p->buf[p->off] == close) {
+			p->off++;
+			return node;
+		}
+
+		json_err(p, is_obj ? "expected ',' or '}'" : "expected ',' or ']'");
+		goto err;
+	}
+
+err:
+	free(key);
+	json_free(node);
+	return NULL;
+}
+
+static struct json_node *json_parse_value(struct json_parser *p)
+{
+	struct json_node *node;
+	char *end;
+	const char *c;
+
+	json_skip_ws(p);
+	c = p->buf + p->off;
+
+	switch (*c) {
+	case '{':
+		return json_parse_list(p, 1);
+	case '[':
+		return json_parse_list(p, 0);
+	case '"':
+		node = json_node_new(JSON_STR);
+		if (!node)
+			return NULL;
+
+		node->str = json_parse_str(p);
+		if (!node->str) {
+			free(node);
+			return NULL;
+		}
+
+		return node;
+	}
+
+	if (!strncmp(c, "null", 4) || !strncmp(c, "true", 4) ||
+	    !strncmp(c, "false", 5)) {
+		node = json_node_new(*c == 't' ? JSON_NUM : JSON_NULL);
+		if (node)
+			node->num = *c == 't';
+		p->off += *c == 'f' ? 5 : 4;
+		return node;
+	}
+
+	node = json_node_new(JSON_NUM);
+	if (!node)
+		return NULL;
+
+	node->num = strtol(c, &end, 10);
+	if (end == c) {
+		json_err(p, "unexpected character");
+		free(node);
+		return NULL;
+	}
+
+	/* fractions are not used in the metadata, skip them */
+	while (*end && strchr("0123456789.eE+-", *end))
+		end++;
+
+	p->off += end - c;
+
+	return node;
+}
+
+static struct json_node *json_get(struct json_node *obj, const char *key)
+{
+	struct json_node *node;
+
+	if (!obj || obj->type != JSON_OBJ)
+		return NULL;
+
+	for (node = obj->child; node; node = node->next) {
+		if (!strcmp(node->key, key))
+			return node;
+	}
+
+	return NULL;
+}
+
+/*
+ * Metaparse stores the initializers as they are written in the source, so
+ * the value may be a number, or a product such as "5 * 60". Anything else
+ * evaluates to 0.
+ */
+static long json_get_num(struct json_node *obj, const char *key)
+{
+	struct json_node *node = json_get(obj, key);
+	const char *c;
+	char *end;
+	long val, ret = 1;
+
+	if (!node)
+		return 0;
+
+	if (node->type == JSON_NUM)
+		return node->num;
+
+	if (node->type != JSON_STR)
+		return 0;
+
+	c = node->str;
+
+	for (;;) {
+		val = strtol(c, &end, 0);
+		if (end == c)
+			return 0;
+
+		ret *= val;
+
+		while (isspace((unsigned char)*end))
+			end++;
+
+		if (!*end)
+			return ret;
+
+		if (*end != '*')
+			return 0;
+
+		c = end + 1;
+	}
+}
+
+static char *slurp_file(const char *path)
+{
+	struct stat st;
+	char *buf;
+	ssize_t ret;
+	size_t off = 0;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		fprintf(stderr, "pan: open(%s) failed. errno:%d %s\n",
+			path, errno, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+
+	buf = malloc(st.st_size + 1);
+	if (!buf) {
+		close(fd);
+		return NULL;
+	}
+
+	while (off < (size_t)st.st_size) {
+		ret = read(fd, buf + off, st.st_size - off);
+		if (ret <= 0) {
+			fprintf(stderr, "pan: read(%s) failed. errno:%d %s\n",
+				path, errno, strerror(errno));
+			free(buf);
+			close(fd);
+			return NULL;
+		}
+
+		off += ret;
+	}
+
+	buf[off] = 0;
+	close(fd);
+
+	return buf;
+}
+
+static int sched_lock_id(struct pan_sched *sched, const char *prefix,
+			 const char *name)
+{
+	char **names;
+	char *lock;
+	unsigned int i;
+
+	if (asprintf(&lock, "%s:%s", prefix, name) < 0)
+		return -1;
+
+	for (i = 0; i < sched->lock_cnt; i++) {
+		if (!strcmp(sched->lock_names[i], lock)) {
+			free(lock);
+			return i;
+		}
+	}
+
+	names = realloc(sched->lock_names, (i + 1) * sizeof(*names));
+	if (!names) {
+		free(lock);
+		return -1;
+	}
+
+	sched->lock_names = names;
+	sched->lock_names[sched->lock_cnt++] = lock;
+
+	return i;
+}
+
+static int sched_add_lock(struct pan_sched *sched, struct sched_test *test,
+			  const char *prefix, const char *name)
+{
+	int id = sched_lock_id(sched, prefix, name);
+	int *locks;
+
+	if (id < 0)
+		return 1;
+
+	locks = realloc(test->locks, (test->lock_cnt + 1) * sizeof(*locks));
+	if (!locks)
+		return 1;
+
+	test->locks = locks;
+	test->locks[test->lock_cnt++] = id;
+
+	return 0;
+}
+
+static int sched_add_locks(struct pan_sched *sched, struct sched_test *test,
+			   struct json_node *meta)
+{
+	struct json_node *node;
+
+	node = json_get(meta, "needs_cgroup_ctrls");
+	if (node) {
+		for (node = node->child; node; node = node->next) {
+			if (node->type == JSON_STR &&
+			    sched_add_lock(sched, test, "cgroup", node->str))
+				return 1;
+		}
+	}
+
+	/* the first member of each struct tst_path_val is the path */
+	node = json_get(meta, "save_restore");
+	if (node) {
+		for (node = node->child; node; node = node->next) {
+			if (node->child && node->child->type == JSON_STR &&
+			    sched_add_lock(sched, test, "sysctl",
+					   node->child->str))
+				return 1;
+		}
+	}
+
+	if (json_get(meta, "hugepages") &&
+	    sched_add_lock(sched, test, "mem", "hugepages"))
+		return 1;
+
+	return 0;
+}
+
+static struct json_node *find_test(struct json_node *tests, const char *cmdline)
+{
+	const char *start, *end;
+	struct json_node *node;
+	size_t len;
+
+	while (isspace((unsigned char)*cmdline))
+		cmdline++;
+
+	end = cmdline + strcspn(cmdline, " \t");
+
+	for (start = end; start > cmdline && start[-1] != '/'; start--)
+		;
+
+	len = end - start;
+
+	for (node = tests->child; node; node = node->next) {
+		if (!strncmp(node->key, start, len) && !node->key[len])
+			return node;
+	}
+
+	return NULL;
+}
+
+static void sched_order(struct pan_sched *sched)
+{
+	struct sched_test *a, *b;
+	int i, j, tmp;
+
+	for (i = 0; i < sched->cnt; i++)
+		sched->order[i] = i;
+
+	/*
+	 * Stable insertion sort, longest first, tests that have to run alone
+	 * at the end in the runtest file order.
+	 */
+	for (i = 1; i < sched->cnt; i++) {
+		for (j = i; j > 0; j--) {
+			a = &sched->tests[sched->order[j - 1]];
+			b = &sched->tests[sched->order[j]];
+
+			if (a->exclusive > b->exclusive)
+				goto swap;
+
+			if (a->exclusive || b->exclusive || a->est >= b->est)
+				break;
+swap:
+			tmp = sched->order[j];
+			sched->order[j] = sched->order[j - 1];
+			sched->order[j - 1] = tmp;
+		}
+	}
+}
+
+struct pan_sched *pan_sched_new(const char *metafile, char **cmdlines, int cnt)
+{
+	struct json_parser parser = {.path = metafile};
+	struct json_node *root, *tests, *meta;
+	struct sched_test *test;
+	struct pan_sched *sched;
+	char *buf;
+	long val;
+	int i;
+
+	buf = slurp_file(metafile);
+	if (!buf)
+		return NULL;
+
+	parser.buf = buf;
+	root = json_parse_value(&parser);
+	free(buf);
+
+	if (!root)
+		return NULL;
+
+	tests = json_get(root, "tests");
+	if (!tests || tests->type != JSON_OBJ) {
+		fprintf(stderr, "pan: %s: missing \"tests\" object\n",
+			metafile);
+		goto err_json;
+	}
+
+	sched = calloc(1, sizeof(*sched));
+	if (!sched)
+		goto err_json;
+
+	sched->cnt = sched->pending = cnt;
+	sched->tests = calloc(cnt, sizeof(*sched->tests));
+	sched->order = calloc(cnt, sizeof(*sched->order));
+	if (!sched->tests || !sched->order)
+		goto err_sched;
+
+	val = sysconf(_SC_NPROCESSORS_ONLN);
+	sched->cpus_total = sched->cpus_free = val > 0 ? val : 1;
+	/*
+	 * Tests attaching loop devices in parallel race for the same free
+	 * device, only devices from the pool can be shared safely.
+	 */
+	sched->devs_free = getenv("LTP_DEV_POOL") && !getenv("LTP_DEV") ? -1 : 1;
+
+	for (i = 0; i < cnt; i++) {
+		test = &sched->tests[i];
+		meta = find_test(tests, cmdlines[i]);
+
+		if (!meta) {
+			test->exclusive = 1;
+			test->cpus = sched->cpus_total;
+			continue;
+		}
+
+		val = json_get_num(meta, "max_runtime");
+		test->est = val > 0 ? val : EST_DEFAULT;
+
+		if (json_get(meta, "all_filesystems"))
+			test->est *= EST_ALL_FS;
+
+		/* the test would be skipped */
+		if (json_get(meta, "needs_root") && geteuid())
+			test->est = 0;
+
+		/*
+		 * Only tests asking for more CPUs reserve them, the number of
+		 * parallel tests is limited by -x.
+		 */
+		val = json_get_num(meta, "min_cpus");
+		test->cpus = val > 1 ? val : 0;
+		if (test->cpus > sched->cpus_total)
+			test->cpus = sched->cpus_total;
+
+		/* tst_test.c implies .needs_device for all of these */
+		test->device = json_get(meta, "needs_device") ||
+			       json_get(meta, "mount_device") ||
+			       json_get(meta, "format_device") ||
+			       json_get(meta, "all_filesystems");
+
+		if (sched_add_locks(sched, test, meta))
+			goto err_sched;
+	}
+
+	sched->locks_held = calloc(sched->lock_cnt + 1, 1);
+	if (!sched->locks_held)
+		goto err_sched;
+
+	sched_order(sched);
+	json_free(root);
+
+	return sched;
+
+err_sched:
+	fprintf(stderr, "pan: failed to allocate memory: %s\n",
+		strerror(errno));
+	if (sched->tests) {
+		for (i = 0; i < cnt; i++)
+			free(sched->tests[i].locks);
+	}
+	for (i = 0; i < (int)sched->lock_cnt; i++)
+		free(sched->lock_names[i]);
+	free(sched->lock_names);
+	free(sched->tests);
+	free(sched->order);
+	free(sched);
+err_json:
+	json_free(root);
+	return NULL;
+}
+
+static int sched_fits(struct pan_sched *sched, struct sched_test *test)
+{
+	unsigned int i;
+
+	if (test->exclusive)
+		return !sched->running;
+
+	if (test->cpus > sched->cpus_free)
+		return 0;
+
+	if (test->device && !sched->devs_free)
+		return 0;
+
+	for (i = 0; i < test->lock_cnt; i++) {
+		if (sched->locks_held[test->locks[i]])
+			return 0;
+	}
+
+	return 1;
+}
+
+static void sched_claim(struct pan_sched *sched, struct sched_test *test,
+			int claim)
+{
+	unsigned int i;
+
+	if (test->exclusive)
+		sched->exclusive_running = claim;
+
+	if (claim) {
+		sched->cpus_free -= test->cpus;
+		sched->running++;
+	} else {
+		sched->cpus_free += test->cpus;
+		sched->running--;
+	}
+
+	if (test->device && sched->devs_free >= 0)
+		sched->devs_free += claim ? -1 : 1;
+
+	for (i = 0; i < test->lock_cnt; i++)
+		sched->locks_held[test->locks[i]] = claim;
+}
+
+int pan_sched_pick(struct pan_sched *sched)
+{
+	struct sched_test *test;
+	int i, idx, head = 1;
+
+	if (sched->exclusive_running)
+		return -1;
+
+	if (!sched->pending) {
+		if (sched->running)
+			return -1;
+
+		for (i = 0; i < sched->cnt; i++)
+			sched->tests[i].state = TEST_PENDING;
+
+		sched->pending = sched->cnt;
+	}
+
+	for (i = 0; i < sched->cnt; i++) {
+		idx = sched->order[i];
+		test = &sched->tests[idx];
+
+		if (test->state != TEST_PENDING)
+			continue;
+
+		if (sched_fits(sched, test)) {
+			test->state = TEST_RUNNING;
+			sched->pending--;
+			sched_claim(sched, test, 1);
+			return idx;
+		}
+
+		/*
+		 * Backfilling past a test that waits for CPUs or for an idle
+		 * system could postpone it indefinitely.
+		 */
+		if (head && (test->exclusive || test->cpus > sched->cpus_free))
+			return -1;
+
+		head = 0;
+	}
+
+	return -1;
+}
+
+void pan_sched_done(struct pan_sched *sched, int idx)
+{
+	struct sched_test *test = &sched->tests[idx];
+
+	if (test->state != TEST_RUNNING)
+		return;
+
+	test->state = TEST_DONE;
+	sched_claim(sched, test, 0);
+}
+
+void pan_sched_dump(struct pan_sched *sched, char **cmdlines)
+{
+	struct sched_test *test;
+	unsigned int j;
+	int i;
+
+	fprintf(stderr, "schedule (%u cpus):\n", sched->cpus_total);
+
+	for (i = 0; i < sched->cnt; i++) {
+		test = &sched->tests[sched->order[i]];
+
+		fprintf(stderr, "  %s: ", cmdlines[sched->order[i]]);
+
+		if (test->exclusive) {
+			fprintf(stderr, "exclusive\n");
+			continue;
+		}
+
+		fprintf(stderr, "est=%us cpus=%u%s", test->est, test->cpus,
+			test->device ? " device" : "");
+
+		for (j = 0; j < test->lock_cnt; j++)
+			fprintf(stderr, " %s", sched->lock_names[test->locks[j]]);
+
+		fprintf(stderr, "\n");
+	}
+}
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (c) Linux Test Project, 2024
+ */
+
+#ifndef PAN_SCHED_H__
+#define PAN_SCHED_H__
+
+/*
+ * Resource aware scheduler for running tests in parallel.
+ *
+ * The test requirements are read from the metadata file generated by
+ * metadata/metaparse (ltp.json). Tests are matched by the basename of the
+ * first word of their command line. Tests that are not found in the metadata
+ * are assumed to possibly touch anything and are run alone, after everything
+ * else.
+ *
+ * The remaining tests are started longest first (LPT), as long as the test
+ * does not need a cgroup controller, a sysctl (.save_restore) or hugepages
+ * that a running test already uses and its .min_cpus fit into the online
+ * CPUs not reserved by the running tests. Only one test using a device
+ * (.needs_device, .mount_device, .format_device or .all_filesystems) runs at
+ * a time unless the devices come from a pool (LTP_DEV_POOL).
+ */
+struct pan_sched;
+
+/*
+ * Parses the metadata file and computes the execution order for the cnt
+ * commands. Prints an error and returns NULL on failure.
+ */
+struct pan_sched *pan_sched_new(const char *metafile, char **cmdlines, int cnt);
+
+/*
+ * Returns the index of the next command to run or -1 if no command can be
+ * started until some of the running ones finish. Once all commands were
+ * started and finished the next pass starts from the beginning.
+ */
+int pan_sched_pick(struct pan_sched *sched);
+
+/*
+ * Releases the resources held by a command returned by pan_sched_pick().
+ */
+void pan_sched_done(struct pan_sched *sched, int idx);
+
+/*
+ * Prints the schedule into stderr.
+ */
+void pan_sched_dump(struct pan_sched *sched, char **cmdlines);
+
+#endif /* PAN_SCHED_H__ */
@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Checks that ltp-pan -M never runs two tests that use a device at the same
+# time, including tests that only set .mount_device, .format_device or
+# .all_filesystems.
+
+fail=0
+tmp=$(mktemp -d)
+
+unset LTP_DEV_POOL
+
+for i in dev_needs dev_mount dev_format dev_allfs nodev; do
+	cat > $tmp/$i <<EOT
+#!/bin/sh
+[ "\$1" = nodev ] && exit 0
+if ! mkdir $tmp/lock 2>/dev/null; then
+	echo "$i runs in parallel with \$(cat $tmp/owner)"
+	exit 1
+fi
+echo $i > $tmp/owner
+sleep 1
+rm $tmp/owner
+rmdir $tmp/lock
+EOT
+	chmod +x $tmp/$i
+	echo "$i $tmp/$i $i" >> $tmp/runtest
+done
+
+../ltp-pan -q -n pan_sched -a $tmp/active -x 4 -M ltp.json -f $tmp/runtest \
+	-l $tmp/log -o $tmp/out >/dev/null 2>&1
+
+if grep -q "stat=[1-9]" $tmp/log; then
+	echo "***"
+	echo "device tests overlap!"
+	cat $tmp/out
+	echo "***"
+	fail=1
+fi
+
+if ! ../ltp-pan -d 0x200 -q -n pan_sched -a $tmp/active -M ltp.json -f $tmp/runtest \
+	-l $tmp/log -o $tmp/out 2>&1 >/dev/null | grep -q "dev_mount: .* device"; then
+	echo "***"
+	echo "mount_device test not scheduled as a device test!"
+	echo "***"
+	fail=1
+fi
+
+rm -rf $tmp
+
+exit $fail
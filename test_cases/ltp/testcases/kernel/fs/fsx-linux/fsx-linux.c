@@ -18,15 +18,30 @@
  * This is a complete rewrite of the old fsx-linux tool, created by
  * NeXT Computer, Inc. and Apple Computer, Inc. between 1991 and 2001,
  * then adapted for LTP. Test is actually a file system exerciser: we bring a
- * file and randomly write operations like read/write/map read/map write and
- * truncate, according with input parameters. Then we check if all of them
- * have been completed.
+ * file and randomly write operations like read/write/map read/map write,
+ * truncate and optionally copy_file_range, hole punching, range zeroing and
+ * O_DIRECT read/write, according with input parameters. Then we check if all
+ * of them have been completed.
+ *
+ * With -p N the test runs N independent streams in parallel, each one with
+ * its own file, thread and random generator. Every stream is seeded from the
+ * -S seed and its number, so a failing stream is reproduced by running the
+ * test again with the same -S and -p. The last operations of the failing
+ * stream are printed along with the failure.
  */
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
 #include "tst_test.h"
+#include "tst_safe_pthread.h"
+#include "tst_safe_prw.h"
+#include "tst_timer.h"
+#include "lapi/fallocate.h"
+#include "lapi/syscalls.h"
 
-#define FNAME "ltp-file.bin"
+#define FNAME "ltp-file%d.bin"
+#define LOG_SIZE 64
 
 enum {
 	OP_READ = 0,
@@ -34,35 +49,141 @@ enum {
 	OP_TRUNCATE,
 	OP_MAPREAD,
 	OP_MAPWRITE,
+	OP_COPYRANGE,
+	OP_PUNCHHOLE,
+	OP_ZERORANGE,
+	OP_DIOREAD,
+	OP_DIOWRITE,
 	/* keep counter here */
 	OP_TOTAL,
 };
 
+static const char *const op_names[] = {
+	[OP_READ] = "read",
+	[OP_WRITE] = "write",
+	[OP_TRUNCATE] = "truncate",
+	[OP_MAPREAD] = "map read",
+	[OP_MAPWRITE] = "map write",
+	[OP_COPYRANGE] = "copy range",
+	[OP_PUNCHHOLE] = "punch hole",
+	[OP_ZERORANGE] = "zero range",
+	[OP_DIOREAD] = "direct read",
+	[OP_DIOWRITE] = "direct write",
+};
+
 static char *str_file_max_size;
 static char *str_op_max_size;
 static char *str_op_nums;
 static char *str_op_write_align;
 static char *str_op_read_align;
 static char *str_op_trunc_align;
+static char *str_streams;
+static char *str_seed;
+static char *use_dio;
+static char *use_range_ops;
 
-static int file_desc;
 static long long file_max_size = 256 * 1024;
 static long long op_max_size = 64 * 1024;
-static long long file_size;
 static int op_write_align = 1;
 static int op_read_align = 1;
 static int op_trunc_align = 1;
 static int op_nums = 1000;
 static int page_size;
+static int streams_num = 1;
+static int seed;
 
-static char *file_buff;
-static char *temp_buff;
+/* operations which are not supported by the file system */
+static int ops_unsupported;
 
 struct file_pos_t {
 	long long offset;
 	long long size;
 };
 
+struct log_entry {
+	int op;
+	long long offset;
+	long long size;
+	long long file_size;
+};
+
+struct fsx_stream {
+	pthread_t thread;
+	int num;
+	int file_desc;
+	int dio_desc;
+	uint64_t rand;
+	long long file_size;
+	char *file_buff;
+	char *temp_buff;
+	int op_cnt;
+	int ops_disabled;
+	int failed;
+	unsigned long log_cnt;
+	struct log_entry log[LOG_SIZE];
+};
+
+static struct fsx_stream *streams;
+
+/* xorshift64*, each stream owns its state so that runs are reproducible */
+static long long fsx_random(struct fsx_stream *s)
+{
+	s->rand ^= s->rand >> 12;
+	s->rand ^= s->rand << 25;
+	s->rand ^= s->rand >> 27;
+
+	return (s->rand * 0x2545F4914F6CDD1DULL) >> 1;
+}
+
+static void fsx_seed(struct fsx_stream *s)
+{
+	/* splitmix64 step, spreads consecutive seeds over the state space */
+	uint64_t z = ((uint64_t)seed << 32 | s->num) + 0x9E3779B97F4A7C15ULL;
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	s->rand = (z ^ (z >> 31)) | 1;
+}
+
+static void fill_buff(struct fsx_stream *s, char *buff, long long size,
+		      char base)
+{
+	uint64_t rnd = 0;
+
+	for (long long i = 0; i < size; i++) {
+		if (!(i % 8))
+			rnd = fsx_random(s);
+
+		buff[i] = base + (rnd & 0xff) % 10;
+		rnd >>= 8;
+	}
+}
+
+static void log_op(struct fsx_stream *s, int op, struct file_pos_t const *pos)
+{
+	struct log_entry *e = &s->log[s->log_cnt++ % LOG_SIZE];
+
+	e->op = op;
+	e->offset = pos->offset;
+	e->size = pos->size;
+	e->file_size = s->file_size;
+}
+
+static void dump_log(struct fsx_stream *s)
+{
+	unsigned long i = s->log_cnt > LOG_SIZE ? s->log_cnt - LOG_SIZE : 0;
+	struct log_entry *e;
+
+	tst_res(TINFO, "Stream %d last operations (reproduce with -S %d -p %d):",
+		s->num, seed, streams_num);
+
+	for (; i < s->log_cnt; i++) {
+		e = &s->log[i % LOG_SIZE];
+		tst_res(TINFO, "%lu: %-12s offset=%llu, size=%llu, file size=%llu",
+			i, op_names[e->op], e->offset, e->size, e->file_size);
+	}
+}
+
 static void op_align_pages(struct file_pos_t *pos)
 {
 	long long pg_offset;
@@ -74,14 +195,15 @@ static void op_align_pages(struct file_pos_t *pos)
 }
 
 static void op_file_position(
+	struct fsx_stream *s,
 	const long long fsize,
 	const int align,
 	struct file_pos_t *pos)
 {
 	long long diff;
 
-	pos->offset = random() % fsize;
-	pos->size = random() % (fsize - pos->offset);
+	pos->offset = fsx_random(s) % fsize;
+	pos->size = fsx_random(s) % (fsize - pos->offset);
 
 	diff = pos->offset % align;
 
@@ -94,151 +216,174 @@ static void op_file_position(
 		pos->size = 1;
 }
 
-static void update_file_size(struct file_pos_t const *pos)
+static void update_file_size(struct fsx_stream *s, struct file_pos_t const *pos)
 {
-	if (pos->offset + pos->size > file_size) {
-		file_size = pos->offset + pos->size;
-		tst_res(TDEBUG, "File size changed: %llu", file_size);
+	if (pos->offset + pos->size > s->file_size) {
+		s->file_size = pos->offset + pos->size;
+		tst_res(TDEBUG, "[%d] File size changed: %llu",
+			s->num, s->file_size);
 	}
 }
 
-static int memory_compare(
-	const char *a,
-	const char *b,
-	const long long offset,
-	const long long size)
+/*
+ * Each stream disables the operation on its own, so that the sequence of the
+ * random numbers does not depend on the timing of the other streams.
+ */
+static void op_disable(struct fsx_stream *s, int op)
 {
-	int diff;
+	s->ops_disabled |= 1 << op;
 
-	for (long long i = 0; i < size; i++) {
-		diff = a[i] - b[i];
-		if (diff) {
-			tst_res(TDEBUG, "File memory differs at offset=%llu ('%c' != '%c')",
-				offset + i, a[i], b[i]);
+	if (__atomic_fetch_or(&ops_unsupported, 1 << op, __ATOMIC_RELAXED) & (1 << op))
+		return;
+
+	tst_res(TINFO | TERRNO, "Disabling %s operation", op_names[op]);
+}
+
+/*
+ * Compares four words at a time and falls back to a byte scan only to locate
+ * the mismatch. Returns the offset of the first differing byte or -1.
+ */
+static long long memory_compare(const char *a, const char *b, long long size)
+{
+	unsigned long wa[4], wb[4];
+	long long i = 0;
+
+	for (; i + (long long)sizeof(wa) <= size; i += sizeof(wa)) {
+		memcpy(wa, a + i, sizeof(wa));
+		memcpy(wb, b + i, sizeof(wb));
+
+		if ((wa[0] ^ wb[0]) | (wa[1] ^ wb[1]) |
+		    (wa[2] ^ wb[2]) | (wa[3] ^ wb[3]))
 			break;
-		}
 	}
 
-	return diff;
+	for (; i < size; i++) {
+		if (a[i] != b[i])
+			return i;
+	}
+
+	return -1;
+}
+
+static int check_buff(struct fsx_stream *s, const char *buff, int op,
+		      struct file_pos_t const *pos)
+{
+	const char *good = s->file_buff + pos->offset;
+	long long i = memory_compare(good, buff, pos->size);
+
+	if (i < 0)
+		return 1;
+
+	tst_res(TFAIL, "[%d] %s: file memory differs at offset=%llu (0x%02x != 0x%02x)",
+		s->num, op_names[op], pos->offset + i,
+		(unsigned char)buff[i], (unsigned char)good[i]);
+
+	return -1;
 }
 
-static int op_read(void)
+static int op_read(struct fsx_stream *s)
 {
-	if (!file_size) {
+	if (!s->file_size) {
 		tst_res(TINFO, "Skipping zero size read");
 		return 0;
 	}
 
 	struct file_pos_t pos;
+	ssize_t ret;
 
-	op_file_position(file_size, op_read_align, &pos);
-
-	tst_res(TDEBUG, "Reading at offset=%llu, size=%llu",
-		pos.offset, pos.size);
+	op_file_position(s, s->file_size, op_read_align, &pos);
+	log_op(s, OP_READ, &pos);
 
-	memset(temp_buff, 0, file_max_size);
+	tst_res(TDEBUG, "[%d] Reading at offset=%llu, size=%llu",
+		s->num, pos.offset, pos.size);
 
-	SAFE_LSEEK(file_desc, (off_t)pos.offset, SEEK_SET);
-	SAFE_READ(0, file_desc, temp_buff, pos.size);
-
-	int ret = memory_compare(
-		file_buff + pos.offset,
-		temp_buff,
-		pos.offset,
-		pos.size);
-
-	if (ret)
+	ret = SAFE_PREAD(0, s->file_desc, s->temp_buff, pos.size,
+			 (off_t)pos.offset);
+	if (ret != pos.size) {
+		tst_res(TFAIL, "[%d] Short read %zi of %llu at offset=%llu",
+			s->num, ret, pos.size, pos.offset);
 		return -1;
+	}
 
-	return 1;
+	return check_buff(s, s->temp_buff, OP_READ, &pos);
 }
 
-static int op_write(void)
+static int op_write(struct fsx_stream *s)
 {
-	if (file_size >= file_max_size) {
+	if (s->file_size >= file_max_size) {
 		tst_res(TINFO, "Skipping max size write");
 		return 0;
 	}
 
 	struct file_pos_t pos;
-	char data;
-
-	op_file_position(file_max_size, op_write_align, &pos);
 
-	for (long long i = 0; i < pos.size; i++) {
-		data = random() % 10 + 'a';
+	op_file_position(s, file_max_size, op_write_align, &pos);
+	log_op(s, OP_WRITE, &pos);
 
-		file_buff[pos.offset + i] = data;
-		temp_buff[i] = data;
-	}
+	fill_buff(s, s->file_buff + pos.offset, pos.size, 'a');
 
-	tst_res(TDEBUG, "Writing at offset=%llu, size=%llu",
-		pos.offset, pos.size);
+	tst_res(TDEBUG, "[%d] Writing at offset=%llu, size=%llu",
+		s->num, pos.offset, pos.size);
 
-	SAFE_LSEEK(file_desc, (off_t)pos.offset, SEEK_SET);
-	SAFE_WRITE(SAFE_WRITE_ALL, file_desc, temp_buff, pos.size);
+	SAFE_PWRITE(1, s->file_desc, s->file_buff + pos.offset,
+		    pos.size, (off_t)pos.offset);
 
-	update_file_size(&pos);
+	update_file_size(s, &pos);
 
 	return 1;
 }
 
-static int op_truncate(void)
+static int op_truncate(struct fsx_stream *s)
 {
 	struct file_pos_t pos;
 
-	op_file_position(file_max_size, op_trunc_align, &pos);
-	file_size = pos.offset + pos.size;
+	op_file_position(s, file_max_size, op_trunc_align, &pos);
+	log_op(s, OP_TRUNCATE, &pos);
+	s->file_size = pos.offset + pos.size;
 
-	tst_res(TDEBUG, "Truncating to %llu", file_size);
+	tst_res(TDEBUG, "[%d] Truncating to %llu", s->num, s->file_size);
 
-	SAFE_FTRUNCATE(file_desc, file_size);
-	memset(file_buff + file_size, 0, file_max_size - file_size);
+	SAFE_FTRUNCATE(s->file_desc, s->file_size);
+	memset(s->file_buff + s->file_size, 0, file_max_size - s->file_size);
 
 	return 1;
 }
 
-static int op_map_read(void)
+static int op_map_read(struct fsx_stream *s)
 {
-	if (!file_size) {
+	if (!s->file_size) {
 		tst_res(TINFO, "Skipping zero size read");
 		return 0;
 	}
 
 	struct file_pos_t pos;
 	char *addr;
+	int ret;
 
-	op_file_position(file_size, op_read_align, &pos);
+	op_file_position(s, s->file_size, op_read_align, &pos);
 	op_align_pages(&pos);
+	log_op(s, OP_MAPREAD, &pos);
 
-	tst_res(TDEBUG, "Map reading at offset=%llu, size=%llu",
-		pos.offset, pos.size);
+	tst_res(TDEBUG, "[%d] Map reading at offset=%llu, size=%llu",
+		s->num, pos.offset, pos.size);
 
 	addr = SAFE_MMAP(
 		0, pos.size,
 		PROT_READ,
 		MAP_FILE | MAP_SHARED,
-		file_desc,
+		s->file_desc,
 		(off_t)pos.offset);
 
-	memcpy(file_buff + pos.offset, addr, pos.size);
-
-	int ret = memory_compare(
-		addr,
-		file_buff + pos.offset,
-		pos.offset,
-		pos.size);
+	ret = check_buff(s, addr, OP_MAPREAD, &pos);
 
 	SAFE_MUNMAP(addr, pos.size);
-	if (ret)
-		return -1;
 
-	return 1;
+	return ret;
 }
 
-static int op_map_write(void)
+static int op_map_write(struct fsx_stream *s)
 {
-	if (file_size >= file_max_size) {
+	if (s->file_size >= file_max_size) {
 		tst_res(TINFO, "Skipping max size write");
 		return 0;
 	}
@@ -246,80 +391,334 @@ static int op_map_write(void)
 	struct file_pos_t pos;
 	char *addr;
 
-	op_file_position(file_max_size, op_write_align, &pos);
+	op_file_position(s, file_max_size, op_write_align, &pos);
 	op_align_pages(&pos);
+	log_op(s, OP_MAPWRITE, &pos);
 
-	if (file_size < pos.offset + pos.size)
-		SAFE_FTRUNCATE(file_desc, pos.offset + pos.size);
+	if (s->file_size < pos.offset + pos.size)
+		SAFE_FTRUNCATE(s->file_desc, pos.offset + pos.size);
 
-	tst_res(TDEBUG, "Map writing at offset=%llu, size=%llu",
-		pos.offset, pos.size);
+	tst_res(TDEBUG, "[%d] Map writing at offset=%llu, size=%llu",
+		s->num, pos.offset, pos.size);
 
-	for (long long i = 0; i < pos.size; i++)
-		file_buff[pos.offset + i] = random() % 10 + 'l';
+	fill_buff(s, s->file_buff + pos.offset, pos.size, 'l');
 
 	addr = SAFE_MMAP(
 		0, pos.size,
 		PROT_READ | PROT_WRITE,
 		MAP_FILE | MAP_SHARED,
-		file_desc,
+		s->file_desc,
 		(off_t)pos.offset);
 
-	memcpy(addr, file_buff + pos.offset, pos.size);
+	memcpy(addr, s->file_buff + pos.offset, pos.size);
 	SAFE_MSYNC(addr, pos.size, MS_SYNC);
 	SAFE_MUNMAP(addr, pos.size);
-	update_file_size(&pos);
+	update_file_size(s, &pos);
 
 	return 1;
 }
 
-static void run(void)
+static int op_copy_range(struct fsx_stream *s)
+{
+	if (!s->file_size) {
+		tst_res(TINFO, "Skipping zero size copy");
+		return 0;
+	}
+
+	struct file_pos_t src, dst;
+	loff_t off_in, off_out;
+	long long len;
+	ssize_t ret;
+
+	op_file_position(s, s->file_size, op_read_align, &src);
+	dst.offset = fsx_random(s) % file_max_size;
+	dst.offset -= dst.offset % op_write_align;
+
+	/* the source and destination ranges must not overlap */
+	len = MIN(src.size, file_max_size - dst.offset);
+	len = MIN(len, llabs(src.offset - dst.offset));
+	if (!len)
+		return 0;
+
+	src.size = dst.size = len;
+	log_op(s, OP_COPYRANGE, &dst);
+
+	tst_res(TDEBUG, "[%d] Copying from offset=%llu to offset=%llu, size=%llu",
+		s->num, src.offset, dst.offset, len);
+
+	off_in = src.offset;
+	off_out = dst.offset;
+
+	while (len > 0) {
+		ret = syscall(__NR_copy_file_range, s->file_desc, &off_in,
+			      s->file_desc, &off_out, (size_t)len, 0);
+		if (ret < 0) {
+			if (errno == ENOSYS || errno == EOPNOTSUPP ||
+			    errno == EXDEV || errno == EINVAL) {
+				op_disable(s, OP_COPYRANGE);
+				return 0;
+			}
+
+			tst_brk(TBROK | TERRNO, "copy_file_range() failed");
+		}
+
+		if (!ret) {
+			tst_res(TFAIL, "[%d] copy_file_range() hit EOF at offset=%lli",
+				s->num, (long long)off_in);
+			return -1;
+		}
+
+		len -= ret;
+	}
+
+	memmove(s->file_buff + dst.offset, s->file_buff + src.offset, dst.size);
+	update_file_size(s, &dst);
+
+	return 1;
+}
+
+static int op_fallocate(struct fsx_stream *s, int op)
 {
+	struct file_pos_t pos;
+	int mode;
+
+	if (op == OP_PUNCHHOLE) {
+		if (!s->file_size) {
+			tst_res(TINFO, "Skipping zero size hole punch");
+			return 0;
+		}
+
+		/* punched holes never change the file size */
+		op_file_position(s, s->file_size, op_write_align, &pos);
+		mode = FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+	} else {
+		op_file_position(s, file_max_size, op_write_align, &pos);
+		mode = FALLOC_FL_ZERO_RANGE;
+	}
+
+	log_op(s, op, &pos);
+
+	tst_res(TDEBUG, "[%d] %s at offset=%llu, size=%llu",
+		s->num, op_names[op], pos.offset, pos.size);
+
+	if (fallocate(s->file_desc, mode, pos.offset, pos.size)) {
+		if (errno == EOPNOTSUPP || errno == ENOSYS) {
+			op_disable(s, op);
+			return 0;
+		}
+
+		tst_brk(TBROK | TERRNO, "fallocate(%s) failed", op_names[op]);
+	}
+
+	memset(s->file_buff + pos.offset, 0, pos.size);
+	update_file_size(s, &pos);
+
+	return 1;
+}
+
+static void op_dio_position(struct fsx_stream *s, long long fsize,
+			    struct file_pos_t *pos)
+{
+	op_file_position(s, fsize, page_size, pos);
+
+	pos->size -= pos->size % page_size;
+	if (!pos->size)
+		pos->size = page_size;
+}
+
+static int op_dio_read(struct fsx_stream *s)
+{
+	if (s->file_size < page_size) {
+		tst_res(TDEBUG, "[%d] Skipping short file direct read", s->num);
+		return 0;
+	}
+
+	struct file_pos_t pos;
+	long long ret;
+
+	op_dio_position(s, s->file_size, &pos);
+	log_op(s, OP_DIOREAD, &pos);
+
+	tst_res(TDEBUG, "[%d] Direct reading at offset=%llu, size=%llu",
+		s->num, pos.offset, pos.size);
+
+	ret = SAFE_PREAD(0, s->dio_desc, s->temp_buff, pos.size,
+			 (off_t)pos.offset);
+
+	/* the last block may go past the end of the file */
+	if (ret != MIN(pos.size, s->file_size - pos.offset)) {
+		tst_res(TFAIL, "[%d] Short direct read %lli of %llu at offset=%llu",
+			s->num, ret, pos.size, pos.offset);
+		return -1;
+	}
+
+	pos.size = ret;
+
+	return check_buff(s, s->temp_buff, OP_DIOREAD, &pos);
+}
+
+static int op_dio_write(struct fsx_stream *s)
+{
+	if (s->file_size >= file_max_size) {
+		tst_res(TINFO, "Skipping max size write");
+		return 0;
+	}
+
+	struct file_pos_t pos;
+
+	op_dio_position(s, file_max_size - file_max_size % page_size, &pos);
+	log_op(s, OP_DIOWRITE, &pos);
+
+	fill_buff(s, s->temp_buff, pos.size, 'A');
+	memcpy(s->file_buff + pos.offset, s->temp_buff, pos.size);
+
+	tst_res(TDEBUG, "[%d] Direct writing at offset=%llu, size=%llu",
+		s->num, pos.offset, pos.size);
+
+	SAFE_PWRITE(1, s->dio_desc, s->temp_buff, pos.size,
+		    (off_t)pos.offset);
+
+	update_file_size(s, &pos);
+
+	return 1;
+}
+
+static void *run_stream(void *arg)
+{
+	struct fsx_stream *s = arg;
 	int op;
 	int ret;
-	int counter = 0;
 
-	file_size = 0;
+	s->file_size = 0;
+	s->op_cnt = 0;
+	s->failed = 0;
+	s->log_cnt = 0;
+	s->ops_disabled = 0;
+
+	if (!use_dio)
+		s->ops_disabled |= (1 << OP_DIOREAD) | (1 << OP_DIOWRITE);
+
+	if (!use_range_ops) {
+		s->ops_disabled |= (1 << OP_COPYRANGE) | (1 << OP_PUNCHHOLE) |
+				   (1 << OP_ZERORANGE);
+	}
+
+	memset(s->file_buff, 0, file_max_size);
 
-	memset(file_buff, 0, file_max_size);
-	memset(temp_buff, 0, file_max_size);
+	SAFE_FTRUNCATE(s->file_desc, 0);
 
-	SAFE_FTRUNCATE(file_desc, 0);
+	while (s->op_cnt < op_nums) {
+		op = fsx_random(s) % OP_TOTAL;
 
-	while (counter < op_nums) {
-		op = random() % OP_TOTAL;
+		if (s->ops_disabled & (1 << op))
+			continue;
 
 		switch (op) {
 		case OP_WRITE:
-			ret = op_write();
+			ret = op_write(s);
 			break;
 		case OP_MAPREAD:
-			ret = op_map_read();
+			ret = op_map_read(s);
 			break;
 		case OP_MAPWRITE:
-			ret = op_map_write();
+			ret = op_map_write(s);
 			break;
 		case OP_TRUNCATE:
-			ret = op_truncate();
+			ret = op_truncate(s);
+			break;
+		case OP_COPYRANGE:
+			ret = op_copy_range(s);
+			break;
+		case OP_PUNCHHOLE:
+		case OP_ZERORANGE:
+			ret = op_fallocate(s, op);
+			break;
+		case OP_DIOREAD:
+			ret = op_dio_read(s);
+			break;
+		case OP_DIOWRITE:
+			ret = op_dio_write(s);
 			break;
 		case OP_READ:
 		default:
-			ret = op_read();
+			ret = op_read(s);
 			break;
 		};
 
-		if (ret == -1)
+		if (ret == -1) {
+			s->failed = 1;
+			dump_log(s);
 			break;
+		}
 
-		counter += ret;
+		s->op_cnt += ret;
 	}
 
-	if (counter != op_nums)
-		tst_brk(TFAIL, "Some file operations failed");
+	return NULL;
+}
+
+static void run(void)
+{
+	struct timespec start, end;
+	long long total = 0;
+	long long elapsed;
+	int failed = 0;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (streams_num == 1) {
+		run_stream(&streams[0]);
+	} else {
+		for (i = 0; i < streams_num; i++) {
+			SAFE_PTHREAD_CREATE(&streams[i].thread, NULL,
+					    run_stream, &streams[i]);
+		}
+
+		for (i = 0; i < streams_num; i++)
+			SAFE_PTHREAD_JOIN(streams[i].thread, NULL);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = MAX(tst_timespec_diff_ms(end, start), 1LL);
+
+	for (i = 0; i < streams_num; i++) {
+		total += streams[i].op_cnt;
+		failed |= streams[i].failed;
+	}
+
+	tst_res(TINFO, "%lld operations in %lldms (%lld ops/s)",
+		total, elapsed, total * 1000 / elapsed);
+
+	if (failed)
+		tst_res(TFAIL, "Some file operations failed");
 	else
 		tst_res(TPASS, "All file operations succeed");
 }
 
+static void setup_stream(struct fsx_stream *s, int num)
+{
+	char fname[32];
+
+	s->num = num;
+	fsx_seed(s);
+
+	snprintf(fname, sizeof(fname), FNAME, num);
+	s->file_desc = SAFE_OPEN(fname, O_RDWR | O_CREAT, 0666);
+	s->dio_desc = -1;
+
+	if (use_dio) {
+		s->dio_desc = open(fname, O_RDWR | O_DIRECT);
+		if (s->dio_desc < 0 && errno == EINVAL)
+			tst_brk(TCONF, "O_DIRECT is not supported");
+		if (s->dio_desc < 0)
+			tst_brk(TBROK | TERRNO, "open(%s, O_DIRECT) failed", fname);
+	}
+
+	s->file_buff = SAFE_MALLOC(file_max_size);
+	s->temp_buff = SAFE_MEMALIGN(page_size, file_max_size);
+}
+
 static void setup(void)
 {
 	if (tst_parse_filesize(str_file_max_size, &file_max_size, 1, LLONG_MAX))
@@ -340,26 +739,51 @@ static void setup(void)
 	if (tst_parse_int(str_op_trunc_align, &op_trunc_align, 1, INT_MAX))
 		tst_brk(TBROK, "Invalid memory truncate alignment factor '%s'", str_op_trunc_align);
 
+	if (tst_parse_int(str_streams, &streams_num, 1, 1024))
+		tst_brk(TBROK, "Invalid number of streams '%s'", str_streams);
+
 	page_size = (int)sysconf(_SC_PAGESIZE);
 
-	srandom(time(NULL));
+	seed = time(NULL) & INT_MAX;
+	if (str_seed && tst_parse_int(str_seed, &seed, 0, INT_MAX))
+		tst_brk(TBROK, "Invalid seed '%s'", str_seed);
 
-	file_desc = SAFE_OPEN(FNAME, O_RDWR | O_CREAT, 0666);
+	if (use_dio && file_max_size < page_size)
+		tst_brk(TBROK, "File size must be at least %d for O_DIRECT", page_size);
 
-	file_buff = SAFE_MALLOC(file_max_size);
-	temp_buff = SAFE_MALLOC(file_max_size);
+	tst_res(TINFO, "Running %d stream(s) with seed %d", streams_num, seed);
+
+	streams = SAFE_MALLOC(streams_num * sizeof(*streams));
+	memset(streams, 0, streams_num * sizeof(*streams));
+
+	for (int i = 0; i < streams_num; i++)
+		setup_stream(&streams[i], i);
 }
 
 static void cleanup(void)
 {
-	if (file_buff)
-		free(file_buff);
+	struct fsx_stream *s;
+
+	if (!streams)
+		return;
 
-	if (temp_buff)
-		free(temp_buff);
+	for (int i = 0; i < streams_num; i++) {
+		s = &streams[i];
+
+		if (s->file_buff)
+			free(s->file_buff);
+
+		if (s->temp_buff)
+			free(s->temp_buff);
+
+		if (s->file_desc > 0)
+			SAFE_CLOSE(s->file_desc);
+
+		if (s->dio_desc > 0)
+			SAFE_CLOSE(s->dio_desc);
+	}
 
-	if (file_desc)
-		SAFE_CLOSE(file_desc);
+	free(streams);
 }
 
 static struct tst_test test = {
@@ -371,10 +795,14 @@ static struct tst_test test = {
 	.options = (struct tst_option[]) {
 		{ "l:", &str_file_max_size, "Maximum size in MB of the test file(s) (default 262144)" },
 		{ "o:", &str_op_max_size, "Maximum size for single operation (default 65536)" },
-		{ "N:", &str_op_nums, "Total # operations to do (default 1000)" },
+		{ "N:", &str_op_nums, "Total # operations to do per stream (default 1000)" },
 		{ "w:", &str_op_write_align, "Write memory page alignment (default 1)" },
 		{ "r:", &str_op_read_align, "Read memory page alignment (default 1)" },
 		{ "t:", &str_op_trunc_align, "Truncate memory page alignment (default 1)" },
+		{ "p:", &str_streams, "Number of parallel streams, one file each (default 1)" },
+		{ "S:", &str_seed, "Random seed (default current time)" },
+		{ "d", &use_dio, "Also do O_DIRECT reads and writes" },
+		{ "x", &use_range_ops, "Also do copy range, hole punch and zero range" },
 		{},
 	},
 };
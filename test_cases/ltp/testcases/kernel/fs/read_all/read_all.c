@@ -25,6 +25,19 @@
  * processors. However this is limited by default to 15 to avoid this becoming
  * an IPC stress test on systems with large numbers of weak cores. This can be
  * overridden with the 'w' parameters.
+ *
+ * With the 'u' parameter each worker takes a batch of paths from its queue
+ * and submits their opens and then their reads through io_uring, so a slow
+ * read handler doesn't stall the reads of the other files in the batch.
+ *
+ * With the 'a' parameter the number of workers which are fed with paths
+ * follows the observed read latency. It grows while the reads block in the
+ * kernel and the read rate keeps up, up to the 'w' limit, and shrinks back
+ * towards the processor count when the reads are fast.
+ *
+ * The read latency of each path is recorded. At the end the test reports the
+ * mean latency and the slowest paths, which point at slow kernel read
+ * handlers. The threshold for a slow read is set with the 's' parameter.
  */
 #include <signal.h>
 #include <sys/types.h>
@@ -48,12 +61,15 @@
 #include "tst_atomic.h"
 #include "tst_safe_clocks.h"
 #include "tst_test.h"
-#include "tst_timer.h"
+#include "tst_safe_io_uring.h"
 
 #define QUEUE_SIZE 16384
 #define BUFFER_SIZE 1024
 #define MAX_PATH 4096
 #define MAX_DISPLAY 40
+#define SLOW_REPORT 10
+#define ADAPT_INTERVAL_US 100000
+#define ADAPT_LAT_US 1000
 
 struct queue {
 	sem_t sem;
@@ -63,12 +79,38 @@ struct queue {
 	char popped[BUFFER_SIZE];
 };
 
+struct slow_read {
+	int elapsed;
+	char path[BUFFER_SIZE];
+};
+
+/* Written by the worker, read by the parent */
+struct worker_stats {
+	unsigned long reads;
+	unsigned long long elapsed;
+	int max_elapsed;
+	unsigned long slow_reads;
+	int slow_cnt;
+	struct slow_read slow[SLOW_REPORT];
+};
+
+/* Kept in shared memory so that the parent sees the worker heartbeat */
 struct worker {
 	int i;
 	pid_t pid;
 	struct queue *q;
 	int last_seen;
 	unsigned int kill_sent:1;
+	struct worker_stats stats;
+};
+
+struct uring_read {
+	char path[BUFFER_SIZE];
+	char buf[BUFFER_SIZE];
+	int fd;
+	int res;
+	int start;
+	int elapsed;
 };
 
 enum dent_action {
@@ -92,6 +134,21 @@ static char *drop_privs;
 static char *str_worker_timeout;
 static int worker_timeout;
 static int timeout_warnings_left = 15;
+static char *use_uring;
+static char *str_batch;
+static int batch = 32;
+static char *adaptive;
+static char *str_slow;
+static int slow_us = 10000;
+static long active_workers;
+static long min_active, max_active;
+static struct tst_io_uring ring;
+static struct uring_read *uring_reads;
+
+/* The previous sample of adapt_workers() */
+static int last_time;
+static unsigned long last_reads, last_rate;
+static unsigned long long last_elapsed;
 
 static char *blacklist[] = {
 	NULL, /* reserved for -e parameter */
@@ -103,21 +160,28 @@ static char *blacklist[] = {
 
 static long long epoch;
 
+/*
+ * tst_timer.h is not used, its kernel time types clash with the ones pulled
+ * in by linux/io_uring.h.
+ */
+static long long timespec_to_us(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000LL + (ts->tv_nsec + 500) / 1000;
+}
+
 static int atomic_timestamp(void)
 {
 	struct timespec now;
 
 	SAFE_CLOCK_GETTIME(CLOCK_MONOTONIC_RAW, &now);
 
-	return tst_timespec_to_us(now) - epoch;
+	return timespec_to_us(&now) - epoch;
 }
 
-static int queue_pop(struct queue *q)
+static int queue_pop_data(struct queue *q)
 {
 	int i = q->front, j = 0;
 
-	sem_wait(&q->sem);
-
 	if (!q->data[i])
 		return 0;
 
@@ -136,6 +200,22 @@ static int queue_pop(struct queue *q)
 	return 1;
 }
 
+static int queue_pop(struct queue *q)
+{
+	sem_wait(&q->sem);
+
+	return queue_pop_data(q);
+}
+
+/* Like queue_pop() but returns -1 instead of waiting on an empty queue */
+static int queue_trypop(struct queue *q)
+{
+	if (sem_trywait(&q->sem))
+		return -1;
+
+	return queue_pop_data(q);
+}
+
 static int queue_push(struct queue *q, const char *buf)
 {
 	int i = q->back, j = 0;
@@ -225,32 +305,61 @@ static int worker_ttl(const int worker)
 	return MAX(0, worker_timeout - worker_elapsed(worker));
 }
 
-static void read_test(const int worker, const char *const path)
+static void record_read(const int worker, const char *const path,
+			const int elapsed)
 {
-	char buf[BUFFER_SIZE];
-	int fd;
-	ssize_t count;
-	const pid_t pid = workers[worker].pid;
-	int elapsed;
+	struct worker_stats *const st = &workers[worker].stats;
+	struct slow_read *slot;
+	int i;
 
-	if (is_blacklisted(path))
+	__atomic_store_n(&st->elapsed, st->elapsed + elapsed, __ATOMIC_RELAXED);
+	__atomic_store_n(&st->reads, st->reads + 1, __ATOMIC_RELAXED);
+	st->max_elapsed = MAX(st->max_elapsed, elapsed);
+
+	if (elapsed < slow_us)
 		return;
 
-	if (verbose)
-		tst_res(TINFO, "Worker %d: %s(%s)", pid, __func__, path);
+	st->slow_reads++;
 
-	fd = open(path, O_RDONLY | O_NONBLOCK);
-	if (fd < 0) {
-		if (!quiet) {
-			tst_res(TINFO | TERRNO, "Worker %d (%d): open(%s)",
-				pid, worker, path);
+	if (verbose) {
+		tst_res(TINFO, "Worker %d (%d): slow read(%s), elapsed = %dus",
+			workers[worker].pid, worker, path, elapsed);
+	}
+
+	/* Keep the slowest reads, replacing the fastest one */
+	if (st->slow_cnt < SLOW_REPORT) {
+		slot = &st->slow[st->slow_cnt++];
+	} else {
+		slot = &st->slow[0];
+		for (i = 1; i < SLOW_REPORT; i++) {
+			if (st->slow[i].elapsed < slot->elapsed)
+				slot = &st->slow[i];
 		}
-		return;
+
+		if (slot->elapsed >= elapsed)
+			return;
 	}
 
-	worker_heartbeat(worker);
-	count = read(fd, buf, sizeof(buf) - 1);
-	elapsed = worker_elapsed(worker);
+	slot->elapsed = elapsed;
+	strncpy(slot->path, path, sizeof(slot->path) - 1);
+	slot->path[sizeof(slot->path) - 1] = '\0';
+}
+
+static void report_open(const int worker, const char *const path)
+{
+	if (quiet)
+		return;
+
+	tst_res(TINFO | TERRNO, "Worker %d (%d): open(%s)",
+		workers[worker].pid, worker, path);
+}
+
+static void report_read(const int worker, const char *const path,
+			char *buf, const ssize_t count, const int elapsed)
+{
+	const pid_t pid = workers[worker].pid;
+
+	record_read(worker, path, elapsed);
 
 	if (count > 0 && verbose) {
 		sanitize_str(buf, count);
@@ -266,10 +375,168 @@ static void read_test(const int worker, const char *const path)
 			"Worker %d (%d): read(%s), elapsed = %dus",
 			pid, worker, path, elapsed);
 	}
+}
+
+static void read_test(const int worker, const char *const path)
+{
+	char buf[BUFFER_SIZE];
+	int fd;
+	ssize_t count;
+	const pid_t pid = workers[worker].pid;
+	int elapsed;
+
+	if (is_blacklisted(path))
+		return;
+
+	if (verbose)
+		tst_res(TINFO, "Worker %d: %s(%s)", pid, __func__, path);
+
+	fd = open(path, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		report_open(worker, path);
+		return;
+	}
+
+	worker_heartbeat(worker);
+	count = read(fd, buf, sizeof(buf) - 1);
+	elapsed = worker_elapsed(worker);
+
+	report_read(worker, path, buf, count, elapsed);
 
 	SAFE_CLOSE(fd);
 }
 
+static void uring_queue(const int opcode, const int fd, void *const addr,
+			const unsigned int len, const unsigned int flags,
+			const int data)
+{
+	uint32_t tail = *ring.sqr_tail;
+	uint32_t idx = tail & *ring.sqr_mask;
+	struct io_uring_sqe *sqe = ring.sqr_entries + idx;
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)addr;
+	sqe->len = len;
+	/* -1 reads from the current position, as read() does */
+	sqe->off = opcode == IORING_OP_READ ? (uint64_t)-1 : 0;
+	sqe->open_flags = flags;
+	sqe->user_data = data;
+	ring.sqr_array[idx] = idx;
+
+	tail++;
+	__atomic_store(ring.sqr_tail, &tail, __ATOMIC_RELEASE);
+}
+
+/*
+ * Submits the queued requests and waits for all of them. The completion
+ * time of each request is taken when it is reaped, which is close enough
+ * to spot slow handlers.
+ */
+static void uring_wait(const int worker, int count,
+		       void (*complete)(int, struct uring_read *, int))
+{
+	const struct io_uring_cqe *cqe;
+	uint32_t head, tail;
+	int submit = count;
+
+	while (count) {
+		SAFE_IO_URING_ENTER(0, ring.fd, submit, 1,
+				    IORING_ENTER_GETEVENTS, NULL);
+		submit = 0;
+
+		head = *ring.cqr_head;
+		__atomic_load(ring.cqr_tail, &tail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; head++, count--) {
+			cqe = ring.cqr_entries + (head & *ring.cqr_mask);
+			complete(worker, uring_reads + cqe->user_data, cqe->res);
+		}
+
+		__atomic_store(ring.cqr_head, &head, __ATOMIC_RELEASE);
+		worker_heartbeat(worker);
+	}
+}
+
+static void uring_open_done(const int worker, struct uring_read *r,
+			    const int res)
+{
+	r->fd = res;
+
+	if (res < 0) {
+		errno = -res;
+		report_open(worker, r->path);
+	}
+}
+
+static void uring_read_done(const int worker LTP_ATTRIBUTE_UNUSED,
+			    struct uring_read *r, const int res)
+{
+	r->res = res;
+	r->elapsed = atomic_timestamp() - r->start;
+}
+
+/*
+ * The completions are reaped in bursts, so all reads of a batch which waited
+ * behind a slow one look slow too. Repeat those with pread() to find out
+ * which handler is actually slow, non-seekable files keep the batch time.
+ */
+static void uring_retime_read(const int worker, struct uring_read *r)
+{
+	char buf[BUFFER_SIZE];
+	ssize_t count;
+
+	if (r->elapsed < slow_us)
+		return;
+
+	worker_heartbeat(worker);
+	count = pread(r->fd, buf, sizeof(buf) - 1, 0);
+	if (count >= 0 || errno != ESPIPE)
+		r->elapsed = worker_elapsed(worker);
+}
+
+static void uring_read_batch(const int worker, const int count)
+{
+	struct uring_read *r;
+	int i, reads = 0;
+
+	for (i = 0; i < count; i++) {
+		r = uring_reads + i;
+		uring_queue(IORING_OP_OPENAT, AT_FDCWD, r->path, 0,
+			    O_RDONLY | O_NONBLOCK, i);
+	}
+
+	uring_wait(worker, count, uring_open_done);
+
+	for (i = 0; i < count; i++) {
+		r = uring_reads + i;
+		if (r->fd < 0)
+			continue;
+
+		r->start = atomic_timestamp();
+		uring_queue(IORING_OP_READ, r->fd, r->buf,
+			    sizeof(r->buf) - 1, 0, i);
+		reads++;
+	}
+
+	uring_wait(worker, reads, uring_read_done);
+
+	for (i = 0; i < count; i++) {
+		r = uring_reads + i;
+		if (r->fd < 0)
+			continue;
+
+		uring_retime_read(worker, r);
+
+		if (r->res < 0)
+			errno = -r->res;
+
+		report_read(worker, r->path, r->buf, r->res, r->elapsed);
+		SAFE_CLOSE(r->fd);
+	}
+}
+
 static void maybe_drop_privs(void)
 {
 	struct passwd *nobody;
@@ -294,6 +561,44 @@ static void maybe_drop_privs(void)
 		tst_brk(TBROK | TTERRNO, "Failed to use nobody uid");
 }
 
+static int worker_run_uring(int worker)
+{
+	struct io_uring_params params = {};
+	struct queue *q = workers[worker].q;
+	int count, ret = 1;
+
+	SAFE_IO_URING_INIT(batch, &params, &ring);
+	uring_reads = SAFE_MALLOC(batch * sizeof(*uring_reads));
+
+	while (ret) {
+		worker_heartbeat(worker);
+
+		count = 0;
+		ret = queue_pop(q);
+
+		while (ret > 0) {
+			if (!is_blacklisted(q->popped)) {
+				strcpy(uring_reads[count].path, q->popped);
+				count++;
+			}
+
+			if (count == batch)
+				break;
+
+			ret = queue_trypop(q);
+		}
+
+		if (count)
+			uring_read_batch(worker, count);
+	}
+
+	free(uring_reads);
+	SAFE_IO_URING_CLOSE(&ring);
+	queue_destroy(q, 1);
+	tst_flush();
+	return 0;
+}
+
 static int worker_run(int worker)
 {
 	struct sigaction term_sa = {
@@ -313,6 +618,9 @@ static int worker_run(int worker)
 			worker_elapsed(self->i));
 	}
 
+	if (use_uring)
+		return worker_run_uring(worker);
+
 	while (1) {
 		worker_heartbeat(worker);
 
@@ -496,15 +804,67 @@ static void destroy_workers(void)
 	}
 }
 
-static int sched_work(const int first_worker,
+/*
+ * Feeds more workers while the reads block in the kernel, as long as that
+ * doesn't lower the read rate, and fewer while the reads are fast so that
+ * the test doesn't turn into an IPC stress test.
+ */
+static void adapt_workers(void)
+{
+	unsigned long reads = 0, rate, mean = 0;
+	unsigned long long elapsed = 0;
+	const int now = atomic_timestamp();
+	long prev = active_workers;
+	int i;
+
+	if (now - last_time < ADAPT_INTERVAL_US)
+		return;
+
+	for (i = 0; i < worker_count; i++) {
+		reads += __atomic_load_n(&workers[i].stats.reads, __ATOMIC_RELAXED);
+		elapsed += __atomic_load_n(&workers[i].stats.elapsed, __ATOMIC_RELAXED);
+	}
+
+	rate = (reads - last_reads) * 1000000ULL / (now - last_time);
+	if (reads != last_reads)
+		mean = (elapsed - last_elapsed) / (reads - last_reads);
+
+	/* No reads finished at all means that the workers are blocked */
+	if (reads == last_reads ||
+	    (mean > ADAPT_LAT_US && rate >= last_rate - last_rate / 10)) {
+		active_workers = MIN(active_workers + 1, worker_count);
+	} else if (mean < ADAPT_LAT_US / 2) {
+		active_workers = MAX(active_workers - 1, min_active);
+	}
+
+	if (verbose && prev != active_workers) {
+		tst_res(TINFO,
+			"Active workers %ld -> %ld, mean latency = %luus, %lu reads/s",
+			prev, active_workers, mean, rate);
+	}
+
+	max_active = MAX(max_active, active_workers);
+	last_time = now;
+	last_reads = reads;
+	last_elapsed = elapsed;
+	last_rate = rate;
+}
+
+static int sched_work(int first_worker,
 		      const char *path, int repetitions)
 {
 	int i, j;
 	int min_ttl = worker_timeout, sleep_time = 1;
 	int pushed, workers_pushed = 0;
 
+	if (adaptive)
+		adapt_workers();
+
+	if (first_worker >= active_workers)
+		first_worker = 0;
+
 	for (i = 0, j = first_worker; i < repetitions; j++) {
-		if (j >= worker_count)
+		if (j >= active_workers)
 			j = 0;
 
 		if (j == first_worker && !workers_pushed) {
@@ -527,6 +887,36 @@ static int sched_work(const int first_worker,
 	return j;
 }
 
+/* Opens the directory through io_uring to check that the kernel can do it */
+static void uring_probe(void)
+{
+	struct io_uring_params params = {};
+	const struct io_uring_cqe *cqe;
+	int res;
+
+	SAFE_IO_URING_INIT(1, &params, &ring);
+
+	uring_queue(IORING_OP_OPENAT, AT_FDCWD, root_dir, 0,
+		    O_RDONLY | O_DIRECTORY, 0);
+	SAFE_IO_URING_ENTER(1, ring.fd, 1, 1, IORING_ENTER_GETEVENTS, NULL);
+
+	cqe = ring.cqr_entries + (*ring.cqr_head & *ring.cqr_mask);
+	res = cqe->res;
+	++*ring.cqr_head;
+
+	SAFE_IO_URING_CLOSE(&ring);
+
+	if (res == -EINVAL)
+		tst_brk(TCONF, "IORING_OP_OPENAT is not supported");
+
+	if (res < 0) {
+		tst_brk(TBROK, "io_uring openat(%s) failed: %s",
+			root_dir, tst_strerrno(-res));
+	}
+
+	SAFE_CLOSE(res);
+}
+
 static void setup(void)
 {
 	struct timespec now;
@@ -550,9 +940,38 @@ static void setup(void)
 	if (!root_dir)
 		tst_brk(TBROK, "The directory argument (-d) is required");
 
+	if (tst_parse_int(str_batch, &batch, 1, 4096)) {
+		tst_brk(TBROK,
+			"Invalid io_uring batch (-b) argument: '%s'",
+			str_batch);
+	}
+
+	if (tst_parse_int(str_slow, &slow_us, 1, INT_MAX / 1000)) {
+		tst_brk(TBROK,
+			"Invalid slow read (-s) argument: '%s'", str_slow);
+	}
+	slow_us *= 1000;
+
+	if (use_uring) {
+		io_uring_setup_supported_by_kernel();
+		uring_probe();
+	}
+
+	if (adaptive && str_worker_count)
+		tst_brk(TBROK, "Adaptive workers (-a) conflict with (-W)");
+
 	if (!worker_count)
 		worker_count = MIN(MAX(tst_ncpus() - 1, 1L), max_workers);
-	workers = SAFE_MALLOC(worker_count * sizeof(*workers));
+
+	/* Spawn all workers up to the limit, but feed only some of them */
+	min_active = worker_count;
+	if (adaptive)
+		worker_count = MAX(max_workers, min_active);
+
+	workers = SAFE_MMAP(NULL, worker_count * sizeof(*workers),
+			    PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_ANONYMOUS,
+			    0, 0);
 
 	if (tst_parse_int(str_worker_timeout, &worker_timeout, 1, INT_MAX)) {
 		tst_brk(TBROK,
@@ -571,7 +990,7 @@ static void setup(void)
 	worker_timeout *= 1000;
 
 	SAFE_CLOCK_GETTIME(CLOCK_MONOTONIC_RAW, &now);
-	epoch = tst_timespec_to_us(now);
+	epoch = timespec_to_us(&now);
 }
 
 static void reap_children(void)
@@ -610,7 +1029,61 @@ static void cleanup(void)
 	stop_workers();
 	reap_children();
 	destroy_workers();
-	free(workers);
+
+	if (workers)
+		SAFE_MUNMAP(workers, worker_count * sizeof(*workers));
+}
+
+static int slow_read_cmp(const void *a, const void *b)
+{
+	const struct slow_read *sa = a, *sb = b;
+
+	return sb->elapsed - sa->elapsed;
+}
+
+static void report_latency(void)
+{
+	struct slow_read *slow;
+	unsigned long reads = 0, slow_reads = 0;
+	unsigned long long elapsed = 0;
+	int i, j, max_elapsed = 0, cnt = 0;
+
+	slow = SAFE_MALLOC(SLOW_REPORT * worker_count * sizeof(*slow));
+
+	for (i = 0; i < worker_count; i++) {
+		reads += workers[i].stats.reads;
+		elapsed += workers[i].stats.elapsed;
+		slow_reads += workers[i].stats.slow_reads;
+		max_elapsed = MAX(max_elapsed, workers[i].stats.max_elapsed);
+
+		for (j = 0; j < workers[i].stats.slow_cnt; j++)
+			slow[cnt++] = workers[i].stats.slow[j];
+	}
+
+	if (!reads)
+		goto out;
+
+	tst_res(TINFO, "%lu reads, mean latency = %lluus, max latency = %dus",
+		reads, elapsed / reads, max_elapsed);
+
+	if (adaptive) {
+		tst_res(TINFO, "Active workers varied between %ld and %ld",
+			min_active, max_active);
+	}
+
+	if (!slow_reads)
+		goto out;
+
+	tst_res(TINFO, "%lu reads took longer than %dms, the slowest were:",
+		slow_reads, slow_us / 1000);
+
+	qsort(slow, cnt, sizeof(*slow), slow_read_cmp);
+
+	for (i = 0; i < MIN(cnt, SLOW_REPORT); i++)
+		tst_res(TINFO, "%10dus %s", slow[i].elapsed, slow[i].path);
+
+out:
+	free(slow);
 }
 
 static void visit_dir(const char *path)
@@ -677,6 +1150,10 @@ static void visit_dir(const char *path)
 
 static void run(void)
 {
+	active_workers = max_active = min_active;
+	last_time = atomic_timestamp();
+	last_reads = last_rate = last_elapsed = 0;
+
 	spawn_workers();
 	visit_dir(root_dir);
 
@@ -684,6 +1161,8 @@ static void run(void)
 	reap_children();
 	destroy_workers();
 
+	report_latency();
+
 	tst_res(TPASS, "Finished reading files");
 }
 
@@ -707,6 +1186,14 @@ static struct tst_test test = {
 		 "Drop privileges; switch to the nobody user."},
 		{"t:", &str_worker_timeout,
 		 "Milliseconds a worker has to read a file before it is restarted"},
+		{"u", &use_uring,
+		 "Open and read the files in batches with io_uring."},
+		{"b:", &str_batch,
+		 "Count The number of files in an io_uring batch, the default is 32."},
+		{"a", &adaptive,
+		 "Adapt the number of fed workers to the read latency, up to (-w)."},
+		{"s:", &str_slow,
+		 "Milliseconds a read has to take to be reported as slow, the default is 10."},
 		{}
 	},
 	.setup = setup,
@@ -12,6 +12,11 @@
  * AIO is done in a rotating loop: first file1.bin gets 8 requests, then
  * file2.bin, then file3.bin etc. As each file finishes writing, test switches
  * to reads. IO buffers are aligned in case we want to do direct IO.
+ *
+ * The I/O is driven either by libaio (default) or by io_uring, so that both
+ * kernel async I/O paths can be compared under identical load. The io_uring
+ * engine can additionally use a SQ polling thread and registered buffers and
+ * files.
  */
 
 #define _FILE_OFFSET_BITS 64
@@ -37,6 +42,7 @@
 #include <libaio.h>
 #include "tst_safe_pthread.h"
 #include "tst_safe_sysv_ipc.h"
+#include "lapi/io_uring.h"
 
 #define IO_FREE 0
 #define IO_PENDING 1
@@ -66,6 +72,9 @@ static char *str_o_flag;
 static char *str_stages;
 static char *str_use_shm;
 static char *str_num_threads;
+static char *str_engine;
+static char *sqpoll;
+static char *register_files;
 
 static int num_files = 1;
 static long long file_size = 1024 * 1024 * 1024;
@@ -107,6 +116,60 @@ struct io_latency {
 	double deviations[DEVIATIONS];
 };
 
+struct thread_info;
+
+/* async I/O interface used to submit and reap the io units */
+struct io_engine {
+	const char *name;
+
+	/* prepare the engine for a worker thread */
+	void (*setup)(struct thread_info *t);
+
+	/*
+	 * submit nr prepared iocbs, returns the number of iocbs queued or
+	 * -errno, -EAGAIN means retry once some I/O has completed
+	 */
+	int (*submit)(struct thread_info *t, int nr, struct iocb **iocbs);
+
+	/*
+	 * wait for at least min_nr completions, finish up to max_nr of them
+	 * and return the number of finished io units or -errno
+	 */
+	int (*reap)(struct thread_info *t, int min_nr, int max_nr);
+
+	void (*cleanup)(struct thread_info *t);
+};
+
+static struct io_engine *engine;
+
+/* io_uring submission and completion ring mappings */
+struct uring {
+	int fd;
+	unsigned int flags;
+
+	/* SQEs written to the ring but not yet passed to io_uring_enter() */
+	unsigned int to_submit;
+
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_entries;
+	unsigned int *sq_flags;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ptr;
+	size_t sq_size;
+	void *cq_ptr;
+	size_t cq_size;
+	size_t sqes_size;
+};
+
 /* container for a series of operations to a file */
 struct io_oper {
 	/* already open file descriptor, valid for whatever operation you want
@@ -149,6 +212,9 @@ struct io_oper {
 	/* stonewalled = 1 when we got cut off before submitting all our I/O */
 	int stonewalled;
 
+	/* index of fd in the io_uring registered files */
+	int file_index;
+
 	/* list management */
 	struct io_oper *next;
 	struct io_oper *prev;
@@ -178,20 +244,20 @@ struct io_unit {
 	/* result of last operation */
 	long res;
 
-	struct io_unit *next;
-
 	struct timeval io_start_time; /* time of io_submit */
 };
 
 struct thread_info {
 	io_context_t io_ctx;
+	struct uring ring;
 	pthread_t tid;
 
 	/* allocated array of io_unit structs */
 	struct io_unit *ios;
 
-	/* list of io units available for io */
-	struct io_unit *free_ious;
+	/* stack of indexes into ios of the io units available for io */
+	int *free_slots;
+	int num_free;
 
 	/* number of io units in the I/O array */
 	int num_global_ios;
@@ -462,8 +528,7 @@ static void finish_io(struct thread_info *t, struct io_unit *io, long result,
 	calc_latency(&io->io_start_time, tv_now, &t->io_completion_latency);
 	io->res = result;
 	io->busy = IO_FREE;
-	io->next = t->free_ious;
-	t->free_ious = io;
+	t->free_slots[t->num_free++] = io - t->ios;
 	oper->num_pending--;
 	t->num_global_pending--;
 	check_finished_io(io);
@@ -476,29 +541,12 @@ static void finish_io(struct thread_info *t, struct io_unit *io, long result,
 
 static int read_some_events(struct thread_info *t)
 {
-	struct io_unit *event_io;
-	struct io_event *event;
-	int nr;
-	int i;
 	int min_nr = io_iter;
-	struct timeval stop_time;
 
 	if (t->num_global_pending < io_iter)
 		min_nr = t->num_global_pending;
 
-	nr = io_getevents(t->io_ctx, min_nr, t->num_global_events, t->events, NULL);
-	if (nr <= 0)
-		return nr;
-
-	gettimeofday(&stop_time, NULL);
-
-	for (i = 0; i < nr; i++) {
-		event = t->events + i;
-		event_io = (struct io_unit *)((unsigned long)event->obj);
-		finish_io(t, event_io, event->res, &stop_time);
-	}
-
-	return nr;
+	return engine->reap(t, min_nr, t->num_global_events);
 }
 
 /*
@@ -511,9 +559,8 @@ static struct io_unit *find_iou(struct thread_info *t, struct io_oper *oper)
 	int nr;
 
 retry:
-	if (t->free_ious) {
-		event_io = t->free_ious;
-		t->free_ious = t->free_ious->next;
+	if (t->num_free) {
+		event_io = &t->ios[t->free_slots[--t->num_free]];
 
 		if (grab_iou(event_io, oper))
 			tst_brk(TBROK, "io unit on free list but not free");
@@ -535,30 +582,17 @@ retry:
  */
 static int io_oper_wait(struct thread_info *t, struct io_oper *oper)
 {
-	struct io_event event;
-	struct io_unit *event_io;
-
 	if (!oper)
 		return 0;
 
-	if (oper->num_pending == 0)
-		goto done;
-
-		/* this func is not speed sensitive, no need to go wild reading
-		 * more than one event at a time
-		 */
-	while (io_getevents(t->io_ctx, 1, 1, &event, NULL) > 0) {
-		struct timeval tv_now;
-
-		event_io = (struct io_unit *)((unsigned long)event.obj);
-
-		gettimeofday(&tv_now, NULL);
-		finish_io(t, event_io, event.res, &tv_now);
-
-		if (oper->num_pending == 0)
+	/* this func is not speed sensitive, no need to go wild reading
+	 * more than one event at a time
+	 */
+	while (oper->num_pending) {
+		if (engine->reap(t, 1, 1) <= 0)
 			break;
 	}
-done:
+
 	if (oper->num_err)
 		tst_res(TINFO, "%u errors on oper, last %u", oper->num_err, oper->last_err);
 
@@ -743,7 +777,7 @@ static int run_built(struct thread_info *t, int num_ios, struct iocb **my_iocbs)
 
 resubmit:
 	gettimeofday(&start_time, NULL);
-	ret = io_submit(t->io_ctx, num_ios, my_iocbs);
+	ret = engine->submit(t, num_ios, my_iocbs);
 
 	gettimeofday(&stop_time, NULL);
 	calc_latency(&start_time, &stop_time, &t->io_submit_latency);
@@ -901,14 +935,283 @@ static int run_active_list(struct thread_info *t, int io_iter, int max_io_submit
 	return 0;
 }
 
-static void aio_setup(io_context_t *io_ctx, int n)
+static void aio_setup(struct thread_info *t)
 {
-	int res = io_queue_init(n, io_ctx);
+	int res = io_queue_init(512, &t->io_ctx);
 
 	if (res != 0)
-		tst_brk(TBROK, "io_queue_setup(%d) returned %d (%s)", n, res, tst_strerrno(-res));
+		tst_brk(TBROK, "io_queue_setup(%d) returned %d (%s)", 512, res, tst_strerrno(-res));
+}
+
+static int aio_submit(struct thread_info *t, int nr, struct iocb **iocbs)
+{
+	return io_submit(t->io_ctx, nr, iocbs);
+}
+
+static int aio_reap(struct thread_info *t, int min_nr, int max_nr)
+{
+	struct io_unit *event_io;
+	struct io_event *event;
+	struct timeval stop_time;
+	int nr;
+	int i;
+
+	nr = io_getevents(t->io_ctx, min_nr, max_nr, t->events, NULL);
+	if (nr <= 0)
+		return nr;
+
+	gettimeofday(&stop_time, NULL);
+
+	for (i = 0; i < nr; i++) {
+		event = t->events + i;
+		event_io = (struct io_unit *)((unsigned long)event->obj);
+		finish_io(t, event_io, event->res, &stop_time);
+	}
+
+	return nr;
+}
+
+static void aio_cleanup(struct thread_info *t)
+{
+	io_queue_release(t->io_ctx);
+}
+
+static struct io_engine aio_engine = {
+	.name = "libaio",
+	.setup = aio_setup,
+	.submit = aio_submit,
+	.reap = aio_reap,
+	.cleanup = aio_cleanup,
+};
+
+static void uring_register(struct thread_info *t)
+{
+	struct uring *ring = &t->ring;
+	struct io_oper *oper = t->active_opers;
+	struct iovec iov;
+	int *fds;
+	int i = 0;
+
+	/*
+	 * The io unit buffers of a thread are a single contiguous chunk of the
+	 * shared memory, one registered buffer covers all of them.
+	 */
+	iov.iov_base = t->ios[0].buf;
+	iov.iov_len = t->num_global_ios * padded_reclen;
+
+	if (io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, &iov, 1))
+		tst_brk(TBROK | TERRNO, "io_uring_register(IORING_REGISTER_BUFFERS)");
+
+	fds = SAFE_MALLOC(t->num_files * sizeof(*fds));
+
+	do {
+		oper->file_index = i;
+		fds[i++] = oper->fd;
+		oper = oper->next;
+	} while (oper != t->active_opers);
+
+	if (io_uring_register(ring->fd, IORING_REGISTER_FILES, fds, i))
+		tst_brk(TBROK | TERRNO, "io_uring_register(IORING_REGISTER_FILES)");
+
+	free(fds);
+}
+
+static void uring_setup(struct thread_info *t)
+{
+	struct uring *ring = &t->ring;
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+
+	/* the CQ ring is twice the SQ ring, enough for all the io units */
+	p.flags = IORING_SETUP_CLAMP;
+	if (sqpoll)
+		p.flags |= IORING_SETUP_SQPOLL;
+
+	ring->fd = io_uring_setup(t->num_global_ios, &p);
+	if (ring->fd < 0) {
+		if (errno == EINVAL && sqpoll)
+			tst_brk(TCONF, "io_uring SQPOLL not supported");
+
+		if (errno == EPERM)
+			tst_brk(TCONF, "io_uring is disabled");
+
+		tst_brk(TBROK | TERRNO, "io_uring_setup()");
+	}
+
+	ring->flags = p.flags;
+
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->sq_ptr = SAFE_MMAP(0, ring->sq_size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_POPULATE, ring->fd,
+				 IORING_OFF_SQ_RING);
+
+	ring->sq_head = ring->sq_ptr + p.sq_off.head;
+	ring->sq_tail = ring->sq_ptr + p.sq_off.tail;
+	ring->sq_mask = ring->sq_ptr + p.sq_off.ring_mask;
+	ring->sq_entries = ring->sq_ptr + p.sq_off.ring_entries;
+	ring->sq_flags = ring->sq_ptr + p.sq_off.flags;
+	ring->sq_array = ring->sq_ptr + p.sq_off.array;
+
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = SAFE_MMAP(0, ring->sqes_size, PROT_READ | PROT_WRITE,
+			       MAP_SHARED | MAP_POPULATE, ring->fd,
+			       IORING_OFF_SQES);
+
+	ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->cq_ptr = SAFE_MMAP(0, ring->cq_size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_POPULATE, ring->fd,
+				 IORING_OFF_CQ_RING);
+
+	ring->cq_head = ring->cq_ptr + p.cq_off.head;
+	ring->cq_tail = ring->cq_ptr + p.cq_off.tail;
+	ring->cq_mask = ring->cq_ptr + p.cq_off.ring_mask;
+	ring->cqes = ring->cq_ptr + p.cq_off.cqes;
+
+	if (register_files)
+		uring_register(t);
 }
 
+/*
+ * passes the SQEs written so far to the kernel, either by waking up the SQ
+ * polling thread or by io_uring_enter(), optionally waiting for min_complete
+ * completions
+ */
+static int uring_enter(struct uring *ring, unsigned int min_complete)
+{
+	unsigned int flags = 0;
+	unsigned int to_submit = ring->to_submit;
+	int ret;
+
+	if (ring->flags & IORING_SETUP_SQPOLL) {
+		/* the tail store must be visible before reading the flags */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) &
+		    IORING_SQ_NEED_WAKEUP)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+
+		to_submit = 0;
+		ring->to_submit = 0;
+	}
+
+	if (min_complete)
+		flags |= IORING_ENTER_GETEVENTS;
+
+	if (!to_submit && !flags)
+		return 0;
+
+	ret = io_uring_enter(ring->fd, to_submit, min_complete, flags, NULL);
+	if (ret < 0)
+		return -errno;
+
+	if (!(ring->flags & IORING_SETUP_SQPOLL))
+		ring->to_submit -= MIN((unsigned int)ret, to_submit);
+
+	return ret;
+}
+
+static int uring_submit(struct thread_info *t, int nr, struct iocb **iocbs)
+{
+	struct uring *ring = &t->ring;
+	struct io_uring_sqe *sqe;
+	struct io_unit *io;
+	unsigned int tail = *ring->sq_tail;
+	unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	unsigned int idx;
+	int i, ret;
+
+	nr = MIN((unsigned int)nr, *ring->sq_entries - (tail - head));
+
+	for (i = 0; i < nr; i++) {
+		io = (struct io_unit *)iocbs[i];
+		idx = tail & *ring->sq_mask;
+		sqe = &ring->sqes[idx];
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->addr = (unsigned long)io->iocb.u.c.buf;
+		sqe->len = io->iocb.u.c.nbytes;
+		sqe->off = io->iocb.u.c.offset;
+		sqe->user_data = io - t->ios;
+
+		if (register_files) {
+			sqe->opcode = io->iocb.aio_lio_opcode == IO_CMD_PREAD ?
+				      IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+			sqe->fd = io->io_oper->file_index;
+			sqe->flags = IOSQE_FIXED_FILE;
+		} else {
+			sqe->opcode = io->iocb.aio_lio_opcode == IO_CMD_PREAD ?
+				      IORING_OP_READ : IORING_OP_WRITE;
+			sqe->fd = io->iocb.aio_fildes;
+		}
+
+		ring->sq_array[idx] = idx;
+		tail++;
+	}
+
+	__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+	ring->to_submit += nr;
+
+	/*
+	 * SQEs the kernel did not consume now stay queued in the ring and are
+	 * passed again with the next io_uring_enter()
+	 */
+	ret = uring_enter(ring, 0);
+	if (ret < 0 && ret != -EAGAIN && ret != -EBUSY)
+		return ret;
+
+	return nr ? nr : -EAGAIN;
+}
+
+static int uring_reap(struct thread_info *t, int min_nr, int max_nr)
+{
+	struct uring *ring = &t->ring;
+	struct io_uring_cqe *cqe;
+	struct timeval stop_time;
+	unsigned int head, tail;
+	int nr = 0;
+	int ret;
+
+	for (;;) {
+		head = *ring->cq_head;
+		tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+		if (head != tail)
+			gettimeofday(&stop_time, NULL);
+
+		for (; head != tail && nr < max_nr; head++, nr++) {
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			finish_io(t, &t->ios[cqe->user_data], cqe->res, &stop_time);
+		}
+
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+		if (nr >= min_nr)
+			return nr;
+
+		ret = uring_enter(ring, min_nr - nr);
+		if (ret < 0 && ret != -EINTR && ret != -EAGAIN)
+			return ret;
+	}
+}
+
+static void uring_cleanup(struct thread_info *t)
+{
+	struct uring *ring = &t->ring;
+
+	SAFE_MUNMAP(ring->sqes, ring->sqes_size);
+	SAFE_MUNMAP(ring->cq_ptr, ring->cq_size);
+	SAFE_MUNMAP(ring->sq_ptr, ring->sq_size);
+	SAFE_CLOSE(ring->fd);
+}
+
+static struct io_engine uring_engine = {
+	.name = "io_uring",
+	.setup = uring_setup,
+	.submit = uring_submit,
+	.reap = uring_reap,
+	.cleanup = uring_cleanup,
+};
+
 /*
  * allocate io operation and event arrays for a given thread
  */
@@ -918,6 +1221,7 @@ static void setup_ious(struct thread_info *t, int num_files, int depth, int recl
 	size_t bytes = num_files * depth * sizeof(*t->ios);
 
 	t->ios = SAFE_MALLOC(bytes);
+	t->free_slots = SAFE_MALLOC(num_files * depth * sizeof(*t->free_slots));
 
 	memset(t->ios, 0, bytes);
 
@@ -929,8 +1233,7 @@ static void setup_ious(struct thread_info *t, int num_files, int depth, int recl
 			memset(t->ios[i].buf, 'b', reclen);
 		else
 			memset(t->ios[i].buf, 0, reclen);
-		t->ios[i].next = t->free_ious;
-		t->free_ious = t->ios + i;
+		t->free_slots[t->num_free++] = depth * num_files - 1 - i;
 	}
 
 	if (verify) {
@@ -1041,7 +1344,7 @@ static int *worker(struct thread_info *t)
 	int status = 0;
 	int cnt;
 
-	aio_setup(&t->io_ctx, 512);
+	engine->setup(t);
 
 restart:
 	if (num_threads > 1) {
@@ -1128,7 +1431,7 @@ restart:
 	if (t->num_global_pending)
 		tst_res(TINFO, "global num pending is %d", t->num_global_pending);
 
-	io_queue_release(t->io_ctx);
+	engine->cleanup(t);
 
 	return (void *)(intptr_t)status;
 }
@@ -1162,6 +1465,28 @@ static void setup(void)
 
 	page_size_mask = getpagesize() - 1;
 
+	engine = &aio_engine;
+
+	if (str_engine) {
+		if (!strcmp(str_engine, "io_uring")) {
+			io_uring_setup_supported_by_kernel();
+			engine = &uring_engine;
+		} else if (strcmp(str_engine, "libaio")) {
+			tst_brk(TBROK, "Invalid I/O engine '%s'", str_engine);
+		}
+	}
+
+	tst_res(TINFO, "Using %s I/O engine", engine->name);
+
+	if ((sqpoll || register_files) && engine != &uring_engine)
+		tst_brk(TBROK, "-p and -R require the io_uring engine");
+
+	/* SQPOLL works only with registered files before 5.11 */
+	if (sqpoll && !register_files && tst_kvercmp(5, 11, 0) < 0) {
+		tst_res(TINFO, "SQPOLL requires registered files, enabling -R");
+		register_files = "";
+	}
+
 	SAFE_FILE_SCANF("/proc/sys/fs/aio-max-nr", "%d", &maxaio);
 	tst_res(TINFO, "Maximum AIO blocks: %d", maxaio);
 
@@ -1353,6 +1678,7 @@ static struct tst_test test = {
 		{ "b:", &str_max_io_submit, "Max number of iocbs to give io_submit at once" },
 		{ "c:", &str_num_contexts, "Number of io contexts per file" },
 		{ "d:", &str_depth, "Number of pending aio requests for each file (default 64)" },
+		{ "E:", &str_engine, "I/O engine, libaio or io_uring (default libaio)" },
 		{ "e:", &str_io_iter, "Number of I/O per file sent before switching to the next file (default 8)" },
 		{ "f:", &str_num_files, "Number of files to generate" },
 		{ "g:", &str_context_offset, "Offset between contexts (default 2M)" },
@@ -1362,7 +1688,9 @@ static struct tst_test test = {
 		{ "n", &no_fsync_stages, "No fsyncs between write stage and read stage" },
 		{ "o:", &str_stages, "Add an operation to the list: write=0, read=1, random write=2, random read=3" },
 		{ "O", &str_o_flag, "Use O_DIRECT" },
+		{ "p", &sqpoll, "Use a SQ polling thread (io_uring)" },
 		{ "r:", &str_rec_len, "Record size in KB used for each io (default 64K)" },
+		{ "R", &register_files, "Use registered buffers and fixed files (io_uring)" },
 		{ "s:", &str_file_size, "Size in MB of the test file(s) (default 1024M)" },
 		{ "t:", &str_num_threads, "Number of threads to run" },
 		{ "u", &unlink_files, "Unlink files after completion" },
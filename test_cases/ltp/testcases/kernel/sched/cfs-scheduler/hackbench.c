@@ -29,6 +29,12 @@
 /* Description: hackbench tests the Linux scheduler. Test groups of 20        */
 /*              processes spraying to 20 receivers                            */
 /*                                                                            */
+/*              Messages go over sockets (default), pipes, eventfds or        */
+/*              futexes. The tasks can be pinned to CPUs or NUMA nodes and    */
+/*              the wakeup latency of the receivers can be recorded in        */
+/*              histograms, which helps to spot tail latency regressions      */
+/*              the total time hides. The results can be printed as JSON.     */
+/*                                                                            */
 /* Total Tests: 1                                                             */
 /*                                                                            */
 /* Test Name:   hackbench01 and hackbench02                                   */
@@ -46,12 +52,21 @@
 /*                  - June 26 2008 - Subrata Modak<subrata@linux.vnet.ibm.com>*/
 /*                                                                            */
 /******************************************************************************/
+#define _GNU_SOURCE
 #include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <dirent.h>
+#include <time.h>
 #include <unistd.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
@@ -70,12 +85,71 @@ static unsigned int loops = 100;
  */
 static unsigned int process_mode = 1;
 
-static int use_pipes = 0;
+enum transport {
+	TRANSPORT_SOCKET,
+	TRANSPORT_PIPE,
+	TRANSPORT_EVENTFD,
+	TRANSPORT_FUTEX,
+};
+
+static const char *const transport_names[] = {
+	"socket", "pipe", "eventfd", "futex"
+};
+
+static enum transport transport = TRANSPORT_SOCKET;
+
+enum pin_policy {
+	PIN_NONE,
+	PIN_CPU,		/* each task to one CPU, round robin */
+	PIN_NUMA,		/* each group to one NUMA node, round robin */
+};
+
+static const char *const pin_names[] = { "none", "cpu", "numa" };
+
+static enum pin_policy pin_policy = PIN_NONE;
+
+#define MAX_NODES 64
+static cpu_set_t allowed_cpus;
+static int allowed_list[CPU_SETSIZE];
+static int num_allowed;
+static cpu_set_t node_cpus[MAX_NODES];
+static int num_nodes;
+static unsigned int worker_num;
+
+static int measure_lat;
+static int json_out;
+
+/*
+ * Latency histogram with 8 linear buckets per power of two, the values are
+ * in nanoseconds and the relative error is at most 12.5%.
+ */
+#define LAT_SUB_BITS 3
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS (64 * LAT_SUB)
+
+struct lat_stats {
+	uint64_t samples;
+	uint64_t max;
+	uint64_t hist[LAT_BUCKETS];
+};
+
+/*
+ * Eventfd and futex carry no data, the sender stores the time of the last
+ * message for the receiver, so the latency is measured per wakeup.
+ */
+struct mailbox {
+	uint32_t seq;		/* futex word, number of messages sent */
+	uint64_t send_ns;
+};
+
+static struct lat_stats *lat_tab;	/* one per receiver, shared */
+static struct mailbox *mbox_tab;	/* one per receiver, shared */
 
 struct sender_context {
 	unsigned int num_fds;
 	int ready_out;
 	int wakefd;
+	struct mailbox *mbox;
 	int out_fds[0];
 };
 
@@ -84,6 +158,8 @@ struct receiver_context {
 	int in_fds[2];
 	int ready_out;
 	int wakefd;
+	struct mailbox *mbox;
+	struct lat_stats *lat;
 };
 
 static void barf(const char *msg)
@@ -95,22 +171,221 @@ static void barf(const char *msg)
 static void print_usage_exit(void)
 {
 	printf
-	    ("Usage: hackbench [-pipe] <num groups> [process|thread] [loops]\n");
+	    ("Usage: hackbench [-pipe|-eventfd|-futex] [-pin cpu|numa] [-lat] [-json]\n"
+	     "                 <num groups> [process|thread] [loops]\n");
 	exit(1);
 }
 
-static void fdpair(int fds[2])
+static void *alloc_shared(size_t size)
+{
+	void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (ptr == MAP_FAILED)
+		barf("mmap()");
+
+	return ptr;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int lat_bucket(uint64_t ns)
+{
+	unsigned int msb;
+
+	if (ns < LAT_SUB)
+		return ns;
+
+	msb = 63 - __builtin_clzll(ns);
+
+	return (msb - LAT_SUB_BITS + 1) * LAT_SUB +
+	       ((ns >> (msb - LAT_SUB_BITS)) & (LAT_SUB - 1));
+}
+
+/* The largest value which falls into the bucket */
+static uint64_t lat_bucket_max(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < LAT_SUB)
+		return idx;
+
+	shift = idx / LAT_SUB - 1;
+
+	return ((uint64_t)(LAT_SUB + idx % LAT_SUB + 1) << shift) - 1;
+}
+
+static void lat_record(struct lat_stats *lat, uint64_t sent)
 {
-	if (use_pipes) {
+	uint64_t ns = now_ns() - sent;
+
+	lat->hist[lat_bucket(ns)]++;
+	lat->samples++;
+	if (ns > lat->max)
+		lat->max = ns;
+}
+
+static void lat_merge(struct lat_stats *dst, const struct lat_stats *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < LAT_BUCKETS; i++)
+		dst->hist[i] += src->hist[i];
+
+	dst->samples += src->samples;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+static uint64_t lat_percentile(const struct lat_stats *lat, double pct)
+{
+	uint64_t want = lat->samples * pct / 100, seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += lat->hist[i];
+		if (seen > want)
+			return lat_bucket_max(i) < lat->max ?
+			       lat_bucket_max(i) : lat->max;
+	}
+
+	return lat->max;
+}
+
+static void futex_wait(uint32_t *addr, uint32_t val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static void fdpair(int fds[2], enum transport type)
+{
+	switch (type) {
+	case TRANSPORT_PIPE:
 		if (pipe(fds) == 0)
 			return;
-	} else {
+	break;
+	case TRANSPORT_SOCKET:
 		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0)
 			return;
+	break;
+	case TRANSPORT_EVENTFD:
+		/* both sides use the same counter */
+		fds[0] = fds[1] = eventfd(0, 0);
+		if (fds[0] >= 0)
+			return;
+	break;
+	case TRANSPORT_FUTEX:
+		fds[0] = fds[1] = -1;
+		return;
 	}
 	barf("Creating fdpair");
 }
 
+/* Parses a cpulist such as 0-3,8 from sysfs */
+static void parse_cpulist(const char *path, cpu_set_t *set)
+{
+	FILE *f = fopen(path, "r");
+	int first, last;
+	char sep;
+
+	CPU_ZERO(set);
+
+	if (!f)
+		return;
+
+	while (fscanf(f, "%d", &first) == 1) {
+		last = first;
+		sep = fgetc(f);
+		if (sep == '-') {
+			if (fscanf(f, "%d", &last) != 1)
+				break;
+			sep = fgetc(f);
+		}
+
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, set);
+
+		if (sep != ',')
+			break;
+	}
+
+	fclose(f);
+}
+
+static void setup_pinning(void)
+{
+	char path[PATH_MAX];
+	struct dirent *ent;
+	DIR *dir;
+	int cpu, node;
+
+	if (sched_getaffinity(0, sizeof(allowed_cpus), &allowed_cpus))
+		barf("sched_getaffinity()");
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &allowed_cpus))
+			allowed_list[num_allowed++] = cpu;
+	}
+
+	if (pin_policy != PIN_NUMA)
+		return;
+
+	dir = opendir("/sys/devices/system/node");
+	while (dir && (ent = readdir(dir)) && num_nodes < MAX_NODES) {
+		if (sscanf(ent->d_name, "node%d", &node) != 1)
+			continue;
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d/cpulist", node);
+		parse_cpulist(path, &node_cpus[num_nodes]);
+		CPU_AND(&node_cpus[num_nodes], &node_cpus[num_nodes],
+			&allowed_cpus);
+
+		/* memory only nodes or nodes we are not allowed to run on */
+		if (CPU_COUNT(&node_cpus[num_nodes]))
+			num_nodes++;
+	}
+
+	if (dir)
+		closedir(dir);
+
+	if (!num_nodes) {
+		fprintf(stderr, "No NUMA nodes found, using all CPUs\n");
+		node_cpus[0] = allowed_cpus;
+		num_nodes = 1;
+	}
+}
+
+/* The CPUs the next worker will run on, set in the order of creation */
+static int worker_cpus(cpu_set_t *set)
+{
+	switch (pin_policy) {
+	case PIN_NONE:
+		return 0;
+	case PIN_CPU:
+		CPU_ZERO(set);
+		CPU_SET(allowed_list[worker_num++ % num_allowed], set);
+		return 1;
+	case PIN_NUMA:
+		*set = node_cpus[gr_num % num_nodes];
+		return 1;
+	}
+
+	return 0;
+}
+
 /* Block until we're ready to go */
 static void ready(int ready_out, int wakefd)
 {
@@ -126,11 +401,30 @@ static void ready(int ready_out, int wakefd)
 		barf("poll");
 }
 
+static void send_wakeup(struct sender_context *ctx, unsigned int j)
+{
+	struct mailbox *mbox = &ctx->mbox[j];
+	uint64_t one = 1;
+
+	if (measure_lat)
+		__atomic_store_n(&mbox->send_ns, now_ns(), __ATOMIC_RELAXED);
+
+	if (transport == TRANSPORT_EVENTFD) {
+		if (write(ctx->out_fds[j], &one, sizeof(one)) != sizeof(one))
+			barf("SENDER: eventfd write");
+		return;
+	}
+
+	__atomic_add_fetch(&mbox->seq, 1, __ATOMIC_RELEASE);
+	futex_wake(&mbox->seq);
+}
+
 /* Sender sprays loops messages down each file descriptor */
 static void *sender(struct sender_context *ctx)
 {
 	char data[DATASIZE];
 	unsigned int i, j;
+	uint64_t sent;
 
 	ready(ctx->ready_out, ctx->wakefd);
 
@@ -139,6 +433,16 @@ static void *sender(struct sender_context *ctx)
 		for (j = 0; j < ctx->num_fds; j++) {
 			int ret, done = 0;
 
+			if (transport == TRANSPORT_EVENTFD ||
+			    transport == TRANSPORT_FUTEX) {
+				send_wakeup(ctx, j);
+				continue;
+			}
+
+			if (measure_lat) {
+				sent = now_ns();
+				memcpy(data, &sent, sizeof(sent));
+			}
 again:
 			ret =
 			    write(ctx->out_fds[j], data + done,
@@ -154,17 +458,53 @@ again:
 	return NULL;
 }
 
+/* Returns the number of messages received in one wakeup */
+static unsigned int receive_wakeup(struct receiver_context *ctx,
+				   uint32_t *seen)
+{
+	struct mailbox *mbox = ctx->mbox;
+	uint64_t cnt;
+	uint32_t seq;
+
+	if (transport == TRANSPORT_EVENTFD) {
+		if (read(ctx->in_fds[0], &cnt, sizeof(cnt)) != sizeof(cnt))
+			barf("SERVER: eventfd read");
+	} else {
+		while ((seq = __atomic_load_n(&mbox->seq, __ATOMIC_ACQUIRE)) ==
+		       *seen)
+			futex_wait(&mbox->seq, seq);
+
+		cnt = seq - *seen;
+		*seen = seq;
+	}
+
+	if (measure_lat)
+		lat_record(ctx->lat,
+			   __atomic_load_n(&mbox->send_ns, __ATOMIC_RELAXED));
+
+	return cnt;
+}
+
 /* One receiver per fd */
 static void *receiver(struct receiver_context *ctx)
 {
 	unsigned int i;
+	uint32_t seen = 0;
+	uint64_t sent;
 
-	if (process_mode)
+	if (process_mode && ctx->in_fds[1] != ctx->in_fds[0])
 		close(ctx->in_fds[1]);
 
 	/* Wait for start... */
 	ready(ctx->ready_out, ctx->wakefd);
 
+	if (transport == TRANSPORT_EVENTFD || transport == TRANSPORT_FUTEX) {
+		for (i = 0; i < ctx->num_packets;)
+			i += receive_wakeup(ctx, &seen);
+
+		return NULL;
+	}
+
 	/* Receive them all */
 	for (i = 0; i < ctx->num_packets; i++) {
 		char data[DATASIZE];
@@ -177,6 +517,11 @@ again:
 		done += ret;
 		if (done < DATASIZE)
 			goto again;
+
+		if (measure_lat) {
+			memcpy(&sent, data, sizeof(sent));
+			lat_record(ctx->lat, sent);
+		}
 	}
 
 	return NULL;
@@ -186,7 +531,8 @@ pthread_t create_worker(void *ctx, void *(*func) (void *))
 {
 	pthread_attr_t attr;
 	pthread_t childid;
-	int err;
+	cpu_set_t cpus;
+	int err, pin = worker_cpus(&cpus);
 
 	if (process_mode) {
 		/* process mode */
@@ -195,6 +541,8 @@ pthread_t create_worker(void *ctx, void *(*func) (void *))
 		case -1:
 			barf("fork()");
 		case 0:
+			if (pin && sched_setaffinity(0, sizeof(cpus), &cpus))
+				barf("sched_setaffinity()");
 			(*func) (ctx);
 			exit(0);
 		}
@@ -210,6 +558,9 @@ pthread_t create_worker(void *ctx, void *(*func) (void *))
 		barf("pthread_attr_setstacksize");
 #endif
 
+	if (pin && pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus))
+		barf("pthread_attr_setaffinity_np");
+
 	if ((err = pthread_create(&childid, &attr, func, ctx)) != 0) {
 		fprintf(stderr, "pthread_create failed: %s (%d)\n",
 			strerror(err), err);
@@ -255,18 +606,20 @@ static unsigned int group(pthread_t * pth,
 			rev_ctx_tab[gr_num * num_fds + i] = ctx;
 
 		/* Create the pipe between client and server */
-		fdpair(fds);
+		fdpair(fds, transport);
 
 		ctx->num_packets = num_fds * loops;
 		ctx->in_fds[0] = fds[0];
 		ctx->in_fds[1] = fds[1];
 		ctx->ready_out = ready_out;
 		ctx->wakefd = wakefd;
+		ctx->mbox = &mbox_tab[gr_num * num_fds + i];
+		ctx->lat = &lat_tab[gr_num * num_fds + i];
 
 		pth[i] = create_worker(ctx, (void *)(void *)receiver);
 
 		snd_ctx->out_fds[i] = fds[1];
-		if (process_mode)
+		if (process_mode && fds[0] != fds[1])
 			close(fds[0]);
 	}
 
@@ -275,6 +628,7 @@ static unsigned int group(pthread_t * pth,
 		snd_ctx->ready_out = ready_out;
 		snd_ctx->wakefd = wakefd;
 		snd_ctx->num_fds = num_fds;
+		snd_ctx->mbox = &mbox_tab[gr_num * num_fds];
 
 		pth[num_fds + i] =
 		    create_worker(snd_ctx, (void *)(void *)sender);
@@ -283,13 +637,99 @@ static unsigned int group(pthread_t * pth,
 	/* Close the fds we have left */
 	if (process_mode)
 		for (i = 0; i < num_fds; i++)
-			close(snd_ctx->out_fds[i]);
+			if (snd_ctx->out_fds[i] >= 0)
+				close(snd_ctx->out_fds[i]);
 
 	gr_num++;
 	/* Return number of children to reap */
 	return num_fds * 2;
 }
 
+static void print_lat(const char *name, const struct lat_stats *lat)
+{
+	printf("%-10s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f\n", name,
+	       (unsigned long long)lat->samples,
+	       lat_percentile(lat, 50) / 1000.0,
+	       lat_percentile(lat, 90) / 1000.0,
+	       lat_percentile(lat, 99) / 1000.0,
+	       lat_percentile(lat, 99.9) / 1000.0,
+	       lat->max / 1000.0);
+}
+
+static void print_lat_json(const struct lat_stats *lat)
+{
+	printf("{\"samples\": %llu, \"p50\": %llu, \"p90\": %llu, "
+	       "\"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+	       (unsigned long long)lat->samples,
+	       (unsigned long long)lat_percentile(lat, 50),
+	       (unsigned long long)lat_percentile(lat, 90),
+	       (unsigned long long)lat_percentile(lat, 99),
+	       (unsigned long long)lat_percentile(lat, 99.9),
+	       (unsigned long long)lat->max);
+}
+
+static void report(unsigned int num_groups, unsigned int num_fds,
+		   struct timeval *diff)
+{
+	struct lat_stats *groups = NULL, all;
+	char name[32];
+	unsigned int i, j;
+
+	memset(&all, 0, sizeof(all));
+
+	if (measure_lat) {
+		groups = calloc(num_groups, sizeof(*groups));
+		if (!groups)
+			barf("calloc()");
+
+		for (i = 0; i < num_groups; i++) {
+			for (j = 0; j < num_fds; j++)
+				lat_merge(&groups[i], &lat_tab[i * num_fds + j]);
+			lat_merge(&all, &groups[i]);
+		}
+	}
+
+	if (!json_out) {
+		printf("Time: %lu.%03lu\n", diff->tv_sec, diff->tv_usec / 1000);
+
+		if (!measure_lat)
+			return;
+
+		printf("Wakeup latency (usec):\n");
+		printf("%-10s %10s %9s %9s %9s %9s %9s\n", "group", "samples",
+		       "p50", "p90", "p99", "p99.9", "max");
+		for (i = 0; i < num_groups; i++) {
+			snprintf(name, sizeof(name), "%u", i);
+			print_lat(name, &groups[i]);
+		}
+		print_lat("all", &all);
+		free(groups);
+		return;
+	}
+
+	printf("{\"groups\": %u, \"tasks\": %u, \"mode\": \"%s\", "
+	       "\"transport\": \"%s\", \"pin\": \"%s\", \"loops\": %u, "
+	       "\"time_usec\": %llu",
+	       num_groups, num_groups * num_fds * 2,
+	       process_mode ? "process" : "thread",
+	       transport_names[transport], pin_names[pin_policy], loops,
+	       (unsigned long long)diff->tv_sec * 1000000 + diff->tv_usec);
+
+	if (measure_lat) {
+		printf(", \"latency_nsec\": ");
+		print_lat_json(&all);
+		printf(", \"group_latency_nsec\": [");
+		for (i = 0; i < num_groups; i++) {
+			printf(i ? ", " : "");
+			print_lat_json(&groups[i]);
+		}
+		printf("]");
+		free(groups);
+	}
+
+	printf("}\n");
+}
+
 int main(int argc, char *argv[])
 {
 	unsigned int i, j, num_groups = 10, total_children;
@@ -299,8 +739,29 @@ int main(int argc, char *argv[])
 	char dummy;
 	pthread_t *pth_tab;
 
-	if (argv[1] && strcmp(argv[1], "-pipe") == 0) {
-		use_pipes = 1;
+	while (argv[1] && argv[1][0] == '-') {
+		if (strcmp(argv[1], "-pipe") == 0) {
+			transport = TRANSPORT_PIPE;
+		} else if (strcmp(argv[1], "-eventfd") == 0) {
+			transport = TRANSPORT_EVENTFD;
+		} else if (strcmp(argv[1], "-futex") == 0) {
+			transport = TRANSPORT_FUTEX;
+		} else if (strcmp(argv[1], "-lat") == 0) {
+			measure_lat = 1;
+		} else if (strcmp(argv[1], "-json") == 0) {
+			json_out = 1;
+		} else if (strcmp(argv[1], "-pin") == 0 && argv[2]) {
+			if (!strcmp(argv[2], "cpu"))
+				pin_policy = PIN_CPU;
+			else if (!strcmp(argv[2], "numa"))
+				pin_policy = PIN_NUMA;
+			else if (strcmp(argv[2], "none"))
+				print_usage_exit();
+			argc--;
+			argv++;
+		} else {
+			print_usage_exit();
+		}
 		argc--;
 		argv++;
 	}
@@ -308,8 +769,9 @@ int main(int argc, char *argv[])
 	if (argc >= 2 && (num_groups = atoi(argv[1])) == 0)
 		print_usage_exit();
 
-	printf("Running with %d*40 (== %d) tasks.\n",
-	       num_groups, num_groups * 40);
+	if (!json_out)
+		printf("Running with %d*40 (== %d) tasks.\n",
+		       num_groups, num_groups * 40);
 
 	fflush(NULL);
 
@@ -331,8 +793,18 @@ int main(int argc, char *argv[])
 	if (!pth_tab || !snd_ctx_tab || !rev_ctx_tab)
 		barf("main:malloc()");
 
-	fdpair(readyfds);
-	fdpair(wakefds);
+	/* Shared with the receivers in the process mode */
+	mbox_tab = alloc_shared(num_groups * num_fds * sizeof(*mbox_tab));
+	lat_tab = alloc_shared(num_groups * num_fds * sizeof(*lat_tab));
+
+	if (pin_policy != PIN_NONE)
+		setup_pinning();
+
+	/* eventfd and futex don't work for the ready and wake up signals */
+	fdpair(readyfds, transport == TRANSPORT_PIPE ? TRANSPORT_PIPE :
+						       TRANSPORT_SOCKET);
+	fdpair(wakefds, transport == TRANSPORT_PIPE ? TRANSPORT_PIPE :
+						      TRANSPORT_SOCKET);
 
 	total_children = 0;
 	for (i = 0; i < num_groups; i++)
@@ -359,7 +831,7 @@ int main(int argc, char *argv[])
 
 	/* Print time... */
 	timersub(&stop, &start, &diff);
-	printf("Time: %lu.%03lu\n", diff.tv_sec, diff.tv_usec / 1000);
+	report(num_groups, num_fds, &diff);
 
 	/* free the memory */
 	for (i = 0; i < num_groups; i++) {
@@ -371,5 +843,7 @@ int main(int argc, char *argv[])
 	SAFE_FREE(pth_tab);
 	SAFE_FREE(snd_ctx_tab);
 	SAFE_FREE(rev_ctx_tab);
+	munmap(mbox_tab, num_groups * num_fds * sizeof(*mbox_tab));
+	munmap(lat_tab, num_groups * num_fds * sizeof(*lat_tab));
 	exit(0);
 }
@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2024
+ */
+
+/*
+ * Batch host, runs many tests in a single driver process.
+ *
+ * The tests are built as shared objects (make test.so) which export their
+ * struct tst_test descriptor and resolve the test library from this binary.
+ * The host loads each object once and creates the IPC region once, then for
+ * each test forks a child that runs the test via tst_run_tcases(). This saves
+ * the exec, dynamic linking and the IPC setup for each test while each test
+ * still starts from a pristine copy of the library and its own state.
+ *
+ * Each argument is a path to the test shared object optionally followed by
+ * the test options, e.g. 'tst_batch getpid01.so "fsync01.so -i 2"'.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#define TST_NO_DEFAULT_MAIN
+#include "tst_test.h"
+
+#define MAX_ARGS 64
+
+extern struct tst_test *tst_test;
+
+static struct tst_test test = {
+};
+
+struct batch_test {
+	char *name;
+	char *argv[MAX_ARGS + 1];
+	int argc;
+	struct tst_test *desc;
+	int status;
+	long dur_ms;
+};
+
+static void print_help(void)
+{
+	fprintf(stderr, "\nUsage:\n");
+	fprintf(stderr, "tst_batch '/path/to/test.so [test options]'...\n\n");
+}
+
+static int parse_test(struct batch_test *test, char *spec)
+{
+	char *tok, *base, *dot;
+
+	for (tok = strtok(spec, " \t"); tok; tok = strtok(NULL, " \t")) {
+		if (test->argc >= MAX_ARGS) {
+			fprintf(stderr, "ERROR: Too many test options\n");
+			return 1;
+		}
+
+		test->argv[test->argc++] = tok;
+	}
+
+	if (!test->argc)
+		return 1;
+
+	base = strrchr(test->argv[0], '/');
+	test->name = strdup(base ? base + 1 : test->argv[0]);
+	if (!test->name)
+		return 1;
+
+	dot = strrchr(test->name, '.');
+	if (dot)
+		*dot = 0;
+
+	return 0;
+}
+
+static int load_test(struct batch_test *test)
+{
+	struct tst_test **desc;
+	void *handle;
+
+	handle = dlopen(test->argv[0], RTLD_NOW | RTLD_LOCAL);
+	if (!handle) {
+		fprintf(stderr, "ERROR: %s\n", dlerror());
+		return 1;
+	}
+
+	desc = dlsym(handle, "tst_batch_test");
+	if (!desc) {
+		fprintf(stderr, "ERROR: '%s' was not built as a test shared object\n",
+			test->argv[0]);
+		dlclose(handle);
+		return 1;
+	}
+
+	test->desc = *desc;
+	/* the test name is used for TID and the shm file name */
+	test->argv[0] = test->name;
+
+	return 0;
+}
+
+static long elapsed_ms(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000 +
+	       (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static void run_test(struct batch_test *test)
+{
+	struct timespec start;
+	pid_t pid;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	fflush(NULL);
+
+	pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "ERROR: fork() failed: %s\n", strerror(errno));
+		test->status = TBROK << 8;
+		return;
+	}
+
+	if (!pid)
+		tst_run_tcases(test->argc, test->argv, test->desc);
+
+	if (waitpid(pid, &test->status, 0) < 0) {
+		fprintf(stderr, "ERROR: waitpid() failed: %s\n",
+			strerror(errno));
+		test->status = TBROK << 8;
+	}
+
+	test->dur_ms = elapsed_ms(&start);
+}
+
+static const char *result_str(int status)
+{
+	int ret;
+
+	if (WIFSIGNALED(status))
+		return "killed";
+
+	ret = WEXITSTATUS(status);
+
+	if (ret & TBROK)
+		return "broken";
+
+	if (ret & TFAIL)
+		return "failed";
+
+	if (ret & TWARN)
+		return "warning";
+
+	if (ret & TCONF)
+		return "skipped";
+
+	return ret ? "unknown" : "passed";
+}
+
+int main(int argc, char *argv[])
+{
+	struct batch_test *tests;
+	int i, ret = 0;
+
+	if (argc < 2 || !strcmp(argv[1], "-h")) {
+		print_help();
+		return argc < 2;
+	}
+
+	/* Route the library messages printed by the host to stderr */
+	tst_test = &test;
+
+	tests = calloc(argc - 1, sizeof(*tests));
+	if (!tests) {
+		fprintf(stderr, "ERROR: calloc() failed\n");
+		return 1;
+	}
+
+	for (i = 0; i < argc - 1; i++) {
+		if (parse_test(&tests[i], argv[i + 1]) ||
+		    load_test(&tests[i])) {
+			print_help();
+			return 1;
+		}
+	}
+
+	tst_batch_setup_ipc();
+
+	for (i = 0; i < argc - 1; i++) {
+		run_test(&tests[i]);
+
+		if (!WIFEXITED(tests[i].status) ||
+		    (WEXITSTATUS(tests[i].status) & ~TCONF))
+			ret = 1;
+	}
+
+	tst_batch_cleanup_ipc();
+
+	fprintf(stderr, "\nBatch summary:\n");
+	for (i = 0; i < argc - 1; i++) {
+		fprintf(stderr, "%-24s %-8s %ldms\n", tests[i].name,
+			result_str(tests[i].status), tests[i].dur_ms);
+	}
+
+	return ret;
+}
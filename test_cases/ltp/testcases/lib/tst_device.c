@@ -21,7 +21,9 @@ static void print_help(void)
 	fprintf(stderr, "\nUsage:\n");
 	fprintf(stderr, "tst_device acquire [size [filename]]\n");
 	fprintf(stderr, "tst_device release /path/to/device\n");
-	fprintf(stderr, "tst_device clear /path/to/device\n\n");
+	fprintf(stderr, "tst_device clear /path/to/device\n");
+	fprintf(stderr, "tst_device pool create /path/to/pool count [size]\n");
+	fprintf(stderr, "tst_device pool destroy /path/to/pool\n\n");
 }
 
 static int acquire_device(int argc, char *argv[])
@@ -85,6 +87,42 @@ static int clear_device(int argc, char *argv[])
 	return 0;
 }
 
+static int device_pool(int argc, char *argv[])
+{
+	unsigned int count, size = 0;
+
+	if (argc < 4)
+		return 1;
+
+	if (!strcmp(argv[2], "destroy")) {
+		if (argc != 4)
+			return 1;
+
+		return tst_loop_pool_destroy(argv[3]);
+	}
+
+	if (strcmp(argv[2], "create") || argc < 5 || argc > 6)
+		return 1;
+
+	count = atoi(argv[4]);
+	if (!count) {
+		fprintf(stderr, "ERROR: Invalid device count '%s'", argv[4]);
+		return 1;
+	}
+
+	if (argc == 6) {
+		size = atoi(argv[5]);
+
+		if (!size) {
+			fprintf(stderr, "ERROR: Invalid device size '%s'",
+				argv[5]);
+			return 1;
+		}
+	}
+
+	return tst_loop_pool_create(argv[3], count, size);
+}
+
 int main(int argc, char *argv[])
 {
 	/*
@@ -110,6 +148,9 @@ int main(int argc, char *argv[])
 	} else if (!strcmp(argv[1], "clear")) {
 		if (clear_device(argc, argv))
 			goto help;
+	} else if (!strcmp(argv[1], "pool")) {
+		if (device_pool(argc, argv))
+			goto help;
 	} else {
 		fprintf(stderr, "ERROR: Invalid COMMAND '%s'\n", argv[1]);
 		goto help;
@@ -745,7 +745,7 @@ tst_netload()
 	fi
 
 	OPTIND=0
-	while getopts :a:c:H:n:N:r:R:S:b:t:T:fFe:m:A:D: opt; do
+	while getopts :a:c:H:n:N:r:R:S:b:t:T:fFe:m:A:D:w: opt; do
 		case "$opt" in
 		a) c_num="$OPTARG" ;;
 		H) c_opts="${c_opts}-H $OPTARG "
@@ -763,6 +763,7 @@ tst_netload()
 		T) cs_opts="${cs_opts}-T $OPTARG "
 		   type="$OPTARG" ;;
 		m) cs_opts="${cs_opts}-m $OPTARG " ;;
+		w) cs_opts="${cs_opts}-w $OPTARG " ;;
 		f) cs_opts="${cs_opts}-f " ;;
 		F) cs_opts="${cs_opts}-F " ;;
 		e) expect_res="$OPTARG" ;;
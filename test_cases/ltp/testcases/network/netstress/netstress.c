@@ -5,6 +5,7 @@
  * Author: Alexey Kodanev <alexey.kodanev@oracle.com>
  */
 
+#define _GNU_SOURCE
 #include <pthread.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -16,6 +17,8 @@
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <poll.h>
+#include <sched.h>
+#include <fcntl.h>
 #include <time.h>
 #include <string.h>
 #include <unistd.h>
@@ -31,6 +34,8 @@
 #include "tst_safe_pthread.h"
 #include "tst_test.h"
 #include "tst_safe_net.h"
+#include "tst_epoll.h"
+#include "tst_timer.h"
 
 #if !defined(HAVE_RAND_R)
 static int rand_r(LTP_ATTRIBUTE_UNUSED unsigned int *seed)
@@ -147,6 +152,38 @@ static char *zcopy;
 static int send_flags = MSG_NOSIGNAL;
 static char *reuse_port;
 
+/*
+ * Event driven mode, each worker thread is pinned to a CPU and multiplexes
+ * its connections with epoll. On the server each worker has its own
+ * SO_REUSEPORT listener.
+ */
+static char *warg;
+static int workers_num;
+
+/* log-linear latency histogram in microseconds, relative error < 1/32 */
+#define LAT_SUB_BITS	6
+#define LAT_SUB_CNT	(1 << (LAT_SUB_BITS - 1))
+#define LAT_BUCKETS	((66 - LAT_SUB_BITS) * LAT_SUB_CNT)
+
+struct net_worker {
+	pthread_t id;
+	int num;
+	int efd;
+	int lfd;
+	struct tst_epoll_event_data accept_data;
+	char *reply;
+	struct client_conn *conns;
+	int conns_num;
+	int conns_active;
+	unsigned long conns_cnt;
+	unsigned long requests;
+	struct timespec start;
+	struct timespec end;
+	unsigned long lat_max;
+	unsigned long lat_hist[LAT_BUCKETS];
+};
+static struct net_worker *workers;
+
 static void init_socket_opts(int sd)
 {
 	if (busy_poll >= 0)
@@ -439,6 +476,348 @@ out:
 	return (void *) err;
 }
 
+static int lat_idx(unsigned long us)
+{
+	int shift;
+
+	if (us < 2 * LAT_SUB_CNT)
+		return us;
+
+	shift = 63 - __builtin_clzl(us) - (LAT_SUB_BITS - 1);
+
+	return shift * LAT_SUB_CNT + (us >> shift);
+}
+
+static unsigned long lat_high(int idx)
+{
+	int shift = MAX(idx / LAT_SUB_CNT - 1, 0);
+
+	return ((unsigned long)(idx - shift * LAT_SUB_CNT) << shift) +
+		(1UL << shift) - 1;
+}
+
+static unsigned long lat_percentile(struct net_worker *w, int permille)
+{
+	unsigned long rank = (w->requests * permille + 999) / 1000;
+	unsigned long sum = 0;
+	int i;
+
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		sum += w->lat_hist[i];
+		if (sum && sum >= rank)
+			return MIN(lat_high(i), w->lat_max);
+	}
+
+	return w->lat_max;
+}
+
+static void worker_pin(struct net_worker *w)
+{
+	cpu_set_t mask;
+	int cpu, num;
+
+	if (sched_getaffinity(0, sizeof(mask), &mask))
+		return;
+
+	num = w->num % CPU_COUNT(&mask);
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &mask) && !num--)
+			break;
+	}
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+
+	errno = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+	if (errno)
+		tst_res(TINFO | TERRNO, "worker %d: can't pin to CPU %d", w->num, cpu);
+}
+
+static void worker_loop(struct net_worker *w, int timeout)
+{
+	struct epoll_event events[64];
+	struct tst_epoll_event_data *data;
+	int i, n;
+
+	n = epoll_wait(w->efd, events, ARRAY_SIZE(events), timeout);
+	if (n == -1) {
+		if (errno == EINTR)
+			return;
+		tst_brk(TBROK | TERRNO, "epoll_wait() failed");
+	}
+
+	if (!n)
+		tst_brk(TBROK, "worker %d: no reply in %d ms", w->num, timeout);
+
+	for (i = 0; i < n; i++) {
+		data = events[i].data.ptr;
+		data->on_epoll(data->self, events[i].events);
+	}
+}
+
+struct client_conn {
+	struct tst_epoll_event_data ev_data;
+	struct net_worker *w;
+	int id;
+	int fd;
+	int requests;
+	unsigned int seed;
+	int cln_len;
+	int srv_len;
+	int send_off;
+	int recv_off;
+	int connecting;
+	uint32_t events;
+	struct timespec req_start;
+	char *msg;
+	char *buf;
+};
+
+static void client_conn_events(struct client_conn *c, uint32_t events)
+{
+	struct epoll_event ev = {
+		.events = events,
+		.data.ptr = &c->ev_data,
+	};
+
+	if (c->events == events)
+		return;
+
+	SAFE_EPOLL_CTL(c->w->efd, c->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+		       c->fd, &ev);
+	c->events = events;
+}
+
+/* sends the rest of the request, returns 1 once it's complete */
+static int client_conn_flush(struct client_conn *c)
+{
+	ssize_t ret;
+
+	while (c->send_off < c->cln_len) {
+		ret = send(c->fd, c->msg + c->send_off, c->cln_len - c->send_off,
+			   send_flags);
+		if (ret == -1) {
+			if (errno == EAGAIN || errno == EINPROGRESS)
+				return 0;
+			tst_brk(TBROK | TERRNO, "client[%d] send() failed", c->id);
+		}
+		c->send_off += ret;
+	}
+
+	return 1;
+}
+
+static void client_conn_start(struct client_conn *c)
+{
+	int ret;
+
+	c->fd = SAFE_SOCKET(family, sock_type | SOCK_NONBLOCK, protocol);
+	c->events = 0;
+	c->send_off = 0;
+	c->recv_off = 0;
+	c->connecting = 0;
+	c->w->conns_cnt++;
+
+	init_socket_opts(c->fd);
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &c->req_start);
+
+	if (fastopen_api) {
+		/* Replaces connect() + send()/write() */
+		ret = sendto(c->fd, c->msg, c->cln_len, send_flags | MSG_FASTOPEN,
+			     remote_addrinfo->ai_addr, remote_addrinfo->ai_addrlen);
+		if (ret >= 0)
+			c->send_off = ret;
+	} else {
+		bind_before_connect(c->fd);
+		ret = connect(c->fd, remote_addrinfo->ai_addr,
+			      remote_addrinfo->ai_addrlen);
+		if (!ret)
+			client_conn_flush(c);
+	}
+
+	if (ret == -1) {
+		if (errno != EINPROGRESS)
+			tst_brk(TBROK | TERRNO, "client[%d] connect failed", c->id);
+		c->connecting = 1;
+	}
+
+	client_conn_events(c, c->send_off < c->cln_len ? EPOLLIN | EPOLLOUT : EPOLLIN);
+}
+
+static void client_conn_reply(struct client_conn *c)
+{
+	struct net_worker *w = c->w;
+	struct timespec now;
+	unsigned long lat;
+	int fin = c->buf[0] == start_fin_byte;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+	lat = tst_timespec_diff_us(now, c->req_start);
+	w->lat_hist[lat_idx(lat)]++;
+	w->lat_max = MAX(w->lat_max, lat);
+	w->requests++;
+
+	if (++c->requests == client_max_requests) {
+		SAFE_CLOSE(c->fd);
+		w->conns_active--;
+		return;
+	}
+
+	/* server closes the connection, reconnect with the same request */
+	if (fin) {
+		SAFE_CLOSE(c->fd);
+		client_conn_start(c);
+		return;
+	}
+
+	if (max_rand_msg_len)
+		make_client_request(c->msg, &c->cln_len, &c->srv_len, &c->seed);
+
+	c->recv_off = 0;
+	c->send_off = 0;
+	c->req_start = now;
+
+	if (!client_conn_flush(c))
+		client_conn_events(c, EPOLLIN | EPOLLOUT);
+}
+
+static int client_conn_event(void *self, uint32_t events)
+{
+	struct client_conn *c = self;
+	int err = 0;
+	socklen_t err_len = sizeof(err);
+	ssize_t len;
+
+	if (c->connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+		getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+		if (err) {
+			errno = err;
+			tst_brk(TBROK | TERRNO, "client[%d] connect failed", c->id);
+		}
+		c->connecting = 0;
+	}
+
+	if (c->send_off < c->cln_len) {
+		if (!client_conn_flush(c))
+			return 0;
+		client_conn_events(c, EPOLLIN);
+	}
+
+	while (1) {
+		len = recv(c->fd, c->buf + c->recv_off, c->srv_len - c->recv_off,
+			   MSG_DONTWAIT);
+		if (len == -1) {
+			if (errno == EAGAIN)
+				return 0;
+			if (errno == EINTR)
+				continue;
+			tst_brk(TBROK | TERRNO, "client[%d] recv() failed", c->id);
+		}
+
+		if (!len) {
+			tst_brk(TBROK, "client[%d] connection closed on '%d' request",
+				c->id, c->requests);
+		}
+
+		c->recv_off += len;
+
+		if (c->buf[0] != start_byte && c->buf[0] != start_fin_byte)
+			tst_brk(TBROK, "client[%d] invalid reply", c->id);
+
+		if (c->buf[c->recv_off - 1] == end_byte) {
+			client_conn_reply(c);
+			return 0;
+		}
+
+		if (c->recv_off == c->srv_len)
+			tst_brk(TBROK, "client[%d] reply is too long", c->id);
+	}
+}
+
+static void *client_worker_fn(void *arg)
+{
+	struct net_worker *w = arg;
+	int i;
+
+	worker_pin(w);
+	w->efd = SAFE_EPOLL_CREATE1(0);
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &w->start);
+
+	w->conns_active = w->conns_num;
+	for (i = 0; i < w->conns_num; i++)
+		client_conn_start(&w->conns[i]);
+
+	while (w->conns_active)
+		worker_loop(w, wait_timeout);
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &w->end);
+	SAFE_CLOSE(w->efd);
+
+	return NULL;
+}
+
+static void client_init_workers(void)
+{
+	int buf_len = MAX(init_cln_msg_len, init_srv_msg_len);
+	struct client_conn *c;
+	struct net_worker *w;
+	int i;
+
+	if (max_rand_msg_len)
+		buf_len = min_msg_len + max_rand_msg_len;
+
+	workers = SAFE_MALLOC(sizeof(*workers) * workers_num);
+	memset(workers, 0, sizeof(*workers) * workers_num);
+
+	for (i = 0; i < workers_num; i++) {
+		w = &workers[i];
+		w->num = i;
+		w->conns_num = clients_num / workers_num +
+			       (i < clients_num % workers_num);
+		w->conns = SAFE_MALLOC(sizeof(*w->conns) * w->conns_num);
+		memset(w->conns, 0, sizeof(*w->conns) * w->conns_num);
+	}
+
+	for (i = 0; i < clients_num; i++) {
+		w = &workers[i % workers_num];
+		c = &w->conns[i / workers_num];
+		c->ev_data.on_epoll = client_conn_event;
+		c->ev_data.self = c;
+		c->w = w;
+		c->id = i;
+		c->seed = init_seed ^ i;
+		c->cln_len = init_cln_msg_len;
+		c->srv_len = init_srv_msg_len;
+		c->msg = SAFE_MALLOC(buf_len);
+		c->buf = SAFE_MALLOC(buf_len);
+		make_client_request(c->msg, &c->cln_len, &c->srv_len, &c->seed);
+	}
+
+	for (i = 0; i < workers_num; i++)
+		SAFE_PTHREAD_CREATE(&workers[i].id, &attr, client_worker_fn, &workers[i]);
+}
+
+static void client_workers_report(void)
+{
+	struct net_worker *w;
+	long long time_us;
+	int i;
+
+	for (i = 0; i < workers_num; i++) {
+		w = &workers[i];
+		time_us = MAX(tst_timespec_diff_us(w->end, w->start), 1LL);
+
+		tst_res(TINFO, "worker %d: %lu conns, %lu requests, %.0f req/s",
+			i, w->conns_cnt, w->requests, w->requests * 1e6 / time_us);
+		tst_res(TINFO, "worker %d: latency p50 %luus p90 %luus p99 %luus max %luus",
+			i, lat_percentile(w, 500), lat_percentile(w, 900),
+			lat_percentile(w, 990), w->lat_max);
+	}
+}
+
 static int parse_client_request(const char *msg)
 {
 	union net_size_field net_size;
@@ -456,7 +835,7 @@ static struct timespec tv_client_end;
 
 static void client_init(void)
 {
-	if (clients_num >= MAX_THREADS) {
+	if (!workers_num && clients_num >= MAX_THREADS) {
 		tst_brk(TBROK, "Unexpected num of clients '%d'",
 			clients_num);
 	}
@@ -480,6 +859,12 @@ static void client_init(void)
 	family = remote_addrinfo->ai_family;
 
 	clock_gettime(CLOCK_MONOTONIC_RAW, &tv_client_start);
+
+	if (workers_num) {
+		client_init_workers();
+		return;
+	}
+
 	intptr_t i;
 	for (i = 0; i < clients_num; ++i)
 		SAFE_PTHREAD_CREATE(&thread_ids[i], &attr, client_fn, (void *)i);
@@ -490,7 +875,11 @@ static void client_run(void)
 	void *res = NULL;
 	long clnt_time = 0;
 	int i;
-	for (i = 0; i < clients_num; ++i) {
+
+	for (i = 0; i < workers_num; ++i)
+		SAFE_PTHREAD_JOIN(workers[i].id, NULL);
+
+	for (i = 0; !workers_num && i < clients_num; ++i) {
 		pthread_join(thread_ids[i], &res);
 		if (res) {
 			tst_brk(TBROK, "client[%d] failed: %s",
@@ -504,6 +893,9 @@ static void client_run(void)
 
 	tst_res(TINFO, "total time '%ld' ms", clnt_time);
 
+	if (workers_num)
+		client_workers_report();
+
 	char client_msg[min_msg_len];
 	int msg_len = min_msg_len;
 
@@ -525,8 +917,19 @@ static void client_run(void)
 
 static void client_cleanup(void)
 {
+	int i, j;
+
 	free(thread_ids);
 
+	for (i = 0; workers && i < workers_num; i++) {
+		for (j = 0; j < workers[i].conns_num; j++) {
+			free(workers[i].conns[j].msg);
+			free(workers[i].conns[j].buf);
+		}
+		free(workers[i].conns);
+	}
+	free(workers);
+
 	if (remote_addrinfo)
 		freeaddrinfo(remote_addrinfo);
 }
@@ -652,6 +1055,55 @@ static pthread_t server_thread_add(intptr_t client_fd)
 	return id;
 }
 
+static int server_socket(void)
+{
+	/* IPv6 socket is also able to access IPv4 protocol stack */
+	int fd = SAFE_SOCKET(family, sock_type, protocol);
+
+	SAFE_SETSOCKOPT_INT(fd, SOL_SOCKET, SO_REUSEADDR, 1);
+	if (reuse_port || workers_num)
+		SAFE_SETSOCKOPT_INT(fd, SOL_SOCKET, SO_REUSEPORT, 1);
+
+	SAFE_BIND(fd, local_addrinfo->ai_addr, local_addrinfo->ai_addrlen);
+
+	return fd;
+}
+
+static void server_listen(int fd)
+{
+	init_socket_opts(fd);
+
+	if (fastopen_api || fastopen_sapi) {
+		SAFE_SETSOCKOPT_INT(fd, IPPROTO_TCP, TCP_FASTOPEN,
+			tfo_queue_size);
+	}
+
+	if (zcopy)
+		SAFE_SETSOCKOPT_INT(fd, SOL_SOCKET, SO_ZEROCOPY, 1);
+
+	SAFE_LISTEN(fd, max_queue_len);
+}
+
+static void server_init_workers(int port)
+{
+	struct sockaddr_in6 *addr = (struct sockaddr_in6 *)local_addrinfo->ai_addr;
+	int i;
+
+	workers = SAFE_MALLOC(sizeof(*workers) * workers_num);
+	memset(workers, 0, sizeof(*workers) * workers_num);
+
+	/* the other listeners join the port of the first one */
+	addr->sin6_port = htons(port);
+	workers[0].lfd = sfd;
+
+	for (i = 1; i < workers_num; i++) {
+		workers[i].lfd = server_socket();
+		server_listen(workers[i].lfd);
+	}
+
+	tst_res(TINFO, "%d workers listen on the port", workers_num);
+}
+
 static void server_init(void)
 {
 	char *src_addr = NULL;
@@ -671,16 +1123,8 @@ static void server_init(void)
 		       &hints, &local_addrinfo);
 	free(src_addr);
 
-	/* IPv6 socket is also able to access IPv4 protocol stack */
-	sfd = SAFE_SOCKET(family, sock_type, protocol);
-	SAFE_SETSOCKOPT_INT(sfd, SOL_SOCKET, SO_REUSEADDR, 1);
-	if (reuse_port)
-		SAFE_SETSOCKOPT_INT(sfd, SOL_SOCKET, SO_REUSEPORT, 1);
-
 	tst_res(TINFO, "assigning a name to the server socket...");
-	SAFE_BIND(sfd, local_addrinfo->ai_addr, local_addrinfo->ai_addrlen);
-
-	freeaddrinfo(local_addrinfo);
+	sfd = server_socket();
 
 	int port = TST_GETSOCKPORT(sfd);
 
@@ -690,27 +1134,29 @@ static void server_init(void)
 		SAFE_FILE_PRINTF(port_path, "%d", port);
 	}
 
-	if (sock_type == SOCK_DGRAM)
+	if (sock_type == SOCK_DGRAM) {
+		freeaddrinfo(local_addrinfo);
 		return;
-
-	init_socket_opts(sfd);
-
-	if (fastopen_api || fastopen_sapi) {
-		SAFE_SETSOCKOPT_INT(sfd, IPPROTO_TCP, TCP_FASTOPEN,
-			tfo_queue_size);
 	}
 
-	if (zcopy)
-		SAFE_SETSOCKOPT_INT(sfd, SOL_SOCKET, SO_ZEROCOPY, 1);
-
-	SAFE_LISTEN(sfd, max_queue_len);
+	server_listen(sfd);
 
 	tst_res(TINFO, "Listen on the socket '%d'", sfd);
+
+	if (workers_num)
+		server_init_workers(port);
+
+	freeaddrinfo(local_addrinfo);
 }
 
 static void server_cleanup(void)
 {
+	int i;
+
 	SAFE_CLOSE(sfd);
+
+	for (i = 1; workers && i < workers_num; i++)
+		SAFE_CLOSE(workers[i].lfd);
 }
 
 static void move_to_background(void)
@@ -771,6 +1217,264 @@ static void server_run(void)
 	}
 }
 
+struct server_conn {
+	struct tst_epoll_event_data ev_data;
+	struct net_worker *w;
+	int fd;
+	int num_requests;
+	int offset;
+	int buf_len;
+	char *buf;
+	int send_len;
+	int send_off;
+	uint32_t events;
+};
+
+static void server_workers_report(void)
+{
+	struct net_worker *w;
+	struct timespec now;
+	long long time_us;
+	unsigned long requests;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+
+	for (i = 0; i < workers_num; i++) {
+		w = &workers[i];
+		requests = __atomic_load_n(&w->requests, __ATOMIC_RELAXED);
+		time_us = MAX(tst_timespec_diff_us(now, w->start), 1LL);
+
+		tst_res(TINFO, "worker %d: %lu conns, %lu requests, %.0f req/s",
+			i, __atomic_load_n(&w->conns_cnt, __ATOMIC_RELAXED),
+			requests, requests * 1e6 / time_us);
+	}
+}
+
+static void server_conn_events(struct server_conn *c, uint32_t events)
+{
+	struct epoll_event ev = {
+		.events = events,
+		.data.ptr = &c->ev_data,
+	};
+
+	if (c->events == events)
+		return;
+
+	SAFE_EPOLL_CTL(c->w->efd, c->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+		       c->fd, &ev);
+	c->events = events;
+}
+
+static void server_conn_close(struct server_conn *c)
+{
+	SAFE_CLOSE(c->fd);
+	free(c->buf);
+	free(c);
+}
+
+/*
+ * Sends the rest of the reply, returns 1 once it's complete. The workers
+ * reply from a buffer filled with server_byte, only the first and the last
+ * byte differ per request. MSG_ZEROCOPY is not used as the buffer is shared.
+ */
+static int server_conn_flush(struct server_conn *c)
+{
+	char *reply = c->w->reply;
+	ssize_t ret;
+
+	reply[0] = (c->num_requests >= server_max_requests) ?
+		   start_fin_byte : start_byte;
+	reply[c->send_len - 1] = end_byte;
+
+	ret = send(c->fd, reply + c->send_off, c->send_len - c->send_off,
+		   send_flags & ~MSG_ZEROCOPY);
+
+	reply[c->send_len - 1] = server_byte;
+
+	if (ret == -1) {
+		if (errno == EAGAIN)
+			return 0;
+		tst_brk(TBROK | TERRNO, "send failed, sock '%d'", c->fd);
+	}
+
+	c->send_off += ret;
+
+	return c->send_off == c->send_len;
+}
+
+/* reply is sent, returns 1 if the connection was closed */
+static int server_conn_sent(struct server_conn *c)
+{
+	c->send_len = 0;
+
+	if (c->num_requests >= server_max_requests) {
+		/* max reqs, close socket */
+		shutdown(c->fd, SHUT_WR);
+		server_conn_close(c);
+		return 1;
+	}
+
+	server_conn_events(c, EPOLLIN);
+
+	return 0;
+}
+
+static int server_conn_event(void *self, LTP_ATTRIBUTE_UNUSED uint32_t events)
+{
+	struct server_conn *c = self;
+	ssize_t recv_len;
+
+	if (c->send_len) {
+		if (!server_conn_flush(c) || server_conn_sent(c))
+			return 0;
+	}
+
+	while (1) {
+		if (c->offset == c->buf_len) {
+			if (c->buf_len == max_msg_len) {
+				tst_res(TFAIL, "recv failed, sock '%d'", c->fd);
+				break;
+			}
+			c->buf_len = MIN(c->buf_len * 2, max_msg_len);
+			c->buf = SAFE_REALLOC(c->buf, c->buf_len);
+		}
+
+		recv_len = recv(c->fd, c->buf + c->offset,
+				c->buf_len - c->offset, MSG_DONTWAIT);
+
+		if (recv_len == -1 && errno == EAGAIN)
+			return 0;
+
+		if (recv_len == -1 && errno == EINTR)
+			continue;
+
+		if (recv_len == 0) {
+			server_conn_close(c);
+			return 0;
+		}
+
+		if (recv_len < 0 || (c->buf[0] != start_byte &&
+		    c->buf[0] != start_fin_byte)) {
+			tst_res(TFAIL, "recv failed, sock '%d'", c->fd);
+			break;
+		}
+
+		c->offset += recv_len;
+
+		if (c->buf[c->offset - 1] != end_byte) {
+			/* msg is not complete, continue recv */
+			continue;
+		}
+
+		/* client asks to terminate */
+		if (c->buf[0] == start_fin_byte) {
+			server_workers_report();
+			break;
+		}
+
+		c->send_len = parse_client_request(c->buf);
+		if (c->send_len < 0) {
+			tst_res(TFAIL, "wrong msg size '%d'", c->send_len);
+			break;
+		}
+
+		c->offset = 0;
+		c->send_off = 0;
+		c->num_requests++;
+		__atomic_add_fetch(&c->w->requests, 1, __ATOMIC_RELAXED);
+
+		if (!server_conn_flush(c)) {
+			server_conn_events(c, EPOLLOUT);
+			return 0;
+		}
+
+		if (server_conn_sent(c))
+			return 0;
+	}
+
+	server_conn_close(c);
+	tst_brk(TBROK, "Server closed");
+	return 0;
+}
+
+static int server_accept_event(void *self, LTP_ATTRIBUTE_UNUSED uint32_t events)
+{
+	struct net_worker *w = self;
+	struct server_conn *c;
+	int fd;
+
+	while (1) {
+		fd = accept4(w->lfd, NULL, NULL, SOCK_NONBLOCK);
+		if (fd == -1) {
+			if (errno == EAGAIN)
+				return 0;
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			tst_brk(TBROK | TERRNO, "Can't create client socket");
+		}
+
+		if (!__atomic_fetch_add(&w->conns_cnt, 1, __ATOMIC_RELAXED))
+			clock_gettime(CLOCK_MONOTONIC_RAW, &w->start);
+
+		c = SAFE_MALLOC(sizeof(*c));
+		memset(c, 0, sizeof(*c));
+		c->ev_data.on_epoll = server_conn_event;
+		c->ev_data.self = c;
+		c->w = w;
+		c->fd = fd;
+		c->buf_len = 1024;
+		c->buf = SAFE_MALLOC(c->buf_len);
+
+		init_socket_opts(fd);
+		server_conn_events(c, EPOLLIN);
+	}
+}
+
+static void *server_worker_fn(void *arg)
+{
+	struct net_worker *w = arg;
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.ptr = &w->accept_data,
+	};
+	int flags;
+
+	worker_pin(w);
+
+	w->efd = SAFE_EPOLL_CREATE1(0);
+	w->accept_data.on_epoll = server_accept_event;
+	w->accept_data.self = w;
+	w->reply = SAFE_MALLOC(max_msg_len);
+	memset(w->reply, server_byte, max_msg_len);
+
+	flags = SAFE_FCNTL(w->lfd, F_GETFL);
+	SAFE_FCNTL(w->lfd, F_SETFL, flags | O_NONBLOCK);
+	SAFE_EPOLL_CTL(w->efd, EPOLL_CTL_ADD, w->lfd, &ev);
+
+	while (1)
+		worker_loop(w, -1);
+
+	return NULL;
+}
+
+static void server_run_workers(void)
+{
+	int i;
+
+	if (server_bg)
+		move_to_background();
+
+	for (i = 0; i < workers_num; i++) {
+		workers[i].num = i;
+		SAFE_PTHREAD_CREATE(&workers[i].id, &attr, server_worker_fn,
+				    &workers[i]);
+	}
+
+	for (i = 0; i < workers_num; i++)
+		SAFE_PTHREAD_JOIN(workers[i].id, NULL);
+}
+
 static void require_root(const char *file)
 {
 	if (!geteuid())
@@ -869,6 +1573,11 @@ static void setup(void)
 		tst_brk(TBROK, "Invalid net.ipv4.tcp_fastopen '%s'", targ);
 	if (tst_parse_int(Aarg, &max_rand_msg_len, 10, max_msg_len))
 		tst_brk(TBROK, "Invalid max random payload size '%s'", Aarg);
+	if (tst_parse_int(warg, &workers_num, 0, MAX_THREADS))
+		tst_brk(TBROK, "Invalid number of workers '%s'", warg);
+
+	if (warg && !workers_num)
+		workers_num = tst_ncpus_available();
 
 	if (!server_addr)
 		server_addr = "localhost";
@@ -889,6 +1598,9 @@ static void setup(void)
 
 	set_protocol_type();
 
+	if (workers_num && proto_type != TYPE_TCP)
+		tst_brk(TCONF, "Workers are supported only with TCP");
+
 	if (client_mode) {
 		if (source_addr && tst_kvercmp(4, 2, 0) >= 0) {
 			bind_no_port = 1;
@@ -898,6 +1610,10 @@ static void setup(void)
 			server_addr, tcp_port);
 		tst_res(TINFO, "client max req: %d", client_max_requests);
 		tst_res(TINFO, "clients num: %d", clients_num);
+		if (workers_num) {
+			workers_num = MIN(workers_num, clients_num);
+			tst_res(TINFO, "epoll workers: %d", workers_num);
+		}
 		if (max_rand_msg_len) {
 			tst_res(TINFO, "random msg size [%d %d]",
 				min_msg_len, max_rand_msg_len);
@@ -929,7 +1645,7 @@ static void setup(void)
 		case TYPE_TCP:
 		case TYPE_DCCP:
 		case TYPE_SCTP:
-			net.run		= server_run;
+			net.run		= workers_num ? server_run_workers : server_run;
 			net.cleanup	= server_cleanup;
 		break;
 		case TYPE_UDP:
@@ -1010,6 +1726,7 @@ static struct tst_test test = {
 		{"T:", &type, "Tcp (default), udp, udp_lite, dccp, sctp"},
 		{"z", &zcopy, "Enable SO_ZEROCOPY"},
 		{"P:", &reuse_port, "Enable SO_REUSEPORT"},
+		{"w:", &warg, "Number of epoll workers (TCP), 0 is one per CPU"},
 		{"d:", &dev, "Bind to device x"},
 
 		{"H:", &server_addr, "Server name or IP address"},
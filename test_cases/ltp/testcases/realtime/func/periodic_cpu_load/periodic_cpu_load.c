@@ -63,8 +63,8 @@
 //#define PASS_US 100
 
 int fail[THREADS_PER_GROUP * NUM_GROUPS];
-stats_container_t dat[THREADS_PER_GROUP * NUM_GROUPS];
-stats_record_t rec;
+stats_stream_t dat[THREADS_PER_GROUP * NUM_GROUPS];
+stats_stream_t all;
 stats_quantiles_t quantiles[THREADS_PER_GROUP * NUM_GROUPS];
 static const char groupname[NUM_GROUPS] = "ABC";
 
@@ -141,9 +141,7 @@ void *periodic_thread(void *thread)
 		func(parg->arg);
 		exe_end = rt_gettime();
 		exe_time = exe_end - exe_start;
-		rec.x = i;
-		rec.y = exe_time / NS_PER_US;
-		stats_container_append(&dat[t->id], rec);
+		stats_stream_record(&dat[t->id], exe_time / NS_PER_US);
 
 		i++;
 
@@ -194,10 +192,14 @@ int main(int argc, char *argv[])
 	printf("  period: %d ms\n", PERIOD_C / NS_PER_MS);
 	printf("\n");
 
+	/* each thread records into its own stream, merged when reporting */
 	for (i = 0; i < (THREADS_PER_GROUP * NUM_GROUPS); i++) {
-		stats_container_init(&dat[i], iterations);
+		if (stats_stream_init(&dat[i]))
+			exit(1);
 		stats_quantiles_init(&quantiles[i], (int)log10(iterations));
 	}
+	if (stats_stream_init(&all))
+		exit(1);
 
 	struct periodic_arg parg_a =
 	    { PERIOD_A, iterations, calc, (void *)CALC_LOOPS_A };
@@ -213,18 +215,21 @@ int main(int argc, char *argv[])
 	for (i = 0; i < THREADS_PER_GROUP; i++)
 		create_fifo_thread(periodic_thread, (void *)&parg_c, PRIO_C);
 
+	stats_stream_dump_start(dat, THREADS_PER_GROUP * NUM_GROUPS,
+				"periodic_cpu_load");
 	join_threads();
+	stats_stream_dump_stop();
 
 	printf("\nExecution Time Statistics:\n\n");
 
 	for (i = 0; i < (THREADS_PER_GROUP * NUM_GROUPS); i++) {
 		printf("TID %d (%c)\n", i, groupname[i >> 2]);
-		printf("  Min: %ld us\n", stats_min(&dat[i]));
-		printf("  Max: %ld us\n", stats_max(&dat[i]));
-		printf("  Avg: %f us\n", stats_avg(&dat[i]));
-		printf("  StdDev: %f us\n\n", stats_stddev(&dat[i]));
+		printf("  Min: %ld us\n", stats_stream_min(&dat[i]));
+		printf("  Max: %ld us\n", stats_stream_max(&dat[i]));
+		printf("  Avg: %f us\n", stats_stream_avg(&dat[i]));
+		printf("  StdDev: %f us\n\n", stats_stream_stddev(&dat[i]));
 		printf("  Quantiles:\n");
-		stats_quantiles_calc(&dat[i], &quantiles[i]);
+		stats_stream_quantiles_calc(&dat[i], &quantiles[i]);
 		stats_quantiles_print(&quantiles[i]);
 		printf("Criteria: TID %d did not miss a period\n", i);
 		printf("Result: %s\n", fail[i] ? "FAIL" : "PASS");
@@ -232,16 +237,25 @@ int main(int argc, char *argv[])
 
 		if (fail[i])
 			ret = 1;
+
+		stats_stream_merge(&all, &dat[i]);
 	}
 
+	printf("All threads\n");
+	printf("  Min: %ld us\n", stats_stream_min(&all));
+	printf("  Max: %ld us\n", stats_stream_max(&all));
+	printf("  Avg: %f us\n", stats_stream_avg(&all));
+	printf("  StdDev: %f us\n\n", stats_stream_stddev(&all));
+
 	// FIXME: define pass criteria
 	// printf("\nCriteria: latencies < %d us\n", PASS_US);
 	// printf("Result: %s\n", ret ? "FAIL" : "PASS");
 
 	for (i = 0; i < (THREADS_PER_GROUP * NUM_GROUPS); i++) {
-		stats_container_free(&dat[i]);
+		stats_stream_free(&dat[i]);
 		stats_quantiles_free(&quantiles[i]);
 	}
+	stats_stream_free(&all);
 
 	return ret;
 }
@@ -72,6 +72,7 @@ static nsec_t period = DEF_PERIOD;
 static unsigned int load_ms = DEF_LOAD_MS;
 
 stats_container_t dat;
+stats_stream_t stream;
 stats_container_t hist;
 stats_quantiles_t quantiles;
 stats_record_t rec;
@@ -137,6 +138,7 @@ void *periodic_thread(void *arg)
 		latency_trace_enable();
 		latency_trace_start();
 	}
+	stats_stream_dump_start(&stream, 1, "sched_latency");
 	for (i = 0; i < iterations; i++) {
 		/* wait for the period to start */
 		next += period;
@@ -177,9 +179,12 @@ void *periodic_thread(void *arg)
 		/* start of period */
 		delay =
 		    (now - iter_start - (nsec_t) (i + 1) * period) / NS_PER_US;
-		rec.x = i;
-		rec.y = delay;
-		stats_container_append(&dat, rec);
+		stats_stream_record(&stream, delay);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = delay;
+			stats_container_append(&dat, rec);
+		}
 
 		if (delay < min_delay)
 			min_delay = delay;
@@ -200,6 +205,7 @@ void *periodic_thread(void *arg)
 
 		busy_work_ms(load_ms);
 	}
+	stats_stream_dump_stop();
 	if (latency_threshold) {
 		latency_trace_stop();
 		if (i != iterations) {
@@ -207,12 +213,12 @@ void *periodic_thread(void *arg)
 			    ("Latency threshold (%lluus) exceeded at iteration %d\n",
 			     latency_threshold, i);
 			latency_trace_print();
-			stats_container_resize(&dat, i + 1);
+			if (save_stats)
+				stats_container_resize(&dat, i + 1);
 		}
 	}
 
-	/* save samples before the quantile calculation messes things up! */
-	stats_hist(&hist, &dat);
+	stats_stream_hist(&hist, &stream);
 	stats_container_save("samples",
 			     "Periodic Scheduling Latency Scatter Plot",
 			     "Iteration", "Latency (us)", &dat, "points");
@@ -229,9 +235,9 @@ void *periodic_thread(void *arg)
 	       max_delay < pass_criteria ? "PASS" : "FAIL");
 	printf("Avg:   %4llu us: %s\n", avg_delay,
 	       avg_delay < pass_criteria ? "PASS" : "FAIL");
-	printf("StdDev: %.4f us\n", stats_stddev(&dat));
+	printf("StdDev: %.4f us\n", stats_stream_stddev(&stream));
 	printf("Quantiles:\n");
-	stats_quantiles_calc(&dat, &quantiles);
+	stats_stream_quantiles_calc(&stream, &quantiles);
 	stats_quantiles_print(&quantiles);
 	printf("Failed Iterations: %d\n", failures);
 
@@ -271,10 +277,17 @@ int main(int argc, char *argv[])
 	printf("Expected running time: %d s\n",
 	       (int)(iterations * ((float)period / NS_PER_SEC)));
 
-	if (stats_container_init(&dat, iterations))
+	/* the samples are only kept for the scatter plot */
+	if (save_stats && stats_container_init(&dat, iterations))
 		exit(1);
 
+	if (stats_stream_init(&stream)) {
+		stats_container_free(&dat);
+		exit(1);
+	}
+
 	if (stats_container_init(&hist, HIST_BUCKETS)) {
+		stats_stream_free(&stream);
 		stats_container_free(&dat);
 		exit(1);
 	}
@@ -282,6 +295,7 @@ int main(int argc, char *argv[])
 	/* use the highest value for the quantiles */
 	if (stats_quantiles_init(&quantiles, (int)log10(iterations))) {
 		stats_container_free(&hist);
+		stats_stream_free(&stream);
 		stats_container_free(&dat);
 		exit(1);
 	}
@@ -297,6 +311,7 @@ int main(int argc, char *argv[])
 	printf("Result: %s\n", ret ? "FAIL" : "PASS");
 
 	stats_container_free(&dat);
+	stats_stream_free(&stream);
 	stats_container_free(&hist);
 	stats_quantiles_free(&quantiles);
 
@@ -72,7 +72,27 @@ typedef struct stats_quantiles {
 	long *quantiles;
 } stats_quantiles_t;
 
+/*
+ * Log-linear histogram used as a constant memory replacement for a
+ * stats_container_t holding every sample. Values below 2^STATS_STREAM_SUB_BITS
+ * are counted exactly, larger values with a relative error below
+ * 2^-(STATS_STREAM_SUB_BITS - 1).
+ */
+#define STATS_STREAM_SUB_BITS	8
+#define STATS_STREAM_SUB_CNT	(1 << (STATS_STREAM_SUB_BITS - 1))
+#define STATS_STREAM_BUCKETS	((66 - STATS_STREAM_SUB_BITS) * STATS_STREAM_SUB_CNT)
+
+typedef struct stats_stream {
+	long count;
+	long min;
+	long max;
+	double sum;
+	double sumsq;
+	long *buckets;
+} stats_stream_t;
+
 extern int save_stats;
+extern int stats_dump_ms;
 
 /* function prototypes */
 
@@ -170,4 +190,71 @@ int stats_container_save(char *filename, char *title, char *labelx, char *labely
  * Returns the index of the appended record on success and -1 on error
  */
 int stats_container_append(stats_container_t *data, stats_record_t rec);
+
+/* stats_stream_init - allocate an empty streaming histogram
+ * data: stats_stream_t destination pointer
+ */
+int stats_stream_init(stats_stream_t *data);
+
+/* stats_stream_free - free the histogram buckets
+ * data: stats_stream_t to free
+ */
+int stats_stream_free(stats_stream_t *data);
+
+/* stats_stream_record - add a sample to data
+ * data: stats_stream_t owned by the calling thread. Recording takes no locks,
+ *       each recording thread should use its own stream and the streams are
+ *       combined with stats_stream_merge() at the end of the run.
+ * y: the sample value, negative values are counted as 0
+ */
+void stats_stream_record(stats_stream_t *data, long y);
+
+/* stats_stream_merge - add the samples of src to dst
+ * dst: stats_stream_t accumulating the result
+ * src: stats_stream_t to merge, may be recorded to concurrently
+ */
+int stats_stream_merge(stats_stream_t *dst, stats_stream_t *src);
+
+/* stats_stream_reset - drop all samples from data
+ * data: stats_stream_t to reset
+ */
+void stats_stream_reset(stats_stream_t *data);
+
+/* stats_stream_stddev, stats_stream_avg, stats_stream_min, stats_stream_max -
+ * the stats_stream_t equivalents of stats_stddev() etc.
+ * data: stats_stream_t with samples for use in the calculation
+ */
+float stats_stream_stddev(stats_stream_t *data);
+float stats_stream_avg(stats_stream_t *data);
+long stats_stream_min(stats_stream_t *data);
+long stats_stream_max(stats_stream_t *data);
+
+/* stats_stream_quantiles_calc - calculate the quantiles of the supplied stream
+ * data: stats_stream_t with samples for use in the calculation
+ * quantiles: stats_quantiles_t structure for storing the results, each
+ *            quantile is the upper bound of the bucket it falls into
+ */
+int stats_stream_quantiles_calc(stats_stream_t *data,
+				stats_quantiles_t *quantiles);
+
+/* stats_stream_hist - calculate a histogram with hist->size divisions from data
+ * hist: the destination of the histogram data, suitable for
+ *       stats_hist_print() and stats_container_save()
+ * data: the source from which to calculate the histogram
+ */
+int stats_stream_hist(stats_container_t *hist, stats_stream_t *data);
+
+/* stats_stream_dump_start - start printing a summary of the streams every
+ * stats_dump_ms milliseconds (librttest option -o), does nothing when
+ * stats_dump_ms is 0. If save_stats is set the histogram is saved to
+ * <name>-hist.dat as well.
+ * streams: array of per-thread streams being recorded
+ * nr_streams: number of streams in the array
+ * name: prefix for the output
+ */
+int stats_stream_dump_start(stats_stream_t *streams, int nr_streams,
+			    char *name);
+
+/* stats_stream_dump_stop - stop the periodic dump started above */
+void stats_stream_dump_stop(void);
 #endif /* LIBSTAT_H */
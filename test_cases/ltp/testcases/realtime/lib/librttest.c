@@ -85,6 +85,7 @@ void rt_help(void)
 	    ("  -v[0-4]	0:no debug, 1:DBG_ERR, 2:DBG_WARN, 3:DBG_INFO, 4:DBG_DEBUG\n");
 	printf("  -s		Enable saving stats data (default disabled)\n");
 	printf("  -c		Set pass criteria\n");
+	printf("  -oINTERVAL	Print latency statistics every INTERVAL ms\n");
 }
 
 /* Calibrate the busy work loop */
@@ -115,7 +116,7 @@ int rt_init_long(const char *options, const struct option *longopts,
 	int mlock = 0;
 	char *all_options;
 
-	if (asprintf(&all_options, ":b:mp:v:sc:%s", options) == -1) {
+	if (asprintf(&all_options, ":b:mp:v:sc:o:%s", options) == -1) {
 		fprintf(stderr,
 			"Failed to allocate string for option string\n");
 		exit(1);
@@ -186,6 +187,9 @@ int rt_init_long(const char *options, const struct option *longopts,
 		case 's':
 			save_stats = 1;
 			break;
+		case 'o':
+			stats_dump_ms = atoi(optarg);
+			break;
 		case ':':
 			if (optopt == '-')
 				fprintf(stderr, "long option missing arg\n");
@@ -43,8 +43,11 @@
 #include <errno.h>
 #include <unistd.h>
 #include <math.h>
+#include <pthread.h>
+#include <time.h>
 #include <libstats.h>
 #include <librttest.h>
+#include "tst_common.h"
 
 #include "../include/realtime_config.h"
 
@@ -53,6 +56,7 @@
 #endif
 
 int save_stats = 0;
+int stats_dump_ms = 0;
 
 /* static helper functions */
 static int stats_record_compare(const void *a, const void *b)
@@ -371,3 +375,356 @@ int stats_container_save(char *filename, char *title, char *xlabel,
 
 	return 0;
 }
+
+/*
+ * The streams are written by a single thread each and may be read by the dump
+ * thread at the same time, relaxed atomic accesses keep both sides lock free.
+ * The count is published last with release semantics so that a reader which
+ * acquires it sees at least as many samples in the buckets.
+ */
+#define STREAM_LOAD(p)		__atomic_load_n(p, __ATOMIC_RELAXED)
+#define STREAM_STORE(p, v)	__atomic_store_n(p, v, __ATOMIC_RELAXED)
+
+static double stream_load_double(double *p)
+{
+	double v;
+
+	__atomic_load(p, &v, __ATOMIC_RELAXED);
+	return v;
+}
+
+static void stream_store_double(double *p, double v)
+{
+	__atomic_store(p, &v, __ATOMIC_RELAXED);
+}
+
+static int stream_idx(unsigned long y)
+{
+	int shift;
+
+	if (y < 2 * STATS_STREAM_SUB_CNT)
+		return y;
+
+	shift = 63 - __builtin_clzl(y) - (STATS_STREAM_SUB_BITS - 1);
+
+	return shift * STATS_STREAM_SUB_CNT + (y >> shift);
+}
+
+static int stream_shift(int idx)
+{
+	return MAX(idx / STATS_STREAM_SUB_CNT - 1, 0);
+}
+
+static long stream_low(int idx)
+{
+	int shift = stream_shift(idx);
+
+	return (long)(idx - shift * STATS_STREAM_SUB_CNT) << shift;
+}
+
+static long stream_high(int idx)
+{
+	return stream_low(idx) + (1L << stream_shift(idx)) - 1;
+}
+
+int stats_stream_init(stats_stream_t * data)
+{
+	data->buckets = calloc(STATS_STREAM_BUCKETS, sizeof(long));
+	if (!data->buckets)
+		return -1;
+	stats_stream_reset(data);
+	return 0;
+}
+
+int stats_stream_free(stats_stream_t * data)
+{
+	free(data->buckets);
+	return 0;
+}
+
+void stats_stream_reset(stats_stream_t * data)
+{
+	memset(data->buckets, 0, STATS_STREAM_BUCKETS * sizeof(long));
+	data->count = 0;
+	data->min = 0;
+	data->max = 0;
+	data->sum = 0.0;
+	data->sumsq = 0.0;
+}
+
+void stats_stream_record(stats_stream_t * data, long y)
+{
+	long *bucket = &data->buckets[stream_idx(MAX(y, 0))];
+
+	if (!data->count || y < data->min)
+		STREAM_STORE(&data->min, y);
+	if (!data->count || y > data->max)
+		STREAM_STORE(&data->max, y);
+
+	stream_store_double(&data->sum, data->sum + y);
+	stream_store_double(&data->sumsq, data->sumsq + (double)y * y);
+	STREAM_STORE(bucket, *bucket + 1);
+	__atomic_store_n(&data->count, data->count + 1, __ATOMIC_RELEASE);
+}
+
+int stats_stream_merge(stats_stream_t * dst, stats_stream_t * src)
+{
+	long count, min, max;
+	int i;
+
+	count = __atomic_load_n(&src->count, __ATOMIC_ACQUIRE);
+	if (!count)
+		return 0;
+
+	min = STREAM_LOAD(&src->min);
+	max = STREAM_LOAD(&src->max);
+
+	for (i = 0; i < STATS_STREAM_BUCKETS; i++)
+		dst->buckets[i] += STREAM_LOAD(&src->buckets[i]);
+
+	if (!dst->count || min < dst->min)
+		dst->min = min;
+	if (!dst->count || max > dst->max)
+		dst->max = max;
+
+	dst->count += count;
+	dst->sum += stream_load_double(&src->sum);
+	dst->sumsq += stream_load_double(&src->sumsq);
+
+	return 0;
+}
+
+float stats_stream_stddev(stats_stream_t * data)
+{
+	double avg, var;
+
+	if (!data->count)
+		return 0.0;
+
+	avg = data->sum / data->count;
+	var = data->sumsq / data->count - avg * avg;
+
+	return var > 0 ? sqrt(var) : 0.0;
+}
+
+float stats_stream_avg(stats_stream_t * data)
+{
+	if (!data->count)
+		return 0.0;
+
+	return data->sum / data->count;
+}
+
+long stats_stream_min(stats_stream_t * data)
+{
+	return data->min;
+}
+
+long stats_stream_max(stats_stream_t * data)
+{
+	return data->max;
+}
+
+int stats_stream_quantiles_calc(stats_stream_t * data,
+				stats_quantiles_t * quantiles)
+{
+	int i, b;
+	long index, sum;
+
+	// check for sufficient data size of accurate calculation
+	if (!data->count || data->count < (long)exp10(quantiles->nines))
+		return -1;
+
+	/* same ranks as stats_quantiles_calc() picks from the sorted records */
+	for (i = 2, b = 0, sum = 0; i <= quantiles->nines; i++) {
+		index = data->count - data->count / exp10(i);
+
+		while (b < STATS_STREAM_BUCKETS - 1 &&
+		       sum + data->buckets[b] <= index)
+			sum += data->buckets[b++];
+
+		quantiles->quantiles[i - 2] = MIN(stream_high(b), data->max);
+	}
+
+	return 0;
+}
+
+int stats_stream_hist(stats_container_t * hist, stats_stream_t * data)
+{
+	int i;
+	long width, y, b;
+
+	if (hist->size <= 0 || !data->count)
+		return -1;
+
+	/* define the bucket ranges */
+	width = MAX((data->max - data->min) / hist->size, 1);
+	for (i = 0; i < hist->size; i++) {
+		hist->records[i].x = data->min + i * width;
+		hist->records[i].y = 0;
+	}
+
+	/* fill in the counts, each bucket is accounted by its midpoint */
+	for (i = 0; i < STATS_STREAM_BUCKETS; i++) {
+		if (!data->buckets[i])
+			continue;
+
+		y = (stream_low(i) + stream_high(i)) / 2;
+		y = MIN(MAX(y, data->min), data->max);
+		b = MIN((y - data->min) / width, hist->size - 1);
+		hist->records[b].y += data->buckets[i];
+	}
+
+	return 0;
+}
+
+static struct stream_dump {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+	stats_stream_t *streams;
+	int nr_streams;
+	char *name;
+} dump = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void stream_dump(stats_stream_t *snap, stats_container_t *hist,
+			long elapsed_ms)
+{
+	char *filename;
+	long p99 = 0, p999 = 0;
+	long nines[2];
+	stats_quantiles_t quantiles = { .nines = 3, .quantiles = nines };
+	int i;
+
+	stats_stream_reset(snap);
+	for (i = 0; i < dump.nr_streams; i++)
+		stats_stream_merge(snap, &dump.streams[i]);
+
+	if (!stats_stream_quantiles_calc(snap, &quantiles)) {
+		p99 = nines[0];
+		p999 = nines[1];
+	}
+
+	printf("%s %ld.%03lds: samples %ld min %ld avg %.2f 99%% %ld 99.9%% %ld max %ld\n",
+	       dump.name, elapsed_ms / 1000, elapsed_ms % 1000, snap->count,
+	       snap->min, stats_stream_avg(snap), p99, p999, snap->max);
+	fflush(stdout);
+
+	if (!save_stats || stats_stream_hist(hist, snap))
+		return;
+
+	if (asprintf(&filename, "%s-hist", dump.name) == -1)
+		return;
+
+	stats_container_save(filename, dump.name, "Value", "Samples", hist,
+			     "steps");
+	free(filename);
+}
+
+static void *stream_dump_thread(void *arg LTP_ATTRIBUTE_UNUSED)
+{
+	stats_stream_t snap;
+	stats_container_t hist;
+	struct timespec start, now, next;
+	long elapsed_ms;
+
+	if (stats_stream_init(&snap))
+		return NULL;
+
+	if (stats_container_init(&hist, 100)) {
+		stats_stream_free(&snap);
+		return NULL;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	next = start;
+
+	pthread_mutex_lock(&dump.lock);
+	while (!dump.stop) {
+		next.tv_sec += stats_dump_ms / 1000;
+		next.tv_nsec += (stats_dump_ms % 1000) * 1000000L;
+		if (next.tv_nsec >= 1000000000L) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+
+		while (!dump.stop &&
+		       pthread_cond_timedwait(&dump.cond, &dump.lock, &next) == 0)
+			;
+
+		if (dump.stop)
+			break;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 +
+			     (now.tv_nsec - start.tv_nsec) / 1000000;
+		stream_dump(&snap, &hist, elapsed_ms);
+	}
+	pthread_mutex_unlock(&dump.lock);
+
+	stats_container_free(&hist);
+	stats_stream_free(&snap);
+
+	return NULL;
+}
+
+int stats_stream_dump_start(stats_stream_t * streams, int nr_streams,
+			    char *name)
+{
+	pthread_condattr_t attr;
+	pthread_attr_t thread_attr;
+	struct sched_param param = { .sched_priority = 0 };
+	int ret;
+
+	if (!stats_dump_ms)
+		return 0;
+
+	dump.streams = streams;
+	dump.nr_streams = nr_streams;
+	dump.name = name;
+	dump.stop = 0;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&dump.cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	/*
+	 * A plain SCHED_OTHER thread so that it does not disturb the test, the
+	 * policy has to be explicit as the caller is often a SCHED_FIFO thread.
+	 */
+	pthread_attr_init(&thread_attr);
+	pthread_attr_setinheritsched(&thread_attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&thread_attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&thread_attr, &param);
+	ret = pthread_create(&dump.thread, &thread_attr, stream_dump_thread,
+			     NULL);
+	pthread_attr_destroy(&thread_attr);
+	if (ret) {
+		fprintf(stderr, "Failed to create stats dump thread: %s\n",
+			strerror(ret));
+		pthread_cond_destroy(&dump.cond);
+		dump.streams = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+void stats_stream_dump_stop(void)
+{
+	if (!dump.streams)
+		return;
+
+	pthread_mutex_lock(&dump.lock);
+	dump.stop = 1;
+	pthread_cond_signal(&dump.cond);
+	pthread_mutex_unlock(&dump.lock);
+
+	pthread_join(dump.thread, NULL);
+	pthread_cond_destroy(&dump.cond);
+	dump.streams = NULL;
+}
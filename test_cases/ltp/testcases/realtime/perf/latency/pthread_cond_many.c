@@ -187,14 +187,13 @@ void test_signal(long iter, long nthreads)
 {
 	int i;
 	int j;
-	int k;
 	pthread_t *pt;
-	unsigned long max = 0;
-	unsigned long min = 0;
-	stats_container_t dat;
-	stats_record_t rec;
+	stats_stream_t dat;
 
-	stats_container_init(&dat, iter * nthreads);
+	if (stats_stream_init(&dat)) {
+		fprintf(stderr, "Out of memory\n");
+		exit(-1);
+	}
 
 	pt = malloc(sizeof(*pt) * nthreads);
 	if (pt == NULL) {
@@ -205,17 +204,19 @@ void test_signal(long iter, long nthreads)
 		child_waiting[j] = 0;
 		pt[j] = create_thread_(j);
 	}
-	for (i = 0; i < (iter - 1) * nthreads; i += nthreads) {
-		for (j = 0, k = i; j < nthreads; j++, k++) {
+	stats_stream_dump_start(&dat, 1, "pthread_cond_many");
+	for (i = 0; i < iter - 1; i++) {
+		for (j = 0; j < nthreads; j++) {
 			wake_child(j, broadcast_flag);
-			rec.x = k;
-			rec.y = latency;
-			stats_container_append(&dat, rec);
+			stats_stream_record(&dat, latency);
+			if (latency > PASS_US)
+				fail = 1;
 			pthread_mutex_lock(&child_mutex);
 			child_waiting[j] = 0;
 			pthread_mutex_unlock(&child_mutex);
 		}
 	}
+	stats_stream_dump_stop();
 	for (j = 0; j < nthreads; j++) {
 		wake_child(j, broadcast_flag);
 		pthread_mutex_lock(&child_mutex);
@@ -227,19 +228,13 @@ void test_signal(long iter, long nthreads)
 			exit(-1);
 		}
 	}
-	min = (unsigned long)-1;
-	for (i = 0; i < iter * nthreads; i++) {
-		latency = dat.records[i].y;
-		if (latency > PASS_US)
-			fail = 1;
-		min = MIN(min, latency);
-		max = MAX(max, latency);
-	}
 	printf("Recording statistics...\n");
-	printf("Minimum: %lu us\n", min);
-	printf("Maximum: %lu us\n", max);
-	printf("Average: %f us\n", stats_avg(&dat));
-	printf("Standard Deviation: %f\n", stats_stddev(&dat));
+	printf("Minimum: %ld us\n", stats_stream_min(&dat));
+	printf("Maximum: %ld us\n", stats_stream_max(&dat));
+	printf("Average: %f us\n", stats_stream_avg(&dat));
+	printf("Standard Deviation: %f\n", stats_stream_stddev(&dat));
+	stats_stream_free(&dat);
+	free(pt);
 }
 
 void usage(void)
@@ -57,6 +57,13 @@
  * to increase coverage between packets sent. SEED 1 further chooses a
  * different seed for each run (and logs this for reproducibility). It
  * is advised to enable this for extra coverage in continuous testing.
+ *
+ * Argument '-b $NUM' runs locally without sending: it cross-checks the
+ * checksum variants in csum_lib.h against the reference, reports their
+ * throughput, then builds and verifies $NUM packets and reports the
+ * packet rate. Argument '-c $VARIANT' selects the checksum variant.
+ *
+ * bench:      $CMD -b 1000000 [-r 1] [-c ref|u64|avx2|neon]
  */
 
 #define _GNU_SOURCE
@@ -92,8 +99,11 @@
 #include <unistd.h>
 
 #include "kselftest.h"
+#include "csum_lib.h"
 
 static bool cfg_bad_csum;
+static unsigned long cfg_bench_nr;
+static const char *cfg_csum_variant;
 static int cfg_family = PF_INET6;
 static int cfg_num_pkt = 4;
 static bool cfg_do_rx = true;
@@ -142,28 +152,19 @@ static unsigned long gettimeofday_ms(void)
 	return (tv.tv_sec * 1000UL) + (tv.tv_usec / 1000UL);
 }
 
-static uint32_t checksum_nofold(char *data, size_t len, uint32_t sum)
+/* xorshift32: with '-b', rand() would dominate the cost of a packet */
+static int bench_rand(void)
 {
-	uint16_t *words = (uint16_t *)data;
-	int i;
+	static uint32_t state;
 
-	for (i = 0; i < len / 2; i++)
-		sum += words[i];
+	if (!state)
+		state = cfg_random_seed ? : 1;
 
-	if (len & 1)
-		sum += ((unsigned char *)data)[len - 1];
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
 
-	return sum;
-}
-
-static uint16_t checksum_fold(void *data, size_t len, uint32_t sum)
-{
-	sum = checksum_nofold(data, len, sum);
-
-	while (sum > 0xFFFF)
-		sum = (sum & 0xFFFF) + (sum >> 16);
-
-	return ~sum;
+	return state & RAND_MAX;
 }
 
 static uint16_t checksum(void *th, uint16_t proto, size_t len)
@@ -184,6 +185,12 @@ static uint16_t checksum(void *th, uint16_t proto, size_t len)
 		return checksum_fold(th, len, sum);
 }
 
+/* Invert to corrupt, except 0 and 0xFFFF: both encode the same sum */
+static uint16_t corrupt_checksum(uint16_t csum)
+{
+	return csum == 0 || csum == 0xFFFF ? 1 : ~csum;
+}
+
 static void *build_packet_ipv4(void *_iph, uint8_t proto, unsigned int len)
 {
 	struct iphdr *iph = _iph;
@@ -247,9 +254,10 @@ static void *build_packet_udp(void *_uh)
 		uh->check = checksum(uh, IPPROTO_UDP, sizeof(*uh) + cfg_payload_len);
 
 	if (cfg_bad_csum)
-		uh->check = ~uh->check;
+		uh->check = corrupt_checksum(uh->check);
 
-	fprintf(stderr, "tx: sending checksum: 0x%x\n", uh->check);
+	if (!cfg_bench_nr)
+		fprintf(stderr, "tx: sending checksum: 0x%x\n", uh->check);
 	return uh + 1;
 }
 
@@ -265,9 +273,10 @@ static void *build_packet_tcp(void *_th)
 	th->check = checksum(th, IPPROTO_TCP, sizeof(*th) + cfg_payload_len);
 
 	if (cfg_bad_csum)
-		th->check = ~th->check;
+		th->check = corrupt_checksum(th->check);
 
-	fprintf(stderr, "tx: sending checksum: 0x%x\n", th->check);
+	if (!cfg_bench_nr)
+		fprintf(stderr, "tx: sending checksum: 0x%x\n", th->check);
 	return th + 1;
 }
 
@@ -303,7 +312,7 @@ static char *build_packet(char *buf, int max_len, int *len)
 		int i;
 
 		for (i = 0; i < (max_len / sizeof(int)); i++)
-			buf32[i] = rand();
+			buf32[i] = cfg_bench_nr ? bench_rand() : rand();
 	} else {
 		memset(buf, cfg_payload_char, max_len);
 	}
@@ -593,8 +602,9 @@ static int recv_verify_csum(void *th, int len, uint16_t sport, uint16_t csum_fie
 
 	csum = checksum(th, cfg_proto, len);
 
-	fprintf(stderr, "rx: pkt: sport=%hu len=%u csum=0x%hx verify=0x%hx\n",
-		sport, len, csum_field, csum);
+	if (!cfg_bench_nr)
+		fprintf(stderr, "rx: pkt: sport=%hu len=%u csum=0x%hx verify=0x%hx\n",
+			sport, len, csum_field, csum);
 
 	/* csum must be zero unless cfg_bad_csum indicates bad csum */
 	if (csum && !cfg_bad_csum) {
@@ -771,7 +781,7 @@ static void parse_args(int argc, char *const argv[])
 	const char *daddr = NULL, *saddr = NULL;
 	int c;
 
-	while ((c = getopt(argc, argv, "46d:D:eEi:l:L:n:r:PRs:S:tTuUzZ")) != -1) {
+	while ((c = getopt(argc, argv, "46b:c:d:D:eEi:l:L:n:r:PRs:S:tTuUzZ")) != -1) {
 		switch (c) {
 		case '4':
 			cfg_family = PF_INET;
@@ -779,6 +789,12 @@ static void parse_args(int argc, char *const argv[])
 		case '6':
 			cfg_family = PF_INET6;
 			break;
+		case 'b':
+			cfg_bench_nr = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			cfg_csum_variant = optarg;
+			break;
 		case 'd':
 			cfg_mac_dst = optarg;
 			break;
@@ -865,6 +881,12 @@ static void parse_args(int argc, char *const argv[])
 	if (cfg_zero_sum && cfg_random_seed)
 		error(1, 0, "Cannot combine zero checksum conversion with randomization");
 
+	if (cfg_bench_nr && (cfg_send_pfpacket || cfg_send_udp || cfg_zero_sum))
+		error(1, 0, "Bench builds full packets: cannot combine with -P, -U or -Z");
+
+	if (!checksum_select(cfg_csum_variant))
+		error(1, 0, "Unsupported checksum variant %s", cfg_csum_variant);
+
 	if (cfg_family == PF_INET6) {
 		cfg_saddr6.sin6_port = htons(cfg_port_src);
 		cfg_daddr6.sin6_port = htons(cfg_port_dst);
@@ -883,7 +905,7 @@ static void parse_args(int argc, char *const argv[])
 			error(1, errno, "Cannot parse ipv4 -S");
 	}
 
-	if (cfg_do_tx && cfg_random_seed) {
+	if ((cfg_do_tx || cfg_bench_nr) && cfg_random_seed) {
 		/* special case: time-based seed */
 		if (cfg_random_seed == 1)
 			cfg_random_seed = (unsigned int)gettimeofday_ms();
@@ -965,12 +987,87 @@ static void do_rx(int fdp, int fdr)
 	}
 }
 
+/* Raw throughput of each checksum variant over a full sized frame */
+static void do_bench_variants(void)
+{
+	static char buf[ETH_DATA_LEN];
+	const unsigned long nr = 1UL << 20;
+	unsigned long i, tstart, tdelta;
+	volatile uint32_t sink = 0;
+	int j;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = bench_rand();
+
+	for (j = 0; j < ARRAY_SIZE(checksum_impls); j++) {
+		if (!checksum_impl_supported(&checksum_impls[j]))
+			continue;
+
+		tstart = gettimeofday_ms();
+		for (i = 0; i < nr; i++)
+			sink = checksum_impls[j].fn(buf, sizeof(buf), sink);
+		tdelta = (gettimeofday_ms() - tstart) ? : 1;
+
+		fprintf(stderr, "bench: csum %-4s: %6lu MB/s\n",
+			checksum_impls[j].name,
+			(nr * sizeof(buf) / tdelta) / 1000);
+	}
+}
+
+/* Build and verify packets without sending, to measure generation rate */
+static void do_bench(void)
+{
+	static char _buf[MAX_HEADER_LEN + MAX_PAYLOAD_LEN];
+	unsigned long i, bytes = 0, errors = 0;
+	unsigned long tstart, tdelta;
+	char *buf;
+	int len, ret;
+
+	if (checksum_selftest(100 * 1000, cfg_random_seed))
+		error(1, 0, "bench: checksum variants differ from reference");
+	fprintf(stderr, "bench: checksum variants match reference\n");
+
+	do_bench_variants();
+
+	tstart = gettimeofday_ms();
+	for (i = 0; i < cfg_bench_nr; i++) {
+		if (cfg_random_seed)
+			cfg_payload_len = bench_rand() % MAX_PAYLOAD_LEN;
+
+		/* only randomize the bytes that this packet uses */
+		buf = build_packet(_buf, MAX_HEADER_LEN + cfg_payload_len, &len);
+
+		if (cfg_family == PF_INET6)
+			ret = recv_verify_packet_ipv6(buf, len);
+		else
+			ret = recv_verify_packet_ipv4(buf, len);
+		if (ret)
+			errors++;
+
+		bytes += len;
+	}
+	tdelta = (gettimeofday_ms() - tstart) ? : 1;
+
+	fprintf(stderr, "bench: %lu pkts %lu MB in %lu ms: %lu pkt/s, %lu errors\n",
+		cfg_bench_nr, bytes >> 20, tdelta,
+		cfg_bench_nr * 1000 / tdelta, errors);
+
+	if (errors)
+		error(1, 0, "bench: %lu packets failed verification", errors);
+}
+
 int main(int argc, char *const argv[])
 {
 	int fdp = -1, fdr = -1;		/* -1 to silence -Wmaybe-uninitialized */
 
 	parse_args(argc, argv);
 
+	if (cfg_bench_nr) {
+		do_bench();
+		fprintf(stderr, "OK\n");
+		return 0;
+	}
+
 	/* open receive sockets before transmitting */
 	if (cfg_do_rx) {
 		fdp = recv_prepare_packet();
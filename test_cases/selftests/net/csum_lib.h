@@ -0,0 +1,278 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Internet checksum (RFC 1071) helpers, shared by csum and gro.
+ *
+ * checksum_nofold() sums the buffer as native 16-bit words without
+ * folding, so that callers can add pseudo header fields before
+ * checksum_fold(). The variants return different unfolded sums, but
+ * all fold to the same checksum as the scalar reference.
+ */
+
+#ifndef CSUM_LIB_H
+#define CSUM_LIB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#ifndef __maybe_unused
+# define __maybe_unused		__attribute__ ((__unused__))
+#endif
+
+#define CSUM_SELFTEST_MAX_LEN	9000	/* jumbo frame */
+#define CSUM_SELFTEST_MAX_OFF	64
+
+typedef uint32_t (*checksum_nofold_fn_t)(const void *data, size_t len,
+					 uint32_t sum);
+
+/* reference: one 16-bit word at a time */
+static __maybe_unused uint32_t checksum_nofold_ref(const void *data,
+						    size_t len, uint32_t sum)
+{
+	const uint16_t *words = data;
+	size_t i;
+
+	for (i = 0; i < len / 2; i++)
+		sum += words[i];
+
+	if (len & 1)
+		sum += ((unsigned char *)data)[len - 1];
+
+	return sum;
+}
+
+/* fold to 16 bits, leaving callers headroom to add more fields */
+static __maybe_unused uint32_t checksum_fold64(uint64_t sum)
+{
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+
+	return sum;
+}
+
+/* 32-bit loads into a 64-bit accumulator: a one's complement sum of
+ * 32-bit words folds to the same value as one of 16-bit words, and the
+ * accumulator cannot overflow for any realistic length.
+ */
+static __maybe_unused uint32_t checksum_nofold_u64(const void *data,
+						    size_t len, uint32_t sum)
+{
+	const unsigned char *p = data;
+	uint64_t acc = sum;
+	uint32_t w[4];
+	uint16_t h;
+
+	for (; len >= sizeof(w); len -= sizeof(w), p += sizeof(w)) {
+		memcpy(w, p, sizeof(w));
+		acc += (uint64_t)w[0] + w[1] + w[2] + w[3];
+	}
+	for (; len >= sizeof(w[0]); len -= sizeof(w[0]), p += sizeof(w[0])) {
+		memcpy(w, p, sizeof(w[0]));
+		acc += w[0];
+	}
+	if (len >= sizeof(h)) {
+		memcpy(&h, p, sizeof(h));
+		acc += h;
+		len -= sizeof(h);
+		p += sizeof(h);
+	}
+	if (len)
+		acc += *p;
+
+	return checksum_fold64(acc);
+}
+
+#if defined(__x86_64__)
+/* Split each 32-bit lane into its two 16-bit words and sum those in
+ * separate 32-bit lanes: 65535 iterations cannot overflow them.
+ */
+__attribute__((target("avx2")))
+static __maybe_unused uint32_t checksum_nofold_avx2(const void *data,
+						     size_t len, uint32_t sum)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFFFF);
+	const unsigned char *p = data;
+	uint32_t lanes[16];
+	uint64_t acc = sum;
+	size_t n;
+	int i;
+
+	while (len >= sizeof(__m256i)) {
+		__m256i lo = _mm256_setzero_si256();
+		__m256i hi = _mm256_setzero_si256();
+
+		n = len / sizeof(__m256i);
+		if (n > 0xFFFF)
+			n = 0xFFFF;
+		len -= n * sizeof(__m256i);
+
+		while (n--) {
+			__m256i v = _mm256_loadu_si256((const void *)p);
+
+			lo = _mm256_add_epi32(lo, _mm256_and_si256(v, mask));
+			hi = _mm256_add_epi32(hi, _mm256_srli_epi32(v, 16));
+			p += sizeof(__m256i);
+		}
+
+		_mm256_storeu_si256((void *)lanes, lo);
+		_mm256_storeu_si256((void *)(lanes + 8), hi);
+		for (i = 0; i < 16; i++)
+			acc += lanes[i];
+	}
+
+	/* the tail starts at an even offset: word order is preserved */
+	return checksum_nofold_u64(p, len, checksum_fold64(acc));
+}
+
+static __maybe_unused bool checksum_avx2_supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#if defined(__aarch64__)
+/* Pairwise add 16-bit words into 32-bit lanes, each grows by at most
+ * 2 * 0xFFFF per iteration: 32768 iterations cannot overflow them.
+ */
+static __maybe_unused uint32_t checksum_nofold_neon(const void *data,
+						     size_t len, uint32_t sum)
+{
+	const unsigned char *p = data;
+	uint64_t acc = sum;
+	size_t n;
+
+	while (len >= sizeof(uint8x16_t)) {
+		uint32x4_t acc32 = vdupq_n_u32(0);
+
+		n = len / sizeof(uint8x16_t);
+		if (n > 0x8000)
+			n = 0x8000;
+		len -= n * sizeof(uint8x16_t);
+
+		while (n--) {
+			acc32 = vpadalq_u16(acc32,
+					    vreinterpretq_u16_u8(vld1q_u8(p)));
+			p += sizeof(uint8x16_t);
+		}
+
+		acc += vaddlvq_u32(acc32);
+	}
+
+	return checksum_nofold_u64(p, len, checksum_fold64(acc));
+}
+#endif
+
+static const struct checksum_impl {
+	const char *name;
+	checksum_nofold_fn_t fn;
+	bool (*supported)(void);	/* NULL if always supported */
+} checksum_impls[] = {
+	{ "ref",	checksum_nofold_ref },
+	{ "u64",	checksum_nofold_u64 },
+#if defined(__x86_64__)
+	{ "avx2",	checksum_nofold_avx2,	checksum_avx2_supported },
+#elif defined(__aarch64__)
+	{ "neon",	checksum_nofold_neon },
+#endif
+};
+
+static __maybe_unused bool checksum_impl_supported(const struct checksum_impl *impl)
+{
+	return !impl->supported || impl->supported();
+}
+
+static checksum_nofold_fn_t checksum_nofold_fn;
+
+/* Select a variant by name, or the fastest supported if name is NULL */
+static __maybe_unused bool checksum_select(const char *name)
+{
+	int i;
+
+	for (i = 0; i < sizeof(checksum_impls) / sizeof(checksum_impls[0]); i++) {
+		if (!checksum_impl_supported(&checksum_impls[i]))
+			continue;
+		if (!name || !strcmp(name, checksum_impls[i].name)) {
+			checksum_nofold_fn = checksum_impls[i].fn;
+			if (name)
+				return true;
+		}
+	}
+
+	return !name;
+}
+
+static __maybe_unused uint32_t checksum_nofold(const void *data, size_t len,
+						uint32_t sum)
+{
+	if (!checksum_nofold_fn)
+		checksum_select(NULL);
+
+	return checksum_nofold_fn(data, len, sum);
+}
+
+static __maybe_unused uint16_t checksum_fold_sum(uint32_t sum)
+{
+	while (sum > 0xFFFF)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+
+	return ~sum;
+}
+
+static __maybe_unused uint16_t checksum_fold(const void *data, size_t len,
+					      uint32_t sum)
+{
+	return checksum_fold_sum(checksum_nofold(data, len, sum));
+}
+
+/* Differential test: compare every supported variant against the
+ * reference on random data, lengths, start offsets and initial sums.
+ * Returns the number of mismatches.
+ */
+static __maybe_unused int checksum_selftest(int iters, unsigned int seed)
+{
+	static unsigned char buf[CSUM_SELFTEST_MAX_LEN + CSUM_SELFTEST_MAX_OFF];
+	int i, j, errors = 0;
+	uint16_t expected, csum;
+	size_t len, off;
+	uint32_t sum;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = rand_r(&seed);
+
+	for (i = 0; i < iters; i++) {
+		len = rand_r(&seed) % (CSUM_SELFTEST_MAX_LEN + 1);
+		off = rand_r(&seed) % CSUM_SELFTEST_MAX_OFF;
+		sum = rand_r(&seed) & 0xFFFF;
+		buf[off + rand_r(&seed) % (len + 1)] = rand_r(&seed);
+
+		expected = checksum_fold_sum(checksum_nofold_ref(buf + off,
+								 len, sum));
+
+		for (j = 0; j < sizeof(checksum_impls) / sizeof(checksum_impls[0]); j++) {
+			if (!checksum_impl_supported(&checksum_impls[j]))
+				continue;
+
+			csum = checksum_fold_sum(checksum_impls[j].fn(buf + off,
+								      len, sum));
+			if (csum != expected) {
+				fprintf(stderr, "csum %s: len=%zu off=%zu sum=0x%x: 0x%hx != 0x%hx\n",
+					checksum_impls[j].name, len, off, sum,
+					csum, expected);
+				errors++;
+			}
+		}
+	}
+
+	return errors;
+}
+
+#endif /* CSUM_LIB_H */
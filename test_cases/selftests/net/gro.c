@@ -58,6 +58,7 @@
 #include <unistd.h>
 
 #include "../kselftest.h"
+#include "csum_lib.h"
 
 #define DPORT 8000
 #define SPORT 1500
@@ -142,26 +143,6 @@ static void setup_sock_filter(int fd)
 		error(1, errno, "error setting filter");
 }
 
-static uint32_t checksum_nofold(void *data, size_t len, uint32_t sum)
-{
-	uint16_t *words = data;
-	int i;
-
-	for (i = 0; i < len / 2; i++)
-		sum += words[i];
-	if (len & 1)
-		sum += ((char *)data)[len - 1];
-	return sum;
-}
-
-static uint16_t checksum_fold(void *data, size_t len, uint32_t sum)
-{
-	sum = checksum_nofold(data, len, sum);
-	while (sum > 0xFFFF)
-		sum = (sum & 0xFFFF) + (sum >> 16);
-	return ~sum;
-}
-
 static uint16_t tcp_checksum(void *buf, int payload_len)
 {
 	struct pseudo_header6 {
@@ -20,8 +20,20 @@
  *   - TPACKET_V1: RX_RING, TX_RING
  *   - TPACKET_V2: RX_RING, TX_RING
  *   - TPACKET_V3: RX_RING
+ *
+ * Benchmark ('-b'):
+ *   Capture with N TPACKET_V3 rx rings in a PACKET_FANOUT group, each
+ *   walked by a thread pinned to its own cpu, for a fixed duration. On lo
+ *   a child process generates UDP traffic over a number of flows, so that
+ *   hash fanout spreads it. Reports per ring packets per second, blocks
+ *   retired by timeout (i.e., not full) and drops. E.g.:
+ *
+ *     psock_tpacket -b -t 4 -F hash -B 1048576 -n 32 -r 8 -d 10
  */
 
+#define _GNU_SOURCE
+
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
@@ -43,6 +55,11 @@
 #include <net/if.h>
 #include <inttypes.h>
 #include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/sysinfo.h>
+#include <sys/wait.h>
 
 #include "psock_lib.h"
 
@@ -96,6 +113,19 @@ union frame_map {
 
 static unsigned int total_packets, total_bytes;
 
+/* ring geometry: 0 selects the defaults of the functional tests */
+static unsigned int cfg_block_size;
+static unsigned int cfg_block_nr;
+static unsigned int cfg_frame_size;
+static unsigned int cfg_retire_tov;
+
+static bool cfg_bench;
+static int cfg_duration = 5;
+static int cfg_fanout_type = PACKET_FANOUT_HASH;
+static int cfg_flows = 16;
+static const char *cfg_ifname = "lo";
+static int cfg_threads;
+
 static int pfsocket(int ver)
 {
 	int ret, sock = socket(PF_PACKET, SOCK_RAW, 0);
@@ -646,12 +676,12 @@ static void __v1_v2_fill(struct ring *ring, unsigned int blocks)
 static void __v3_fill(struct ring *ring, unsigned int blocks, int type)
 {
 	if (type == PACKET_RX_RING) {
-		ring->req3.tp_retire_blk_tov = 64;
+		ring->req3.tp_retire_blk_tov = cfg_retire_tov ? : 64;
 		ring->req3.tp_sizeof_priv = 0;
 		ring->req3.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
 	}
-	ring->req3.tp_block_size = getpagesize() << 2;
-	ring->req3.tp_frame_size = TPACKET_ALIGNMENT << 7;
+	ring->req3.tp_block_size = cfg_block_size ? : getpagesize() << 2;
+	ring->req3.tp_frame_size = cfg_frame_size ? : TPACKET_ALIGNMENT << 7;
 	ring->req3.tp_block_nr = blocks;
 
 	ring->req3.tp_frame_nr = ring->req3.tp_block_size /
@@ -667,7 +697,7 @@ static void __v3_fill(struct ring *ring, unsigned int blocks, int type)
 static void setup_ring(int sock, struct ring *ring, int version, int type)
 {
 	int ret = 0;
-	unsigned int blocks = 256;
+	unsigned int blocks = cfg_block_nr ? : 256;
 
 	ring->type = type;
 	ring->version = version;
@@ -829,10 +859,345 @@ static int test_tpacket(int version, int type)
 	return 0;
 }
 
-int main(void)
+struct bench_ring {
+	struct ring ring;
+	int sock;
+	int cpu;
+	pthread_t thread;
+
+	unsigned long packets;
+	unsigned long bytes;
+	unsigned long blocks;
+	unsigned long blocks_tmo;
+	struct tpacket_stats_v3 stats;
+} __attribute__((aligned(64)));
+
+static volatile bool bench_stop;
+
+static const char *fanout_str[] = {
+	[PACKET_FANOUT_HASH] = "hash",
+	[PACKET_FANOUT_LB] = "lb",
+	[PACKET_FANOUT_CPU] = "cpu",
+	[PACKET_FANOUT_RND] = "rnd",
+	[PACKET_FANOUT_QM] = "qm",
+};
+
+static void bench_stats(struct bench_ring *br)
+{
+	socklen_t len = sizeof(br->stats);
+
+	/* reading resets the counters */
+	if (getsockopt(br->sock, SOL_PACKET, PACKET_STATISTICS,
+		       &br->stats, &len)) {
+		perror("getsockopt PACKET_STATISTICS");
+		exit(1);
+	}
+}
+
+static void bench_setup_ring(struct bench_ring *br, int fanout_id)
+{
+	struct sockaddr_ll ll = {
+		.sll_family = PF_PACKET,
+		.sll_protocol = htons(ETH_P_ALL),
+	};
+	int val;
+
+	br->sock = pfsocket(TPACKET_V3);
+	setup_ring(br->sock, &br->ring, TPACKET_V3, PACKET_RX_RING);
+	mmap_ring(br->sock, &br->ring);
+
+	/* with generated traffic, only capture that */
+	if (cfg_flows)
+		pair_udp_setfilter(br->sock);
+
+	ll.sll_ifindex = if_nametoindex(cfg_ifname);
+	if (!ll.sll_ifindex) {
+		perror("if_nametoindex");
+		exit(1);
+	}
+	if (bind(br->sock, (struct sockaddr *) &ll, sizeof(ll))) {
+		perror("bind");
+		exit(1);
+	}
+
+	/* must come after bind */
+	val = (cfg_fanout_type << 16) | fanout_id;
+	if (setsockopt(br->sock, SOL_PACKET, PACKET_FANOUT, &val, sizeof(val))) {
+		perror("setsockopt PACKET_FANOUT");
+		exit(1);
+	}
+}
+
+static void *bench_walk(void *arg)
+{
+	struct bench_ring *br = arg;
+	struct ring *ring = &br->ring;
+	unsigned int block_num = 0;
+	struct tpacket3_hdr *ppd;
+	struct block_desc *pbd;
+	struct pollfd pfd;
+	cpu_set_t mask;
+	int i;
+
+	CPU_ZERO(&mask);
+	CPU_SET(br->cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask)) {
+		perror("sched_setaffinity");
+		exit(1);
+	}
+
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.fd = br->sock;
+	pfd.events = POLLIN | POLLERR;
+
+	while (!bench_stop) {
+		pbd = (struct block_desc *) ring->rd[block_num].iov_base;
+
+		if ((pbd->h1.block_status & TP_STATUS_USER) == 0) {
+			poll(&pfd, 1, 10);
+			continue;
+		}
+
+		/* touch every frame header, like a capture application */
+		ppd = (struct tpacket3_hdr *) ((uint8_t *) pbd +
+					       pbd->h1.offset_to_first_pkt);
+		for (i = 0; i < pbd->h1.num_pkts; i++) {
+			br->bytes += ppd->tp_snaplen;
+			ppd = (struct tpacket3_hdr *) ((uint8_t *) ppd +
+						       ppd->tp_next_offset);
+		}
+
+		br->packets += pbd->h1.num_pkts;
+		br->blocks++;
+		if (pbd->h1.block_status & TP_STATUS_BLK_TMO)
+			br->blocks_tmo++;
+
+		__v3_flush_block(pbd);
+		block_num = (block_num + 1) % ring->rd_num;
+	}
+
+	return NULL;
+}
+
+/* Child process: send UDP over cfg_flows source ports until killed */
+static void bench_generate(void)
+{
+	struct sockaddr_in saddr, daddr;
+	struct mmsghdr msgs[64];
+	struct iovec iov;
+	char buf[DATA_LEN];
+	int fds[cfg_flows], sink, val, i;
+
+	memset(&daddr, 0, sizeof(daddr));
+	daddr.sin_family = AF_INET;
+	daddr.sin_port = htons(PORT_BASE);
+	daddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	/* a bound sink avoids icmp port unreachable, never read it */
+	sink = socket(PF_INET, SOCK_DGRAM, 0);
+	val = 1;
+	if (sink == -1 ||
+	    setsockopt(sink, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val)) ||
+	    bind(sink, (void *) &daddr, sizeof(daddr))) {
+		perror("sink");
+		exit(1);
+	}
+
+	saddr = daddr;
+	for (i = 0; i < cfg_flows; i++) {
+		saddr.sin_port = htons(PORT_BASE + 1 + i);
+		fds[i] = socket(PF_INET, SOCK_DGRAM, 0);
+		if (fds[i] == -1 ||
+		    bind(fds[i], (void *) &saddr, sizeof(saddr)) ||
+		    connect(fds[i], (void *) &daddr, sizeof(daddr))) {
+			perror("flow");
+			exit(1);
+		}
+	}
+
+	memset(buf, DATA_CHAR, sizeof(buf));
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < ARRAY_SIZE(msgs); i++) {
+		msgs[i].msg_hdr.msg_iov = &iov;
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (i = 0; ; i = (i + 1) % cfg_flows)
+		sendmmsg(fds[i], msgs, ARRAY_SIZE(msgs), MSG_DONTWAIT);
+}
+
+static int bench_tpacket(void)
+{
+	struct bench_ring *rings;
+	unsigned long packets = 0, drops = 0;
+	int i, ncpus = get_nprocs();
+	pid_t pid = 0;
+
+	rings = calloc(cfg_threads, sizeof(*rings));
+	if (!rings) {
+		perror("calloc");
+		exit(1);
+	}
+
+	fprintf(stderr, "bench: %s rings=%d fanout=%s block=%u x %u frame=%u "
+		"tov=%ums flows=%d\n", cfg_ifname, cfg_threads,
+		fanout_str[cfg_fanout_type], cfg_block_size, cfg_block_nr,
+		cfg_frame_size, cfg_retire_tov, cfg_flows);
+
+	/* complete the fanout group before any traffic arrives */
+	for (i = 0; i < cfg_threads; i++) {
+		rings[i].cpu = i % ncpus;
+		bench_setup_ring(&rings[i], getpid() & 0xffff);
+	}
+	for (i = 0; i < cfg_threads; i++)
+		bench_stats(&rings[i]);
+
+	for (i = 0; i < cfg_threads; i++) {
+		if (pthread_create(&rings[i].thread, NULL, bench_walk,
+				   &rings[i])) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+	}
+
+	if (cfg_flows) {
+		pid = fork();
+		if (pid == -1) {
+			perror("fork");
+			exit(1);
+		}
+		if (!pid)
+			bench_generate();
+	}
+
+	sleep(cfg_duration);
+
+	if (pid) {
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+	}
+
+	/* let partially filled blocks retire before stopping */
+	usleep(2 * cfg_retire_tov * 1000);
+	bench_stop = true;
+
+	for (i = 0; i < cfg_threads; i++) {
+		struct bench_ring *br = &rings[i];
+
+		pthread_join(br->thread, NULL);
+		bench_stats(br);
+
+		fprintf(stderr, "ring %2d cpu %2d: %10lu pkts %9lu pps %6lu MB/s "
+			"%8lu blocks %8lu tmo %8u drops %6u freezes\n",
+			i, br->cpu, br->packets, br->packets / cfg_duration,
+			(br->bytes / cfg_duration) >> 20, br->blocks,
+			br->blocks_tmo, br->stats.tp_drops,
+			br->stats.tp_freeze_q_cnt);
+
+		packets += br->packets;
+		drops += br->stats.tp_drops;
+
+		unmap_ring(br->sock, &br->ring);
+		close(br->sock);
+	}
+
+	fprintf(stderr, "total: %lu pkts %lu pps %lu drops\n",
+		packets, packets / cfg_duration, drops);
+
+	free(rings);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-b [-B block_size] [-d secs] "
+		"[-f frame_size] [-F hash|lb|cpu|rnd|qm] [-g flows] "
+		"[-i ifname] [-n block_nr] [-r retire_tov_ms] [-t threads]]\n",
+		prog);
+	exit(1);
+}
+
+static void parse_opts(int argc, char **argv)
+{
+	int c, i;
+
+	while ((c = getopt(argc, argv, "bB:d:f:F:g:i:n:r:t:")) != -1) {
+		switch (c) {
+		case 'b':
+			cfg_bench = true;
+			break;
+		case 'B':
+			cfg_block_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			cfg_duration = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			cfg_frame_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'F':
+			for (i = 0; i < ARRAY_SIZE(fanout_str); i++)
+				if (fanout_str[i] && !strcmp(optarg, fanout_str[i]))
+					break;
+			if (i == ARRAY_SIZE(fanout_str))
+				usage(argv[0]);
+			cfg_fanout_type = i;
+			break;
+		case 'g':
+			cfg_flows = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			cfg_ifname = optarg;
+			break;
+		case 'n':
+			cfg_block_nr = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			cfg_retire_tov = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			cfg_threads = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind != argc || (!cfg_bench && argc > 1))
+		usage(argv[0]);
+	if (!cfg_bench)
+		return;
+
+	/* size rings for sustained capture rather than a few packets */
+	if (!cfg_block_size)
+		cfg_block_size = 1 << 20;
+	if (!cfg_block_nr)
+		cfg_block_nr = 32;
+	if (!cfg_frame_size)
+		cfg_frame_size = 2048;
+	if (!cfg_retire_tov)
+		cfg_retire_tov = 8;
+	if (!cfg_threads)
+		cfg_threads = get_nprocs();
+	if (cfg_duration < 1)
+		cfg_duration = 1;
+
+	/* generated traffic only flows over loopback */
+	if (strcmp(cfg_ifname, "lo"))
+		cfg_flows = 0;
+}
+
+int main(int argc, char **argv)
 {
 	int ret = 0;
 
+	parse_opts(argc, argv);
+	if (cfg_bench)
+		return bench_tpacket();
+
 	ret |= test_tpacket(TPACKET_V1, PACKET_RX_RING);
 	ret |= test_tpacket(TPACKET_V1, PACKET_TX_RING);
 
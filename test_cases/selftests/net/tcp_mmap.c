@@ -45,9 +45,21 @@
  *   cpu usage user:0.046 sys:3.559, 110.016 usec per MB, 65529 c-switches
  * received 32768 MB (99.9939 % mmap'ed) in 7.43764 s, 36.9577 Gbit
  *   cpu usage user:0.035 sys:3.467, 106.873 usec per MB, 65530 c-switches
+ *
+ * A single flow can't saturate fast links, use -n to run several flows in
+ * parallel. Both sides need the same -n value. The client sends each flow
+ * from its own thread. The server receives each flow in a thread pinned to
+ * its own CPU with a copy buffer kept for the flow slot, and prints per flow
+ * TCP_ZEROCOPY_RECEIVE hit ratio, mapped and copied bytes and throughput
+ * percentiles (sampled every 100 ms) once all flows are done.
+ *
+ * $ ./tcp_mmap -s -z -n 4 &
+ * $ ./tcp_mmap -H ::1 -z -n 4
  */
 #define _GNU_SOURCE
 #include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
 #include <sys/types.h>
 #include <fcntl.h>
 #include <error.h>
@@ -90,6 +102,34 @@ static int integrity; /* -i option: sender and receiver compute sha256 over the
 
 static size_t chunk_size  = 512*1024;
 
+static int cfg_flows; /* -n option: number of parallel flows, 0 for one thread per connection */
+
+static char *host;
+static int mss;
+static unsigned int max_pacing_rate;
+
+#define TPUT_INTERVAL_NSEC 100000000ULL
+
+struct flow {
+	int fd;
+	int cpu;		/* receiver CPU or -1 */
+	void *buffer;		/* copy buffer, kept across the flows of a slot */
+	size_t buffer_sz;
+	/* the fields below are reset for each flow */
+	unsigned long total;
+	unsigned long total_mmap;
+	unsigned long total_copy;
+	unsigned long zc_calls;	/* TCP_ZEROCOPY_RECEIVE calls */
+	unsigned long zc_hits;	/* calls which mapped some data */
+	unsigned long delta_usec;
+	struct rusage ru;
+	uint32_t rcv_mss;
+	float *tput;		/* Gbit/s for each interval */
+	unsigned int tput_cnt;
+	unsigned int tput_max;
+	pthread_t th;
+};
+
 static size_t map_align;
 
 unsigned long htotal;
@@ -166,38 +206,71 @@ static uint32_t tcp_info_get_rcv_mss(int fd)
 	return info.tcpi_rcv_mss;
 }
 
-void *child_thread(void *arg)
+static unsigned long long mono_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void flow_sample(struct flow *f, unsigned long long *last_ns,
+			unsigned long *last_total)
+{
+	unsigned long long now = mono_nsec();
+	float *tput;
+
+	if (now - *last_ns < TPUT_INTERVAL_NSEC)
+		return;
+
+	if (f->tput_cnt == f->tput_max) {
+		f->tput_max = f->tput_max ? 2 * f->tput_max : 256;
+		tput = realloc(f->tput, f->tput_max * sizeof(*tput));
+		if (!tput)
+			error(1, errno, "realloc");
+		f->tput = tput;
+	}
+
+	f->tput[f->tput_cnt++] = (f->total - *last_total) * 8.0 /
+				 (now - *last_ns);
+	*last_ns = now;
+	*last_total = f->total;
+}
+
+/* Receives one connection, the buffer is allocated unless pooled */
+static void receive_flow(struct flow *f)
 {
 	unsigned char digest[SHA256_DIGEST_LENGTH];
-	unsigned long total_mmap = 0, total = 0;
+	unsigned long long last_ns;
+	unsigned long last_total = 0;
 	struct tcp_zerocopy_receive zc;
-	unsigned char *buffer = NULL;
-	unsigned long delta_usec;
+	unsigned char *buffer;
 	EVP_MD_CTX *ctx = NULL;
 	int flags = MAP_SHARED;
 	struct timeval t0, t1;
 	void *raddr = NULL;
 	void *addr = NULL;
-	double throughput;
-	struct rusage ru;
-	size_t buffer_sz;
-	int lu, fd;
-
-	fd = (int)(unsigned long)arg;
+	int zerocopy = zflg;
+	int lu, fd = f->fd;
 
 	gettimeofday(&t0, NULL);
+	last_ns = mono_nsec();
 
 	fcntl(fd, F_SETFL, O_NDELAY);
-	buffer = mmap_large_buffer(chunk_size, &buffer_sz);
-	if (buffer == (void *)-1) {
-		perror("mmap");
-		goto error;
+	if (!f->buffer) {
+		f->buffer = mmap_large_buffer(chunk_size, &f->buffer_sz);
+		if (f->buffer == (void *)-1) {
+			perror("mmap");
+			f->buffer = NULL;
+			return;
+		}
 	}
-	if (zflg) {
+	buffer = f->buffer;
+	if (zerocopy) {
 		raddr = mmap(NULL, chunk_size + map_align, PROT_READ, flags, fd, 0);
 		if (raddr == (void *)-1) {
 			perror("mmap");
-			zflg = 0;
+			zerocopy = 0;
 		} else {
 			addr = ALIGN_PTR_UP(raddr, map_align);
 		}
@@ -215,42 +288,47 @@ void *child_thread(void *arg)
 		int sub;
 
 		poll(&pfd, 1, 10000);
-		if (zflg) {
+		if (cfg_flows)
+			flow_sample(f, &last_ns, &last_total);
+		if (zerocopy) {
 			socklen_t zc_len = sizeof(zc);
 			int res;
 
 			memset(&zc, 0, sizeof(zc));
 			zc.address = (__u64)((unsigned long)addr);
-			zc.length = min(chunk_size, FILE_SZ - total);
+			zc.length = min(chunk_size, FILE_SZ - f->total);
 
 			res = getsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE,
 					 &zc, &zc_len);
 			if (res == -1)
 				break;
 
+			f->zc_calls++;
 			if (zc.length) {
 				assert(zc.length <= chunk_size);
 				if (integrity)
 					EVP_DigestUpdate(ctx, addr, zc.length);
-				total_mmap += zc.length;
+				f->total_mmap += zc.length;
+				f->zc_hits++;
 				if (xflg)
 					hash_zone(addr, zc.length);
 				/* It is more efficient to unmap the pages right now,
 				 * instead of doing this in next TCP_ZEROCOPY_RECEIVE.
 				 */
 				madvise(addr, zc.length, MADV_DONTNEED);
-				total += zc.length;
+				f->total += zc.length;
 			}
 			if (zc.recv_skip_hint) {
 				assert(zc.recv_skip_hint <= chunk_size);
 				lu = read(fd, buffer, min(zc.recv_skip_hint,
-							  FILE_SZ - total));
+							  FILE_SZ - f->total));
 				if (lu > 0) {
 					if (integrity)
 						EVP_DigestUpdate(ctx, buffer, lu);
 					if (xflg)
 						hash_zone(buffer, lu);
-					total += lu;
+					f->total += lu;
+					f->total_copy += lu;
 				}
 				if (lu == 0)
 					goto end;
@@ -260,7 +338,7 @@ void *child_thread(void *arg)
 		sub = 0;
 		while (sub < chunk_size) {
 			lu = read(fd, buffer + sub, min(chunk_size - sub,
-							FILE_SZ - total));
+							FILE_SZ - f->total));
 			if (lu == 0)
 				goto end;
 			if (lu < 0)
@@ -269,13 +347,14 @@ void *child_thread(void *arg)
 				EVP_DigestUpdate(ctx, buffer + sub, lu);
 			if (xflg)
 				hash_zone(buffer + sub, lu);
-			total += lu;
+			f->total += lu;
+			f->total_copy += lu;
 			sub += lu;
 		}
 	}
 end:
 	gettimeofday(&t1, NULL);
-	delta_usec = (t1.tv_sec - t0.tv_sec) * 1000000 + t1.tv_usec - t0.tv_usec;
+	f->delta_usec = (t1.tv_sec - t0.tv_sec) * 1000000 + t1.tv_usec - t0.tv_usec;
 
 	if (integrity) {
 		fcntl(fd, F_SETFL, 0);
@@ -291,10 +370,30 @@ end:
 			printf("\nSHA256 is correct\n");
 	}
 
+	getrusage(RUSAGE_THREAD, &f->ru);
+	f->rcv_mss = tcp_info_get_rcv_mss(fd);
+error:
+	if (zerocopy)
+		munmap(raddr, chunk_size + map_align);
+}
+
+void *child_thread(void *arg)
+{
+	struct flow flow = { .fd = (int)(unsigned long)arg, .cpu = -1 };
+	unsigned long total_mmap, total, delta_usec;
+	double throughput;
+	struct rusage ru;
+
+	receive_flow(&flow);
+
+	total = flow.total;
+	total_mmap = flow.total_mmap;
+	delta_usec = flow.delta_usec;
+	ru = flow.ru;
+
 	throughput = 0;
 	if (delta_usec)
 		throughput = total * 8.0 / (double)delta_usec / 1000.0;
-	getrusage(RUSAGE_THREAD, &ru);
 	if (total > 1024*1024) {
 		unsigned long total_usec;
 		unsigned long mb = total >> 20;
@@ -310,16 +409,132 @@ end:
 				(double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec / 1000000.0,
 				(double)total_usec/mb,
 				ru.ru_nvcsw,
-				tcp_info_get_rcv_mss(fd));
+				flow.rcv_mss);
 	}
-error:
-	munmap(buffer, buffer_sz);
-	close(fd);
-	if (zflg)
-		munmap(raddr, chunk_size + map_align);
+	if (flow.buffer)
+		munmap(flow.buffer, flow.buffer_sz);
+	close(flow.fd);
 	pthread_exit(0);
 }
 
+static void *flow_thread(void *arg)
+{
+	struct flow *f = arg;
+	cpu_set_t set;
+
+	if (f->cpu >= 0) {
+		CPU_ZERO(&set);
+		CPU_SET(f->cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set))
+			perror("sched_setaffinity");
+	}
+
+	receive_flow(f);
+	close(f->fd);
+
+	return NULL;
+}
+
+static int cmp_float(const void *a, const void *b)
+{
+	float fa = *(const float *)a, fb = *(const float *)b;
+
+	return (fa > fb) - (fa < fb);
+}
+
+static float percentile(const float *sorted, unsigned int cnt, int pct)
+{
+	if (!cnt)
+		return 0;
+
+	return sorted[(cnt - 1) * pct / 100];
+}
+
+static void print_flows(struct flow *flows)
+{
+	unsigned long total = 0, total_mmap = 0, delta_usec = 0;
+	struct flow *f;
+	int i;
+
+	printf("%-4s %-4s %10s %8s %9s %10s %10s %8s %8s %8s\n",
+	       "flow", "cpu", "MB", "Gbit", "zc hit%", "mapped MB",
+	       "copied MB", "p10", "p50", "p90");
+
+	for (i = 0; i < cfg_flows; i++) {
+		f = &flows[i];
+
+		qsort(f->tput, f->tput_cnt, sizeof(*f->tput), cmp_float);
+		printf("%-4d %-4d %10.1f %8.2f %9.2f %10.1f %10.1f %8.2f %8.2f %8.2f\n",
+		       i, f->cpu, f->total / (1024.0 * 1024.0),
+		       f->delta_usec ? f->total * 8.0 / f->delta_usec / 1000.0 : 0,
+		       f->zc_calls ? 100.0 * f->zc_hits / f->zc_calls : 0,
+		       f->total_mmap / (1024.0 * 1024.0),
+		       f->total_copy / (1024.0 * 1024.0),
+		       percentile(f->tput, f->tput_cnt, 10),
+		       percentile(f->tput, f->tput_cnt, 50),
+		       percentile(f->tput, f->tput_cnt, 90));
+
+		total += f->total;
+		total_mmap += f->total_mmap;
+		if (f->delta_usec > delta_usec)
+			delta_usec = f->delta_usec;
+	}
+
+	printf("received %lg MB (%lg %% mmap'ed) over %d flows in %lg s, %lg Gbit\n",
+	       total / (1024.0 * 1024.0),
+	       total ? 100.0 * total_mmap / total : 0, cfg_flows,
+	       delta_usec / 1000000.0,
+	       delta_usec ? total * 8.0 / delta_usec / 1000.0 : 0);
+}
+
+/* Receives cfg_flows connections at a time, each on its own CPU */
+static void do_accept_flows(int fdlisten)
+{
+	int cpus[CPU_SETSIZE], ncpus = 0, i, res;
+	struct flow *flows;
+	cpu_set_t set;
+
+	if (!sched_getaffinity(0, sizeof(set), &set)) {
+		for (i = 0; i < CPU_SETSIZE; i++) {
+			if (CPU_ISSET(i, &set))
+				cpus[ncpus++] = i;
+		}
+	}
+
+	flows = calloc(cfg_flows, sizeof(*flows));
+	if (!flows)
+		error(1, errno, "calloc");
+
+	while (1) {
+		for (i = 0; i < cfg_flows; i++) {
+			struct flow *f = &flows[i];
+
+			f->fd = accept(fdlisten, NULL, NULL);
+			if (f->fd == -1) {
+				perror("accept");
+				i--;
+				continue;
+			}
+
+			/* Keep the pooled buffer, reset the stats */
+			free(f->tput);
+			memset(&f->total, 0, sizeof(*f) -
+			       offsetof(struct flow, total));
+			f->cpu = ncpus ? cpus[i % ncpus] : -1;
+
+			res = pthread_create(&f->th, NULL, flow_thread, f);
+			if (res)
+				error(1, res, "pthread_create");
+		}
+
+		for (i = 0; i < cfg_flows; i++)
+			pthread_join(flows[i].th, NULL);
+
+		print_flows(flows);
+		fflush(stdout);
+	}
+}
+
 static void apply_rcvsnd_buf(int fd)
 {
 	if (rcvbuf && setsockopt(fd, SOL_SOCKET,
@@ -378,6 +593,9 @@ static void do_accept(int fdlisten)
 
 	apply_rcvsnd_buf(fdlisten);
 
+	if (cfg_flows)
+		do_accept_flows(fdlisten);
+
 	while (1) {
 		struct sockaddr_in addr;
 		socklen_t addrlen = sizeof(addr);
@@ -440,21 +658,93 @@ static void randomize(void *target, size_t count)
 	}
 }
 
-int main(int argc, char *argv[])
+static void *send_flow(void *arg)
 {
 	unsigned char digest[SHA256_DIGEST_LENGTH];
-	struct sockaddr_storage listenaddr, addr;
-	unsigned int max_pacing_rate = 0;
+	struct sockaddr_storage addr;
 	EVP_MD_CTX *ctx = NULL;
 	unsigned char *buffer;
 	uint64_t total = 0;
-	char *host = NULL;
-	int fd, c, on = 1;
+	int fd, on = 1;
+	int zerocopy = zflg;
 	size_t buffer_sz;
+
+	buffer = mmap_large_buffer(chunk_size, &buffer_sz);
+	if (buffer == (unsigned char *)-1) {
+		perror("mmap");
+		exit(1);
+	}
+
+	fd = socket(cfg_family, SOCK_STREAM, 0);
+	if (fd == -1) {
+		perror("socket");
+		exit(1);
+	}
+	apply_rcvsnd_buf(fd);
+
+	setup_sockaddr(cfg_family, host, &addr);
+
+	if (mss &&
+	    setsockopt(fd, IPPROTO_TCP, TCP_MAXSEG, &mss, sizeof(mss)) == -1) {
+		perror("setsockopt TCP_MAXSEG");
+		exit(1);
+	}
+	if (connect(fd, (const struct sockaddr *)&addr, cfg_alen) == -1) {
+		perror("connect");
+		exit(1);
+	}
+	if (max_pacing_rate &&
+	    setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE,
+		       &max_pacing_rate, sizeof(max_pacing_rate)) == -1)
+		perror("setsockopt SO_MAX_PACING_RATE");
+
+	if (zerocopy && setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY,
+				   &on, sizeof(on)) == -1) {
+		perror("setsockopt SO_ZEROCOPY, (-z option disabled)");
+		zerocopy = 0;
+	}
+	if (integrity) {
+		randomize(buffer, buffer_sz);
+		ctx = EVP_MD_CTX_new();
+		if (!ctx) {
+			perror("cannot enable SHA computing");
+			exit(1);
+		}
+		EVP_DigestInit_ex(ctx, EVP_sha256(), NULL);
+	}
+	while (total < FILE_SZ) {
+		size_t offset = total % chunk_size;
+		int64_t wr = FILE_SZ - total;
+
+		if (wr > chunk_size - offset)
+			wr = chunk_size - offset;
+		/* Note : we just want to fill the pipe with random bytes */
+		wr = send(fd, buffer + offset,
+			  (size_t)wr, zerocopy ? MSG_ZEROCOPY : 0);
+		if (wr <= 0)
+			break;
+		if (integrity)
+			EVP_DigestUpdate(ctx, buffer + offset, wr);
+		total += wr;
+	}
+	if (integrity && total == FILE_SZ) {
+		EVP_DigestFinal_ex(ctx, digest, &digest_len);
+		send(fd, digest, (size_t)SHA256_DIGEST_LENGTH, 0);
+	}
+	close(fd);
+	munmap(buffer, buffer_sz);
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct sockaddr_storage listenaddr;
+	pthread_t *threads;
+	int c, on = 1;
 	int sflg = 0;
-	int mss = 0;
+	int i, res;
 
-	while ((c = getopt(argc, argv, "46p:svr:w:H:zxkP:M:C:a:i")) != -1) {
+	while ((c = getopt(argc, argv, "46p:svr:w:H:zxkP:M:C:a:in:")) != -1) {
 		switch (c) {
 		case '4':
 			cfg_family = PF_INET;
@@ -503,6 +793,11 @@ int main(int argc, char *argv[])
 		case 'i':
 			integrity = 1;
 			break;
+		case 'n':
+			cfg_flows = atoi(optarg);
+			if (cfg_flows < 1)
+				error(1, 0, "-n needs at least one flow");
+			break;
 		default:
 			exit(1);
 		}
@@ -544,69 +839,24 @@ int main(int argc, char *argv[])
 		do_accept(fdlisten);
 	}
 
-	buffer = mmap_large_buffer(chunk_size, &buffer_sz);
-	if (buffer == (unsigned char *)-1) {
-		perror("mmap");
-		exit(1);
-	}
-
-	fd = socket(cfg_family, SOCK_STREAM, 0);
-	if (fd == -1) {
-		perror("socket");
-		exit(1);
+	if (!cfg_flows) {
+		send_flow(NULL);
+		return 0;
 	}
-	apply_rcvsnd_buf(fd);
 
-	setup_sockaddr(cfg_family, host, &addr);
+	threads = calloc(cfg_flows, sizeof(*threads));
+	if (!threads)
+		error(1, errno, "calloc");
 
-	if (mss &&
-	    setsockopt(fd, IPPROTO_TCP, TCP_MAXSEG, &mss, sizeof(mss)) == -1) {
-		perror("setsockopt TCP_MAXSEG");
-		exit(1);
+	for (i = 0; i < cfg_flows; i++) {
+		res = pthread_create(&threads[i], NULL, send_flow, NULL);
+		if (res)
+			error(1, res, "pthread_create");
 	}
-	if (connect(fd, (const struct sockaddr *)&addr, cfg_alen) == -1) {
-		perror("connect");
-		exit(1);
-	}
-	if (max_pacing_rate &&
-	    setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE,
-		       &max_pacing_rate, sizeof(max_pacing_rate)) == -1)
-		perror("setsockopt SO_MAX_PACING_RATE");
 
-	if (zflg && setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY,
-			       &on, sizeof(on)) == -1) {
-		perror("setsockopt SO_ZEROCOPY, (-z option disabled)");
-		zflg = 0;
-	}
-	if (integrity) {
-		randomize(buffer, buffer_sz);
-		ctx = EVP_MD_CTX_new();
-		if (!ctx) {
-			perror("cannot enable SHA computing");
-			exit(1);
-		}
-		EVP_DigestInit_ex(ctx, EVP_sha256(), NULL);
-	}
-	while (total < FILE_SZ) {
-		size_t offset = total % chunk_size;
-		int64_t wr = FILE_SZ - total;
+	for (i = 0; i < cfg_flows; i++)
+		pthread_join(threads[i], NULL);
 
-		if (wr > chunk_size - offset)
-			wr = chunk_size - offset;
-		/* Note : we just want to fill the pipe with random bytes */
-		wr = send(fd, buffer + offset,
-			  (size_t)wr, zflg ? MSG_ZEROCOPY : 0);
-		if (wr <= 0)
-			break;
-		if (integrity)
-			EVP_DigestUpdate(ctx, buffer + offset, wr);
-		total += wr;
-	}
-	if (integrity && total == FILE_SZ) {
-		EVP_DigestFinal_ex(ctx, digest, &digest_len);
-		send(fd, digest, (size_t)SHA256_DIGEST_LENGTH, 0);
-	}
-	close(fd);
-	munmap(buffer, buffer_sz);
+	free(threads);
 	return 0;
 }
@@ -19,6 +19,14 @@
  * 4. Identify the cpu on which the packet arrived with PACKET_FANOUT_CPU
  * 5. Compute the cpu that RPS should select based on rx_hash and $rps_bitmap
  * 6. Compare the cpus from 4 and 5
+ *
+ * By default the rings are read once, after the timeout. With '-P' each
+ * ring is instead drained for the whole timeout by a thread pinned to its
+ * cpu, so that every frame is verified at line rate without ring overruns.
+ *
+ * The software hash uses a per byte lookup table, or carry-less multiply
+ * where the cpu supports it. '-b $nr' benchmarks these against the bit
+ * by bit reference on random input and exits, without any traffic.
  */
 
 #define _GNU_SOURCE
@@ -38,6 +46,8 @@
 #include <netinet/tcp.h>
 #include <netinet/udp.h>
 #include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -50,8 +60,17 @@
 #include <sys/sysinfo.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_CLMUL 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+#include <arm_neon.h>
+#define HAVE_CLMUL 1
+#endif
+
 #include "../kselftest.h"
 
 #define TOEPLITZ_KEY_MIN_LEN	40
@@ -74,6 +93,8 @@ static char *cfg_ifname =	"eth0";
 static int cfg_num_queues;
 static int cfg_num_rps_cpus;
 static bool cfg_sink;
+static bool cfg_threaded;
+static unsigned long cfg_bench_nr;
 static int cfg_type =		SOCK_STREAM;
 static int cfg_timeout_msec =	1000;
 static bool cfg_verbose;
@@ -83,10 +104,11 @@ static int num_cpus;
 static int ring_block_nr;
 static int ring_block_sz;
 
-/* stats */
+/* stats, summed over all rings */
 static int frames_received;
 static int frames_nohash;
 static int frames_error;
+static unsigned int frames_dropped;
 
 #define log_verbose(args...)	do { if (cfg_verbose) fprintf(stderr, args); } while (0)
 
@@ -96,13 +118,27 @@ struct ring_state {
 	char *mmap;
 	int idx;
 	int cpu;
-};
+	pthread_t thread;
+
+	/* stats: per ring, so that threads do not share cachelines */
+	int frames_received;
+	int frames_nohash;
+	int frames_error;
+} __attribute__((aligned(64)));
+
+typedef uint32_t (*toeplitz_fn_t)(const unsigned char *four_tuple, int len);
 
 static unsigned int rx_irq_cpus[RSS_MAX_CPUS];	/* map from rxq to cpu */
 static int rps_silo_to_cpu[RPS_MAX_CPUS];
 static unsigned char toeplitz_key[TOEPLITZ_KEY_MAX_LEN];
 static struct ring_state rings[RSS_MAX_CPUS];
 
+/* software hash implementation, see toeplitz_init() */
+static toeplitz_fn_t toeplitz_fn;
+static const char *cfg_hash;
+static uint32_t toeplitz_table[FOUR_TUPLE_MAX_LEN][256];
+static uint64_t toeplitz_clmul_key[FOUR_TUPLE_MAX_LEN / 4];
+
 static inline uint32_t toeplitz(const unsigned char *four_tuple,
 				const unsigned char *key)
 {
@@ -126,27 +162,251 @@ static inline uint32_t toeplitz(const unsigned char *four_tuple,
 	return ret;
 }
 
+static uint32_t toeplitz_ref(const unsigned char *four_tuple, int len)
+{
+	return toeplitz(four_tuple, toeplitz_key);
+}
+
+/* The hash is linear in its input: xor the precomputed contribution
+ * of each input byte value at each offset.
+ */
+static uint32_t toeplitz_lut(const unsigned char *four_tuple, int len)
+{
+	uint32_t ret = 0;
+	int i;
+
+	for (i = 0; i < len; i++)
+		ret ^= toeplitz_table[i][four_tuple[i]];
+
+	return ret;
+}
+
+static void toeplitz_lut_init(void)
+{
+	unsigned char one_hot[FOUR_TUPLE_MAX_LEN] = {0};
+	uint32_t bit_hash[8];
+	int i, bit, val;
+
+	for (i = 0; i < FOUR_TUPLE_MAX_LEN; i++) {
+		for (bit = 0; bit < 8; bit++) {
+			one_hot[i] = 1 << bit;
+			bit_hash[bit] = toeplitz(one_hot, toeplitz_key);
+		}
+		one_hot[i] = 0;
+
+		for (val = 0; val < 256; val++) {
+			toeplitz_table[i][val] = 0;
+			for (bit = 0; bit < 8; bit++)
+				if (val & (1 << bit))
+					toeplitz_table[i][val] ^= bit_hash[bit];
+		}
+	}
+}
+
+static uint32_t bitrev32(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+	x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+	x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+	return __builtin_bswap32(x);
+}
+
+static uint64_t bitrev64(uint64_t x)
+{
+	return ((uint64_t)bitrev32(x) << 32) | bitrev32(x >> 32);
+}
+
+#ifdef HAVE_CLMUL
+/* Toeplitz over 32 input bits d[0..31] at bit offset o is the xor of the
+ * key windows k[o + j .. o + j + 31] for each set d[j], which is bits
+ * 32..63 of the carry-less product of k[o .. o + 63] and sum(d[j] x^j).
+ * Computed bit reflected, that is bits 31..62 of the product of the
+ * reversed key and the input word as is, reversed once at the end.
+ */
+#if defined(__x86_64__)
+__attribute__((target("pclmul,sse2")))
+#endif
+static uint32_t toeplitz_clmul(const unsigned char *four_tuple, int len)
+{
+	uint64_t ret = 0, prod;
+	uint32_t word;
+	int i;
+
+	for (i = 0; i < len / 4; i++) {
+		memcpy(&word, four_tuple + (i * 4), sizeof(word));
+		word = ntohl(word);
+#if defined(__x86_64__)
+		prod = _mm_cvtsi128_si64(
+			_mm_clmulepi64_si128(
+				_mm_cvtsi64_si128(toeplitz_clmul_key[i]),
+				_mm_cvtsi64_si128(word), 0));
+#else
+		prod = (uint64_t)vmull_p64(toeplitz_clmul_key[i], word);
+#endif
+		ret ^= prod >> 31;
+	}
+
+	return bitrev32(ret);
+}
+
+static bool toeplitz_clmul_supported(void)
+{
+#if defined(__x86_64__)
+	return __builtin_cpu_supports("pclmul");
+#else
+	return true;
+#endif
+}
+#endif
+
+static void toeplitz_clmul_init(void)
+{
+	uint64_t window;
+	int i;
+
+	/* 64 key bits cover the 32 windows starting in each input word */
+	for (i = 0; i < FOUR_TUPLE_MAX_LEN / 4; i++) {
+		memcpy(&window, toeplitz_key + (i * 4), sizeof(window));
+		toeplitz_clmul_key[i] = bitrev64(be64toh(window));
+	}
+}
+
+static const struct {
+	const char *name;
+	toeplitz_fn_t fn;
+} toeplitz_impls[] = {
+	{ "ref",	toeplitz_ref },
+	{ "table",	toeplitz_lut },
+#ifdef HAVE_CLMUL
+	{ "clmul",	toeplitz_clmul },
+#endif
+};
+
+static bool toeplitz_impl_supported(toeplitz_fn_t fn)
+{
+#ifdef HAVE_CLMUL
+	if (fn == toeplitz_clmul)
+		return toeplitz_clmul_supported();
+#endif
+	return true;
+}
+
+/* Select the hash: '-H $name' or else the fastest the cpu supports */
+static void toeplitz_init(void)
+{
+	int i;
+
+	toeplitz_lut_init();
+	toeplitz_clmul_init();
+
+	for (i = 0; i < ARRAY_SIZE(toeplitz_impls); i++) {
+		if (!toeplitz_impl_supported(toeplitz_impls[i].fn))
+			continue;
+		if (!cfg_hash || !strcmp(cfg_hash, toeplitz_impls[i].name))
+			toeplitz_fn = toeplitz_impls[i].fn;
+	}
+
+	if (!toeplitz_fn)
+		error(1, 0, "unsupported hash implementation: %s", cfg_hash);
+}
+
+static uint64_t gettime_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		error(1, errno, "clock_gettime");
+
+	return ts.tv_sec * 1000ULL * 1000 * 1000 + ts.tv_nsec;
+}
+
+/* Check each implementation against the reference on random tuples,
+ * then time it. Returns the number of mismatches.
+ */
+static int do_bench(void)
+{
+	const int len = cfg_family == AF_INET ?
+			(sizeof(struct in_addr) * 2) + (sizeof(uint16_t) * 2) :
+			FOUR_TUPLE_MAX_LEN;
+	volatile uint32_t sink;
+	unsigned char *tuples;
+	uint32_t *expected;
+	unsigned long n;
+	uint64_t tstart;
+	int i, errors = 0;
+
+	tuples = calloc(cfg_bench_nr, FOUR_TUPLE_MAX_LEN);
+	expected = calloc(cfg_bench_nr, sizeof(*expected));
+	if (!tuples || !expected)
+		error(1, errno, "calloc");
+
+	for (n = 0; n < cfg_bench_nr * FOUR_TUPLE_MAX_LEN; n++)
+		if ((n % FOUR_TUPLE_MAX_LEN) < len)
+			tuples[n] = random();
+
+	for (n = 0; n < cfg_bench_nr; n++)
+		expected[n] = toeplitz(tuples + (n * FOUR_TUPLE_MAX_LEN),
+				       toeplitz_key);
+
+	for (i = 0; i < ARRAY_SIZE(toeplitz_impls); i++) {
+		toeplitz_fn_t fn = toeplitz_impls[i].fn;
+		unsigned long mismatch = 0;
+		uint64_t tdelta;
+
+		if (!toeplitz_impl_supported(fn)) {
+			fprintf(stderr, "%-6s: not supported\n",
+				toeplitz_impls[i].name);
+			continue;
+		}
+
+		for (n = 0; n < cfg_bench_nr; n++)
+			if (fn(tuples + (n * FOUR_TUPLE_MAX_LEN), len) !=
+			    expected[n])
+				mismatch++;
+
+		tstart = gettime_ns();
+		for (n = 0; n < cfg_bench_nr; n++)
+			sink = fn(tuples + (n * FOUR_TUPLE_MAX_LEN), len);
+		tdelta = gettime_ns() - tstart;
+
+		fprintf(stderr, "%-6s: %6.1f ns/hash %8.2f Mhash/s mismatch=%lu\n",
+			toeplitz_impls[i].name,
+			(double)tdelta / cfg_bench_nr,
+			cfg_bench_nr * 1000.0 / (tdelta ? tdelta : 1),
+			mismatch);
+		if (mismatch)
+			errors++;
+	}
+	(void)sink;
+
+	free(expected);
+	free(tuples);
+	return errors;
+}
+
 /* Compare computed cpu with arrival cpu from packet_fanout_cpu */
-static void verify_rss(uint32_t rx_hash, int cpu)
+static bool verify_rss(uint32_t rx_hash, int cpu)
 {
 	int queue = rx_hash % cfg_num_queues;
 
 	log_verbose(" rxq %d (cpu %d)", queue, rx_irq_cpus[queue]);
 	if (rx_irq_cpus[queue] != cpu) {
 		log_verbose(". error: rss cpu mismatch (%d)", cpu);
-		frames_error++;
+		return false;
 	}
+	return true;
 }
 
-static void verify_rps(uint64_t rx_hash, int cpu)
+static bool verify_rps(uint64_t rx_hash, int cpu)
 {
 	int silo = (rx_hash * cfg_num_rps_cpus) >> 32;
 
 	log_verbose(" silo %d (cpu %d)", silo, rps_silo_to_cpu[silo]);
 	if (rps_silo_to_cpu[silo] != cpu) {
 		log_verbose(". error: rps cpu mismatch (%d)", cpu);
-		frames_error++;
+		return false;
 	}
+	return true;
 }
 
 static void log_rxhash(int cpu, uint32_t rx_hash,
@@ -166,12 +426,13 @@ static void log_rxhash(int cpu, uint32_t rx_hash,
 }
 
 /* Compare computed rxhash with rxhash received from tpacket_v3 */
-static void verify_rxhash(const char *pkt, uint32_t rx_hash, int cpu)
+static bool verify_rxhash(const char *pkt, uint32_t rx_hash, int cpu)
 {
 	unsigned char four_tuple[FOUR_TUPLE_MAX_LEN] = {0};
 	uint32_t rx_hash_sw;
 	const char *addrs;
-	int addr_len;
+	int addr_len, len;
+	bool ok = true;
 
 	if (cfg_family == AF_INET) {
 		addr_len = sizeof(struct in_addr);
@@ -181,35 +442,37 @@ static void verify_rxhash(const char *pkt, uint32_t rx_hash, int cpu)
 		addrs = pkt + offsetof(struct ip6_hdr, ip6_src);
 	}
 
-	memcpy(four_tuple, addrs, (addr_len * 2) + (sizeof(uint16_t) * 2));
-	rx_hash_sw = toeplitz(four_tuple, toeplitz_key);
+	len = (addr_len * 2) + (sizeof(uint16_t) * 2);
+	memcpy(four_tuple, addrs, len);
+	rx_hash_sw = toeplitz_fn(four_tuple, len);
 
 	if (cfg_verbose)
 		log_rxhash(cpu, rx_hash, addrs, addr_len);
 
 	if (rx_hash != rx_hash_sw) {
 		log_verbose(" != expected 0x%x\n", rx_hash_sw);
-		frames_error++;
-		return;
+		return false;
 	}
 
 	log_verbose(" OK");
 	if (cfg_num_queues)
-		verify_rss(rx_hash, cpu);
+		ok = verify_rss(rx_hash, cpu);
 	else if (cfg_num_rps_cpus)
-		verify_rps(rx_hash, cpu);
+		ok = verify_rps(rx_hash, cpu);
 	log_verbose("\n");
+
+	return ok;
 }
 
-static char *recv_frame(const struct ring_state *ring, char *frame)
+static char *recv_frame(struct ring_state *ring, char *frame)
 {
 	struct tpacket3_hdr *hdr = (void *)frame;
 
-	if (hdr->hv1.tp_rxhash)
-		verify_rxhash(frame + hdr->tp_net, hdr->hv1.tp_rxhash,
-			      ring->cpu);
-	else
-		frames_nohash++;
+	if (!hdr->hv1.tp_rxhash)
+		ring->frames_nohash++;
+	else if (!verify_rxhash(frame + hdr->tp_net, hdr->hv1.tp_rxhash,
+				ring->cpu))
+		ring->frames_error++;
 
 	return frame + hdr->tp_next_offset;
 }
@@ -230,7 +493,7 @@ static bool recv_block(struct ring_state *ring)
 
 	for (i = 0; i < block->hdr.bh1.num_pkts; i++) {
 		frame = recv_frame(ring, frame);
-		frames_received++;
+		ring->frames_received++;
 	}
 
 	block->hdr.bh1.block_status = TP_STATUS_KERNEL;
@@ -239,19 +502,81 @@ static bool recv_block(struct ring_state *ring)
 	return true;
 }
 
-/* simple test: sleep once unconditionally and then process all rings */
+/* '-P': drain one ring from its own cpu until the timeout */
+static void *process_ring_thread(void *arg)
+{
+	struct ring_state *ring = arg;
+	struct pollfd pfd = {0};
+	uint64_t tnow, tstop;
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(ring->cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask))
+		error(1, errno, "setaffinity %d", ring->cpu);
+
+	pfd.fd = ring->fd;
+	pfd.events = POLLIN | POLLERR;
+
+	tnow = gettime_ns();
+	tstop = tnow + cfg_timeout_msec * 1000ULL * 1000;
+	while (tnow < tstop) {
+		do {} while (recv_block(ring));
+
+		if (poll(&pfd, 1, (tstop - tnow) / (1000 * 1000) + 1) == -1 &&
+		    errno != EINTR)
+			error(1, errno, "poll");
+		tnow = gettime_ns();
+	}
+	do {} while (recv_block(ring));
+
+	return NULL;
+}
+
+/* frames the kernel dropped because the ring was full */
+static unsigned int ring_drops(const struct ring_state *ring)
+{
+	struct tpacket_stats_v3 stats;
+	socklen_t len = sizeof(stats);
+
+	if (getsockopt(ring->fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len))
+		error(1, errno, "getsockopt PACKET_STATISTICS");
+
+	return stats.tp_drops;
+}
+
+/* simple test: sleep once unconditionally and then process all rings,
+ * or with '-P' process each ring continuously from its own thread
+ */
 static void process_rings(void)
 {
 	int i;
 
-	usleep(1000 * cfg_timeout_msec);
+	if (cfg_threaded) {
+		for (i = 0; i < num_cpus; i++)
+			if (pthread_create(&rings[i].thread, NULL,
+					   process_ring_thread, &rings[i]))
+				error(1, 0, "pthread_create");
+		for (i = 0; i < num_cpus; i++)
+			if (pthread_join(rings[i].thread, NULL))
+				error(1, 0, "pthread_join");
+	} else {
+		usleep(1000 * cfg_timeout_msec);
 
-	for (i = 0; i < num_cpus; i++)
-		do {} while (recv_block(&rings[i]));
+		for (i = 0; i < num_cpus; i++)
+			do {} while (recv_block(&rings[i]));
+	}
 
-	fprintf(stderr, "count: pass=%u nohash=%u fail=%u\n",
+	for (i = 0; i < num_cpus; i++) {
+		frames_received += rings[i].frames_received;
+		frames_nohash += rings[i].frames_nohash;
+		frames_error += rings[i].frames_error;
+		frames_dropped += ring_drops(&rings[i]);
+	}
+
+	fprintf(stderr, "count: pass=%u nohash=%u fail=%u drop=%u\n",
 		frames_received - frames_nohash - frames_error,
-		frames_nohash, frames_error);
+		frames_nohash, frames_error, frames_dropped);
 }
 
 static char *setup_ring(int fd)
@@ -485,13 +810,16 @@ static void parse_rps_bitmap(const char *arg)
 static void parse_opts(int argc, char **argv)
 {
 	static struct option long_options[] = {
+	    {"bench",	required_argument, 0, 'b'},
 	    {"dport",	required_argument, 0, 'd'},
 	    {"cpus",	required_argument, 0, 'C'},
+	    {"hash",	required_argument, 0, 'H'},
 	    {"key",	required_argument, 0, 'k'},
 	    {"iface",	required_argument, 0, 'i'},
 	    {"ipv4",	no_argument, 0, '4'},
 	    {"ipv6",	no_argument, 0, '6'},
 	    {"sink",	no_argument, 0, 's'},
+	    {"threaded", no_argument, 0, 'P'},
 	    {"tcp",	no_argument, 0, 't'},
 	    {"timeout",	required_argument, 0, 'T'},
 	    {"udp",	no_argument, 0, 'u'},
@@ -502,7 +830,7 @@ static void parse_opts(int argc, char **argv)
 	bool have_toeplitz = false;
 	int index, c;
 
-	while ((c = getopt_long(argc, argv, "46C:d:i:k:r:stT:uv", long_options, &index)) != -1) {
+	while ((c = getopt_long(argc, argv, "46b:C:d:H:i:k:Pr:stT:uv", long_options, &index)) != -1) {
 		switch (c) {
 		case '4':
 			cfg_family = AF_INET;
@@ -510,12 +838,18 @@ static void parse_opts(int argc, char **argv)
 		case '6':
 			cfg_family = AF_INET6;
 			break;
+		case 'b':
+			cfg_bench_nr = strtoul(optarg, NULL, 0);
+			break;
 		case 'C':
 			parse_cpulist(optarg);
 			break;
 		case 'd':
 			cfg_dport = strtol(optarg, NULL, 0);
 			break;
+		case 'H':
+			cfg_hash = optarg;
+			break;
 		case 'i':
 			cfg_ifname = optarg;
 			break;
@@ -524,6 +858,9 @@ static void parse_opts(int argc, char **argv)
 					   toeplitz_key);
 			have_toeplitz = true;
 			break;
+		case 'P':
+			cfg_threaded = true;
+			break;
 		case 'r':
 			parse_rps_bitmap(optarg);
 			break;
@@ -549,7 +886,11 @@ static void parse_opts(int argc, char **argv)
 		}
 	}
 
-	if (!have_toeplitz)
+	/* the benchmark needs no real key: any random one will do */
+	if (!have_toeplitz && cfg_bench_nr)
+		for (index = 0; index < TOEPLITZ_KEY_MAX_LEN; index++)
+			toeplitz_key[index] = random();
+	else if (!have_toeplitz)
 		error(1, 0, "Must supply rss key ('-k')");
 
 	num_cpus = get_nprocs();
@@ -571,6 +912,10 @@ int main(int argc, char **argv)
 	int fd_sink = -1;
 
 	parse_opts(argc, argv);
+	toeplitz_init();
+
+	if (cfg_bench_nr)
+		return do_bench();
 
 	if (cfg_sink)
 		fd_sink = setup_sink();
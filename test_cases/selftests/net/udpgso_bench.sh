@@ -61,7 +61,14 @@ run_one() {
 	local i=0
 	local -r timeout=10
 
-	./udpgso_bench_rx -p "$TESTPORT" &
+	# SO_TXTIME pacing (-R) is only honoured by the fq and etf qdiscs
+	if [[ " ${args} " == *" -R "* ]] &&
+	   ! tc qdisc replace dev lo root fq 2>/dev/null; then
+		echo "fq qdisc not available"
+		exit "${KSFT_SKIP}"
+	fi
+
+	./udpgso_bench_rx -p "$TESTPORT" ${RX_ARGS} &
 	./udpgso_bench_rx -p "$TESTPORT" -t &
 
 	# Wait for the above test program to get ready to receive connections.
@@ -109,6 +116,21 @@ run_udp() {
 
 	echo "udp gso zerocopy timestamp audit"
 	run_in_netns ${args} -S 0 -T -z -a
+
+	echo "udp gso sendmmsg batch"
+	run_in_netns ${args} -S 0 -B 8
+
+	echo "udp gso recvmmsg batch"
+	RX_ARGS="-B 8" run_in_netns ${args} -S 0
+
+	echo "udp gso paced"
+	run_in_netns ${args} -S 0 -R 1000
+
+	echo "udp gso io_uring"
+	run_in_netns ${args} -S 0 -U -B 8
+
+	echo "udp gso io_uring zerocopy audit"
+	run_in_netns ${args} -S 0 -U -B 8 -z -a
 }
 
 run_tcp() {
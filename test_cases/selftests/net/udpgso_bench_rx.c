@@ -35,7 +35,10 @@
 #define UDP_GRO		104
 #endif
 
+#define MAX_BATCH	64
+
 static int  cfg_port		= 8000;
+static int  cfg_batch		= 1;
 static bool cfg_tcp;
 static bool cfg_verify;
 static bool cfg_read_all;
@@ -51,6 +54,7 @@ static struct sockaddr_storage cfg_bind_addr;
 
 static bool interrupted;
 static unsigned long packets, bytes;
+static unsigned long batches, segments;
 
 static void sigint_handler(int signum)
 {
@@ -212,12 +216,24 @@ static void do_verify_udp(const char *data, int len)
 	}
 }
 
+static int recv_gso_size(struct msghdr *msg)
+{
+	struct cmsghdr *cmsg;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_UDP
+		    && cmsg->cmsg_type == UDP_GRO)
+			return *(int *)CMSG_DATA(cmsg);
+	}
+	return -1;
+}
+
 static int recv_msg(int fd, char *buf, int len, int *gso_size)
 {
 	char control[CMSG_SPACE(sizeof(int))] = {0};
 	struct msghdr msg = {0};
 	struct iovec iov = {0};
-	struct cmsghdr *cmsg;
 	int ret;
 
 	iov.iov_base = buf;
@@ -231,19 +247,33 @@ static int recv_msg(int fd, char *buf, int len, int *gso_size)
 
 	*gso_size = -1;
 	ret = recvmsg(fd, &msg, MSG_TRUNC | MSG_DONTWAIT);
-	if (ret != -1) {
-		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
-		     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
-			if (cmsg->cmsg_level == SOL_UDP
-			    && cmsg->cmsg_type == UDP_GRO) {
-				*gso_size = *(int *)CMSG_DATA(cmsg);
-				break;
-			}
-		}
-	}
+	if (ret != -1)
+		*gso_size = recv_gso_size(&msg);
 	return ret;
 }
 
+/* Check one datagram of ret bytes, of which len were copied to data */
+static void do_check_udp(const char *data, int len, int ret, int gso_size)
+{
+	if (cfg_expected_pkt_len && ret != cfg_expected_pkt_len)
+		error(1, 0, "recv: bad packet len, got %d,"
+		      " expected %d\n", ret, cfg_expected_pkt_len);
+	if (len && cfg_verify) {
+		if (ret == 0)
+			error(1, errno, "recv: 0 byte datagram\n");
+
+		do_verify_udp(data, ret);
+	}
+	if (cfg_expected_gso_size && cfg_expected_gso_size != gso_size)
+		error(1, 0, "recv: bad gso size, got %d, expected %d "
+		      "(-1 == no gso cmsg))\n", gso_size,
+		      cfg_expected_gso_size);
+
+	packets++;
+	bytes += ret;
+	segments += gso_size > 0 ? (ret + gso_size - 1) / gso_size : 1;
+}
+
 /* Flush all outstanding datagrams. Verify first few bytes of each. */
 static void do_flush_udp(int fd)
 {
@@ -261,31 +291,67 @@ static void do_flush_udp(int fd)
 			break;
 		if (ret == -1)
 			error(1, errno, "recv");
-		if (cfg_expected_pkt_len && ret != cfg_expected_pkt_len)
-			error(1, 0, "recv: bad packet len, got %d,"
-			      " expected %d\n", ret, cfg_expected_pkt_len);
-		if (len && cfg_verify) {
-			if (ret == 0)
-				error(1, errno, "recv: 0 byte datagram\n");
-
-			do_verify_udp(rbuf, ret);
+
+		do_check_udp(rbuf, len, ret, gso_size);
+		if (cfg_expected_pkt_nr && packets >= cfg_expected_pkt_nr)
+			break;
+	}
+}
+
+/* Same as do_flush_udp, but read up to cfg_batch datagrams per recvmmsg */
+static void do_flush_udp_batch(int fd)
+{
+	static char control[MAX_BATCH][CMSG_SPACE(sizeof(int))];
+	static char rbuf[MAX_BATCH][ETH_MAX_MTU];
+	static struct mmsghdr mmsgs[MAX_BATCH];
+	static struct iovec iov[MAX_BATCH];
+	int i, ret, len, vlen, budget = 256;
+
+	len = cfg_read_all ? sizeof(rbuf[0]) : 0;
+	while (budget > 0) {
+		vlen = cfg_batch;
+		if (cfg_expected_pkt_nr && packets < cfg_expected_pkt_nr &&
+		    packets + vlen > cfg_expected_pkt_nr)
+			vlen = cfg_expected_pkt_nr - packets;
+
+		memset(mmsgs, 0, vlen * sizeof(mmsgs[0]));
+		for (i = 0; i < vlen; i++) {
+			struct msghdr *msg = &mmsgs[i].msg_hdr;
+
+			iov[i].iov_base = rbuf[i];
+			iov[i].iov_len = len;
+			msg->msg_iov = iov + i;
+			msg->msg_iovlen = 1;
+			msg->msg_control = control[i];
+			msg->msg_controllen = sizeof(control[i]);
 		}
-		if (cfg_expected_gso_size && cfg_expected_gso_size != gso_size)
-			error(1, 0, "recv: bad gso size, got %d, expected %d "
-			      "(-1 == no gso cmsg))\n", gso_size,
-			      cfg_expected_gso_size);
 
-		packets++;
-		bytes += ret;
+		/* MSG_TRUNC will make msg_len full datagram length */
+		ret = recvmmsg(fd, mmsgs, vlen, MSG_TRUNC | MSG_DONTWAIT, NULL);
+		if (ret == -1 && errno == EAGAIN)
+			break;
+		if (ret == -1)
+			error(1, errno, "recvmmsg");
+		batches++;
+
+		for (i = 0; i < ret; i++)
+			do_check_udp(rbuf[i], len, mmsgs[i].msg_len,
+				     recv_gso_size(&mmsgs[i].msg_hdr));
+
 		if (cfg_expected_pkt_nr && packets >= cfg_expected_pkt_nr)
 			break;
+		/* a short batch means the queue is drained */
+		if (ret < vlen)
+			break;
+		budget -= ret;
 	}
 }
 
 static void usage(const char *filepath)
 {
-	error(1, 0, "Usage: %s [-C connect_timeout] [-Grtv] [-b addr] [-p port]"
-	      " [-l pktlen] [-n packetnr] [-R rcv_timeout] [-S gsosize]",
+	error(1, 0, "Usage: %s [-C connect_timeout] [-Grtv] [-b addr] [-B batch]"
+	      " [-p port] [-l pktlen] [-n packetnr] [-R rcv_timeout]"
+	      " [-S gsosize]",
 	      filepath);
 }
 
@@ -294,7 +360,7 @@ static void parse_opts(int argc, char **argv)
 	const char *bind_addr = NULL;
 	int c;
 
-	while ((c = getopt(argc, argv, "4b:C:Gl:n:p:rR:S:tv")) != -1) {
+	while ((c = getopt(argc, argv, "4b:B:C:Gl:n:p:rR:S:tv")) != -1) {
 		switch (c) {
 		case '4':
 			cfg_family = PF_INET;
@@ -303,6 +369,9 @@ static void parse_opts(int argc, char **argv)
 		case 'b':
 			bind_addr = optarg;
 			break;
+		case 'B':
+			cfg_batch = strtoul(optarg, NULL, 0);
+			break;
 		case 'C':
 			cfg_connect_timeout_ms = strtoul(optarg, NULL, 0);
 			break;
@@ -349,6 +418,10 @@ static void parse_opts(int argc, char **argv)
 
 	if (cfg_tcp && cfg_verify)
 		error(1, 0, "TODO: implement verify mode for tcp");
+	if (cfg_batch < 1 || cfg_batch > MAX_BATCH)
+		error(1, 0, "batch size must be in [1, %d]", MAX_BATCH);
+	if (cfg_tcp && cfg_batch > 1)
+		error(1, 0, "Option -B is udp only");
 }
 
 static void do_recv(void)
@@ -371,17 +444,27 @@ static void do_recv(void)
 
 		if (cfg_tcp)
 			do_flush_tcp(fd);
+		else if (cfg_batch > 1)
+			do_flush_udp_batch(fd);
 		else
 			do_flush_udp(fd);
 
 		tnow = gettimeofday_ms();
 		if (tnow > treport) {
-			if (packets)
+			if (packets && cfg_batch > 1)
+				fprintf(stderr,
+					"%s rx: %6lu MB/s %8lu calls/s"
+					" %6lu batches/s %8lu segs/s\n",
+					cfg_tcp ? "tcp" : "udp",
+					bytes >> 20, packets,
+					batches, segments);
+			else if (packets)
 				fprintf(stderr,
 					"%s rx: %6lu MB/s %8lu calls/s\n",
 					cfg_tcp ? "tcp" : "udp",
 					bytes >> 20, packets);
 			bytes = packets = 0;
+			batches = segments = 0;
 			treport = tnow + 1000;
 		}
 
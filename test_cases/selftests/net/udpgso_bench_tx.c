@@ -23,9 +23,11 @@
 #include <sys/time.h>
 #include <sys/poll.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "../kselftest.h"
+#include "io_uring_lib.h"
 
 #ifndef ETH_MAX_MTU
 #define ETH_MAX_MTU 0xFFFFU
@@ -51,7 +53,18 @@
 #define ENOTSUPP	524
 #endif
 
+#ifndef SO_TXTIME
+#define SO_TXTIME	61
+#define SCM_TXTIME	SO_TXTIME
+#endif
+
 #define NUM_PKT		100
+#define MAX_BATCH	1024	/* UIO_MAXIOV */
+
+/* room for UDP_SEGMENT, SO_TIMESTAMPING and SCM_TXTIME */
+#define SEGMENT_CMSG_SPACE	(CMSG_SPACE(sizeof(uint16_t)) + \
+				 CMSG_SPACE(sizeof(uint32_t)) + \
+				 CMSG_SPACE(sizeof(uint64_t)))
 
 static bool	cfg_cache_trash;
 static int	cfg_cpu		= -1;
@@ -69,6 +82,9 @@ static bool	cfg_tcp;
 static uint32_t	cfg_tx_ts = SOF_TIMESTAMPING_TX_SOFTWARE;
 static bool	cfg_tx_tstamp;
 static bool	cfg_audit;
+static int	cfg_batch	= 1;
+static bool	cfg_io_uring;
+static unsigned long cfg_txtime_rate;
 static bool	cfg_verbose;
 static bool	cfg_zerocopy;
 static int	cfg_msg_nr;
@@ -80,6 +96,8 @@ static unsigned long stat_tx_ts_errors;
 static unsigned long tstart;
 static unsigned long tend;
 static unsigned long stat_zcopies;
+static unsigned long stat_batches;
+static unsigned long total_num_batches;
 
 static socklen_t cfg_alen;
 static struct sockaddr_storage cfg_dst_addr;
@@ -87,6 +105,11 @@ static struct sockaddr_storage cfg_dst_addr;
 static bool interrupted;
 static char buf[NUM_PKT][ETH_MAX_MTU];
 
+static struct io_uring uring;
+static bool uring_fixed_buf;
+static bool uring_sent;
+static unsigned long uring_notifs;
+
 static void sigint_handler(int signum)
 {
 	if (signum == SIGINT)
@@ -270,6 +293,35 @@ static void flush_errqueue_retry(int fd, unsigned long num_sends)
 	} while ((stat_zcopies != num_sends) && (tnow < tstop));
 }
 
+/* Message nr of a batch starting at buf[idx]: walk buf with -c only */
+static char *batch_buf(int idx, int nr)
+{
+	return buf[cfg_cache_trash ? (idx + nr) % NUM_PKT : idx];
+}
+
+/* Departure time of the next payload when pacing at cfg_txtime_rate.
+ * Only the fq and etf qdiscs honour SO_TXTIME, other qdiscs send the
+ * packets right away. print_report warns if the rate is not kept.
+ */
+static uint64_t txtime_next(void)
+{
+	static uint64_t tnext;
+	struct timespec ts;
+	uint64_t tnow, txtime;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		error(1, errno, "clock_gettime");
+	tnow = ts.tv_sec * 1000ULL * 1000 * 1000 + ts.tv_nsec;
+
+	/* a sender that fell behind must not catch up in a burst */
+	if (tnext < tnow)
+		tnext = tnow;
+
+	txtime = tnext;
+	tnext += cfg_payload_len * 8000ULL / cfg_txtime_rate;
+	return txtime;
+}
+
 static int send_tcp(int fd, char *data)
 {
 	int ret, done = 0, count = 0;
@@ -386,14 +438,45 @@ static void send_udp_segment_cmsg(struct cmsghdr *cm)
 	*valp = cfg_gso_size;
 }
 
+static void send_txtime_cmsg(struct cmsghdr *cm)
+{
+	uint64_t txtime = txtime_next();
+
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_TXTIME;
+	cm->cmsg_len = CMSG_LEN(sizeof(txtime));
+	memcpy(CMSG_DATA(cm), &txtime, sizeof(txtime));
+}
+
+/* Fill a zeroed control buffer of SEGMENT_CMSG_SPACE bytes */
+static void send_udp_segment_cmsgs(struct msghdr *msg)
+{
+	size_t msg_controllen;
+	struct cmsghdr *cmsg;
+
+	msg->msg_controllen = SEGMENT_CMSG_SPACE;
+	cmsg = CMSG_FIRSTHDR(msg);
+	send_udp_segment_cmsg(cmsg);
+	msg_controllen = CMSG_SPACE(sizeof(cfg_mss));
+	if (cfg_tx_tstamp) {
+		cmsg = CMSG_NXTHDR(msg, cmsg);
+		send_ts_cmsg(cmsg);
+		msg_controllen += CMSG_SPACE(sizeof(cfg_tx_ts));
+	}
+	if (cfg_txtime_rate) {
+		cmsg = CMSG_NXTHDR(msg, cmsg);
+		send_txtime_cmsg(cmsg);
+		msg_controllen += CMSG_SPACE(sizeof(uint64_t));
+	}
+
+	msg->msg_controllen = msg_controllen;
+}
+
 static int send_udp_segment(int fd, char *data)
 {
-	char control[CMSG_SPACE(sizeof(cfg_gso_size)) +
-		     CMSG_SPACE(sizeof(cfg_tx_ts))] = {0};
+	char control[SEGMENT_CMSG_SPACE] = {0};
 	struct msghdr msg = {0};
 	struct iovec iov = {0};
-	size_t msg_controllen;
-	struct cmsghdr *cmsg;
 	int ret;
 
 	iov.iov_base = data;
@@ -403,17 +486,8 @@ static int send_udp_segment(int fd, char *data)
 	msg.msg_iovlen = 1;
 
 	msg.msg_control = control;
-	msg.msg_controllen = sizeof(control);
-	cmsg = CMSG_FIRSTHDR(&msg);
-	send_udp_segment_cmsg(cmsg);
-	msg_controllen = CMSG_SPACE(sizeof(cfg_mss));
-	if (cfg_tx_tstamp) {
-		cmsg = CMSG_NXTHDR(&msg, cmsg);
-		send_ts_cmsg(cmsg);
-		msg_controllen += CMSG_SPACE(sizeof(cfg_tx_ts));
-	}
+	send_udp_segment_cmsgs(&msg);
 
-	msg.msg_controllen = msg_controllen;
 	msg.msg_name = (void *)&cfg_dst_addr;
 	msg.msg_namelen = cfg_alen;
 
@@ -427,10 +501,179 @@ static int send_udp_segment(int fd, char *data)
 	return 1;
 }
 
+/* Send cfg_batch GSO datagrams, each with its own cmsgs, per sendmmsg */
+static int send_udp_segment_batch(int fd, int idx)
+{
+	static char control[MAX_BATCH][SEGMENT_CMSG_SPACE];
+	static struct mmsghdr mmsgs[MAX_BATCH];
+	static struct iovec iov[MAX_BATCH];
+	int i, ret, off = 0;
+
+	memset(control, 0, cfg_batch * sizeof(control[0]));
+	memset(mmsgs, 0, cfg_batch * sizeof(mmsgs[0]));
+
+	for (i = 0; i < cfg_batch; i++) {
+		struct msghdr *msg = &mmsgs[i].msg_hdr;
+
+		iov[i].iov_base = batch_buf(idx, i);
+		iov[i].iov_len = cfg_payload_len;
+
+		msg->msg_iov = iov + i;
+		msg->msg_iovlen = 1;
+		msg->msg_name = (void *)&cfg_dst_addr;
+		msg->msg_namelen = cfg_alen;
+		msg->msg_control = control[i];
+		send_udp_segment_cmsgs(msg);
+	}
+
+	/* a blocking socket may still return short on a signal */
+	while (off < cfg_batch) {
+		ret = sendmmsg(fd, mmsgs + off, cfg_batch - off,
+			       cfg_zerocopy ? MSG_ZEROCOPY : 0);
+		if (ret == -1)
+			error(1, errno, "sendmmsg");
+		stat_batches++;
+
+		for (i = off; i < off + ret; i++)
+			if (mmsgs[i].msg_len != cfg_payload_len)
+				error(1, 0, "sendmmsg: %u != %u\n",
+				      mmsgs[i].msg_len, cfg_payload_len);
+		off += ret;
+	}
+
+	return cfg_batch;
+}
+
+static void setup_io_uring(int fd)
+{
+	struct iovec iov;
+	int ret, val;
+
+	ret = io_uring_queue_init(cfg_batch, &uring, 0);
+	if (ret) {
+		if (errno == ENOSYS) {
+			fprintf(stderr, "io_uring not supported\n");
+			exit(KSFT_SKIP);
+		}
+		error(1, errno, "io_uring: queue init");
+	}
+
+	/* fixed buffers save per request page pinning on SEND_ZC, but are
+	 * subject to RLIMIT_MEMLOCK: fall back to plain buffers if refused
+	 */
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+	ret = io_uring_register_buffers(&uring, &iov, 1);
+	if (ret && cfg_verbose)
+		fprintf(stderr, "io_uring: buffer registration: %s\n",
+			strerror(-ret));
+	uring_fixed_buf = !ret;
+
+	/* SEND carries no cmsg: segment with the socket option instead */
+	if (cfg_segment) {
+		val = cfg_gso_size;
+		if (setsockopt(fd, SOL_UDP, UDP_SEGMENT, &val, sizeof(val)))
+			error(1, errno, "setsockopt udp segment");
+	}
+}
+
+/* Returns true for a send completion, false for a zerocopy notification */
+static bool io_uring_handle_cqe(struct io_uring_cqe *cqe)
+{
+	int res = cqe->res;
+
+	if (cqe->flags & IORING_CQE_F_NOTIF) {
+		if (!uring_notifs)
+			error(1, 0, "io_uring: unexpected notification");
+		uring_notifs--;
+		stat_zcopies++;
+		io_uring_cqe_seen(&uring);
+		return false;
+	}
+
+	if (cqe->flags & IORING_CQE_F_MORE)
+		uring_notifs++;
+	io_uring_cqe_seen(&uring);
+
+	/* kernels without SEND_ZC reject the opcode on first use */
+	if (res == -EINVAL && cfg_zerocopy && !uring_sent) {
+		fprintf(stderr, "io_uring SEND_ZC not supported\n");
+		exit(KSFT_SKIP);
+	}
+	if (res < 0)
+		error(1, -res, "io_uring: send");
+	if (res != cfg_payload_len)
+		error(1, 0, "io_uring: send: %uB != %uB\n",
+		      res, cfg_payload_len);
+
+	uring_sent = true;
+	return true;
+}
+
+/* Queue cfg_batch SEND or SEND_ZC requests and reap their completions */
+static int send_udp_io_uring(int fd, int idx)
+{
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	int i, ret, done = 0;
+
+	for (i = 0; i < cfg_batch; i++) {
+		char *data = batch_buf(idx, i);
+
+		sqe = io_uring_get_sqe(&uring);
+		if (!sqe)
+			error(1, 0, "io_uring: sq full");
+
+		if (cfg_zerocopy) {
+			io_uring_prep_sendzc(sqe, fd, data, cfg_payload_len,
+					     0, 0);
+			if (uring_fixed_buf) {
+				sqe->ioprio |= IORING_RECVSEND_FIXED_BUF;
+				sqe->buf_index = 0;
+			}
+		} else {
+			io_uring_prep_send(sqe, fd, data, cfg_payload_len, 0);
+		}
+	}
+
+	ret = io_uring_submit(&uring);
+	if (ret < 0)
+		error(1, -ret, "io_uring: submit");
+	if (ret != cfg_batch)
+		error(1, 0, "io_uring: submit: %d != %d", ret, cfg_batch);
+
+	while (done < cfg_batch) {
+		ret = io_uring_wait_cqe(&uring, &cqe);
+		if (ret)
+			error(1, -ret, "io_uring: wait cqe");
+		if (io_uring_handle_cqe(cqe))
+			done++;
+	}
+	stat_batches++;
+
+	return cfg_batch;
+}
+
+/* Wait for the zerocopy notifications still in flight */
+static void flush_io_uring(void)
+{
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	while (uring_notifs) {
+		ret = io_uring_wait_cqe(&uring, &cqe);
+		if (ret)
+			error(1, -ret, "io_uring: wait cqe");
+		if (io_uring_handle_cqe(cqe))
+			error(1, 0, "io_uring: unexpected send completion");
+	}
+}
+
 static void usage(const char *filepath)
 {
-	error(1, 0, "Usage: %s [-46acmHPtTuvz] [-C cpu] [-D dst ip] [-l secs] "
-		    "[-L secs] [-M messagenr] [-p port] [-s sendsize] [-S gsosize]",
+	error(1, 0, "Usage: %s [-46acmHPtTuUvz] [-B batch] [-C cpu] [-D dst ip] "
+		    "[-l secs] [-L secs] [-M messagenr] [-p port] [-R mbps] "
+		    "[-s sendsize] [-S gsosize]",
 		    filepath);
 }
 
@@ -440,7 +683,7 @@ static void parse_opts(int argc, char **argv)
 	int max_len, hdrlen;
 	int c;
 
-	while ((c = getopt(argc, argv, "46acC:D:Hl:L:mM:p:s:PS:tTuvz")) != -1) {
+	while ((c = getopt(argc, argv, "46aB:cC:D:Hl:L:mM:p:R:s:PS:tTuUvz")) != -1) {
 		switch (c) {
 		case '4':
 			if (cfg_family != PF_UNSPEC)
@@ -457,6 +700,9 @@ static void parse_opts(int argc, char **argv)
 		case 'a':
 			cfg_audit = true;
 			break;
+		case 'B':
+			cfg_batch = strtoul(optarg, NULL, 0);
+			break;
 		case 'c':
 			cfg_cache_trash = true;
 			break;
@@ -484,6 +730,9 @@ static void parse_opts(int argc, char **argv)
 		case 'P':
 			cfg_poll = true;
 			break;
+		case 'R':
+			cfg_txtime_rate = strtoul(optarg, NULL, 0);
+			break;
 		case 's':
 			cfg_payload_len = strtoul(optarg, NULL, 0);
 			break;
@@ -504,6 +753,9 @@ static void parse_opts(int argc, char **argv)
 		case 'u':
 			cfg_connected = false;
 			break;
+		case 'U':
+			cfg_io_uring = true;
+			break;
 		case 'v':
 			cfg_verbose = true;
 			break;
@@ -531,6 +783,18 @@ static void parse_opts(int argc, char **argv)
 		error(1, 0, "cannot combine segment offload and sendmmsg");
 	if (cfg_tx_tstamp && !(cfg_segment || cfg_sendmmsg))
 		error(1, 0, "Options -T and -H require either -S or -m option");
+	if (cfg_batch < 1 || cfg_batch > MAX_BATCH)
+		error(1, 0, "batch size must be in [1, %d]", MAX_BATCH);
+	if (cfg_batch > 1 && !(cfg_segment || cfg_io_uring))
+		error(1, 0, "Option -B requires either -S or -U option");
+	if (cfg_io_uring) {
+		if (cfg_tcp || cfg_sendmmsg || !cfg_connected)
+			error(1, 0, "Option -U requires connected udp");
+		if (cfg_tx_tstamp || cfg_txtime_rate)
+			error(1, 0, "Option -U cannot pass -T, -H or -R cmsgs");
+	}
+	if (cfg_txtime_rate && !cfg_segment)
+		error(1, 0, "Option -R requires -S option");
 
 	if (cfg_family == PF_INET)
 		hdrlen = sizeof(struct iphdr) + sizeof(struct udphdr);
@@ -579,6 +843,22 @@ static void set_tx_timestamping(int fd)
 		error(1, errno, "setsockopt tx timestamping");
 }
 
+static void set_txtime(int fd)
+{
+	struct sock_txtime so_txtime = {
+		.clockid = CLOCK_MONOTONIC,
+	};
+
+	if (setsockopt(fd, SOL_SOCKET, SO_TXTIME,
+		       &so_txtime, sizeof(so_txtime))) {
+		if (errno == ENOPROTOOPT) {
+			fprintf(stderr, "SO_TXTIME not supported\n");
+			exit(KSFT_SKIP);
+		}
+		error(1, errno, "setsockopt txtime");
+	}
+}
+
 static void print_audit_report(unsigned long num_msgs, unsigned long num_sends)
 {
 	unsigned long tdelta;
@@ -595,6 +875,10 @@ static void print_audit_report(unsigned long num_msgs, unsigned long num_sends)
 		((num_msgs * cfg_payload_len) >> 10) / tdelta,
 		num_sends, num_sends * 1000 / tdelta,
 		num_msgs, num_msgs * 1000 / tdelta);
+	if (cfg_batch > 1 || cfg_io_uring)
+		fprintf(stderr, "sum batches: %10lu (%lu/s) of %d msgs\n",
+			total_num_batches, total_num_batches * 1000 / tdelta,
+			cfg_batch);
 
 	if (cfg_tx_tstamp) {
 		if (stat_tx_ts_errors)
@@ -622,16 +906,32 @@ static void print_audit_report(unsigned long num_msgs, unsigned long num_sends)
 
 static void print_report(unsigned long num_msgs, unsigned long num_sends)
 {
+	static bool warned_txtime;
+	unsigned long mbps;
+
+	mbps = num_msgs * cfg_payload_len * 8 / (1000 * 1000);
+	if (cfg_txtime_rate && !warned_txtime && mbps > 2 * cfg_txtime_rate) {
+		fprintf(stderr, "warning: %lu Mbps exceeds -R %lu Mbps, "
+				"SO_TXTIME needs the fq or etf qdisc\n",
+			mbps, cfg_txtime_rate);
+		warned_txtime = true;
+	}
+
 	fprintf(stderr,
-		"%s tx: %6lu MB/s %8lu calls/s %6lu msg/s\n",
+		"%s tx: %6lu MB/s %8lu calls/s %6lu msg/s",
 		cfg_tcp ? "tcp" : "udp",
 		(num_msgs * cfg_payload_len) >> 20,
 		num_sends, num_msgs);
+	if (cfg_batch > 1 || cfg_io_uring)
+		fprintf(stderr, " %6lu batches/s", stat_batches);
+	fprintf(stderr, "\n");
 
 	if (cfg_audit) {
 		total_num_msgs += num_msgs;
 		total_num_sends += num_sends;
+		total_num_batches += stat_batches;
 	}
+	stat_batches = 0;
 }
 
 int main(int argc, char **argv)
@@ -656,7 +956,7 @@ int main(int argc, char **argv)
 	if (fd == -1)
 		error(1, errno, "socket");
 
-	if (cfg_zerocopy) {
+	if (cfg_zerocopy && !cfg_io_uring) {
 		val = 1;
 
 		ret = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY,
@@ -680,6 +980,12 @@ int main(int argc, char **argv)
 	if (cfg_tx_tstamp)
 		set_tx_timestamping(fd);
 
+	if (cfg_txtime_rate)
+		set_txtime(fd);
+
+	if (cfg_io_uring)
+		setup_io_uring(fd);
+
 	num_msgs = num_sends = 0;
 	tnow = gettimeofday_ms();
 	tstart = tnow;
@@ -691,14 +997,25 @@ int main(int argc, char **argv)
 	do {
 		if (cfg_tcp)
 			num_sends += send_tcp(fd, buf[i]);
+		else if (cfg_io_uring)
+			num_sends += send_udp_io_uring(fd, i);
+		else if (cfg_segment && cfg_batch > 1)
+			num_sends += send_udp_segment_batch(fd, i);
 		else if (cfg_segment)
 			num_sends += send_udp_segment(fd, buf[i]);
 		else if (cfg_sendmmsg)
 			num_sends += send_udp_sendmmsg(fd, buf[i]);
 		else
 			num_sends += send_udp(fd, buf[i]);
-		num_msgs++;
-		if ((cfg_zerocopy && ((num_msgs & 0xF) == 0)) || cfg_tx_tstamp)
+		/* each iteration sends one msg, or one batch with -B */
+		num_msgs += cfg_batch;
+
+		/* io_uring reports zerocopy completions on its own cq.
+		 * Otherwise flush each time num_msgs crosses a multiple of 16.
+		 */
+		if ((cfg_zerocopy && !cfg_io_uring &&
+		     ((num_msgs - cfg_batch) >> 4) != (num_msgs >> 4)) ||
+		    cfg_tx_tstamp)
 			flush_errqueue(fd, cfg_poll, 500, true);
 
 		if (cfg_msg_nr && num_msgs >= cfg_msg_nr)
@@ -713,11 +1030,13 @@ int main(int argc, char **argv)
 
 		/* cold cache when writing buffer */
 		if (cfg_cache_trash)
-			i = ++i < NUM_PKT ? i : 0;
+			i = (i + cfg_batch) % NUM_PKT;
 
 	} while (!interrupted && (cfg_runtime_ms == -1 || tnow < tstop));
 
-	if (cfg_zerocopy || cfg_tx_tstamp)
+	if (cfg_io_uring)
+		flush_io_uring();
+	else if (cfg_zerocopy || cfg_tx_tstamp)
 		flush_errqueue_retry(fd, num_sends);
 
 	if (close(fd))
@@ -727,6 +1046,7 @@ int main(int argc, char **argv)
 		tend = tnow;
 		total_num_msgs += num_msgs;
 		total_num_sends += num_sends;
+		total_num_batches += stat_batches;
 		print_audit_report(total_num_msgs, total_num_sends);
 	}
 